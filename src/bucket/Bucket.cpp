@@ -21,13 +21,14 @@
 #include "util/XDRStream.h"
 #include "util/make_unique.h"
 #include "xdrpp/message.h"
-#include "database/Database.h"
+#include "database/ReadSnapshot.h"
 #include "ledger/EntryFrame.h"
 #include "ledger/LedgerDelta.h"
 #include "medida/medida.h"
 #include "lib/util/format.h"
 
 #include <cassert>
+#include <exception>
 #include <future>
 
 namespace stellar
@@ -176,7 +177,8 @@ class Bucket::OutputIterator
     bool mKeepDeadEntries{true};
 
   public:
-    OutputIterator(std::string const& tmpDir, bool keepDeadEntries)
+    OutputIterator(std::string const& tmpDir, bool keepDeadEntries,
+                   bool compress)
         : mFilename(randomBucketName(tmpDir))
         , mBuf(nullptr)
         , mHasher(SHA256::create())
@@ -184,7 +186,8 @@ class Bucket::OutputIterator
     {
         CLOG(TRACE, "Bucket")
             << "Bucket::OutputIterator opening file to write: " << mFilename;
-        mOut.open(mFilename);
+        mOut.open(mFilename, compress ? XDROutputFileStream::BLOCK_COMPRESSED
+                                      : XDROutputFileStream::RAW);
     }
 
     void
@@ -230,7 +233,11 @@ class Bucket::OutputIterator
             mBuf.reset();
         }
 
-        mOut.close();
+        if (!mOut.close())
+        {
+            throw std::runtime_error("failed to write bucket file: " +
+                                     mFilename);
+        }
         if (mObjectsPut == 0 || mBytesPut == 0)
         {
             assert(mObjectsPut == 0);
@@ -338,8 +345,9 @@ Bucket::fresh(BucketManager& bucketManager,
 
     std::sort(dead.begin(), dead.end(), BucketEntryIdCmp());
 
-    OutputIterator liveOut(bucketManager.getTmpDir(), true);
-    OutputIterator deadOut(bucketManager.getTmpDir(), true);
+    bool compress = bucketManager.getCompressBuckets();
+    OutputIterator liveOut(bucketManager.getTmpDir(), true, compress);
+    OutputIterator deadOut(bucketManager.getTmpDir(), true, compress);
     for (auto const& e : live)
     {
         liveOut.put(e);
@@ -405,7 +413,8 @@ Bucket::merge(BucketManager& bucketManager,
                                                        shadows.end());
 
     auto timer = bucketManager.getMergeTimer().TimeScope();
-    Bucket::OutputIterator out(bucketManager.getTmpDir(), keepDeadEntries);
+    Bucket::OutputIterator out(bucketManager.getTmpDir(), keepDeadEntries,
+                               bucketManager.getCompressBuckets());
 
     BucketEntryIdCmp cmp;
     while (oi || ni)
@@ -457,43 +466,17 @@ compareSizes(std::string const& objType, uint64_t inDatabase,
     }
 }
 
-// FIXME issue NNN: this should be refactored to run in a read-transaction on a
-// background thread and take a soci::session& rather than Database&. For now we
-// code it to run on main thread because there's a bunch of code to move around
-// in the ledger frames and db layer to make that work.
-
-void
-checkDBAgainstBuckets(medida::MetricsRegistry& metrics,
-                      BucketManager& bucketManager, Database& db,
-                      BucketList& bl)
+// Steps 2-4 of checkDBAgainstBuckets; only touches the buckets and the
+// snapshot, so it can run on a worker thread.
+static void
+checkSnapshotAgainstBuckets(medida::MetricsRegistry& metrics,
+                            BucketManager& bucketManager,
+                            ReadSnapshot& snapshot,
+                            std::vector<std::shared_ptr<Bucket>> const& buckets)
 {
-    CLOG(INFO, "Bucket") << "CheckDB starting";
     auto execTimer =
         metrics.NewTimer({"bucket", "checkdb", "execute"}).TimeScope();
 
-    // Step 1: Collect all buckets to merge.
-    std::vector<std::shared_ptr<Bucket>> buckets;
-    for (size_t i = 0; i < BucketList::kNumLevels; ++i)
-    {
-        CLOG(INFO, "Bucket") << "CheckDB collecting buckets from level " << i;
-        auto& level = bl.getLevel(i);
-        auto& next = level.getNext();
-        if (next.isLive())
-        {
-            CLOG(INFO, "Bucket") << "CheckDB resolving future bucket on level "
-                                 << i;
-            buckets.push_back(next.resolve());
-        }
-        buckets.push_back(level.getCurr());
-        buckets.push_back(level.getSnap());
-    }
-
-    if (buckets.empty())
-    {
-        CLOG(INFO, "Bucket") << "CheckDB found no buckets, returning";
-        return;
-    }
-
     // Step 2: merge all buckets into a single super-bucket.
     auto i = buckets.begin();
     assert(i != buckets.end());
@@ -536,7 +519,7 @@ checkDBAgainstBuckets(medida::MetricsRegistry& metrics,
                     ++nOffers;
                     break;
                 }
-                EntryFrame::checkAgainstDatabase(e.liveEntry(), db);
+                EntryFrame::checkAgainstDatabase(e.liveEntry(), snapshot);
                 if (meter.count() % 100 == 0)
                 {
                     CLOG(INFO, "Bucket") << "CheckDB compared " << meter.count()
@@ -547,9 +530,79 @@ checkDBAgainstBuckets(medida::MetricsRegistry& metrics,
     }
 
     // Step 4: confirm size of datasets matches size of datasets in DB.
-    soci::session& sess = db.getSession();
-    compareSizes("account", AccountFrame::countObjects(sess), nAccounts);
-    compareSizes("trustline", TrustFrame::countObjects(sess), nTrustLines);
+    soci::session& sess = snapshot.getSession();
+    auto kv = snapshot.getEntryKVStore();
+    compareSizes("account", kv ? kv->countObjects(ACCOUNT)
+                               : AccountFrame::countObjects(sess),
+                 nAccounts);
+    compareSizes("trustline", kv ? kv->countObjects(TRUSTLINE)
+                                 : TrustFrame::countObjects(sess),
+                 nTrustLines);
     compareSizes("offer", OfferFrame::countObjects(sess), nOffers);
 }
+
+void
+checkDBAgainstBuckets(Application& app, BucketList& bl)
+{
+    CLOG(INFO, "Bucket") << "CheckDB starting";
+
+    // Step 1: Collect all buckets to merge. This and taking the snapshot
+    // happen here on the main thread, between ledger closes, so the two
+    // describe the same ledger.
+    std::vector<std::shared_ptr<Bucket>> buckets;
+    for (size_t i = 0; i < BucketList::kNumLevels; ++i)
+    {
+        CLOG(INFO, "Bucket") << "CheckDB collecting buckets from level " << i;
+        auto& level = bl.getLevel(i);
+        auto& next = level.getNext();
+        if (next.isLive())
+        {
+            CLOG(INFO, "Bucket") << "CheckDB resolving future bucket on level "
+                                 << i;
+            buckets.push_back(next.resolve());
+        }
+        buckets.push_back(level.getCurr());
+        buckets.push_back(level.getSnap());
+    }
+
+    if (buckets.empty())
+    {
+        CLOG(INFO, "Bucket") << "CheckDB found no buckets, returning";
+        return;
+    }
+
+    auto snapshot = std::make_shared<ReadSnapshot>(app.getDatabase());
+    if (!snapshot->isPooled())
+    {
+        checkSnapshotAgainstBuckets(app.getMetrics(), app.getBucketManager(),
+                                    *snapshot, buckets);
+        return;
+    }
+
+    // The rest runs on a worker; an inconsistency is rethrown on the main
+    // thread, as it would be if the check had run there.
+    app.getWorkerIOService().post(
+        [&app, snapshot, buckets]()
+        {
+            std::exception_ptr err;
+            try
+            {
+                checkSnapshotAgainstBuckets(app.getMetrics(),
+                                            app.getBucketManager(), *snapshot,
+                                            buckets);
+            }
+            catch (...)
+            {
+                err = std::current_exception();
+            }
+            app.getClock().getIOService().post([err]()
+                                               {
+                                                   if (err)
+                                                   {
+                                                       std::rethrow_exception(
+                                                           err);
+                                                   }
+                                               });
+        });
+}
 }
@@ -27,6 +27,7 @@ namespace stellar
  * merged in sorted order, and all elements are hashed while being added.
  */
 
+class Application;
 class BucketManager;
 class BucketList;
 class Database;
@@ -107,7 +108,9 @@ class Bucket : public std::enable_shared_from_this<Bucket>,
           bool keepDeadEntries = true);
 };
 
-void checkDBAgainstBuckets(medida::MetricsRegistry& metrics,
-                           BucketManager& bucketManager, Database& db,
-                           BucketList& bl);
+// Check every live entry in the bucket list against the database, and the
+// entry counts, throwing on the first inconsistency. Call on the main thread:
+// when the database has a connection pool the comparison itself runs on a
+// worker against a ReadSnapshot of the current state.
+void checkDBAgainstBuckets(Application& app, BucketList& bl);
 }
@@ -52,6 +52,8 @@ class BucketManager : NonMovableOrCopyable
     }
     virtual std::string const& getTmpDir() = 0;
     virtual std::string const& getBucketDir() = 0;
+    // Whether newly written buckets should be block-compressed on disk.
+    virtual bool getCompressBuckets() const = 0;
     virtual BucketList& getBucketList() = 0;
 
     virtual medida::Timer& getMergeTimer() = 0;
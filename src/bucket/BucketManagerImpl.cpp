@@ -88,6 +88,12 @@ BucketManagerImpl::getTmpDir()
     return mWorkDir->getName();
 }
 
+bool
+BucketManagerImpl::getCompressBuckets() const
+{
+    return mApp.getConfig().COMPRESS_BUCKETS;
+}
+
 std::string const&
 BucketManagerImpl::getBucketDir()
 {
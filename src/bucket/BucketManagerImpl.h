@@ -53,6 +53,7 @@ class BucketManagerImpl : public BucketManager
     ~BucketManagerImpl() override;
     std::string const& getTmpDir() override;
     std::string const& getBucketDir() override;
+    bool getCompressBuckets() const override;
     BucketList& getBucketList() override;
     medida::Timer& getMergeTimer() override;
     std::shared_ptr<Bucket> adoptFileAsBucket(std::string const& filename,
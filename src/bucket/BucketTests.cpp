@@ -19,9 +19,11 @@
 #include "lib/catch.hpp"
 #include "main/Application.h"
 #include "main/test.h"
+#include "util/BlockCompressedFile.h"
 #include "util/Fs.h"
 #include "util/Logging.h"
 #include "util/Timer.h"
+#include "util/XDRStream.h"
 #include "util/TmpDir.h"
 #include "util/types.h"
 #include "xdrpp/autocheck.h"
@@ -432,6 +434,68 @@ TEST_CASE("file-backed buckets", "[bucket][bucketbench]")
     CLOG(DEBUG, "Bucket") << "Spill file size: " << fileSize(b1->getFilename());
 }
 
+TEST_CASE("compressed buckets", "[bucket][compress]")
+{
+    VirtualClock clock;
+    Config rawCfg(getTestConfig(0));
+    Config compressedCfg(getTestConfig(1));
+    compressedCfg.COMPRESS_BUCKETS = true;
+    Application::pointer rawApp = Application::create(clock, rawCfg);
+    Application::pointer compressedApp =
+        Application::create(clock, compressedCfg);
+    auto& rawBm = rawApp->getBucketManager();
+    auto& compressedBm = compressedApp->getBucketManager();
+
+    autocheck::generator<LedgerEntry> liveGen;
+    autocheck::generator<LedgerKey> deadGen;
+    std::vector<LedgerEntry> live(9000);
+    std::vector<LedgerKey> dead(1000);
+    for (auto& e : live)
+        e = liveGen(3);
+    for (auto& e : dead)
+        e = deadGen(3);
+
+    auto raw = Bucket::fresh(rawBm, live, dead);
+    auto compressed = Bucket::fresh(compressedBm, live, dead);
+    CHECK(!BlockCompressedFile::isBlockCompressed(raw->getFilename()));
+    CHECK(BlockCompressedFile::isBlockCompressed(compressed->getFilename()));
+    CLOG(DEBUG, "Bucket") << "Raw size: " << fileSize(raw->getFilename())
+                          << ", compressed size: "
+                          << fileSize(compressed->getFilename());
+
+    // Hashes are over the uncompressed XDR, so they must agree.
+    REQUIRE(raw->getHash() == compressed->getHash());
+    REQUIRE(countEntries(raw) == countEntries(compressed));
+
+    // Merging a compressed bucket with a raw one, as happens when catchup
+    // adopts downloaded buckets, must still produce the same bucket.
+    for (auto& e : live)
+        e = liveGen(3);
+    for (auto& e : dead)
+        e = deadGen(3);
+    auto newer = Bucket::fresh(rawBm, live, dead);
+    auto rawMerged = Bucket::merge(rawBm, raw, newer);
+    auto compressedMerged = Bucket::merge(compressedBm, compressed, newer);
+    CHECK(BlockCompressedFile::isBlockCompressed(
+        compressedMerged->getFilename()));
+    REQUIRE(rawMerged->getHash() == compressedMerged->getHash());
+
+    XDRInputFileStream rawIn;
+    XDRInputFileStream compressedIn;
+    rawIn.open(rawMerged->getFilename());
+    compressedIn.open(compressedMerged->getFilename());
+    BucketEntry re, ce;
+    size_t n = 0;
+    while (rawIn.readOne(re))
+    {
+        REQUIRE(compressedIn.readOne(ce));
+        REQUIRE(re == ce);
+        ++n;
+    }
+    CHECK(!compressedIn.readOne(ce));
+    CHECK(n == countEntries(rawMerged));
+}
+
 TEST_CASE("merging bucket entries", "[bucket]")
 {
     VirtualClock clock;
@@ -8,14 +8,20 @@
 #include "crypto/Base58.h"
 #include "crypto/Hex.h"
 #include "crypto/SHA.h"
+#include "crypto/SHA256Accel.h"
 #include "crypto/SecretKey.h"
 #include "crypto/Random.h"
 #include "crypto/StrKey.h"
+#include "crypto/VerifySigCache.h"
 #include "util/basen.h"
 #include <autocheck/autocheck.hpp>
 #include <sodium.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <map>
 #include <regex>
+#include <thread>
 
 using namespace stellar;
 
@@ -101,6 +107,118 @@ TEST_CASE("Stateful SHA256 tests", "[crypto]")
     }
 }
 
+static uint256
+sodiumSHA256(ByteSlice const& bin)
+{
+    uint256 out;
+    crypto_hash_sha256(out.data(), bin.data(), bin.size());
+    return out;
+}
+
+TEST_CASE("SHA256 backends", "[crypto][sha]")
+{
+    LOG(DEBUG) << "SHA extensions: " << sha256accel::haveSHANI()
+               << ", AVX2: " << sha256accel::haveAVX2();
+
+    // lengths around the block and padding boundaries, and random ones
+    std::vector<std::vector<uint8_t>> msgs;
+    for (size_t len : {0, 1, 55, 56, 63, 64, 65, 119, 120, 128, 1000})
+    {
+        msgs.push_back(randomBytes(len));
+    }
+    std::uniform_int_distribution<size_t> lens(0, 600);
+    for (size_t i = 0; i < 100; i++)
+    {
+        msgs.push_back(randomBytes(lens(autocheck::rng())));
+    }
+
+    std::vector<ByteSlice> bins(msgs.begin(), msgs.end());
+    auto batch = sha256Batch(bins);
+    REQUIRE(batch.size() == msgs.size());
+    for (size_t i = 0; i < msgs.size(); i++)
+    {
+        auto expected = sodiumSHA256(msgs[i]);
+        REQUIRE(sha256(msgs[i]) == expected);
+        REQUIRE(batch[i] == expected);
+
+        // added in uneven pieces
+        auto h = SHA256::create();
+        size_t pos = 0;
+        for (size_t step = 1; pos < msgs[i].size(); step = step * 3 + 1)
+        {
+            size_t n = std::min(step, msgs[i].size() - pos);
+            h->add(ByteSlice(msgs[i].data() + pos, n));
+            pos += n;
+        }
+        REQUIRE(h->finish() == expected);
+    }
+
+    // sha256Batch prefers the SHA extensions, so check AVX2 on its own
+    if (sha256accel::haveAVX2())
+    {
+        for (size_t i = 0; i + 8 <= msgs.size(); i += 5)
+        {
+            unsigned char const* data[8];
+            size_t sizes[8];
+            for (size_t j = 0; j < 8; j++)
+            {
+                data[j] = msgs[i + j].data();
+                sizes[j] = msgs[i + j].size();
+            }
+            size_t count = 1 + i % 8;
+            unsigned char out[8 * 32];
+            sha256accel::hashAVX2x8(data, sizes, count, out);
+            for (size_t j = 0; j < count; j++)
+            {
+                auto expected = sodiumSHA256(msgs[i + j]);
+                REQUIRE(std::equal(expected.begin(), expected.end(),
+                                   out + 32 * j));
+            }
+        }
+    }
+}
+
+TEST_CASE("SHA256 throughput", "[crypto-bench][bench][hide]")
+{
+    for (size_t len : {32, 256, 1024, 65536})
+    {
+        size_t n = std::max<size_t>(16, (64 << 20) / len / 4);
+        std::vector<std::vector<uint8_t>> msgs;
+        for (size_t i = 0; i < n; i++)
+        {
+            msgs.push_back(randomBytes(len));
+        }
+        std::vector<ByteSlice> bins(msgs.begin(), msgs.end());
+        double mb = double(n * len) / (1 << 20);
+
+        auto start = std::chrono::steady_clock::now();
+        for (auto const& m : msgs)
+        {
+            sodiumSHA256(m);
+        }
+        std::chrono::duration<double> sodium =
+            std::chrono::steady_clock::now() - start;
+
+        start = std::chrono::steady_clock::now();
+        for (auto const& m : msgs)
+        {
+            sha256(m);
+        }
+        std::chrono::duration<double> single =
+            std::chrono::steady_clock::now() - start;
+
+        start = std::chrono::steady_clock::now();
+        sha256Batch(bins);
+        std::chrono::duration<double> batch =
+            std::chrono::steady_clock::now() - start;
+
+        LOG(INFO) << len << "-byte messages: libsodium "
+                  << (mb / sodium.count()) << " MB/s, sha256 "
+                  << (mb / single.count()) << " MB/s, sha256Batch "
+                  << (mb / batch.count()) << " MB/s";
+    }
+}
+
 // Note: the fixed test vectors are based on the bitcoin alphabet; the stellar /
 // ripple alphabet is a permutation of it. But these ought to test the algorithm
 // relatively well and have been cross-checked against several implementations
@@ -325,6 +443,166 @@ TEST_CASE("sign and verify benchmarking", "[crypto-bench][bench][hide]")
     }
 }
 
+TEST_CASE("signature verification cache", "[crypto][sigcache]")
+{
+    std::vector<SignVerifyTestcase> cases;
+    for (size_t i = 0; i < 200; ++i)
+    {
+        cases.push_back(SignVerifyTestcase::create());
+        cases.back().sign();
+    }
+    auto& a = cases[0];
+
+    SECTION("entries are found by key, signature and message")
+    {
+        VerifySigCache cache(VerifySigCache::NUM_SHARDS * 4);
+        auto h = cache.hash(a.pub, a.sig, a.msg);
+        bool valid = false;
+        REQUIRE(!cache.lookup(h, a.pub, a.sig, valid));
+        cache.insert(h, a.pub, a.sig, true);
+        REQUIRE(cache.lookup(h, a.pub, a.sig, valid));
+        REQUIRE(valid);
+
+        auto msg = a.msg;
+        msg[0] ^= 1;
+        REQUIRE(cache.hash(a.pub, a.sig, msg) != h);
+        auto sig = a.sig;
+        sig[0] ^= 1;
+        REQUIRE(!cache.lookup(h, a.pub, sig, valid));
+        REQUIRE(!cache.lookup(h, cases[1].pub, a.sig, valid));
+
+        uint64_t hits = 0, misses = 0;
+        for (auto const& c : cache.flushCounts())
+        {
+            hits += c.mHits;
+            misses += c.mMisses;
+        }
+        REQUIRE(hits == 1);
+        REQUIRE(misses == 3);
+        REQUIRE(cache.flushCounts()[0].mHits == 0);
+    }
+
+    SECTION("recently used entries are not evicted")
+    {
+        VerifySigCache cache(VerifySigCache::NUM_SHARDS * 4);
+        REQUIRE(cache.getCapacity() == VerifySigCache::NUM_SHARDS * 4);
+        auto ha = cache.hash(a.pub, a.sig, a.msg);
+        cache.insert(ha, a.pub, a.sig, true);
+        bool valid;
+        for (size_t i = 1; i < cases.size(); i++)
+        {
+            auto& c = cases[i];
+            REQUIRE(cache.lookup(ha, a.pub, a.sig, valid));
+            cache.insert(cache.hash(c.pub, c.sig, c.msg), c.pub, c.sig, true);
+        }
+
+        size_t cached = 0;
+        for (auto& c : cases)
+        {
+            if (cache.lookup(cache.hash(c.pub, c.sig, c.msg), c.pub, c.sig,
+                             valid))
+            {
+                cached++;
+            }
+        }
+        REQUIRE(cache.lookup(ha, a.pub, a.sig, valid));
+        REQUIRE(cached <= cache.getCapacity());
+
+        cache.clear();
+        REQUIRE(!cache.lookup(ha, a.pub, a.sig, valid));
+    }
+
+    SECTION("verifySig caches its results")
+    {
+        uint64_t hits, misses, ignores;
+        PubKeyUtils::clearVerifySigCache();
+        PubKeyUtils::flushVerifySigCacheCounts(hits, misses, ignores);
+        REQUIRE(PubKeyUtils::verifySig(a.pub, a.sig, a.msg));
+        REQUIRE(PubKeyUtils::verifySig(a.pub, a.sig, a.msg));
+        REQUIRE(!PubKeyUtils::verifySig(a.pub, cases[1].sig, a.msg));
+        REQUIRE(!PubKeyUtils::verifySig(a.pub, cases[1].sig, a.msg));
+        PubKeyUtils::flushVerifySigCacheCounts(hits, misses, ignores);
+        REQUIRE(hits == 2);
+        REQUIRE(misses == 2);
+    }
+
+    SECTION("resizing to the same size keeps the cache")
+    {
+        uint64_t hits, misses, ignores;
+        // not a multiple of the shard count, as with the default size
+        size_t capacity = VerifySigCache::NUM_SHARDS * 64 - 1;
+        PubKeyUtils::resizeVerifySigCache(capacity);
+        REQUIRE(PubKeyUtils::verifySig(a.pub, a.sig, a.msg));
+        PubKeyUtils::flushVerifySigCacheCounts(hits, misses, ignores);
+
+        PubKeyUtils::resizeVerifySigCache(capacity);
+        REQUIRE(PubKeyUtils::verifySig(a.pub, a.sig, a.msg));
+        PubKeyUtils::flushVerifySigCacheCounts(hits, misses, ignores);
+        REQUIRE(hits == 1);
+
+        PubKeyUtils::resizeVerifySigCache(capacity * 2);
+        REQUIRE(PubKeyUtils::verifySig(a.pub, a.sig, a.msg));
+        PubKeyUtils::flushVerifySigCacheCounts(hits, misses, ignores);
+        REQUIRE(hits == 0);
+        REQUIRE(misses == 1);
+        PubKeyUtils::resizeVerifySigCache(0xffff);
+    }
+}
+
+TEST_CASE("signature cache benchmarking", "[crypto-bench][bench][hide]")
+{
+    size_t const n = 10000;
+    size_t const rounds = 20;
+    std::vector<SignVerifyTestcase> cases;
+    for (size_t i = 0; i < n; ++i)
+    {
+        cases.push_back(SignVerifyTestcase::create());
+        cases.back().sign();
+    }
+    PubKeyUtils::resizeVerifySigCache(2 * n);
+    for (auto& c : cases)
+    {
+        c.verify();
+    }
+
+    // threads verifying the same, cached, signatures at once
+    for (size_t threads = 1; threads <= 8; threads *= 2)
+    {
+        std::atomic<size_t> failed{0};
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> workers;
+        for (size_t t = 0; t < threads; t++)
+        {
+            workers.emplace_back([&cases, &failed, t]()
+                                 {
+                                     for (size_t r = 0; r < rounds; r++)
+                                     {
+                                         for (size_t i = t; i < n + t; i++)
+                                         {
+                                             auto& c = cases[i % n];
+                                             if (!PubKeyUtils::verifySig(
+                                                     c.pub, c.sig, c.msg))
+                                             {
+                                                 failed++;
+                                             }
+                                         }
+                                     }
+                                 });
+        }
+        for (auto& w : workers)
+        {
+            w.join();
+        }
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+        REQUIRE(failed == 0);
+        LOG(INFO) << threads << " threads: "
+                  << (threads * rounds * n / elapsed.count())
+                  << " cached verifications/s";
+    }
+    PubKeyUtils::resizeVerifySigCache(0xffff);
+}
+
 TEST_CASE("StrKey tests", "[crypto]")
 {
     std::regex b32("^([A-Z2-7])+$");
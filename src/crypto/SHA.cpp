@@ -4,17 +4,43 @@
 
 #include "crypto/SHA.h"
 #include "crypto/ByteSlice.h"
+#include "crypto/SHA256Accel.h"
 #include <sodium.h>
+#include <algorithm>
+#include <cstring>
 #include "util/make_unique.h"
 #include "util/NonCopyable.h"
 
 namespace stellar
 {
 
+// SHA256 on the SHA extensions, when the CPU has them: the same as
+// SHA256Impl below with the compression function replaced.
+class SHA256NIImpl : public SHA256, NonCopyable
+{
+    uint32_t mState[8];
+    unsigned char mBuffer[64];
+    size_t mBuffered;
+    uint64_t mLength;
+    bool mFinished;
+
+  public:
+    SHA256NIImpl();
+    void reset() override;
+    void add(ByteSlice const& bin) override;
+    uint256 finish() override;
+};
+
 // Plain SHA256
 uint256
 sha256(ByteSlice const& bin)
 {
+    if (sha256accel::haveSHANI())
+    {
+        SHA256NIImpl h;
+        h.add(bin);
+        return h.finish();
+    }
     uint256 out;
     if (crypto_hash_sha256(out.data(), bin.data(), bin.size()) != 0)
     {
@@ -23,6 +49,46 @@ sha256(ByteSlice const& bin)
     return out;
 }
 
+std::vector<uint256>
+sha256Batch(std::vector<ByteSlice> const& bins)
+{
+    std::vector<uint256> res(bins.size());
+    size_t i = 0;
+    // a single message is hashed faster by the SHA extensions than eight
+    // are by AVX2; without either, one at a time with libsodium
+    if (!sha256accel::haveSHANI() && sha256accel::haveAVX2())
+    {
+        for (; bins.size() - i >= 2; i += 8)
+        {
+            size_t count = std::min<size_t>(8, bins.size() - i);
+            unsigned char const* msgs[8];
+            size_t lens[8];
+            for (size_t j = 0; j < count; j++)
+            {
+                msgs[j] = bins[i + j].data();
+                lens[j] = bins[i + j].size();
+            }
+            unsigned char out[8 * 32];
+            sha256accel::hashAVX2x8(msgs, lens, count, out);
+            for (size_t j = 0; j < count; j++)
+            {
+                std::copy(out + 32 * j, out + 32 * (j + 1),
+                          res[i + j].begin());
+            }
+            if (count < 8)
+            {
+                i += count;
+                break;
+            }
+        }
+    }
+    for (; i < bins.size(); i++)
+    {
+        res[i] = sha256(bins[i]);
+    }
+    return res;
+}
+
 class SHA256Impl : public SHA256, NonCopyable
 {
     crypto_hash_sha256_state mState;
@@ -38,6 +104,10 @@ class SHA256Impl : public SHA256, NonCopyable
 std::unique_ptr<SHA256>
 SHA256::create()
 {
+    if (sha256accel::haveSHANI())
+    {
+        return make_unique<SHA256NIImpl>();
+    }
     return make_unique<SHA256Impl>();
 }
 
@@ -84,4 +154,96 @@ SHA256Impl::finish()
     }
     return out;
 }
+
+SHA256NIImpl::SHA256NIImpl() : mFinished(false)
+{
+    reset();
+}
+
+void
+SHA256NIImpl::reset()
+{
+    static uint32_t const initial[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372,
+                                        0xa54ff53a, 0x510e527f, 0x9b05688c,
+                                        0x1f83d9ab, 0x5be0cd19};
+    std::copy(initial, initial + 8, mState);
+    mBuffered = 0;
+    mLength = 0;
+    mFinished = false;
+}
+
+void
+SHA256NIImpl::add(ByteSlice const& bin)
+{
+    if (mFinished)
+    {
+        throw std::runtime_error("adding bytes to finished SHA256");
+    }
+    unsigned char const* data = bin.data();
+    size_t size = bin.size();
+    if (size == 0)
+    {
+        return;
+    }
+    mLength += size;
+
+    if (mBuffered != 0)
+    {
+        size_t n = std::min(size, sizeof(mBuffer) - mBuffered);
+        std::memcpy(mBuffer + mBuffered, data, n);
+        mBuffered += n;
+        data += n;
+        size -= n;
+        if (mBuffered < sizeof(mBuffer))
+        {
+            return;
+        }
+        sha256accel::compressSHANI(mState, mBuffer, 1);
+        mBuffered = 0;
+    }
+
+    size_t blocks = size / 64;
+    sha256accel::compressSHANI(mState, data, blocks);
+    data += 64 * blocks;
+    size -= 64 * blocks;
+
+    if (size != 0)
+    {
+        std::memcpy(mBuffer, data, size);
+        mBuffered = size;
+    }
+}
+
+uint256
+SHA256NIImpl::finish()
+{
+    if (mFinished)
+    {
+        throw std::runtime_error("finishing already-finished SHA256");
+    }
+
+    // 0x80, zeroes up to 8 bytes short of a block, then the length in bits
+    unsigned char tail[128] = {0};
+    std::memcpy(tail, mBuffer, mBuffered);
+    tail[mBuffered] = 0x80;
+    size_t tailLen = (mBuffered + 9 <= 64) ? 64 : 128;
+    uint64_t bits = mLength * 8;
+    for (size_t i = 0; i < 8; i++)
+    {
+        tail[tailLen - 1 - i] = static_cast<unsigned char>(bits >> (8 * i));
+    }
+    uint32_t state[8];
+    std::copy(mState, mState + 8, state);
+    sha256accel::compressSHANI(state, tail, tailLen / 64);
+
+    uint256 out;
+    for (size_t i = 0; i < 8; i++)
+    {
+        out[4 * i] = static_cast<unsigned char>(state[i] >> 24);
+        out[4 * i + 1] = static_cast<unsigned char>(state[i] >> 16);
+        out[4 * i + 2] = static_cast<unsigned char>(state[i] >> 8);
+        out[4 * i + 3] = static_cast<unsigned char>(state[i]);
+    }
+    return out;
+}
 }
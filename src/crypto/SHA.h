@@ -7,6 +7,7 @@
 #include "xdr/Stellar-types.h"
 #include "crypto/ByteSlice.h"
 #include <memory>
+#include <vector>
 
 namespace stellar
 {
@@ -14,6 +15,10 @@ namespace stellar
 // Plain SHA256
 uint256 sha256(ByteSlice const& bin);
 
+// SHA256 of each of `bins`, several at once where the CPU allows it: for
+// many small independent messages, such as the transactions of a set.
+std::vector<uint256> sha256Batch(std::vector<ByteSlice> const& bins);
+
 // SHA256 in incremental mode, for large inputs.
 class SHA256
 {
@@ -0,0 +1,386 @@
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "crypto/SHA256Accel.h"
+#include <cstring>
+#include <stdexcept>
+
+#if (defined(__x86_64__) || defined(__i386__)) &&                             \
+    (defined(__GNUC__) || defined(__clang__))
+#define STELLAR_SHA256_ACCEL 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+namespace stellar
+{
+namespace sha256accel
+{
+
+#ifdef STELLAR_SHA256_ACCEL
+
+namespace
+{
+
+alignas(16) uint32_t const K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+uint32_t const H0[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+struct Features
+{
+    bool mSHANI{false};
+    bool mAVX2{false};
+
+    Features()
+    {
+        unsigned int a, b, c, d;
+        if (__get_cpuid_max(0, nullptr) < 7 || !__get_cpuid(1, &a, &b, &c, &d))
+        {
+            return;
+        }
+        bool ssse3 = (c & (1u << 9)) != 0;
+        bool sse41 = (c & (1u << 19)) != 0;
+        bool osxsave = (c & (1u << 27)) != 0;
+        bool avx = (c & (1u << 28)) != 0;
+
+        __cpuid_count(7, 0, a, b, c, d);
+        bool sha = (b & (1u << 29)) != 0;
+        bool avx2 = (b & (1u << 5)) != 0;
+
+        // the OS must save the YMM registers for AVX2 to be usable
+        bool ymm = false;
+        if (osxsave && avx)
+        {
+            uint32_t lo, hi;
+            __asm__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+            ymm = (lo & 6) == 6;
+        }
+
+        mSHANI = sha && ssse3 && sse41;
+        mAVX2 = avx2 && ymm;
+    }
+};
+
+Features const&
+getFeatures()
+{
+    static Features const features;
+    return features;
+}
+
+// the padded last block(s) of a message: what follows its full blocks
+size_t
+padTail(unsigned char const* msg, size_t len, unsigned char tail[128])
+{
+    size_t full = len & ~size_t(63);
+    size_t rest = len - full;
+    size_t tailLen = (rest + 9 <= 64) ? 64 : 128;
+    std::memset(tail, 0, tailLen);
+    if (rest != 0)
+    {
+        std::memcpy(tail, msg + full, rest);
+    }
+    tail[rest] = 0x80;
+    uint64_t bits = uint64_t(len) * 8;
+    for (int i = 0; i < 8; i++)
+    {
+        tail[tailLen - 1 - i] = static_cast<unsigned char>(bits >> (8 * i));
+    }
+    return tailLen;
+}
+
+__attribute__((target("sha,sse4.1,ssse3"))) void
+compressSHANIImpl(uint32_t state[8], unsigned char const* data,
+                  size_t numBlocks)
+{
+    __m128i const mask =
+        _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    // the round instructions want the state as ABEF and CDGH
+    __m128i tmp = _mm_loadu_si128(reinterpret_cast<__m128i const*>(state));
+    __m128i state1 =
+        _mm_loadu_si128(reinterpret_cast<__m128i const*>(state + 4));
+    tmp = _mm_shuffle_epi32(tmp, 0xB1);
+    state1 = _mm_shuffle_epi32(state1, 0x1B);
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+    for (; numBlocks != 0; numBlocks--, data += 64)
+    {
+        __m128i abefSave = state0;
+        __m128i cdghSave = state1;
+
+        // w[g] holds the message words of rounds 4g to 4g+3, for g modulo 4
+        __m128i w[4];
+        for (int g = 0; g < 4; g++)
+        {
+            w[g] = _mm_shuffle_epi8(
+                _mm_loadu_si128(
+                    reinterpret_cast<__m128i const*>(data + 16 * g)),
+                mask);
+        }
+
+        for (int g = 0; g < 16; g++)
+        {
+            __m128i& cur = w[g & 3];
+            __m128i& prev = w[(g + 3) & 3];
+            __m128i& next = w[(g + 1) & 3];
+
+            __m128i msg = _mm_add_epi32(
+                cur, _mm_load_si128(reinterpret_cast<__m128i const*>(K) + g));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+            if (g >= 3 && g < 15)
+            {
+                // finish the words of the next group
+                tmp = _mm_alignr_epi8(cur, prev, 4);
+                next = _mm_add_epi32(next, tmp);
+                next = _mm_sha256msg2_epu32(next, cur);
+            }
+            msg = _mm_shuffle_epi32(msg, 0x0E);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+            if (g >= 1 && g < 13)
+            {
+                // start on the words of the group after the next
+                prev = _mm_sha256msg1_epu32(prev, cur);
+            }
+        }
+
+        state0 = _mm_add_epi32(state0, abefSave);
+        state1 = _mm_add_epi32(state1, cdghSave);
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1B);
+    state1 = _mm_shuffle_epi32(state1, 0xB1);
+    state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+    state1 = _mm_alignr_epi8(state1, tmp, 8);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state), state0);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state + 4), state1);
+}
+
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+AVX2_TARGET inline __m256i
+rotr(__m256i x, int n)
+{
+    return _mm256_or_si256(_mm256_srli_epi32(x, n),
+                           _mm256_slli_epi32(x, 32 - n));
+}
+
+AVX2_TARGET inline __m256i
+add(__m256i a, __m256i b)
+{
+    return _mm256_add_epi32(a, b);
+}
+
+AVX2_TARGET inline __m256i
+bxor(__m256i a, __m256i b, __m256i c)
+{
+    return _mm256_xor_si256(_mm256_xor_si256(a, b), c);
+}
+
+inline uint32_t
+loadBE(unsigned char const* p)
+{
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) |
+           (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+AVX2_TARGET void
+hashAVX2x8Impl(unsigned char const* const* msgs, size_t const* lens,
+               size_t count, unsigned char* out)
+{
+    unsigned char tails[8][128];
+    size_t fullBlocks[8];
+    size_t numBlocks[8];
+    size_t maxBlocks = 0;
+    for (size_t i = 0; i < 8; i++)
+    {
+        if (i < count)
+        {
+            fullBlocks[i] = lens[i] / 64;
+            numBlocks[i] =
+                fullBlocks[i] + padTail(msgs[i], lens[i], tails[i]) / 64;
+        }
+        else
+        {
+            // unused lanes hash an empty message, and are not written out
+            fullBlocks[i] = 0;
+            numBlocks[i] = padTail(nullptr, 0, tails[i]) / 64;
+        }
+        if (numBlocks[i] > maxBlocks)
+        {
+            maxBlocks = numBlocks[i];
+        }
+    }
+
+    __m256i s[8];
+    for (int j = 0; j < 8; j++)
+    {
+        s[j] = _mm256_set1_epi32(static_cast<int>(H0[j]));
+    }
+
+    for (size_t blk = 0; blk < maxBlocks; blk++)
+    {
+        unsigned char const* block[8];
+        uint32_t active[8];
+        for (size_t i = 0; i < 8; i++)
+        {
+            if (blk < fullBlocks[i])
+            {
+                block[i] = msgs[i] + 64 * blk;
+            }
+            else if (blk < numBlocks[i])
+            {
+                block[i] = tails[i] + 64 * (blk - fullBlocks[i]);
+            }
+            else
+            {
+                block[i] = tails[i];
+            }
+            active[i] = blk < numBlocks[i] ? 0xffffffff : 0;
+        }
+
+        __m256i w[64];
+        for (int t = 0; t < 16; t++)
+        {
+            w[t] = _mm256_setr_epi32(
+                loadBE(block[0] + 4 * t), loadBE(block[1] + 4 * t),
+                loadBE(block[2] + 4 * t), loadBE(block[3] + 4 * t),
+                loadBE(block[4] + 4 * t), loadBE(block[5] + 4 * t),
+                loadBE(block[6] + 4 * t), loadBE(block[7] + 4 * t));
+        }
+        for (int t = 16; t < 64; t++)
+        {
+            __m256i s0 = bxor(rotr(w[t - 15], 7), rotr(w[t - 15], 18),
+                              _mm256_srli_epi32(w[t - 15], 3));
+            __m256i s1 = bxor(rotr(w[t - 2], 17), rotr(w[t - 2], 19),
+                              _mm256_srli_epi32(w[t - 2], 10));
+            w[t] = add(add(w[t - 16], s0), add(w[t - 7], s1));
+        }
+
+        __m256i a = s[0], b = s[1], c = s[2], d = s[3];
+        __m256i e = s[4], f = s[5], g = s[6], h = s[7];
+        for (int t = 0; t < 64; t++)
+        {
+            __m256i S1 = bxor(rotr(e, 6), rotr(e, 11), rotr(e, 25));
+            __m256i ch = _mm256_xor_si256(_mm256_and_si256(e, f),
+                                          _mm256_andnot_si256(e, g));
+            __m256i t1 = add(add(add(h, S1), add(ch, w[t])),
+                             _mm256_set1_epi32(static_cast<int>(K[t])));
+            __m256i S0 = bxor(rotr(a, 2), rotr(a, 13), rotr(a, 22));
+            __m256i maj = bxor(_mm256_and_si256(a, b), _mm256_and_si256(a, c),
+                               _mm256_and_si256(b, c));
+            __m256i t2 = add(S0, maj);
+            h = g;
+            g = f;
+            f = e;
+            e = add(d, t1);
+            d = c;
+            c = b;
+            b = a;
+            a = add(t1, t2);
+        }
+
+        // lanes past the end of their message keep their digest
+        __m256i keep = _mm256_loadu_si256(reinterpret_cast<__m256i*>(active));
+        __m256i v[8] = {a, b, c, d, e, f, g, h};
+        for (int j = 0; j < 8; j++)
+        {
+            s[j] = _mm256_blendv_epi8(s[j], add(s[j], v[j]), keep);
+        }
+    }
+
+    alignas(32) uint32_t words[8][8];
+    for (int j = 0; j < 8; j++)
+    {
+        _mm256_store_si256(reinterpret_cast<__m256i*>(words[j]), s[j]);
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        for (int j = 0; j < 8; j++)
+        {
+            uint32_t x = words[j][i];
+            unsigned char* p = out + 32 * i + 4 * j;
+            p[0] = static_cast<unsigned char>(x >> 24);
+            p[1] = static_cast<unsigned char>(x >> 16);
+            p[2] = static_cast<unsigned char>(x >> 8);
+            p[3] = static_cast<unsigned char>(x);
+        }
+    }
+}
+}
+
+bool
+haveSHANI()
+{
+    return getFeatures().mSHANI;
+}
+
+bool
+haveAVX2()
+{
+    return getFeatures().mAVX2;
+}
+
+void
+compressSHANI(uint32_t state[8], unsigned char const* blocks,
+              size_t numBlocks)
+{
+    compressSHANIImpl(state, blocks, numBlocks);
+}
+
+void
+hashAVX2x8(unsigned char const* const* msgs, size_t const* lens,
+           size_t count, unsigned char* out)
+{
+    if (count > 8)
+    {
+        throw std::invalid_argument("hashAVX2x8 takes 8 messages at most");
+    }
+    hashAVX2x8Impl(msgs, lens, count, out);
+}
+
+#else
+
+bool
+haveSHANI()
+{
+    return false;
+}
+
+bool
+haveAVX2()
+{
+    return false;
+}
+
+void
+compressSHANI(uint32_t state[8], unsigned char const* blocks,
+              size_t numBlocks)
+{
+    throw std::runtime_error("SHA extensions not available");
+}
+
+void
+hashAVX2x8(unsigned char const* const* msgs, size_t const* lens,
+           size_t count, unsigned char* out)
+{
+    throw std::runtime_error("AVX2 not available");
+}
+
+#endif
+}
+}
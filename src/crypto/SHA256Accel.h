@@ -0,0 +1,39 @@
+#pragma once
+
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include <cstddef>
+#include <cstdint>
+
+namespace stellar
+{
+
+/**
+ * SHA256 with x86 extensions, picked at runtime from what the CPU reports.
+ *
+ * compressSHANI runs the compression function with the SHA extensions, and
+ * is what sha256() and SHA256 use when they are present. hashAVX2x8 hashes up
+ * to eight independent messages at once, one per 32-bit lane of the AVX2
+ * registers, for sha256Batch() on CPUs without the SHA extensions.
+ *
+ * Elsewhere, and with compilers other than GCC and clang, neither is
+ * available and libsodium does all the hashing.
+ */
+namespace sha256accel
+{
+bool haveSHANI();
+bool haveAVX2();
+
+// Run `numBlocks` 64-byte blocks through the compression function, on the
+// eight words of `state` (H0 to H7). Only when haveSHANI().
+void compressSHANI(uint32_t state[8], unsigned char const* blocks,
+                   size_t numBlocks);
+
+// Hash messages msgs[i] of lens[i] bytes, `count` of them, at most eight,
+// writing digest i at out + 32 * i. Only when haveAVX2().
+void hashAVX2x8(unsigned char const* const* msgs, size_t const* lens,
+                size_t count, unsigned char* out);
+}
+}
@@ -11,10 +11,8 @@
 #include <type_traits>
 #include <memory>
 #include "util/make_unique.h"
-#include "util/HashOfHash.h"
-#include <mutex>
-
-#include "util/lrucache.hpp"
+#include "crypto/VerifySigCache.h"
+#include <atomic>
 
 namespace stellar
 {
@@ -26,12 +24,8 @@ namespace stellar
 // makes all signature-verification in the program faster and
 // has no effect on correctness.
 
-static std::mutex gVerifySigCacheMutex;
-static cache::lru_cache<Hash, bool> gVerifySigCache(0xffff);
-static std::unique_ptr<SHA256> gHasher = SHA256::create();
-static uint64_t gVerifyCacheHit = 0;
-static uint64_t gVerifyCacheMiss = 0;
-static uint64_t gVerifyCacheIgnore = 0;
+static VerifySigCache gVerifySigCache(0xffff);
+static std::atomic<uint64_t> gVerifyCacheIgnore{0};
 
 static bool
 shouldCacheVerifySig(PublicKey const& key, Signature const& signature,
@@ -40,17 +34,6 @@ shouldCacheVerifySig(PublicKey const& key, Signature const& signature,
     return true;
 }
 
-static Hash
-verifySigCacheKey(PublicKey const& key, Signature const& signature,
-                  ByteSlice const& bin)
-{
-    gHasher->reset();
-    gHasher->add(key.ed25519());
-    gHasher->add(signature);
-    gHasher->add(bin);
-    return gHasher->finish();
-}
-
 SecretKey::SecretKey() : mKeyType(KEY_TYPE_ED25519)
 {
     static_assert(crypto_sign_PUBLICKEYBYTES == sizeof(uint256),
@@ -234,21 +217,33 @@ SecretKey::fromBase58Seed(std::string const& base58Seed)
 void
 PubKeyUtils::clearVerifySigCache()
 {
-    std::lock_guard<std::mutex> guard(gVerifySigCacheMutex);
     gVerifySigCache.clear();
 }
 
+void
+PubKeyUtils::resizeVerifySigCache(size_t capacity)
+{
+    // Applications created side by side all call this: only a real change
+    // of size may empty the process-wide cache.
+    if (VerifySigCache::roundCapacity(capacity) !=
+        gVerifySigCache.getCapacity())
+    {
+        gVerifySigCache.resize(capacity);
+    }
+}
+
 void
 PubKeyUtils::flushVerifySigCacheCounts(uint64_t& hits, uint64_t& misses,
                                        uint64_t& ignores)
 {
-    std::lock_guard<std::mutex> guard(gVerifySigCacheMutex);
-    hits = gVerifyCacheHit;
-    misses = gVerifyCacheMiss;
-    ignores = gVerifyCacheIgnore;
-    gVerifyCacheHit = 0;
-    gVerifyCacheMiss = 0;
-    gVerifyCacheIgnore = 0;
+    hits = 0;
+    misses = 0;
+    for (auto const& c : gVerifySigCache.flushCounts())
+    {
+        hits += c.mHits;
+        misses += c.mMisses;
+    }
+    ignores = gVerifyCacheIgnore.exchange(0);
 }
 
 bool
@@ -256,18 +251,16 @@ PubKeyUtils::verifySig(PublicKey const& key, Signature const& signature,
                        ByteSlice const& bin)
 {
     bool shouldCache = shouldCacheVerifySig(key, signature, bin);
-    Hash cacheKey;
+    uint64_t cacheKey = 0;
 
     if (shouldCache)
     {
-        cacheKey = verifySigCacheKey(key, signature, bin);
-        std::lock_guard<std::mutex> guard(gVerifySigCacheMutex);
-        if (gVerifySigCache.exists(cacheKey))
+        cacheKey = gVerifySigCache.hash(key, signature, bin);
+        bool ok;
+        if (gVerifySigCache.lookup(cacheKey, key, signature, ok))
         {
-            ++gVerifyCacheHit;
-            return gVerifySigCache.get(cacheKey);
+            return ok;
         }
-        ++gVerifyCacheMiss;
     }
     else
     {
@@ -279,8 +272,7 @@ PubKeyUtils::verifySig(PublicKey const& key, Signature const& signature,
                                      key.ed25519().data()) == 0);
     if (shouldCache)
     {
-        std::lock_guard<std::mutex> guard(gVerifySigCacheMutex);
-        gVerifySigCache.put(cacheKey, ok);
+        gVerifySigCache.insert(cacheKey, key, signature, ok);
     }
     return ok;
 }
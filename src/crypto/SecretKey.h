@@ -81,6 +81,8 @@ bool verifySig(PublicKey const& key, Signature const& signature,
                ByteSlice const& bin);
 
 void clearVerifySigCache();
+// Entries the verification cache holds; changing it empties the cache.
+void resizeVerifySigCache(size_t capacity);
 void flushVerifySigCacheCounts(uint64_t& hits, uint64_t& misses,
                                uint64_t& ignores);
 
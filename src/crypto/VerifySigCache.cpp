@@ -0,0 +1,162 @@
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "crypto/VerifySigCache.h"
+#include <algorithm>
+#include <cstring>
+#include <sodium.h>
+
+namespace stellar
+{
+
+static_assert(crypto_shorthash_BYTES == sizeof(uint64_t),
+              "Unexpected short hash length");
+static_assert(crypto_shorthash_KEYBYTES == 16, "Unexpected short hash key");
+
+VerifySigCache::VerifySigCache(size_t capacity)
+{
+    randombytes_buf(mHashKey.data(), mHashKey.size());
+    resize(capacity);
+}
+
+uint64_t
+VerifySigCache::hash(PublicKey const& key, Signature const& signature,
+                     ByteSlice const& bin) const
+{
+    // the message, then the message hash along with the key and signature
+    unsigned char buf[sizeof(uint64_t) + 32 + 64];
+    crypto_shorthash(buf, bin.data(), bin.size(), mHashKey.data());
+    std::memcpy(buf + sizeof(uint64_t), key.ed25519().data(), 32);
+    std::memcpy(buf + sizeof(uint64_t) + 32, signature.data(),
+                signature.size());
+
+    unsigned char out[sizeof(uint64_t)];
+    crypto_shorthash(out, buf, sizeof(uint64_t) + 32 + signature.size(),
+                     mHashKey.data());
+    uint64_t res;
+    std::memcpy(&res, out, sizeof(res));
+    return res;
+}
+
+bool
+VerifySigCache::matches(Slot const& slot, uint64_t hash, PublicKey const& key,
+                        Signature const& signature)
+{
+    return slot.mHash == hash && slot.mKey == key.ed25519() &&
+           slot.mSignatureSize == signature.size() &&
+           std::equal(signature.begin(), signature.end(),
+                      slot.mSignature.begin());
+}
+
+bool
+VerifySigCache::lookup(uint64_t hash, PublicKey const& key,
+                       Signature const& signature, bool& valid)
+{
+    auto& shard = mShards[hash % NUM_SHARDS];
+    std::lock_guard<std::mutex> guard(shard.mMutex);
+    auto it = shard.mIndex.find(hash);
+    if (it == shard.mIndex.end() ||
+        !matches(shard.mSlots[it->second], hash, key, signature))
+    {
+        ++shard.mCounts.mMisses;
+        return false;
+    }
+    auto& slot = shard.mSlots[it->second];
+    slot.mReferenced = true;
+    valid = slot.mValid;
+    ++shard.mCounts.mHits;
+    return true;
+}
+
+void
+VerifySigCache::insert(uint64_t hash, PublicKey const& key,
+                       Signature const& signature, bool valid)
+{
+    auto& shard = mShards[hash % NUM_SHARDS];
+    std::lock_guard<std::mutex> guard(shard.mMutex);
+    if (shard.mSlots.empty())
+    {
+        return;
+    }
+
+    size_t victim;
+    auto it = shard.mIndex.find(hash);
+    if (it != shard.mIndex.end())
+    {
+        victim = it->second;
+    }
+    else
+    {
+        // one turn at most clears every mark, so this ends within two
+        while (shard.mSlots[shard.mHand].mUsed &&
+               shard.mSlots[shard.mHand].mReferenced)
+        {
+            shard.mSlots[shard.mHand].mReferenced = false;
+            shard.mHand = (shard.mHand + 1) % shard.mSlots.size();
+        }
+        victim = shard.mHand;
+        shard.mHand = (shard.mHand + 1) % shard.mSlots.size();
+        if (shard.mSlots[victim].mUsed)
+        {
+            shard.mIndex.erase(shard.mSlots[victim].mHash);
+        }
+        shard.mIndex[hash] = victim;
+    }
+
+    auto& slot = shard.mSlots[victim];
+    slot.mHash = hash;
+    slot.mKey = key.ed25519();
+    slot.mSignatureSize = static_cast<uint8_t>(signature.size());
+    std::copy(signature.begin(), signature.end(), slot.mSignature.begin());
+    slot.mUsed = true;
+    slot.mReferenced = false;
+    slot.mValid = valid;
+}
+
+void
+VerifySigCache::clear()
+{
+    resize(getCapacity());
+}
+
+void
+VerifySigCache::resize(size_t capacity)
+{
+    size_t perShard = roundCapacity(capacity) / NUM_SHARDS;
+    for (auto& shard : mShards)
+    {
+        std::lock_guard<std::mutex> guard(shard.mMutex);
+        shard.mSlots.assign(perShard, Slot());
+        shard.mIndex.clear();
+        shard.mIndex.reserve(perShard);
+        shard.mHand = 0;
+    }
+    mCapacity = perShard * NUM_SHARDS;
+}
+
+size_t
+VerifySigCache::getCapacity() const
+{
+    return mCapacity;
+}
+
+size_t
+VerifySigCache::roundCapacity(size_t capacity)
+{
+    return (capacity + NUM_SHARDS - 1) / NUM_SHARDS * NUM_SHARDS;
+}
+
+std::vector<VerifySigCache::Counts>
+VerifySigCache::flushCounts()
+{
+    std::vector<Counts> res;
+    for (auto& shard : mShards)
+    {
+        std::lock_guard<std::mutex> guard(shard.mMutex);
+        res.push_back(shard.mCounts);
+        shard.mCounts = Counts();
+    }
+    return res;
+}
+}
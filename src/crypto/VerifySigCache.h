@@ -0,0 +1,99 @@
+#pragma once
+
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "crypto/ByteSlice.h"
+#include "util/NonCopyable.h"
+#include "xdr/Stellar-types.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace stellar
+{
+
+/**
+ * Fixed-capacity cache of signature verification results, split in shards
+ * that each have their own lock so that threads verifying at once rarely
+ * wait on each other.
+ *
+ * Entries are found by a SipHash of the key, the signature and the signed
+ * bytes, keyed with a secret picked at random when the cache is created, and
+ * also hold the key and the signature themselves. A hit thus needs another
+ * message with the same keyed hash as a cached one, which cannot be searched
+ * for without the secret.
+ *
+ * Each shard evicts with the CLOCK algorithm: a hit marks its entry, and the
+ * hand looking for a victim spares (and unmarks) marked entries.
+ */
+class VerifySigCache : NonMovableOrCopyable
+{
+  public:
+    static size_t const NUM_SHARDS = 16;
+
+    struct Counts
+    {
+        uint64_t mHits{0};
+        uint64_t mMisses{0};
+    };
+
+  private:
+    struct Slot
+    {
+        uint64_t mHash;
+        uint256 mKey;
+        std::array<unsigned char, 64> mSignature;
+        uint8_t mSignatureSize;
+        bool mUsed{false};
+        bool mReferenced{false};
+        bool mValid;
+    };
+
+    struct Shard
+    {
+        std::mutex mMutex;
+        std::vector<Slot> mSlots;
+        std::unordered_map<uint64_t, size_t> mIndex;
+        size_t mHand{0};
+        Counts mCounts;
+    };
+
+    std::array<unsigned char, 16> mHashKey;
+    std::array<Shard, NUM_SHARDS> mShards;
+    std::atomic<size_t> mCapacity{0};
+
+    static bool matches(Slot const& slot, uint64_t hash,
+                        PublicKey const& key, Signature const& signature);
+
+  public:
+    // `capacity` entries across the shards
+    explicit VerifySigCache(size_t capacity);
+
+    uint64_t hash(PublicKey const& key, Signature const& signature,
+                  ByteSlice const& bin) const;
+
+    // Whether a result is cached for `hash`, and if so `valid` is set to it.
+    bool lookup(uint64_t hash, PublicKey const& key, Signature const& signature,
+                bool& valid);
+    void insert(uint64_t hash, PublicKey const& key, Signature const& signature,
+                bool valid);
+
+    // Drop every entry; resize() also changes the capacity.
+    void clear();
+    void resize(size_t capacity);
+
+    size_t getCapacity() const;
+
+    // The capacity a cache asked for `capacity` entries gets: a whole
+    // number of entries per shard.
+    static size_t roundCapacity(size_t capacity);
+
+    // Hits and misses of each shard since the last flush, which zeroes them.
+    std::vector<Counts> flushCounts();
+};
+}
@@ -22,6 +22,7 @@
 #include "medida/timer.h"
 #include "medida/counter.h"
 
+#include <algorithm>
 #include <stdexcept>
 #include <vector>
 #include <sstream>
@@ -44,6 +45,8 @@ using namespace std;
 
 bool Database::gDriversRegistered = false;
 
+const unsigned long Database::SCHEMA_VERSION;
+
 static void
 setSerializable(soci::session& sess)
 {
@@ -64,15 +67,32 @@ Database::registerDrivers()
     }
 }
 
+std::string
+Database::getConnectionString(std::string const& database)
+{
+    auto const& prefix = EntryKVStore::DATABASE_PREFIX;
+    if (database.compare(0, prefix.size(), prefix) == 0)
+    {
+        return database.substr(prefix.size());
+    }
+    return database;
+}
+
 Database::Database(Application& app)
     : mApp(app)
+    , mConnectionString(getConnectionString(app.getConfig().DATABASE))
     , mStatementsSize(
           app.getMetrics().NewCounter({"database", "memory", "statements"}))
     , mEntryCache(4096)
+    , mEntryOverlay(app.getMetrics())
+    , mEntryPrefetch(app.getMetrics())
+    , mOrderBookCache(app.getMetrics())
+    , mInflationVoteTally(app.getMetrics())
+    , mSQLProfiler(app.getConfig().SQL_PROFILING)
 {
     registerDrivers();
     CLOG(INFO, "Database") << "Connecting to: " << app.getConfig().DATABASE;
-    mSession.open(app.getConfig().DATABASE);
+    mSession.open(mConnectionString);
     if (isSqlite())
     {
         mSession << "PRAGMA journal_mode = WAL";
@@ -81,6 +101,10 @@ Database::Database(Application& app)
     {
         setSerializable(mSession);
     }
+    if (mConnectionString != app.getConfig().DATABASE)
+    {
+        mEntryKVStore = make_unique<EntryKVStore>(mSession);
+    }
 }
 
 medida::TimerContext
@@ -130,35 +154,104 @@ Database::setCurrentTransactionReadOnly()
 bool
 Database::isSqlite() const
 {
-    return mApp.getConfig().DATABASE.find("sqlite3:") != std::string::npos;
+    return mConnectionString.find("sqlite3:") != std::string::npos;
 }
 
 bool
 Database::canUsePool() const
 {
-    return !(mApp.getConfig().DATABASE == ("sqlite3://:memory:"));
+    return !(mConnectionString == ("sqlite3://:memory:"));
 }
 
 void
-Database::initialize()
+Database::clearPreparedStatementCache()
 {
-    // Flush all prepared statements; in sqlite they represent open cursors
-    // and will conflict with any DROP TABLE commands issued below
     for (auto st : mStatements)
     {
         st.second->clean_up(true);
     }
     mStatements.clear();
+    mStatementsSize.set_count(mStatements.size());
+    if (mEntryKVStore)
+    {
+        mEntryKVStore->clearStatements();
+    }
+}
+
+void
+Database::initialize()
+{
+    // Flush all prepared statements; in sqlite they represent open cursors
+    // and will conflict with any DROP TABLE commands issued below
+    clearPreparedStatementCache();
 
     AccountFrame::dropAll(*this);
     OfferFrame::dropAll(*this);
     TrustFrame::dropAll(*this);
+    EntryKVStore::dropAll(*this);
+    mInflationVoteTally.clear();
     OverlayManager::dropAll(*this);
     PersistentState::dropAll(*this);
     ExternalQueue::dropAll(*this);
     LedgerHeaderFrame::dropAll(*this);
     TransactionFrame::dropAll(*this);
     BucketManager::dropAll(mApp);
+    putSchemaVersion(SCHEMA_VERSION);
+}
+
+unsigned long
+Database::getDBSchemaVersion() const
+{
+    assert(mSchemaVersion != 0);
+    return mSchemaVersion;
+}
+
+void
+Database::putSchemaVersion(unsigned long vers)
+{
+    mApp.getPersistentState().setState(PersistentState::kDatabaseSchema,
+                                       std::to_string(vers));
+    mSchemaVersion = vers;
+}
+
+void
+Database::upgradeToCurrentSchema()
+{
+    auto vstr =
+        mApp.getPersistentState().getState(PersistentState::kDatabaseSchema);
+    unsigned long vers = vstr.empty() ? 1 : std::stoul(vstr);
+    mSchemaVersion = vers;
+
+    if (vers > SCHEMA_VERSION)
+    {
+        std::string s = ("DB schema version " + std::to_string(vers) +
+                         " is newer than application schema " +
+                         std::to_string(SCHEMA_VERSION));
+        throw std::runtime_error(s);
+    }
+    while (vers < SCHEMA_VERSION)
+    {
+        ++vers;
+        CLOG(INFO, "Database") << "Applying DB schema upgrade to version "
+                               << vers;
+        applySchemaUpgrade(vers);
+        putSchemaVersion(vers);
+    }
+}
+
+void
+Database::applySchemaUpgrade(unsigned long vers)
+{
+    clearPreparedStatementCache();
+
+    switch (vers)
+    {
+    case 2:
+        TransactionFrame::upgradeHistoryToBinary(*this);
+        break;
+    default:
+        throw std::runtime_error("Unknown DB schema version");
+    }
 }
 
 soci::session&
@@ -172,9 +265,10 @@ Database::getSession()
 soci::connection_pool&
 Database::getPool()
 {
+    std::lock_guard<std::mutex> lock(mPoolMutex);
     if (!mPool)
     {
-        std::string const& c = mApp.getConfig().DATABASE;
+        std::string const& c = mConnectionString;
         if (!canUsePool())
         {
             std::string s("Can't create connection pool to ");
@@ -205,6 +299,59 @@ Database::getEntryCache()
     return mEntryCache;
 }
 
+LedgerEntryOverlay&
+Database::getEntryOverlay()
+{
+    return mEntryOverlay;
+}
+
+LedgerEntryPrefetch&
+Database::getEntryPrefetch()
+{
+    return mEntryPrefetch;
+}
+
+OrderBookCache&
+Database::getOrderBookCache()
+{
+    return mOrderBookCache;
+}
+
+InflationVoteTally&
+Database::getInflationVoteTally()
+{
+    return mInflationVoteTally;
+}
+
+SQLProfiler&
+Database::getSQLProfiler()
+{
+    return mSQLProfiler;
+}
+
+void
+StatementContext::record()
+{
+    auto micros = std::chrono::duration_cast<std::chrono::microseconds>(
+                      std::chrono::steady_clock::now() - mStart)
+                      .count();
+    long long rows = 0;
+    if (mProfile->mIsWrite)
+    {
+        // called from the destructor: a statement that never ran counts no
+        // rows rather than throwing
+        try
+        {
+            rows = std::max(mStmt->get_affected_rows(), 0LL);
+        }
+        catch (soci::soci_error&)
+        {
+        }
+    }
+    mProfiler->record(*mProfile, static_cast<uint64_t>(micros),
+                      static_cast<uint64_t>(rows));
+}
+
 class SQLLogContext : NonCopyable
 {
     std::string mName;
@@ -258,7 +405,7 @@ Database::getPreparedStatement(std::string const& query)
     {
         p = i->second;
     }
-    StatementContext sc(p);
+    StatementContext sc(p, mSQLProfiler, mSQLProfiler.getEntry(query));
     return sc;
 }
 
@@ -4,12 +4,20 @@
 // under the Apache License, Version 2.0. See the COPYING file at the root
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
+#include <chrono>
+#include <mutex>
 #include <string>
 #include <soci.h>
 #include "overlay/StellarXDR.h"
+#include "database/EntryKVStore.h"
+#include "database/SQLProfiler.h"
 #include "ledger/AccountFrame.h"
+#include "ledger/InflationVoteTally.h"
 #include "ledger/OfferFrame.h"
 #include "ledger/TrustFrame.h"
+#include "ledger/LedgerEntryOverlay.h"
+#include "ledger/LedgerEntryPrefetch.h"
+#include "ledger/OrderBookCache.h"
 #include "medida/timer_context.h"
 #include "util/NonCopyable.h"
 #include "util/lrucache.hpp"
@@ -34,21 +42,44 @@ class SQLLogContext;
 class StatementContext : NonCopyable
 {
     std::shared_ptr<soci::statement> mStmt;
+    SQLProfiler* mProfiler{nullptr};
+    SQLProfiler::Entry* mProfile{nullptr};
+    std::chrono::steady_clock::time_point mStart;
 
   public:
     StatementContext(std::shared_ptr<soci::statement> stmt) : mStmt(stmt)
     {
         mStmt->clean_up(false);
     }
+    // Reports to `profile` of `profiler` how long the statement is borrowed.
+    StatementContext(std::shared_ptr<soci::statement> stmt,
+                     SQLProfiler& profiler, SQLProfiler::Entry* profile)
+        : StatementContext(stmt)
+    {
+        if (profile)
+        {
+            mProfiler = &profiler;
+            mProfile = profile;
+            mStart = std::chrono::steady_clock::now();
+        }
+    }
     StatementContext(StatementContext&& other)
     {
         mStmt = other.mStmt;
+        mProfiler = other.mProfiler;
+        mProfile = other.mProfile;
+        mStart = other.mStart;
         other.mStmt.reset();
+        other.mProfile = nullptr;
     }
     ~StatementContext()
     {
         if (mStmt)
         {
+            if (mProfile)
+            {
+                record();
+            }
             mStmt->clean_up(false);
         }
     }
@@ -57,6 +88,9 @@ class StatementContext : NonCopyable
     {
         return *mStmt;
     }
+
+  private:
+    void record();
 };
 
 /**
@@ -74,6 +108,10 @@ class StatementContext : NonCopyable
  * "main connection" is where most SQL statements -- and all write-statements --
  * are executed.
  *
+ * A DATABASE string prefixed with "kv+" (e.g. "kv+sqlite3://stellar.db")
+ * selects the key-value backend for account and trustline entries: see
+ * EntryKVStore. The rest of the string is the connection string proper.
+ *
  * Database may establish additional connections for worker threads to read
  * data, from a separate connection pool, if worker threads request them. The
  * pool will connect to the same target and only one connection will be made per
@@ -86,19 +124,45 @@ class StatementContext : NonCopyable
 class Database : NonMovableOrCopyable
 {
     Application& mApp;
+    std::string mConnectionString;
     soci::session mSession;
+    // declared after mSession: its statements must go before the connection
+    std::unique_ptr<EntryKVStore> mEntryKVStore;
     std::unique_ptr<soci::connection_pool> mPool;
+    std::mutex mPoolMutex;
 
     std::map<std::string, std::shared_ptr<soci::statement>> mStatements;
     medida::Counter& mStatementsSize;
 
+    // Schema version of the connected database, as recorded in
+    // PersistentState; 0 until loaded by initialize() or
+    // upgradeToCurrentSchema().
+    unsigned long mSchemaVersion{0};
+
     cache::lru_cache<std::string, std::shared_ptr<LedgerEntry const>>
         mEntryCache;
 
+    LedgerEntryOverlay mEntryOverlay;
+    LedgerEntryPrefetch mEntryPrefetch;
+    OrderBookCache mOrderBookCache;
+
+    InflationVoteTally mInflationVoteTally;
+
+    SQLProfiler mSQLProfiler;
+
     static bool gDriversRegistered;
     static void registerDrivers();
 
+    void applySchemaUpgrade(unsigned long vers);
+
   public:
+    // Schema version written by this build. Databases that predate schema
+    // versioning are treated as version 1.
+    //
+    //   1: txhistory and txfeehistory store base64 XDR in TEXT columns.
+    //   2: txhistory and txfeehistory store raw XDR in BLOB/BYTEA columns.
+    static const unsigned long SCHEMA_VERSION = 2;
+
     // Instantiate object and connect to app.getConfig().DATABASE;
     // if there is a connection error, this will throw.
     Database(Application& app);
@@ -114,6 +178,10 @@ class Database : NonMovableOrCopyable
     // when the statement context is destroyed.
     StatementContext getPreparedStatement(std::string const& query);
 
+    // Release all cached prepared statements. In sqlite these hold open
+    // cursors that conflict with DROP TABLE and similar DDL.
+    void clearPreparedStatementCache();
+
     // Return metric-gathering timers for various families of SQL operation.
     // These timers automatically count the time they are alive for,
     // so only acquire them immediately before executing an SQL statement.
@@ -130,6 +198,18 @@ class Database : NonMovableOrCopyable
     // Return true if the Database target is SQLite, otherwise false.
     bool isSqlite() const;
 
+    // Return `database` without any backend prefix: the part SOCI connects
+    // to.
+    static std::string getConnectionString(std::string const& database);
+
+    // Return the key-value store holding account and trustline entries on
+    // the main connection, or nullptr when they live in their SQL tables.
+    EntryKVStore*
+    getEntryKVStore()
+    {
+        return mEntryKVStore.get();
+    }
+
     // Return true if a connection pool is available for worker threads
     // to read from the database through, otherwise false.
     bool canUsePool() const;
@@ -138,11 +218,23 @@ class Database : NonMovableOrCopyable
     // by the --newdb command-line flag on stellar-core.
     void initialize();
 
+    // Return the schema version of the connected database.
+    unsigned long getDBSchemaVersion() const;
+
+    // Record `vers` as the schema version of the connected database.
+    void putSchemaVersion(unsigned long vers);
+
+    // Bring an existing database up to SCHEMA_VERSION, one version step at a
+    // time. Each step commits before the version is bumped, so an
+    // interrupted upgrade resumes from the last completed step on restart.
+    void upgradeToCurrentSchema();
+
     // Access the underlying SOCI session object
     soci::session& getSession();
 
     // Access the optional SOCI connection pool available for worker
-    // threads. Throws an error if !canUsePool().
+    // threads. Throws an error if !canUsePool(). Safe to call from any
+    // thread.
     soci::connection_pool& getPool();
 
     // Access the LedgerEntry cache. Note: clients are responsible for
@@ -151,5 +243,21 @@ class Database : NonMovableOrCopyable
     typedef cache::lru_cache<std::string, std::shared_ptr<LedgerEntry const>>
         EntryCache;
     EntryCache& getEntryCache();
+
+    // Access the write-behind overlay for ledger entries. It only holds
+    // anything while LedgerManager is closing a ledger in write-behind mode.
+    LedgerEntryOverlay& getEntryOverlay();
+
+    // Access the entry cache prefetch run before applying transactions.
+    LedgerEntryPrefetch& getEntryPrefetch();
+
+    // Access the order books cached while applying transactions.
+    OrderBookCache& getOrderBookCache();
+
+    // Access the running inflation vote totals of the stored accounts.
+    InflationVoteTally& getInflationVoteTally();
+
+    // Access the per-statement profile of prepared statements.
+    SQLProfiler& getSQLProfiler();
 };
 }
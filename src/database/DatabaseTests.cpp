@@ -4,15 +4,22 @@
 
 #include "util/asio.h"
 #include "database/Database.h"
+#include "database/ReadSnapshot.h"
+#include "ledger/LedgerDelta.h"
+#include "ledger/LedgerManager.h"
 #include "main/Application.h"
 #include "main/Config.h"
 #include "main/test.h"
 #include "crypto/Hex.h"
+#include "crypto/SecretKey.h"
 #include "util/Logging.h"
 #include "util/Timer.h"
 #include "util/TmpDir.h"
+#include "util/types.h"
 #include "lib/catch.hpp"
+#include <map>
 #include <random>
+#include <thread>
 
 using namespace stellar;
 
@@ -186,7 +193,264 @@ TEST_CASE("sqlite MVCC test", "[db]")
     checkMVCCIsolation(app);
 }
 
+TEST_CASE("read snapshot isolation", "[db][snapshot]")
+{
+    Config const& cfg = getTestConfig(0, Config::TESTDB_ON_DISK_SQLITE);
+    VirtualClock clock;
+    Application::pointer app = Application::create(clock, cfg);
+    app->start();
+
+    auto& db = app->getDatabase();
+    auto& lm = app->getLedgerManager();
+
+    AccountFrame::pointer acc =
+        std::make_shared<AccountFrame>(SecretKey::random().getPublicKey());
+    AccountID const& id = acc->getID();
+    acc->getAccount().balance = 100;
+    {
+        LedgerDelta delta(lm.getCurrentLedgerHeader(), db);
+        acc->storeAdd(delta, db);
+        delta.commit();
+    }
+
+    ReadSnapshot snapshot(db);
+    REQUIRE(snapshot.isPooled());
+
+    // change the account on the main connection after the snapshot was
+    // taken, and add a second one
+    acc->getAccount().balance = 200;
+    AccountFrame::pointer acc2 =
+        std::make_shared<AccountFrame>(SecretKey::random().getPublicKey());
+    acc2->getAccount().balance = 300;
+    {
+        LedgerDelta delta(lm.getCurrentLedgerHeader(), db);
+        acc->storeChange(delta, db);
+        acc2->storeAdd(delta, db);
+        delta.commit();
+    }
+    REQUIRE(AccountFrame::loadAccount(id, db)->getBalance() == 200);
+
+    // the snapshot still sees the state as of its construction, from
+    // another thread
+    AccountFrame::pointer fromSnapshot, missing;
+    std::thread worker([&]()
+                       {
+                           fromSnapshot =
+                               AccountFrame::loadAccount(id, snapshot);
+                           missing = AccountFrame::loadAccount(acc2->getID(),
+                                                               snapshot);
+                       });
+    worker.join();
+    REQUIRE(!!fromSnapshot);
+    REQUIRE(fromSnapshot->getBalance() == 100);
+    REQUIRE(!missing);
+
+    // and a new snapshot sees the change
+    ReadSnapshot snapshot2(db);
+    REQUIRE(AccountFrame::loadAccount(id, snapshot2)->getBalance() == 200);
+    REQUIRE(!!EntryFrame::storeLoad(acc2->getKey(), snapshot2));
+}
+
+TEST_CASE("key-value entry store", "[db][kv]")
+{
+    Config cfg(getTestConfig(0, Config::TESTDB_IN_MEMORY_SQLITE));
+    cfg.DATABASE = EntryKVStore::DATABASE_PREFIX + cfg.DATABASE;
+    VirtualClock clock;
+    Application::pointer app = Application::create(clock, cfg);
+    app->start();
+
+    auto& db = app->getDatabase();
+    auto& lm = app->getLedgerManager();
+    auto kv = db.getEntryKVStore();
+    REQUIRE(kv);
+    // the root account
+    REQUIRE(kv->countObjects(ACCOUNT) == 1);
+
+    AccountFrame::pointer issuer =
+        std::make_shared<AccountFrame>(SecretKey::random().getPublicKey());
+    issuer->getAccount().balance = 2000000000;
+
+    AccountFrame::pointer holder =
+        std::make_shared<AccountFrame>(SecretKey::random().getPublicKey());
+    holder->getAccount().balance = 1000000000;
+    holder->getAccount().inflationDest.activate() = issuer->getID();
+    Signer signer;
+    signer.pubKey = SecretKey::random().getPublicKey();
+    signer.weight = 2;
+    holder->getAccount().signers.push_back(signer);
+    holder->setUpdateSigners();
+
+    Asset usd;
+    usd.type(ASSET_TYPE_CREDIT_ALPHANUM4);
+    strToAssetCode(usd.alphaNum4().assetCode, "USD");
+    usd.alphaNum4().issuer = issuer->getID();
+    TrustFrame::pointer line = std::make_shared<TrustFrame>();
+    line->getTrustLine().accountID = holder->getID();
+    line->getTrustLine().asset = usd;
+    line->getTrustLine().limit = 100;
+    line->getTrustLine().flags = AUTHORIZED_FLAG;
+
+    {
+        LedgerDelta delta(lm.getCurrentLedgerHeader(), db);
+        issuer->storeAdd(delta, db);
+        holder->storeAdd(delta, db);
+        line->storeAdd(delta, db);
+        delta.commit();
+    }
+    db.getEntryCache().clear();
+
+    auto loaded = AccountFrame::loadAccount(holder->getID(), db);
+    REQUIRE(loaded);
+    REQUIRE(loaded->getBalance() == 1000000000);
+    REQUIRE(loaded->getAccount().signers.size() == 1);
+    REQUIRE(loaded->getAccount().signers[0].weight == 2);
+    REQUIRE(AccountFrame::exists(db, issuer->getKey()));
+    REQUIRE(kv->countObjects(ACCOUNT) == 3);
+    REQUIRE(kv->countObjects(TRUSTLINE) == 1);
+
+    std::vector<TrustFrame::pointer> lines;
+    TrustFrame::loadLines(holder->getID(), lines, db);
+    REQUIRE(lines.size() == 1);
+    REQUIRE(lines[0]->getTrustLine().limit == 100);
+    TrustFrame::loadLines(issuer->getID(), lines, db);
+    REQUIRE(lines.size() == 1);
+
+    int winners = 0;
+    auto countWinners = [&](AccountFrame::InflationVotes const& votes) -> bool
+    {
+        REQUIRE(votes.mInflationDest == issuer->getID());
+        REQUIRE(votes.mVotes == 1000000000);
+        ++winners;
+        return true;
+    };
+
+    SECTION("secondary columns follow the entries")
+    {
+        REQUIRE(!TrustFrame::hasIssued(issuer->getID(), db));
+        AccountFrame::processForInflation(countWinners, 10, db);
+        REQUIRE(winners == 1);
+
+        line->getTrustLine().balance = 10;
+        holder->getAccount().inflationDest.reset();
+        {
+            LedgerDelta delta(lm.getCurrentLedgerHeader(), db);
+            line->storeChange(delta, db);
+            holder->storeChange(delta, db);
+            delta.commit();
+        }
+        REQUIRE(TrustFrame::hasIssued(issuer->getID(), db));
+        winners = 0;
+        AccountFrame::processForInflation(countWinners, 10, db);
+        REQUIRE(winners == 0);
+    }
+
+    SECTION("writes are part of SQL transactions")
+    {
+        {
+            soci::transaction tx(db.getSession());
+            LedgerDelta delta(lm.getCurrentLedgerHeader(), db);
+            line->storeDelete(delta, db);
+            delta.commit();
+            REQUIRE(!TrustFrame::exists(db, line->getKey()));
+            tx.rollback();
+        }
+        db.getEntryCache().clear();
+        REQUIRE(TrustFrame::exists(db, line->getKey()));
+
+        {
+            LedgerDelta delta(lm.getCurrentLedgerHeader(), db);
+            line->storeDelete(delta, db);
+            delta.commit();
+        }
+        db.getEntryCache().clear();
+        REQUIRE(!TrustFrame::loadTrustLine(holder->getID(), usd, db));
+        REQUIRE(kv->countObjects(TRUSTLINE) == 0);
+    }
+}
+
 #ifdef USE_POSTGRES
+TEST_CASE("sql statement profile", "[db][sqlprofile]")
+{
+    Config cfg(getTestConfig());
+    cfg.SQL_PROFILING = true;
+    VirtualClock clock;
+    Application::pointer app = Application::create(clock, cfg);
+    app->start();
+
+    auto& db = app->getDatabase();
+    auto& profiler = db.getSQLProfiler();
+    REQUIRE(profiler.isEnabled());
+    profiler.reset();
+
+    auto& session = db.getSession();
+    session << "DROP TABLE IF EXISTS test";
+    session << "CREATE TABLE test (x INTEGER)";
+
+    std::string const insert = "INSERT INTO test (x) VALUES (:x)";
+    std::string const select = "SELECT  x FROM test\n    WHERE x = :x";
+    auto insertRows = [&](int n)
+    {
+        for (int x = 0; x < n; x++)
+        {
+            auto prep = db.getPreparedStatement(insert);
+            auto& st = prep.statement();
+            st.exchange(soci::use(x));
+            st.define_and_bind();
+            st.execute(true);
+        }
+    };
+    auto selectRows = [&](int n)
+    {
+        int x = 0, res;
+        for (int i = 0; i < n; i++)
+        {
+            auto prep = db.getPreparedStatement(select);
+            auto& st = prep.statement();
+            st.exchange(soci::into(res));
+            st.exchange(soci::use(x));
+            st.define_and_bind();
+            st.execute(true);
+        }
+    };
+
+    insertRows(3);
+    {
+        SQLProfiler::LedgerScope scope(profiler, 42);
+        insertRows(2);
+        selectRows(4);
+    }
+    selectRows(1);
+
+    auto top = profiler.getTop(10);
+    REQUIRE(top.size() == 2);
+    std::map<std::string, SQLProfiler::Stats> byQuery(top.begin(), top.end());
+    auto const& inserts = byQuery.at(insert);
+    REQUIRE(inserts.mCalls == 5);
+    REQUIRE(inserts.mRows == 5);
+    auto const& selects = byQuery.at("SELECT x FROM test WHERE x = :x");
+    REQUIRE(selects.mCalls == 5);
+    REQUIRE(selects.mRows == 0);
+    REQUIRE(selects.quantile(0.5) <= selects.quantile(0.99));
+    REQUIRE(selects.quantile(0.99) <= selects.mMaxMicros);
+    REQUIRE(profiler.getTop(1).size() == 1);
+
+    REQUIRE(profiler.getLastLedgerSeq() == 42);
+    std::map<std::string, SQLProfiler::Stats> inLedger(
+        profiler.getLastLedger().begin(), profiler.getLastLedger().end());
+    REQUIRE(inLedger.at(insert).mCalls == 2);
+    REQUIRE(inLedger.at(insert).mRows == 2);
+    REQUIRE(inLedger.at("SELECT x FROM test WHERE x = :x").mCalls == 4);
+
+    SECTION("disabled")
+    {
+        profiler.setEnabled(false);
+        profiler.reset();
+        insertRows(1);
+        REQUIRE(profiler.getTop(10).empty());
+        REQUIRE(profiler.getLastLedgerSeq() == 0);
+    }
+}
+
 TEST_CASE("postgres smoketest", "[db]")
 {
     Config const& cfg = getTestConfig(0, Config::TESTDB_POSTGRESQL);
@@ -0,0 +1,405 @@
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "database/EntryKVStore.h"
+#include "crypto/SecretKey.h"
+#include "database/Database.h"
+#include "xdrpp/marshal.h"
+#include <soci.h>
+#include "soci/src/backends/sqlite3/soci-sqlite3.h"
+#include <stdexcept>
+
+using namespace sqlite_api;
+
+namespace stellar
+{
+
+const std::string EntryKVStore::DATABASE_PREFIX = "kv+";
+
+static const char* kSQLCreateStatement1 =
+    "CREATE TABLE ledgerentries"
+    "("
+    "entrykey      BLOB          PRIMARY KEY,"
+    "entry         BLOB          NOT NULL,"
+    "issuer        VARCHAR(56),"
+    "inflationdest VARCHAR(56),"
+    "balance       BIGINT"
+    ") WITHOUT ROWID;";
+
+static const char* kSQLCreateStatement2 =
+    "CREATE INDEX ledgerentriesissuer ON ledgerentries (issuer) "
+    "WHERE issuer IS NOT NULL;";
+
+static const char* kSQLCreateStatement3 =
+    "CREATE INDEX ledgerentriesinflation ON ledgerentries (inflationdest) "
+    "WHERE inflationdest IS NOT NULL;";
+
+namespace
+{
+// Puts a cached statement back in its initial state when leaving scope, so
+// that it holds no cursor open on the connection.
+class StatementReset : NonCopyable
+{
+    sqlite3_stmt* mStmt;
+
+  public:
+    explicit StatementReset(sqlite3_stmt* stmt) : mStmt(stmt)
+    {
+    }
+    ~StatementReset()
+    {
+        sqlite3_reset(mStmt);
+        sqlite3_clear_bindings(mStmt);
+    }
+};
+
+void
+bindBytes(sqlite3_stmt* stmt, int i, std::vector<uint8_t> const& bytes)
+{
+    sqlite3_bind_blob(stmt, i, bytes.data(), static_cast<int>(bytes.size()),
+                      SQLITE_STATIC);
+}
+
+void
+bindText(sqlite3_stmt* stmt, int i, std::string const& s)
+{
+    sqlite3_bind_text(stmt, i, s.data(), static_cast<int>(s.size()),
+                      SQLITE_STATIC);
+}
+
+// The XDR of a LedgerKey starts with its type as a big-endian int.
+std::vector<uint8_t>
+typePrefix(LedgerEntryType type)
+{
+    uint32_t t = static_cast<uint32_t>(type);
+    return {static_cast<uint8_t>(t >> 24), static_cast<uint8_t>(t >> 16),
+            static_cast<uint8_t>(t >> 8), static_cast<uint8_t>(t)};
+}
+
+// Smallest byte string greater than every string starting with `prefix`.
+std::vector<uint8_t>
+prefixEnd(std::vector<uint8_t> prefix)
+{
+    while (!prefix.empty() && prefix.back() == 0xFF)
+    {
+        prefix.pop_back();
+    }
+    if (prefix.empty())
+    {
+        throw std::runtime_error("unbounded key prefix");
+    }
+    ++prefix.back();
+    return prefix;
+}
+
+AccountID const*
+getIssuer(Asset const& asset)
+{
+    switch (asset.type())
+    {
+    case ASSET_TYPE_CREDIT_ALPHANUM4:
+        return &asset.alphaNum4().issuer;
+    case ASSET_TYPE_CREDIT_ALPHANUM12:
+        return &asset.alphaNum12().issuer;
+    default:
+        return nullptr;
+    }
+}
+}
+
+EntryKVStore::EntryKVStore(soci::session& sess)
+{
+    auto backend =
+        dynamic_cast<soci::sqlite3_session_backend*>(sess.get_backend());
+    if (!backend)
+    {
+        throw std::runtime_error(
+            "key-value ledger entry store requires a sqlite3 database");
+    }
+    mConn = backend->conn_;
+}
+
+EntryKVStore::~EntryKVStore()
+{
+    clearStatements();
+}
+
+void
+EntryKVStore::clearStatements()
+{
+    for (auto& st : mStatements)
+    {
+        sqlite3_finalize(st.second);
+    }
+    mStatements.clear();
+}
+
+sqlite3_stmt*
+EntryKVStore::getStatement(std::string const& sql)
+{
+    auto i = mStatements.find(sql);
+    if (i != mStatements.end())
+    {
+        return i->second;
+    }
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(mConn, sql.c_str(), static_cast<int>(sql.size()),
+                           &stmt, nullptr) != SQLITE_OK)
+    {
+        std::string msg("ledgerentries: ");
+        throw std::runtime_error(msg + sqlite3_errmsg(mConn));
+    }
+    mStatements.insert(std::make_pair(sql, stmt));
+    return stmt;
+}
+
+static bool
+step(sqlite3* conn, sqlite3_stmt* stmt)
+{
+    int rc = sqlite3_step(stmt);
+    if (rc != SQLITE_ROW && rc != SQLITE_DONE)
+    {
+        std::string msg("ledgerentries: ");
+        throw std::runtime_error(msg + sqlite3_errmsg(conn));
+    }
+    return rc == SQLITE_ROW;
+}
+
+static void
+readEntry(sqlite3_stmt* stmt, int i, LedgerEntry& entry)
+{
+    auto p = static_cast<uint8_t const*>(sqlite3_column_blob(stmt, i));
+    auto n = sqlite3_column_bytes(stmt, i);
+    xdr::xdr_get g(p, p + n);
+    xdr_argpack_archive(g, entry);
+}
+
+bool
+EntryKVStore::load(LedgerKey const& key, LedgerEntry& entry)
+{
+    auto k = xdr::xdr_to_opaque(key);
+    auto stmt =
+        getStatement("SELECT entry FROM ledgerentries WHERE entrykey = ?1");
+    StatementReset reset(stmt);
+    bindBytes(stmt, 1, k);
+    if (!step(mConn, stmt))
+    {
+        return false;
+    }
+    readEntry(stmt, 0, entry);
+    return true;
+}
+
+bool
+EntryKVStore::exists(LedgerKey const& key)
+{
+    auto k = xdr::xdr_to_opaque(key);
+    auto stmt = getStatement("SELECT EXISTS (SELECT NULL FROM ledgerentries "
+                             "WHERE entrykey = ?1)");
+    StatementReset reset(stmt);
+    bindBytes(stmt, 1, k);
+    return step(mConn, stmt) && sqlite3_column_int(stmt, 0) != 0;
+}
+
+bool
+EntryKVStore::write(std::string const& sql, LedgerEntry const& entry)
+{
+    auto k = xdr::xdr_to_opaque(LedgerEntryKey(entry));
+    auto v = xdr::xdr_to_opaque(entry);
+
+    std::string issuer, inflationDest;
+    int64_t balance = 0;
+    switch (entry.data.type())
+    {
+    case ACCOUNT:
+    {
+        auto const& account = entry.data.account();
+        if (account.inflationDest)
+        {
+            inflationDest = PubKeyUtils::toStrKey(*account.inflationDest);
+            balance = account.balance;
+        }
+    }
+    break;
+    case TRUSTLINE:
+    {
+        auto const& tl = entry.data.trustLine();
+        auto issuerID = getIssuer(tl.asset);
+        if (issuerID && tl.balance > 0)
+        {
+            issuer = PubKeyUtils::toStrKey(*issuerID);
+        }
+    }
+    break;
+    default:
+        throw std::runtime_error("unexpected key-value ledger entry");
+    }
+
+    auto stmt = getStatement(sql);
+    StatementReset reset(stmt);
+    bindBytes(stmt, 1, k);
+    bindBytes(stmt, 2, v);
+    if (!issuer.empty())
+    {
+        bindText(stmt, 3, issuer);
+    }
+    if (!inflationDest.empty())
+    {
+        bindText(stmt, 4, inflationDest);
+        sqlite3_bind_int64(stmt, 5, balance);
+    }
+    step(mConn, stmt);
+    return sqlite3_changes(mConn) == 1;
+}
+
+bool
+EntryKVStore::insert(LedgerEntry const& entry)
+{
+    return write("INSERT OR IGNORE INTO ledgerentries "
+                 "(entrykey, entry, issuer, inflationdest, balance) "
+                 "VALUES (?1, ?2, ?3, ?4, ?5)",
+                 entry);
+}
+
+bool
+EntryKVStore::update(LedgerEntry const& entry)
+{
+    return write("UPDATE ledgerentries SET entry = ?2, issuer = ?3, "
+                 "inflationdest = ?4, balance = ?5 WHERE entrykey = ?1",
+                 entry);
+}
+
+void
+EntryKVStore::erase(LedgerKey const& key)
+{
+    auto k = xdr::xdr_to_opaque(key);
+    auto stmt = getStatement("DELETE FROM ledgerentries WHERE entrykey = ?1");
+    StatementReset reset(stmt);
+    bindBytes(stmt, 1, k);
+    step(mConn, stmt);
+}
+
+void
+EntryKVStore::scan(std::vector<uint8_t> const& prefix,
+                   std::vector<LedgerEntry>& entries)
+{
+    auto end = prefixEnd(prefix);
+    auto stmt = getStatement("SELECT entry FROM ledgerentries "
+                             "WHERE entrykey >= ?1 AND entrykey < ?2 "
+                             "ORDER BY entrykey");
+    StatementReset reset(stmt);
+    bindBytes(stmt, 1, prefix);
+    bindBytes(stmt, 2, end);
+    while (step(mConn, stmt))
+    {
+        entries.emplace_back();
+        readEntry(stmt, 0, entries.back());
+    }
+}
+
+uint64_t
+EntryKVStore::count(std::vector<uint8_t> const& prefix)
+{
+    auto end = prefixEnd(prefix);
+    auto stmt = getStatement("SELECT COUNT(*) FROM ledgerentries "
+                             "WHERE entrykey >= ?1 AND entrykey < ?2");
+    StatementReset reset(stmt);
+    bindBytes(stmt, 1, prefix);
+    bindBytes(stmt, 2, end);
+    step(mConn, stmt);
+    return static_cast<uint64_t>(sqlite3_column_int64(stmt, 0));
+}
+
+void
+EntryKVStore::loadLines(AccountID const& accountID,
+                        std::vector<LedgerEntry>& lines)
+{
+    auto prefix = typePrefix(TRUSTLINE);
+    auto account = xdr::xdr_to_opaque(accountID);
+    prefix.insert(prefix.end(), account.begin(), account.end());
+    scan(prefix, lines);
+}
+
+bool
+EntryKVStore::hasIssued(AccountID const& issuerID)
+{
+    std::string issuer = PubKeyUtils::toStrKey(issuerID);
+    auto stmt = getStatement("SELECT EXISTS (SELECT NULL FROM ledgerentries "
+                             "WHERE issuer = ?1)");
+    StatementReset reset(stmt);
+    bindText(stmt, 1, issuer);
+    return step(mConn, stmt) && sqlite3_column_int(stmt, 0) != 0;
+}
+
+void
+EntryKVStore::processForInflation(
+    std::function<bool(AccountFrame::InflationVotes const&)>
+        inflationProcessor,
+    int maxWinners)
+{
+    // the processor stores the winning accounts: read all rows first
+    std::vector<AccountFrame::InflationVotes> winners;
+    {
+        auto stmt = getStatement(
+            "SELECT sum(balance) AS votes, inflationdest FROM ledgerentries "
+            "WHERE inflationdest IS NOT NULL AND balance >= 1000000000 "
+            "GROUP BY inflationdest "
+            "ORDER BY votes DESC, inflationdest DESC LIMIT ?1");
+        StatementReset reset(stmt);
+        sqlite3_bind_int(stmt, 1, maxWinners);
+        while (step(mConn, stmt))
+        {
+            AccountFrame::InflationVotes v;
+            v.mVotes = sqlite3_column_int64(stmt, 0);
+            auto dest =
+                reinterpret_cast<char const*>(sqlite3_column_text(stmt, 1));
+            v.mInflationDest = PubKeyUtils::fromStrKey(dest);
+            winners.push_back(v);
+        }
+    }
+
+    for (auto const& v : winners)
+    {
+        if (!inflationProcessor(v))
+        {
+            break;
+        }
+    }
+}
+
+void
+EntryKVStore::loadInflationVoters(
+    std::function<void(LedgerEntry const&)> entryProcessor)
+{
+    auto stmt = getStatement("SELECT entry FROM ledgerentries "
+                             "WHERE inflationdest IS NOT NULL "
+                             "AND balance >= 1000000000");
+    StatementReset reset(stmt);
+    LedgerEntry entry;
+    while (step(mConn, stmt))
+    {
+        readEntry(stmt, 0, entry);
+        entryProcessor(entry);
+    }
+}
+
+uint64_t
+EntryKVStore::countObjects(LedgerEntryType type)
+{
+    return count(typePrefix(type));
+}
+
+void
+EntryKVStore::dropAll(Database& db)
+{
+    db.getSession() << "DROP TABLE IF EXISTS ledgerentries;";
+
+    if (db.getEntryKVStore())
+    {
+        db.getSession() << kSQLCreateStatement1;
+        db.getSession() << kSQLCreateStatement2;
+        db.getSession() << kSQLCreateStatement3;
+    }
+}
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "ledger/AccountFrame.h"
+#include "overlay/StellarXDR.h"
+#include "util/NonCopyable.h"
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace soci
+{
+class session;
+}
+
+namespace sqlite_api
+{
+struct sqlite3;
+struct sqlite3_stmt;
+}
+
+namespace stellar
+{
+class Database;
+
+/**
+ * Key-value storage for account and trustline entries, used in place of the
+ * accounts, signers and trustlines tables when the DATABASE string carries
+ * the "kv+" prefix (e.g. "kv+sqlite3://stellar.db").
+ *
+ * Each entry is one row of the ledgerentries table, keyed by the XDR of its
+ * LedgerKey and holding the XDR of the whole LedgerEntry, signers included.
+ * The table is WITHOUT ROWID, so sqlite keeps it as a single B-tree sorted by
+ * key: a load is one descent returning one blob, and statements are driven
+ * through the sqlite3 API directly rather than binding column by column
+ * through soci. Living in the same database as everything else, it shares
+ * its transactions and savepoints, its snapshots and its pooled connections.
+ *
+ * The XDR of a key starts with the entry type and then the account, so an
+ * account's trustlines are adjacent and loading them is a range scan. The
+ * two other queries over these entries get narrow secondary columns, set on
+ * write and indexed only where non-NULL: `issuer` on trustlines holding a
+ * balance (for TrustFrame::hasIssued) and `inflationdest`/`balance` on
+ * accounts with an inflation destination (for
+ * AccountFrame::processForInflation). Offers stay in the offers table, which
+ * is the order book's index.
+ *
+ * One instance wraps one sqlite connection: Database owns one for its main
+ * session and each ReadSnapshot one for its own.
+ */
+class EntryKVStore : NonMovableOrCopyable
+{
+    sqlite_api::sqlite3* mConn;
+    std::map<std::string, sqlite_api::sqlite3_stmt*> mStatements;
+
+    sqlite_api::sqlite3_stmt* getStatement(std::string const& sql);
+    bool write(std::string const& sql, LedgerEntry const& entry);
+    void scan(std::vector<uint8_t> const& prefix,
+              std::vector<LedgerEntry>& entries);
+    uint64_t count(std::vector<uint8_t> const& prefix);
+
+  public:
+    // Prefix of DATABASE strings selecting this backend.
+    static const std::string DATABASE_PREFIX;
+
+    // Throws if `sess` is not connected to sqlite.
+    explicit EntryKVStore(soci::session& sess);
+    ~EntryKVStore();
+
+    // Return true and set `entry` if `key` is stored.
+    bool load(LedgerKey const& key, LedgerEntry& entry);
+    bool exists(LedgerKey const& key);
+
+    // insert returns false if the key is already stored, update if it is not.
+    bool insert(LedgerEntry const& entry);
+    bool update(LedgerEntry const& entry);
+    void erase(LedgerKey const& key);
+
+    // Append the trustlines of `accountID` to `lines`, in key order.
+    void loadLines(AccountID const& accountID,
+                   std::vector<LedgerEntry>& lines);
+
+    bool hasIssued(AccountID const& issuerID);
+
+    // Same tally and order as AccountFrame::processForInflation.
+    void processForInflation(
+        std::function<bool(AccountFrame::InflationVotes const&)>
+            inflationProcessor,
+        int maxWinners);
+
+    // Pass every account entry with an inflation destination and a voting
+    // balance to entryProcessor.
+    void loadInflationVoters(
+        std::function<void(LedgerEntry const&)> entryProcessor);
+
+    uint64_t countObjects(LedgerEntryType type);
+
+    // Finalize cached statements; they are prepared again on next use.
+    void clearStatements();
+
+    static void dropAll(Database& db);
+};
+}
@@ -0,0 +1,99 @@
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "database/ReadSnapshot.h"
+#include "crypto/Hex.h"
+#include "database/Database.h"
+#include "util/make_unique.h"
+#include "xdrpp/marshal.h"
+
+namespace stellar
+{
+
+ReadSnapshot::ReadSnapshot(Database& db)
+    : mDatabase(db)
+    , mPoolSession(db.canUsePool() ? make_unique<soci::session>(db.getPool())
+                                   : nullptr)
+    , mSession(mPoolSession ? *mPoolSession : db.getSession())
+    , mEntryCache(4096)
+{
+    if (mPoolSession)
+    {
+        mTransaction = make_unique<soci::transaction>(mSession);
+        if (!mDatabase.isSqlite())
+        {
+            mSession << "SET TRANSACTION READ ONLY";
+        }
+        // Both backends take the transaction's snapshot at its first read,
+        // not at BEGIN: read something now so the view is the one current
+        // at construction rather than at first use.
+        int n = 0;
+        mSession << "SELECT COUNT(*) FROM storestate", soci::into(n);
+    }
+    if (mDatabase.getEntryKVStore())
+    {
+        mEntryKVStore = make_unique<EntryKVStore>(mSession);
+    }
+}
+
+ReadSnapshot::~ReadSnapshot()
+{
+    // statements hold cursors on the connection: release them before the
+    // transaction rolls back and the connection goes back to the pool
+    mStatements.clear();
+    mEntryKVStore.reset();
+}
+
+StatementContext
+ReadSnapshot::getPreparedStatement(std::string const& query)
+{
+    auto i = mStatements.find(query);
+    std::shared_ptr<soci::statement> p;
+    if (i == mStatements.end())
+    {
+        p = std::make_shared<soci::statement>(mSession);
+        p->alloc();
+        p->prepare(query);
+        mStatements.insert(std::make_pair(query, p));
+    }
+    else
+    {
+        p = i->second;
+    }
+    StatementContext sc(p);
+    return sc;
+}
+
+medida::TimerContext
+ReadSnapshot::getSelectTimer(std::string const& entityName)
+{
+    return mDatabase.getSelectTimer(entityName);
+}
+
+soci::session&
+ReadSnapshot::getSession()
+{
+    return mSession;
+}
+
+bool
+ReadSnapshot::getCachedEntry(LedgerKey const& key,
+                             std::shared_ptr<LedgerEntry const>& entry)
+{
+    auto s = binToHex(xdr::xdr_to_opaque(key));
+    if (!mEntryCache.exists(s))
+    {
+        return false;
+    }
+    entry = mEntryCache.get(s);
+    return true;
+}
+
+void
+ReadSnapshot::putCachedEntry(LedgerKey const& key,
+                             std::shared_ptr<LedgerEntry const> entry)
+{
+    mEntryCache.put(binToHex(xdr::xdr_to_opaque(key)), entry);
+}
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "medida/timer_context.h"
+#include "overlay/StellarXDR.h"
+#include "util/NonCopyable.h"
+#include "util/lrucache.hpp"
+#include <map>
+#include <memory>
+#include <string>
+
+namespace soci
+{
+class session;
+class statement;
+class transaction;
+}
+
+namespace stellar
+{
+class Database;
+class EntryKVStore;
+class StatementContext;
+
+/**
+ * A consistent, read-only view of the ledger state that can be queried off
+ * the main thread.
+ *
+ * The Database's main session, prepared statement cache, entry cache and
+ * write-behind overlay all belong to the main thread. A ReadSnapshot instead
+ * leases its own connection from the Database's pool and holds a read-only
+ * transaction open on it for its whole lifetime, so every query sees the
+ * state as of construction even while the main thread goes on closing
+ * ledgers. It keeps its own prepared statements (and key-value store, if the
+ * Database uses one) and its own (small, LRU) cache of the entries loaded
+ * through it.
+ *
+ * Construct it on the main thread between ledger closes to capture the last
+ * closed ledger, then hand it to a single worker thread: the object itself is
+ * not thread-safe. Frame loaders that take a ReadSnapshot in place of the
+ * Database -- AccountFrame::loadAccount, TrustFrame::loadTrustLine,
+ * OfferFrame::loadOffer, OfferFrame::loadBestOffers and EntryFrame::storeLoad
+ * -- read through it.
+ *
+ * When the database has no pool (in-memory SQLite) the snapshot falls back to
+ * the main session without a transaction, and can only be used on the main
+ * thread.
+ */
+class ReadSnapshot : NonMovableOrCopyable
+{
+    Database& mDatabase;
+    std::unique_ptr<soci::session> mPoolSession;
+    soci::session& mSession;
+    std::unique_ptr<soci::transaction> mTransaction;
+    std::unique_ptr<EntryKVStore> mEntryKVStore;
+
+    std::map<std::string, std::shared_ptr<soci::statement>> mStatements;
+    cache::lru_cache<std::string, std::shared_ptr<LedgerEntry const>>
+        mEntryCache;
+
+  public:
+    explicit ReadSnapshot(Database& db);
+    ~ReadSnapshot();
+
+    // Return true if the snapshot has its own connection and can be used
+    // from another thread.
+    bool
+    isPooled() const
+    {
+        return !!mPoolSession;
+    }
+
+    // Same as Database::getPreparedStatement, against the snapshot's
+    // connection.
+    StatementContext getPreparedStatement(std::string const& query);
+
+    medida::TimerContext getSelectTimer(std::string const& entityName);
+
+    soci::session& getSession();
+
+    // Same as Database::getEntryKVStore, against the snapshot's connection.
+    EntryKVStore*
+    getEntryKVStore()
+    {
+        return mEntryKVStore.get();
+    }
+
+    // Return true if `key` was already loaded through this snapshot, setting
+    // `entry` to it (nullptr if it does not exist).
+    bool getCachedEntry(LedgerKey const& key,
+                        std::shared_ptr<LedgerEntry const>& entry);
+    void putCachedEntry(LedgerKey const& key,
+                        std::shared_ptr<LedgerEntry const> entry);
+};
+}
@@ -0,0 +1,228 @@
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "database/SQLProfiler.h"
+#include "util/Logging.h"
+#include <algorithm>
+#include <cctype>
+#include <limits>
+#include <map>
+
+namespace stellar
+{
+
+SQLProfiler::Stats::Stats()
+{
+    mBuckets.fill(0);
+}
+
+void
+SQLProfiler::Stats::add(uint64_t micros, uint64_t rows)
+{
+    mCalls++;
+    mRows += rows;
+    mTotalMicros += micros;
+    mMaxMicros = std::max(mMaxMicros, micros);
+    size_t bucket = 0;
+    while (bucket < NUM_BUCKETS - 1 && (uint64_t(1) << bucket) <= micros)
+    {
+        bucket++;
+    }
+    mBuckets[bucket]++;
+}
+
+void
+SQLProfiler::Stats::merge(Stats const& other)
+{
+    mCalls += other.mCalls;
+    mRows += other.mRows;
+    mTotalMicros += other.mTotalMicros;
+    mMaxMicros = std::max(mMaxMicros, other.mMaxMicros);
+    for (size_t i = 0; i < NUM_BUCKETS; i++)
+    {
+        mBuckets[i] += other.mBuckets[i];
+    }
+}
+
+uint64_t
+SQLProfiler::Stats::quantile(double q) const
+{
+    if (mCalls == 0)
+    {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(q * mCalls);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < NUM_BUCKETS - 1; i++)
+    {
+        seen += mBuckets[i];
+        if (seen > rank)
+        {
+            return std::min(uint64_t(1) << i, mMaxMicros);
+        }
+    }
+    return mMaxMicros;
+}
+
+SQLProfiler::SQLProfiler(bool enabled) : mEnabled(enabled)
+{
+}
+
+void
+SQLProfiler::setEnabled(bool enabled)
+{
+    mEnabled = enabled;
+}
+
+void
+SQLProfiler::reset()
+{
+    for (auto& e : mEntries)
+    {
+        e.second.mTotal = Stats();
+        e.second.mLedger = Stats();
+    }
+    mLastLedgerSeq = 0;
+    mLastLedger.clear();
+}
+
+SQLProfiler::Entry*
+SQLProfiler::getEntry(std::string const& query)
+{
+    if (!mEnabled)
+    {
+        return nullptr;
+    }
+    auto it = mEntries.find(query);
+    if (it == mEntries.end())
+    {
+        auto start = query.find_first_not_of(" \t\r\n(");
+        std::string verb;
+        if (start != std::string::npos)
+        {
+            verb = query.substr(start, 6);
+            std::transform(verb.begin(), verb.end(), verb.begin(), ::toupper);
+        }
+        Entry e;
+        e.mIsWrite =
+            (verb == "INSERT" || verb == "UPDATE" || verb == "DELETE");
+        it = mEntries.emplace(query, e).first;
+    }
+    return &it->second;
+}
+
+void
+SQLProfiler::record(Entry& entry, uint64_t micros, uint64_t rows)
+{
+    entry.mTotal.add(micros, rows);
+    if (mInLedger)
+    {
+        entry.mLedger.add(micros, rows);
+    }
+}
+
+std::string
+SQLProfiler::normalize(std::string const& query)
+{
+    std::string res;
+    res.reserve(query.size());
+    bool space = false;
+    for (char c : query)
+    {
+        if (std::isspace(static_cast<unsigned char>(c)))
+        {
+            space = true;
+            continue;
+        }
+        if (space && !res.empty())
+        {
+            res.push_back(' ');
+        }
+        space = false;
+        res.push_back(c);
+    }
+    return res;
+}
+
+SQLProfiler::Report
+SQLProfiler::makeReport(bool ledger, size_t n) const
+{
+    std::map<std::string, Stats> merged;
+    for (auto const& e : mEntries)
+    {
+        auto const& stats = ledger ? e.second.mLedger : e.second.mTotal;
+        if (stats.mCalls != 0)
+        {
+            merged[normalize(e.first)].merge(stats);
+        }
+    }
+
+    Report res(merged.begin(), merged.end());
+    std::stable_sort(res.begin(), res.end(),
+                     [](Report::value_type const& a,
+                        Report::value_type const& b)
+                     {
+                         return a.second.mTotalMicros > b.second.mTotalMicros;
+                     });
+    if (res.size() > n)
+    {
+        res.resize(n);
+    }
+    return res;
+}
+
+SQLProfiler::Report
+SQLProfiler::getTop(size_t n) const
+{
+    return makeReport(false, n);
+}
+
+SQLProfiler::LedgerScope::LedgerScope(SQLProfiler& profiler, uint32_t seq)
+    : mProfiler(profiler)
+{
+    if (!mProfiler.mEnabled)
+    {
+        return;
+    }
+    for (auto& e : mProfiler.mEntries)
+    {
+        e.second.mLedger = Stats();
+    }
+    mProfiler.mInLedger = true;
+    mProfiler.mLedgerSeq = seq;
+}
+
+SQLProfiler::LedgerScope::~LedgerScope()
+{
+    if (!mProfiler.mInLedger)
+    {
+        return;
+    }
+    mProfiler.mInLedger = false;
+    mProfiler.mLastLedgerSeq = mProfiler.mLedgerSeq;
+    mProfiler.mLastLedger =
+        mProfiler.makeReport(true, std::numeric_limits<size_t>::max());
+
+    uint64_t calls = 0, micros = 0;
+    for (auto const& s : mProfiler.mLastLedger)
+    {
+        calls += s.second.mCalls;
+        micros += s.second.mTotalMicros;
+    }
+    CLOG(DEBUG, "Database") << "SQL for ledger " << mProfiler.mLastLedgerSeq
+                            << ": " << calls << " statements, "
+                            << (micros / 1000) << "ms";
+    size_t shown = 0;
+    for (auto const& s : mProfiler.mLastLedger)
+    {
+        if (shown++ == 5)
+        {
+            break;
+        }
+        CLOG(DEBUG, "Database") << "  " << s.second.mCalls << "x "
+                                << (s.second.mTotalMicros / 1000)
+                                << "ms: " << s.first;
+    }
+}
+}
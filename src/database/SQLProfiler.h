@@ -0,0 +1,127 @@
+#pragma once
+
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/NonCopyable.h"
+#include <array>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace stellar
+{
+
+/**
+ * Per-statement profile of the SQL run through
+ * Database::getPreparedStatement.
+ *
+ * When enabled (SQL_PROFILING in the config, or the `sqlprofile` command),
+ * every StatementContext reports, when it is released, how long the statement
+ * was borrowed (binding, execution and fetching the rows) and, for INSERT,
+ * UPDATE and DELETE, how many rows it affected. Statements are reported
+ * under their normalized text with a call count, row count and a latency
+ * histogram of power-of-two buckets.
+ *
+ * LedgerManager brackets each ledger close with a LedgerScope, which keeps a
+ * breakdown of the statements run during the last closed ledger.
+ *
+ * Statements run with `session << ...` or through ReadSnapshot are not
+ * counted.
+ */
+class SQLProfiler : NonMovableOrCopyable
+{
+  public:
+    // bucket i counts calls that took less than 2^i microseconds; the last
+    // bucket counts everything slower
+    static const size_t NUM_BUCKETS = 24;
+
+    struct Stats
+    {
+        uint64_t mCalls{0};
+        uint64_t mRows{0};
+        uint64_t mTotalMicros{0};
+        uint64_t mMaxMicros{0};
+        std::array<uint64_t, NUM_BUCKETS> mBuckets;
+
+        Stats();
+        void add(uint64_t micros, uint64_t rows);
+        void merge(Stats const& other);
+        // upper bound, in microseconds, of the bucket holding quantile `q`
+        uint64_t quantile(double q) const;
+    };
+
+    struct Entry
+    {
+        bool mIsWrite;
+        Stats mTotal;
+        Stats mLedger;
+    };
+
+    // normalized statement text and its stats, most total time first
+    typedef std::vector<std::pair<std::string, Stats>> Report;
+
+  private:
+    bool mEnabled;
+    // keyed by the query text as passed to getPreparedStatement; entries
+    // are never erased, as live StatementContexts point to them
+    std::unordered_map<std::string, Entry> mEntries;
+
+    bool mInLedger{false};
+    uint32_t mLedgerSeq{0};
+    uint32_t mLastLedgerSeq{0};
+    Report mLastLedger;
+
+    Report makeReport(bool ledger, size_t n) const;
+
+  public:
+    explicit SQLProfiler(bool enabled);
+
+    bool
+    isEnabled() const
+    {
+        return mEnabled;
+    }
+    void setEnabled(bool enabled);
+
+    // Zero every count.
+    void reset();
+
+    // Entry to report `query` to, nullptr when profiling is off.
+    Entry* getEntry(std::string const& query);
+
+    void record(Entry& entry, uint64_t micros, uint64_t rows);
+
+    // Top `n` statements since the last reset.
+    Report getTop(size_t n) const;
+
+    // Statements run while closing the last ledger.
+    uint32_t
+    getLastLedgerSeq() const
+    {
+        return mLastLedgerSeq;
+    }
+    Report const&
+    getLastLedger() const
+    {
+        return mLastLedger;
+    }
+
+    // Collapse whitespace, so that queries only formatted differently
+    // are reported together.
+    static std::string normalize(std::string const& query);
+
+    // Counts statements run until destruction as those of ledger `seq`.
+    class LedgerScope : NonMovableOrCopyable
+    {
+        SQLProfiler& mProfiler;
+
+      public:
+        LedgerScope(SQLProfiler& profiler, uint32_t seq);
+        ~LedgerScope();
+    };
+};
+}
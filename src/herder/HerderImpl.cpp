@@ -7,6 +7,7 @@
 #include "crypto/SHA.h"
 #include "herder/TxSetFrame.h"
 #include "herder/LedgerCloseData.h"
+#include "database/Database.h"
 #include "ledger/LedgerManager.h"
 #include "main/Application.h"
 #include "main/Config.h"
@@ -20,6 +21,7 @@
 
 #include "medida/meter.h"
 #include "medida/counter.h"
+#include "medida/timer.h"
 #include "medida/metrics_registry.h"
 #include "xdrpp/marshal.h"
 
@@ -96,6 +98,14 @@ HerderImpl::SCPMetrics::SCPMetrics(Application& app)
           app.getMetrics().NewCounter({"herder", "pending-txs", "age2"}))
     , mHerderPendingTxs3(
           app.getMetrics().NewCounter({"herder", "pending-txs", "age3"}))
+
+    , mPreloadHit(
+          app.getMetrics().NewMeter({"herder", "preload", "hit"}, "ledger"))
+    , mPreloadMiss(
+          app.getMetrics().NewMeter({"herder", "preload", "miss"}, "ledger"))
+    , mPreloadWasted(
+          app.getMetrics().NewMeter({"herder", "preload", "wasted"}, "entry"))
+    , mPreloadLoad(app.getMetrics().NewTimer({"herder", "preload", "load"}))
 {
 }
 
@@ -540,6 +550,11 @@ HerderImpl::valueExternalized(uint64 slotIndex, Value const& value)
 
     TxSetFramePtr externalizedSet = mPendingEnvelopes.getTxSet(txSetHash);
 
+    if (mApp.getConfig().PRELOAD_PREPARED_TX_SET)
+    {
+        recordPreload(slotIndex, txSetHash);
+    }
+
     // trigger will be recreated when the ledger is closed
     // we do not want it to trigger while downloading the current set
     // and there is no point in taking a position after the round is over
@@ -1303,6 +1318,82 @@ void
 HerderImpl::confirmedBallotPrepared(uint64 slotIndex, SCPBallot const& ballot)
 {
     mSCPMetrics.mConfirmedBallotPrepared.Mark();
+    if (mApp.getConfig().PRELOAD_PREPARED_TX_SET)
+    {
+        // the loads can take a while: run them after SCP is done with this
+        // envelope rather than from within its callback
+        Value value = ballot.value;
+        mApp.getClock().getIOService().post([this, slotIndex, value]()
+                                            {
+                                                preloadTxSet(slotIndex, value);
+                                            });
+    }
+}
+
+void
+HerderImpl::preloadTxSet(uint64 slotIndex, Value const& value)
+{
+    // only for the ledger about to be closed
+    if (!mLedgerManager.isSynced() ||
+        slotIndex != mLedgerManager.getLedgerNum())
+    {
+        return;
+    }
+
+    StellarValue b;
+    try
+    {
+        xdr::xdr_from_opaque(value, b);
+    }
+    catch (...)
+    {
+        return;
+    }
+    if (mPreload && mPreload->mSlotIndex == slotIndex &&
+        mPreload->mTxSetHash == b.txSetHash)
+    {
+        return;
+    }
+    TxSetFramePtr txSet = mPendingEnvelopes.getTxSet(b.txSetHash);
+    if (!txSet)
+    {
+        return;
+    }
+
+    if (mPreload && mPreload->mSlotIndex == slotIndex)
+    {
+        // the ballot moved on to another tx set
+        mSCPMetrics.mPreloadWasted.Mark(mPreload->mKeys);
+    }
+
+    auto timer = mSCPMetrics.mPreloadLoad.TimeScope();
+    auto keys = txSet->getPrefetchKeys();
+    auto& db = mApp.getDatabase();
+    db.getEntryPrefetch().preload(db, keys);
+    mPreload =
+        make_unique<Preload>(Preload{slotIndex, b.txSetHash, keys.size()});
+    CLOG(DEBUG, "Herder") << "Preloaded " << keys.size()
+                          << " entries for txSet " << hexAbbrev(b.txSetHash)
+                          << " of slot " << slotIndex;
+}
+
+void
+HerderImpl::recordPreload(uint64 slotIndex, Hash const& txSetHash)
+{
+    if (mPreload && mPreload->mSlotIndex == slotIndex &&
+        mPreload->mTxSetHash == txSetHash)
+    {
+        mSCPMetrics.mPreloadHit.Mark();
+    }
+    else
+    {
+        mSCPMetrics.mPreloadMiss.Mark();
+        if (mPreload && mPreload->mSlotIndex == slotIndex)
+        {
+            mSCPMetrics.mPreloadWasted.Mark(mPreload->mKeys);
+        }
+    }
+    mPreload.reset();
 }
 
 void
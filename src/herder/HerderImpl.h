@@ -132,6 +132,19 @@ class HerderImpl : public Herder, public SCPDriver
 
     void updateSCPCounters();
 
+    // tx set whose entries were loaded into the entry cache ahead of
+    // externalization. Nothing is applied speculatively: apply needs the
+    // main-thread database session, so only the loads move ahead.
+    struct Preload
+    {
+        uint64 mSlotIndex;
+        Hash mTxSetHash;
+        size_t mKeys;
+    };
+    std::unique_ptr<Preload> mPreload;
+    void preloadTxSet(uint64 slotIndex, Value const& value);
+    void recordPreload(uint64 slotIndex, Hash const& txSetHash);
+
     void processSCPQueueAtIndex(uint64 slotIndex);
 
     // returns true if the local instance is in a state compatible with
@@ -253,6 +266,12 @@ class HerderImpl : public Herder, public SCPDriver
         medida::Counter& mHerderPendingTxs2;
         medida::Counter& mHerderPendingTxs3;
 
+        // Tx sets loaded ahead of externalization
+        medida::Meter& mPreloadHit;
+        medida::Meter& mPreloadMiss;
+        medida::Meter& mPreloadWasted;
+        medida::Timer& mPreloadLoad;
+
         SCPMetrics(Application& app);
     };
 
@@ -16,6 +16,10 @@
 #include "ledger/LedgerManager.h"
 #include "main/CommandHandler.h"
 #include "ledger/LedgerHeaderFrame.h"
+#include "ledger/HistoryPruner.h"
+#include "medida/meter.h"
+#include "medida/metrics_registry.h"
+#include "medida/timer.h"
 
 using namespace stellar;
 using namespace stellar::txtest;
@@ -33,6 +37,7 @@ TEST_CASE("standalone", "[herder]")
     cfg.QUORUM_SET.threshold = 1;
     cfg.QUORUM_SET.validators.clear();
     cfg.QUORUM_SET.validators.push_back(v0NodeID);
+    cfg.PRELOAD_PREPARED_TX_SET = true;
 
     VirtualClock clock;
     Application::pointer app = Application::create(clock, cfg);
@@ -68,6 +73,11 @@ TEST_CASE("standalone", "[herder]")
             b1Account = loadAccount(b1, *app);
             REQUIRE(a1Account->getBalance() == paymentAmount);
             REQUIRE(b1Account->getBalance() == paymentAmount);
+
+            // tx sets were loaded once their ballots were confirmed prepared
+            auto& preloadHit = app->getMetrics().NewMeter(
+                {"herder", "preload", "hit"}, "ledger");
+            REQUIRE(preloadHit.count() > 0);
         };
 
         auto setup = [&](asio::error_code const& error)
@@ -98,22 +108,34 @@ TEST_CASE("standalone", "[herder]")
 
         SECTION("Queue processing test")
         {
-            app->getCommandHandler().manualCmd("maintenance?queue=true");
+            // history is deleted in the background: run the queue and wait
+            // for the pruner to catch up
+            auto& pruner = app->getLedgerManager().getHistoryPruner();
+            auto maintenance = [&]()
+            {
+                app->getCommandHandler().manualCmd("maintenance?queue=true");
+                while (!pruner.isIdle())
+                {
+                    app->getClock().crank(true);
+                }
+            };
+
+            maintenance();
 
             app->getCommandHandler().manualCmd("setcursor?id=A1&cursor=1");
-            app->getCommandHandler().manualCmd("maintenance?queue=true");
+            maintenance();
             auto& db = app->getDatabase();
             auto& sess = db.getSession();
             LedgerHeaderFrame::pointer lh;
 
             app->getCommandHandler().manualCmd("setcursor?id=A2&cursor=3");
-            app->getCommandHandler().manualCmd("maintenance?queue=true");
+            maintenance();
             lh = LedgerHeaderFrame::loadBySequence(2, db, sess);
             REQUIRE(!!lh);
 
             app->getCommandHandler().manualCmd("setcursor?id=A1&cursor=2");
             // this should delete items older than sequence 2
-            app->getCommandHandler().manualCmd("maintenance?queue=true");
+            maintenance();
             lh = LedgerHeaderFrame::loadBySequence(2, db, sess);
             REQUIRE(!lh);
             lh = LedgerHeaderFrame::loadBySequence(3, db, sess);
@@ -123,14 +145,14 @@ TEST_CASE("standalone", "[herder]")
             SECTION("set min to 3 by update")
             {
                 app->getCommandHandler().manualCmd("setcursor?id=A1&cursor=3");
-                app->getCommandHandler().manualCmd("maintenance?queue=true");
+                maintenance();
                 lh = LedgerHeaderFrame::loadBySequence(3, db, sess);
                 REQUIRE(!lh);
             }
             SECTION("set min to 3 by deletion")
             {
                 app->getCommandHandler().manualCmd("dropcursor?id=A1");
-                app->getCommandHandler().manualCmd("maintenance?queue=true");
+                maintenance();
                 lh = LedgerHeaderFrame::loadBySequence(3, db, sess);
                 REQUIRE(!lh);
             }
@@ -138,6 +160,106 @@ TEST_CASE("standalone", "[herder]")
     }
 }
 
+TEST_CASE("prepared tx set preload", "[herder]")
+{
+    Config cfg(getTestConfig());
+    cfg.PRELOAD_PREPARED_TX_SET = true;
+
+    VirtualClock clock;
+    Application::pointer app = Application::create(clock, cfg);
+    app->start();
+
+    Hash const& networkID = app->getNetworkID();
+    auto& herder = static_cast<HerderImpl&>(app->getHerder());
+    auto& lm = app->getLedgerManager();
+
+    SecretKey root = getRoot(networkID);
+    SequenceNumber rootSeq = getAccountSeqNum(root, *app) + 1;
+    int64_t const paymentAmount = lm.getMinBalance(0);
+
+    auto makeTxSet = [&](SecretKey const& dest) -> TxSetFramePtr
+    {
+        TxSetFramePtr txSet = std::make_shared<TxSetFrame>(
+            lm.getLastClosedLedgerHeader().hash);
+        txSet->add(createCreateAccountTx(networkID, root, dest, rootSeq,
+                                         paymentAmount));
+        herder.recvTxSet(txSet->getContentsHash(), *txSet);
+        return txSet;
+    };
+    TxSetFramePtr txSetA = makeTxSet(getAccount("A"));
+    TxSetFramePtr txSetB = makeTxSet(getAccount("B"));
+    size_t const keysA = txSetA->getPrefetchKeys().size();
+
+    uint64 const slotIndex = lm.getLedgerNum();
+    auto makeValue = [&](TxSetFramePtr txSet) -> Value
+    {
+        StellarValue sv;
+        sv.txSetHash = txSet->getContentsHash();
+        auto const& lcl = lm.getLastClosedLedgerHeader();
+        sv.closeTime = lcl.header.scpValue.closeTime + 1;
+        return xdr::xdr_to_opaque(sv);
+    };
+
+    auto& loads = app->getMetrics().NewTimer({"herder", "preload", "load"});
+    auto& hit =
+        app->getMetrics().NewMeter({"herder", "preload", "hit"}, "ledger");
+    auto& miss =
+        app->getMetrics().NewMeter({"herder", "preload", "miss"}, "ledger");
+    auto& wasted =
+        app->getMetrics().NewMeter({"herder", "preload", "wasted"}, "entry");
+
+    // the entries are loaded once SCP is done with the envelope
+    auto prepare = [&](TxSetFramePtr txSet)
+    {
+        auto before = loads.count();
+        herder.confirmedBallotPrepared(slotIndex,
+                                       SCPBallot(1, makeValue(txSet)));
+        REQUIRE(loads.count() == before);
+        app->getClock().crank(false);
+        REQUIRE(loads.count() == before + 1);
+    };
+
+    SECTION("externalized set was preloaded")
+    {
+        prepare(txSetA);
+        herder.valueExternalized(slotIndex, makeValue(txSetA));
+        REQUIRE(hit.count() == 1);
+        REQUIRE(miss.count() == 0);
+        REQUIRE(wasted.count() == 0);
+    }
+
+    SECTION("ballot moved on to another set")
+    {
+        prepare(txSetA);
+        prepare(txSetB);
+        REQUIRE(wasted.count() == keysA);
+        herder.valueExternalized(slotIndex, makeValue(txSetB));
+        REQUIRE(hit.count() == 1);
+        REQUIRE(miss.count() == 0);
+        REQUIRE(wasted.count() == keysA);
+    }
+
+    SECTION("another set was externalized")
+    {
+        prepare(txSetA);
+        herder.valueExternalized(slotIndex, makeValue(txSetB));
+        REQUIRE(hit.count() == 0);
+        REQUIRE(miss.count() == 1);
+        REQUIRE(wasted.count() == keysA);
+    }
+
+    SECTION("nothing was preloaded")
+    {
+        herder.valueExternalized(slotIndex, makeValue(txSetB));
+        REQUIRE(hit.count() == 0);
+        REQUIRE(miss.count() == 1);
+        REQUIRE(wasted.count() == 0);
+        REQUIRE(loads.count() == 0);
+    }
+
+    REQUIRE(lm.getLastClosedLedgerNum() == slotIndex);
+}
+
 // see if we flood at the right times
 //  invalid tx
 //  normal tx
@@ -11,6 +11,7 @@
 #include "main/Config.h"
 #include "database/Database.h"
 #include <algorithm>
+#include <set>
 
 #include "xdrpp/printer.h"
 
@@ -36,6 +37,8 @@ TxSetFrame::TxSetFrame(Hash const& networkID, TransactionSet const& xdrSet)
             TransactionFrame::makeTransactionFromWire(networkID, txEnvelope);
         mTransactions.push_back(tx);
     }
+    // sorting, validation and apply need both hashes of every transaction
+    TransactionFrame::computeHashes(mTransactions);
     mPreviousLedgerHash = xdrSet.previousLedgerHash;
 }
 
@@ -140,6 +143,27 @@ TxSetFrame::sortForApply()
     return retList;
 }
 
+std::vector<LedgerKey>
+TxSetFrame::getPrefetchKeys() const
+{
+    std::vector<LedgerKey> keys;
+    for (auto const& tx : mTransactions)
+    {
+        tx->addPrefetchKeys(keys);
+    }
+
+    std::vector<LedgerKey> res;
+    std::set<LedgerKey, LedgerEntryIdCmp> seen;
+    for (auto& k : keys)
+    {
+        if (seen.insert(k).second)
+        {
+            res.emplace_back(std::move(k));
+        }
+    }
+    return res;
+}
+
 struct SurgeSorter
 {
     map<AccountID, float>& mAccountFeeMap;
@@ -353,7 +377,7 @@ TxSetFrame::getContentsHash()
         hasher->add(mPreviousLedgerHash);
         for (unsigned int n = 0; n < mTransactions.size(); n++)
         {
-            hasher->add(xdr::xdr_to_opaque(mTransactions[n]->getEnvelope()));
+            hasher->add(mTransactions[n]->getEnvelopeBytes());
         }
         mHash = hasher->finish();
         mHashIsValid = true;
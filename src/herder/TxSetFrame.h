@@ -38,6 +38,10 @@ class TxSetFrame
 
     std::vector<TransactionFramePtr> sortForApply();
 
+    // keys of the ledger entries applying this set is known to load, once
+    // each
+    std::vector<LedgerKey> getPrefetchKeys() const;
+
     bool checkValid(Application& app) const;
     void trimInvalid(Application& app,
                      std::vector<TransactionFramePtr>& trimmed);
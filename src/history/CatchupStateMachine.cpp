@@ -16,12 +16,15 @@
 #include "herder/HerderImpl.h"
 #include "ledger/LedgerDelta.h"
 #include "ledger/LedgerManager.h"
+#include "process/ProcessManager.h"
 #include "transactions/TransactionFrame.h"
 #include "herder/LedgerCloseData.h"
 #include "util/Logging.h"
 #include "util/XDRStream.h"
 #include "xdrpp/printer.h"
 #include "util/Math.h"
+#include "medida/meter.h"
+#include "medida/metrics_registry.h"
 
 #include <random>
 #include <memory>
@@ -541,6 +544,119 @@ CatchupStateMachine::enterRetryingState(uint64_t nseconds)
         });
 }
 
+static HistoryManager::VerifyHashStatus
+verifyLedgerHistoryEntry(LedgerHeaderHistoryEntry const& hhe)
+{
+    LedgerHeaderFrame lFrame(hhe.header);
+    Hash calculated = lFrame.getHash();
+    if (calculated != hhe.hash)
+    {
+        CLOG(ERROR, "History")
+            << "Bad ledger-header history entry: claimed ledger "
+            << LedgerManager::ledgerAbbrev(hhe) << " actually hashes to "
+            << hexAbbrev(calculated);
+        return HistoryManager::VERIFY_HASH_BAD;
+    }
+    return HistoryManager::VERIFY_HASH_OK;
+}
+
+static HistoryManager::VerifyHashStatus
+verifyLedgerHistoryLink(Hash const& prev, LedgerHeaderHistoryEntry const& curr)
+{
+    if (verifyLedgerHistoryEntry(curr) != HistoryManager::VERIFY_HASH_OK)
+    {
+        return HistoryManager::VERIFY_HASH_BAD;
+    }
+    if (prev != curr.header.previousLedgerHash)
+    {
+        CLOG(ERROR, "History")
+            << "Bad hash-chain: " << LedgerManager::ledgerAbbrev(curr)
+            << " wants prev hash " << hexAbbrev(curr.header.previousLedgerHash)
+            << " but actual prev hash is " << hexAbbrev(prev);
+        return HistoryManager::VERIFY_HASH_BAD;
+    }
+    return HistoryManager::VERIFY_HASH_OK;
+}
+
+// Outcome of verifying the internal hash-chain of a single checkpoint's
+// ledger-header file. Only the entries at or above the first ledger we
+// need are considered; the first and last of those are kept so the
+// links between adjacent checkpoints can be checked once all of them
+// are in.
+struct CatchupStateMachine::CheckpointVerifyResult
+{
+    HistoryManager::VerifyHashStatus mStatus{HistoryManager::VERIFY_HASH_OK};
+    bool mEmpty{true};
+    LedgerHeaderHistoryEntry mFirst;
+    LedgerHeaderHistoryEntry mLast;
+};
+
+// Helper struct that holds the state of an ongoing verification of the
+// ledger-history chain: the LCL it must connect to and the results of
+// the per-checkpoint verifications running on the worker pool.
+struct CatchupStateMachine::VerifyState
+{
+    LedgerHeaderHistoryEntry mLastClosed;
+    std::map<uint32_t, CheckpointVerifyResult> mResults;
+    size_t mPending{0};
+
+    VerifyState(LedgerHeaderHistoryEntry const& lastClosed)
+        : mLastClosed(lastClosed)
+    {
+    }
+};
+
+// Runs on a worker thread: must not touch anything but its arguments.
+void
+CatchupStateMachine::verifyHistoryOfSingleCheckpoint(
+    std::string const& filename, uint32_t minSeq,
+    CheckpointVerifyResult& result)
+{
+    XDRInputFileStream hdrIn;
+    CLOG(DEBUG, "History") << "Verifying ledger headers from " << filename
+                           << " starting from ledger " << minSeq;
+    hdrIn.open(filename);
+    LedgerHeaderHistoryEntry curr;
+    while (hdrIn && hdrIn.readOne(curr))
+    {
+        uint32_t expectedSeq =
+            result.mEmpty ? minSeq : result.mLast.header.ledgerSeq + 1;
+        if (curr.header.ledgerSeq < expectedSeq)
+        {
+            // Harmless prehistory
+            continue;
+        }
+        else if (curr.header.ledgerSeq > expectedSeq && !result.mEmpty)
+        {
+            CLOG(ERROR, "History")
+                << "History chain overshot expected ledger seq " << expectedSeq
+                << ", got " << curr.header.ledgerSeq << " instead";
+            result.mStatus = HistoryManager::VERIFY_HASH_BAD;
+            return;
+        }
+        if (result.mEmpty)
+        {
+            // The link to the previous checkpoint is checked serially,
+            // once every checkpoint has been verified.
+            if (verifyLedgerHistoryEntry(curr) !=
+                HistoryManager::VERIFY_HASH_OK)
+            {
+                result.mStatus = HistoryManager::VERIFY_HASH_BAD;
+                return;
+            }
+            result.mFirst = curr;
+            result.mEmpty = false;
+        }
+        else if (verifyLedgerHistoryLink(result.mLast.hash, curr) !=
+                 HistoryManager::VERIFY_HASH_OK)
+        {
+            result.mStatus = HistoryManager::VERIFY_HASH_BAD;
+            return;
+        }
+        result.mLast = curr;
+    }
+}
+
 void
 CatchupStateMachine::enterVerifyingState()
 {
@@ -549,22 +665,27 @@ CatchupStateMachine::enterVerifyingState()
 
     if (mMode == HistoryManager::CATCHUP_COMPLETE)
     {
-        auto prev = std::make_shared<LedgerHeaderHistoryEntry>(
+        auto state = std::make_shared<VerifyState>(
             mApp.getLedgerManager().getLastClosedLedgerHeader());
 
         CLOG(INFO, "History") << "Verifying ledger-history chain of "
                               << mHeaderInfos.size()
                               << " transaction-history files from LCL "
-                              << LedgerManager::ledgerAbbrev(*prev);
+                              << LedgerManager::ledgerAbbrev(
+                                     state->mLastClosed);
 
-        auto i = mHeaderInfos.begin();
-        if (i == mHeaderInfos.end())
+        if (mHeaderInfos.empty())
         {
-            finishVerifyingState(HistoryManager::VERIFY_HASH_OK);
+            auto status = verifyCheckpointBoundaries(state);
+            finishVerifyingState(status);
         }
         else
         {
-            advanceVerifyingState(prev, i->first);
+            state->mPending = mHeaderInfos.size();
+            for (auto const& pair : mHeaderInfos)
+            {
+                verifyCheckpointInBackground(state, pair.first);
+            }
         }
     }
     else if (mMode == HistoryManager::CATCHUP_MINIMAL)
@@ -587,57 +708,125 @@ CatchupStateMachine::enterVerifyingState()
     }
 }
 
-// CATCHUP_VERIFYING has to be split in 3 pieces (enter/advance/finish) so
-// that it can bounce off the io_service scheduler in fine enough
-// increments to keep normal network traffic flowing, SCP messages flooding
-// and such. The same is true for CATCHUP_APPLYING.
+// CATCHUP_VERIFYING of a full history chain is split so that every
+// checkpoint file is re-hashed independently on the worker pool; the main
+// thread only collects results and, once they're all in, checks the links
+// between adjacent checkpoints (and to the LCL), which is cheap. This keeps
+// normal network traffic flowing, SCP messages flooding and such while
+// months of headers are being verified.
+
+void
+CatchupStateMachine::verifyCheckpointInBackground(
+    std::shared_ptr<VerifyState> state, uint32_t checkpoint)
+{
+    auto i = mHeaderInfos.find(checkpoint);
+    assert(i != mHeaderInfos.end());
+
+    Application& app = mApp;
+    std::string filename = i->second->localPath_nogz();
+    uint32_t minSeq = state->mLastClosed.header.ledgerSeq + 1;
+    std::weak_ptr<CatchupStateMachine> weak(shared_from_this());
+
+    app.getWorkerIOService().post(
+        [&app, weak, state, checkpoint, filename, minSeq]()
+        {
+            CheckpointVerifyResult result;
+            try
+            {
+                verifyHistoryOfSingleCheckpoint(filename, minSeq, result);
+            }
+            catch (std::exception& e)
+            {
+                CLOG(ERROR, "History") << "Error verifying " << filename
+                                       << ": " << e.what();
+                result.mStatus = HistoryManager::VERIFY_HASH_BAD;
+            }
+            app.getClock().getIOService().post(
+                [weak, state, checkpoint, result]()
+                {
+                    auto self = weak.lock();
+                    if (!self)
+                    {
+                        return;
+                    }
+                    self->advanceVerifyingState(state, checkpoint, result);
+                });
+        });
+}
 
 void
 CatchupStateMachine::advanceVerifyingState(
-    std::shared_ptr<LedgerHeaderHistoryEntry> prev, uint32_t checkpoint)
+    std::shared_ptr<VerifyState> state, uint32_t checkpoint,
+    CheckpointVerifyResult const& result)
 {
     assert(mState == CATCHUP_VERIFYING);
     assert(mMode == HistoryManager::CATCHUP_COMPLETE);
+    assert(state->mPending > 0);
 
-    auto status = HistoryManager::VERIFY_HASH_OK;
-
-    auto i = mHeaderInfos.find(checkpoint);
-    if (i != mHeaderInfos.end())
+    if (result.mStatus != HistoryManager::VERIFY_HASH_OK)
     {
-        status = verifyHistoryOfSingleCheckpoint(prev, checkpoint);
-        ++i;
+        CLOG(ERROR, "History") << "Ledger headers of checkpoint "
+                               << checkpoint << " failed verification";
     }
+    state->mResults[checkpoint] = result;
+    mApp.getMetrics()
+        .NewMeter({"history", "verify", "checkpoint"}, "checkpoint")
+        .Mark();
 
-    if (status != HistoryManager::VERIFY_HASH_OK || i == mHeaderInfos.end())
+    if (--state->mPending == 0)
     {
+        auto status = verifyCheckpointBoundaries(state);
+        finishVerifyingState(status);
+    }
+}
+
+HistoryManager::VerifyHashStatus
+CatchupStateMachine::verifyCheckpointBoundaries(
+    std::shared_ptr<VerifyState> state)
+{
+    assert(state->mPending == 0);
 
-        if (prev->header.ledgerSeq + 1 != mNextLedger)
+    LedgerHeaderHistoryEntry prev = state->mLastClosed;
+    for (auto const& pair : state->mResults)
+    {
+        auto const& res = pair.second;
+        if (res.mStatus != HistoryManager::VERIFY_HASH_OK)
+        {
+            CLOG(ERROR, "History") << "History chain broken in checkpoint "
+                                   << pair.first;
+            return res.mStatus;
+        }
+        if (res.mEmpty)
+        {
+            // Entirely prehistory
+            continue;
+        }
+        uint32_t expectedSeq = prev.header.ledgerSeq + 1;
+        if (res.mFirst.header.ledgerSeq != expectedSeq)
         {
             CLOG(ERROR, "History")
-                << "Insufficient history to connect chain to ledger "
-                << mNextLedger;
-            CLOG(ERROR, "History") << "History chain ends at "
-                                   << prev->header.ledgerSeq;
-            status = HistoryManager::VERIFY_HASH_BAD;
+                << "History chain overshot expected ledger seq " << expectedSeq
+                << ", got " << res.mFirst.header.ledgerSeq << " instead";
+            return HistoryManager::VERIFY_HASH_BAD;
         }
-        status = mApp.getLedgerManager().verifyCatchupCandidate(*prev);
-        finishVerifyingState(status);
+        if (verifyLedgerHistoryLink(prev.hash, res.mFirst) !=
+            HistoryManager::VERIFY_HASH_OK)
+        {
+            return HistoryManager::VERIFY_HASH_BAD;
+        }
+        prev = res.mLast;
     }
-    else
+
+    if (prev.header.ledgerSeq + 1 != mNextLedger)
     {
-        uint32_t nextCheckpoint = i->first;
-        std::weak_ptr<CatchupStateMachine> weak(shared_from_this());
-        mApp.getClock().getIOService().post(
-            [weak, prev, nextCheckpoint]()
-            {
-                auto self = weak.lock();
-                if (!self)
-                {
-                    return;
-                }
-                self->advanceVerifyingState(prev, nextCheckpoint);
-            });
+        CLOG(ERROR, "History")
+            << "Insufficient history to connect chain to ledger "
+            << mNextLedger;
+        CLOG(ERROR, "History") << "History chain ends at "
+                               << prev.header.ledgerSeq;
+        return HistoryManager::VERIFY_HASH_BAD;
     }
+    return mApp.getLedgerManager().verifyCatchupCandidate(prev);
 }
 
 void
@@ -667,79 +856,6 @@ CatchupStateMachine::finishVerifyingState(
     }
 }
 
-static HistoryManager::VerifyHashStatus
-verifyLedgerHistoryEntry(LedgerHeaderHistoryEntry const& hhe)
-{
-    LedgerHeaderFrame lFrame(hhe.header);
-    Hash calculated = lFrame.getHash();
-    if (calculated != hhe.hash)
-    {
-        CLOG(ERROR, "History")
-            << "Bad ledger-header history entry: claimed ledger "
-            << LedgerManager::ledgerAbbrev(hhe) << " actually hashes to "
-            << hexAbbrev(calculated);
-        return HistoryManager::VERIFY_HASH_BAD;
-    }
-    return HistoryManager::VERIFY_HASH_OK;
-}
-
-static HistoryManager::VerifyHashStatus
-verifyLedgerHistoryLink(Hash const& prev, LedgerHeaderHistoryEntry const& curr)
-{
-    if (verifyLedgerHistoryEntry(curr) != HistoryManager::VERIFY_HASH_OK)
-    {
-        return HistoryManager::VERIFY_HASH_BAD;
-    }
-    if (prev != curr.header.previousLedgerHash)
-    {
-        CLOG(ERROR, "History")
-            << "Bad hash-chain: " << LedgerManager::ledgerAbbrev(curr)
-            << " wants prev hash " << hexAbbrev(curr.header.previousLedgerHash)
-            << " but actual prev hash is " << hexAbbrev(prev);
-        return HistoryManager::VERIFY_HASH_BAD;
-    }
-    return HistoryManager::VERIFY_HASH_OK;
-}
-
-HistoryManager::VerifyHashStatus
-CatchupStateMachine::verifyHistoryOfSingleCheckpoint(
-    std::shared_ptr<LedgerHeaderHistoryEntry> prev, uint32_t checkpoint)
-{
-    auto i = mHeaderInfos.find(checkpoint);
-    assert(i != mHeaderInfos.end());
-    auto hi = i->second;
-
-    XDRInputFileStream hdrIn;
-    CLOG(INFO, "History") << "Verifying ledger headers from "
-                          << hi->localPath_nogz() << " starting from ledger "
-                          << LedgerManager::ledgerAbbrev(*prev);
-    hdrIn.open(hi->localPath_nogz());
-    LedgerHeaderHistoryEntry curr;
-    while (hdrIn && hdrIn.readOne(curr))
-    {
-        uint32_t expectedSeq = prev->header.ledgerSeq + 1;
-        if (curr.header.ledgerSeq < expectedSeq)
-        {
-            // Harmless prehistory
-            continue;
-        }
-        else if (curr.header.ledgerSeq > expectedSeq)
-        {
-            CLOG(ERROR, "History")
-                << "History chain overshot expected ledger seq " << expectedSeq
-                << ", got " << curr.header.ledgerSeq << " instead";
-            return HistoryManager::VERIFY_HASH_BAD;
-        }
-        if (verifyLedgerHistoryLink(prev->hash, curr) !=
-            HistoryManager::VERIFY_HASH_OK)
-        {
-            return HistoryManager::VERIFY_HASH_BAD;
-        }
-        *prev = curr;
-    }
-    return HistoryManager::VERIFY_HASH_OK;
-}
-
 // Helper struct that encapsulates the state of ongoing incremental
 // application of either buckets or headers.
 struct CatchupStateMachine::ApplyState
@@ -808,6 +924,12 @@ CatchupStateMachine::advanceApplyingState(std::shared_ptr<ApplyState> state)
             keepGoing = (state->mBucketLevel != 0);
             applySingleBucketLevel(state->mApplyingBuckets,
                                    state->mBucketLevel);
+            if (!keepGoing)
+            {
+                // the accounts now come from the buckets
+                auto& db = mApp.getDatabase();
+                db.getInflationVoteTally().rebuild(db);
+            }
         }
         else if (mMode == HistoryManager::CATCHUP_COMPLETE)
         {
@@ -1119,6 +1241,9 @@ CatchupStateMachine::enterEndState()
     mState = CATCHUP_END;
     CLOG(DEBUG, "History") << "Completed catchup from '" << mArchive->getName()
                            << "', at nextLedger=" << mNextLedger;
+
+    // Nothing still queued on behalf of this catchup will be looked at again.
+    mApp.getProcessManager().cancelPendingProcesses(PROCESS_CATCHUP);
     mEndHandler(mError, mMode, mLastClosed);
 }
 }
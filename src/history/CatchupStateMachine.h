@@ -143,11 +143,20 @@ class CatchupStateMachine
     void enterFetchingState(
         std::shared_ptr<FileTransferInfo<FileCatchupState>> fi = nullptr);
 
+    struct VerifyState;
+    struct CheckpointVerifyResult;
     void enterVerifyingState();
-    void advanceVerifyingState(std::shared_ptr<LedgerHeaderHistoryEntry> prev,
-                               uint32_t checkpoint);
-    HistoryManager::VerifyHashStatus verifyHistoryOfSingleCheckpoint(
-        std::shared_ptr<LedgerHeaderHistoryEntry> prev, uint32_t checkpoint);
+    static void
+    verifyHistoryOfSingleCheckpoint(std::string const& filename,
+                                    uint32_t minSeq,
+                                    CheckpointVerifyResult& result);
+    void verifyCheckpointInBackground(std::shared_ptr<VerifyState> state,
+                                      uint32_t checkpoint);
+    void advanceVerifyingState(std::shared_ptr<VerifyState> state,
+                               uint32_t checkpoint,
+                               CheckpointVerifyResult const& result);
+    HistoryManager::VerifyHashStatus
+    verifyCheckpointBoundaries(std::shared_ptr<VerifyState> state);
     void finishVerifyingState(HistoryManager::VerifyHashStatus status);
 
     struct ApplyState;
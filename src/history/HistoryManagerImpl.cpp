@@ -351,7 +351,8 @@ HistoryManagerImpl::decompress(
         outputFile = filename;
     }
     commandLine += filename_gz;
-    auto exit = app.getProcessManager().runProcess(commandLine, outputFile);
+    auto exit = app.getProcessManager().runProcess(commandLine, outputFile,
+                                                   PROCESS_CATCHUP);
     exit.async_wait(
         [&app, filename_gz, filename, handler](asio::error_code const& ec)
         {
@@ -385,7 +386,8 @@ HistoryManagerImpl::compress(
         outputFile = filename;
     }
     commandLine += filename_nogz;
-    auto exit = app.getProcessManager().runProcess(commandLine, outputFile);
+    auto exit = app.getProcessManager().runProcess(commandLine, outputFile,
+                                                   PROCESS_PUBLISH);
     exit.async_wait(
         [&app, filename_nogz, filename, handler](asio::error_code const& ec)
         {
@@ -409,7 +411,8 @@ HistoryManagerImpl::putFile(
 {
     assert(archive->hasPutCmd());
     auto cmd = archive->putFileCmd(local, remote);
-    auto exit = this->mApp.getProcessManager().runProcess(cmd);
+    auto exit =
+        this->mApp.getProcessManager().runProcess(cmd, "", PROCESS_PUBLISH);
     exit.async_wait(handler);
 }
 
@@ -421,7 +424,8 @@ HistoryManagerImpl::getFile(
 {
     assert(archive->hasGetCmd());
     auto cmd = archive->getFileCmd(remote, local);
-    auto exit = this->mApp.getProcessManager().runProcess(cmd);
+    auto exit =
+        this->mApp.getProcessManager().runProcess(cmd, "", PROCESS_CATCHUP);
     exit.async_wait(handler);
 }
 
@@ -433,7 +437,8 @@ HistoryManagerImpl::mkdir(
     if (archive->hasMkdirCmd())
     {
         auto cmd = archive->mkdirCmd(dir);
-        auto exit = this->mApp.getProcessManager().runProcess(cmd);
+        auto exit =
+            this->mApp.getProcessManager().runProcess(cmd, "", PROCESS_PUBLISH);
         exit.async_wait(handler);
     }
     else
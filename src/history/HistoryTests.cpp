@@ -5,21 +5,28 @@
 #include "main/Application.h"
 #include "history/HistoryManager.h"
 #include "history/HistoryArchive.h"
+#include "history/FileTransferInfo.h"
 #include "main/test.h"
 #include "main/Config.h"
 #include "main/PersistentState.h"
 #include "bucket/BucketManager.h"
 #include "bucket/BucketList.h"
 #include "crypto/Hex.h"
+#include "crypto/SHA.h"
+#include "database/Database.h"
 #include "lib/catch.hpp"
 #include "util/Fs.h"
 #include "util/Logging.h"
 #include "util/Timer.h"
 #include "util/TmpDir.h"
+#include "util/XDRStream.h"
+#include "transactions/TransactionFrame.h"
 #include "transactions/TxTests.h"
 #include "ledger/LedgerManager.h"
 #include "util/NonCopyable.h"
 #include "herder/LedgerCloseData.h"
+#include "medida/metrics_registry.h"
+#include "medida/timer.h"
 #include <cstdio>
 #include <xdrpp/autocheck.h>
 #include <fstream>
@@ -66,6 +73,12 @@ class TmpDirConfigurator : public Configurator
             std::make_shared<HistoryArchive>("test", getCmd, putCmd, mkdirCmd);
         return cfg;
     }
+
+    std::string
+    getArchiveDirName() const
+    {
+        return mDir.getName();
+    }
 };
 
 class HistoryTests
@@ -209,6 +222,59 @@ TEST_CASE_METHOD(HistoryTests, "HistoryManager::compress", "[history]")
     crankTillDone(done);
 }
 
+TEST_CASE_METHOD(HistoryTests, "XDROutputFileStream gzip", "[history]")
+{
+    HistoryManager& hm = app.getHistoryManager();
+    std::string fname = hm.localFilename("streamme.xdr");
+    auto hasher1 = SHA256::create();
+    auto hasher2 = SHA256::create();
+    size_t bytes1 = 0, bytes2 = 0;
+    std::vector<LedgerHeaderHistoryEntry> entries;
+    for (size_t i = 0; i < 100; ++i)
+    {
+        entries.push_back(
+            autocheck::generator<LedgerHeaderHistoryEntry>()(10));
+    }
+    {
+        XDROutputFileStream out;
+        out.open(fname + ".gz", XDROutputFileStream::GZIP);
+        for (auto const& e : entries)
+        {
+            CHECK(out.writeOne(e, hasher1.get(), &bytes1));
+        }
+        CHECK(out.close());
+    }
+    bool done = false;
+    hm.decompress(fname + ".gz", [&done](asio::error_code const& ec)
+                  {
+                      CHECK(!ec);
+                      done = true;
+                  });
+    crankTillDone(done);
+
+    // The uncompressed file matches, and hashes the same as, what went in.
+    XDRInputFileStream in;
+    in.open(fname);
+    LedgerHeaderHistoryEntry e;
+    size_t n = 0;
+    while (in && in.readOne(e))
+    {
+        REQUIRE(n < entries.size());
+        CHECK(e == entries[n++]);
+    }
+    CHECK(n == entries.size());
+    in.close();
+
+    XDROutputFileStream plain;
+    plain.open(fname + ".plain");
+    for (auto const& e2 : entries)
+    {
+        plain.writeOne(e2, hasher2.get(), &bytes2);
+    }
+    CHECK(bytes1 == bytes2);
+    CHECK(hasher1->finish() == hasher2->finish());
+}
+
 TEST_CASE_METHOD(HistoryTests, "HistoryManager::verifyHash", "[history]")
 {
     std::string s = "hello there";
@@ -661,6 +727,102 @@ TEST_CASE_METHOD(HistoryTests, "Full history catchup",
     }
 }
 
+TEST_CASE_METHOD(HistoryTests, "Full history catchup verifies in background",
+                 "[history][historycatchup]")
+{
+    generateAndPublishInitialHistory(3);
+    uint32_t initLedger = app.getLedgerManager().getLastClosedLedgerNum();
+
+    mCfgs.emplace_back(getTestConfig(1));
+    auto app2 = Application::create(
+        clock, mConfigurator->configure(mCfgs.back(), false));
+    app2->start();
+    auto& verified = app2->getMetrics().NewMeter(
+        {"history", "verify", "checkpoint"}, "checkpoint");
+    REQUIRE(verified.count() == 0);
+
+    CHECK(catchupApplication(initLedger, HistoryManager::CATCHUP_COMPLETE,
+                             app2));
+    // every checkpoint's headers went through the worker pool
+    CHECK(verified.count() >= 3);
+    CHECK(app2->getHistoryManager().getCatchupSuccessCount() == 1);
+}
+
+TEST_CASE_METHOD(HistoryTests, "Full history catchup with corrupt headers",
+                 "[history][historycatchup]")
+{
+    generateAndPublishInitialHistory(3);
+    uint32_t initLedger = app.getLedgerManager().getLastClosedLedgerNum();
+    auto& hm = app.getHistoryManager();
+
+    // Alter one header in the middle of the second checkpoint, keeping its
+    // recorded hash, so that only the worker-side check can catch it.
+    auto tmpDir = std::dynamic_pointer_cast<TmpDirConfigurator>(mConfigurator);
+    REQUIRE(tmpDir);
+    uint32_t checkpoint = 2 * hm.getCheckpointFrequency() - 1;
+    std::string archived =
+        tmpDir->getArchiveDirName() + "/" +
+        fs::remoteName(HISTORY_FILE_TYPE_LEDGER, fs::hexStr(checkpoint),
+                       "xdr.gz");
+    REQUIRE(fs::exists(archived));
+
+    std::string local = hm.localFilename("tampered.xdr");
+    {
+        std::ifstream in(archived, std::ifstream::binary);
+        std::ofstream out(local + ".gz", std::ofstream::binary);
+        out << in.rdbuf();
+    }
+    bool done = false;
+    hm.decompress(local + ".gz", [&done](asio::error_code const& ec)
+                  {
+                      CHECK(!ec);
+                      done = true;
+                  });
+    crankTillDone(done);
+
+    std::vector<LedgerHeaderHistoryEntry> entries;
+    {
+        XDRInputFileStream in;
+        in.open(local);
+        LedgerHeaderHistoryEntry e;
+        while (in && in.readOne(e))
+        {
+            entries.push_back(e);
+        }
+    }
+    REQUIRE(entries.size() > 2);
+    entries[entries.size() / 2].header.totalCoins += 1;
+    {
+        XDROutputFileStream out;
+        out.open(archived, XDROutputFileStream::GZIP);
+        for (auto const& e : entries)
+        {
+            CHECK(out.writeOne(e));
+        }
+        CHECK(out.close());
+    }
+
+    mCfgs.emplace_back(getTestConfig(1));
+    auto app2 = Application::create(
+        clock, mConfigurator->configure(mCfgs.back(), false));
+    app2->start();
+    auto& hm2 = app2->getHistoryManager();
+    app2->getLedgerManager().startCatchUp(initLedger,
+                                          HistoryManager::CATCHUP_COMPLETE);
+
+    // the failure found on the worker ends catchup on the main thread
+    while (hm2.getCatchupFailureCount() == 0 &&
+           hm2.getCatchupSuccessCount() == 0 &&
+           !app2->getClock().getIOService().stopped())
+    {
+        app2->getClock().crank(true);
+    }
+    CHECK(hm2.getCatchupFailureCount() == 1);
+    CHECK(hm2.getCatchupSuccessCount() == 0);
+    CHECK(app2->getLedgerManager().getState() ==
+          LedgerManager::LM_CATCHING_UP_STATE);
+}
+
 TEST_CASE_METHOD(HistoryTests, "History publish queueing",
                  "[history][historydelay][historycatchup]")
 {
@@ -865,3 +1027,196 @@ TEST_CASE_METHOD(S3HistoryTests, "Publish/catchup via s3", "[hide][s3]")
         Config::TESTDB_IN_MEMORY_SQLITE, HistoryManager::CATCHUP_COMPLETE,
         "s3");
 }
+
+// Recreate the transaction history tables in their schema 1 layout, with
+// base64 XDR in TEXT columns.
+static void
+useLegacyTxHistoryTables(Database& db)
+{
+    db.clearPreparedStatementCache();
+    auto& sess = db.getSession();
+    sess << "DROP TABLE IF EXISTS txhistory";
+    sess << "DROP TABLE IF EXISTS txfeehistory";
+    sess << "CREATE TABLE txhistory ("
+            "txid        CHARACTER(64) NOT NULL,"
+            "ledgerseq   INT NOT NULL CHECK (ledgerseq >= 0),"
+            "txindex     INT NOT NULL,"
+            "txbody      TEXT NOT NULL,"
+            "txresult    TEXT NOT NULL,"
+            "txmeta      TEXT NOT NULL,"
+            "PRIMARY KEY (ledgerseq, txindex)"
+            ")";
+    sess << "CREATE INDEX histbyseq ON txhistory (ledgerseq);";
+    sess << "CREATE TABLE txfeehistory ("
+            "txid        CHARACTER(64) NOT NULL,"
+            "ledgerseq   INT NOT NULL CHECK (ledgerseq >= 0),"
+            "txindex     INT NOT NULL,"
+            "txchanges   TEXT NOT NULL,"
+            "PRIMARY KEY (ledgerseq, txindex)"
+            ")";
+    sess << "CREATE INDEX histfeebyseq ON txfeehistory (ledgerseq);";
+    db.putSchemaVersion(1);
+}
+
+TEST_CASE_METHOD(HistoryTests, "txhistory binary schema upgrade",
+                 "[history][txhistory]")
+{
+    app.start();
+    auto& db = app.getDatabase();
+    REQUIRE(db.getDBSchemaVersion() == Database::SCHEMA_VERSION);
+
+    useLegacyTxHistoryTables(db);
+    for (size_t i = 0; i < 8; ++i)
+    {
+        generateRandomLedger();
+    }
+
+    std::vector<TransactionResultSet> results;
+    std::vector<std::vector<LedgerEntryChanges>> fees;
+    for (auto seq : mLedgerSeqs)
+    {
+        results.emplace_back(
+            TransactionFrame::getTransactionHistoryMeta(db, seq));
+        fees.emplace_back(TransactionFrame::getTransactionFeeMeta(db, seq));
+        CHECK(!results.back().results.empty());
+    }
+
+    db.upgradeToCurrentSchema();
+    REQUIRE(db.getDBSchemaVersion() == Database::SCHEMA_VERSION);
+    for (size_t i = 0; i < mLedgerSeqs.size(); ++i)
+    {
+        auto seq = mLedgerSeqs[i];
+        CHECK(TransactionFrame::getTransactionHistoryMeta(db, seq) ==
+              results[i]);
+        CHECK(TransactionFrame::getTransactionFeeMeta(db, seq) == fees[i]);
+    }
+
+    // Ledgers closed after the upgrade are stored in binary, and the whole
+    // range still streams out for publishing.
+    for (size_t i = 0; i < 4; ++i)
+    {
+        generateRandomLedger();
+    }
+    size_t expected = 0;
+    for (auto seq : mLedgerSeqs)
+    {
+        auto res = TransactionFrame::getTransactionHistoryMeta(db, seq);
+        CHECK(!res.results.empty());
+        expected += res.results.size();
+    }
+
+    auto& hm = app.getHistoryManager();
+    XDROutputFileStream txOut, txResultOut;
+    txOut.open(hm.localFilename("transactions.xdr"));
+    txResultOut.open(hm.localFilename("results.xdr"));
+    size_t n = TransactionFrame::copyTransactionsToStream(
+        app.getNetworkID(), db, db.getSession(), mLedgerSeqs.front(),
+        static_cast<uint32_t>(mLedgerSeqs.size()), txOut, txResultOut);
+    CHECK(n == expected);
+}
+
+TEST_CASE_METHOD(HistoryTests, "txhistory storage bench",
+                 "[history][txhistory][bench][hide]")
+{
+    app.start();
+    auto& db = app.getDatabase();
+    auto& hm = app.getHistoryManager();
+    auto& insertTimer =
+        app.getMetrics().NewTimer({"database", "insert", "txhistory"});
+    auto& selectTimer =
+        app.getMetrics().NewTimer({"database", "select", "txhistory"});
+    size_t const nLedgers = 256;
+    size_t const nScans = 20;
+
+    auto bench = [&](std::string const& mode)
+    {
+        insertTimer.Clear();
+        selectTimer.Clear();
+        uint32_t first = app.getLedgerManager().getLedgerNum();
+        for (size_t i = 0; i < nLedgers; ++i)
+        {
+            generateRandomLedger();
+        }
+
+        size_t n = 0;
+        for (size_t i = 0; i < nScans; ++i)
+        {
+            XDROutputFileStream txOut, txResultOut;
+            txOut.open(hm.localFilename("transactions.xdr"));
+            txResultOut.open(hm.localFilename("results.xdr"));
+            n = TransactionFrame::copyTransactionsToStream(
+                app.getNetworkID(), db, db.getSession(), first,
+                static_cast<uint32_t>(nLedgers), txOut, txResultOut);
+        }
+
+        long long bytes = 0;
+        soci::indicator ind;
+        db.getSession() << "SELECT SUM(LENGTH(txbody) + LENGTH(txresult) + "
+                           "LENGTH(txmeta)) FROM txhistory "
+                           "WHERE ledgerseq >= :first",
+            soci::into(bytes, ind), soci::use(first);
+
+        REQUIRE(n != 0);
+        CLOG(INFO, "History")
+            << mode << ": " << insertTimer.count() << " inserts, mean "
+            << insertTimer.mean() << "ms; " << selectTimer.count()
+            << " publish scans of " << n << " txs, mean " << selectTimer.mean()
+            << "ms; " << (bytes / static_cast<long long>(n))
+            << " bytes/tx stored";
+    };
+
+    useLegacyTxHistoryTables(db);
+    bench("base64 TEXT");
+    db.upgradeToCurrentSchema();
+    bench("binary");
+}
+
+TEST_CASE_METHOD(HistoryTests, "txhistory batched insert",
+                 "[history][txhistory]")
+{
+    app.start();
+    auto& db = app.getDatabase();
+    auto& insertTimer =
+        app.getMetrics().NewTimer({"database", "insert", "txhistory"});
+    uint32_t ledgerSeq = app.getLedgerManager().getLedgerNum() + 100;
+
+    // 150 rows go out as chunks of 64, 64, 16, 4 and 2.
+    size_t const nRows = 150;
+    TxHistoryBatch batch(db, ledgerSeq);
+    for (size_t i = 0; i < nRows; ++i)
+    {
+        TransactionResultPair res;
+        res.transactionHash = sha256(std::to_string(i));
+        res.result.feeCharged = i;
+        LedgerEntryChanges changes;
+        auto txid = binToHex(res.transactionHash);
+        batch.addTransaction(txid, static_cast<int>(i + 1),
+                             xdr::xdr_to_opaque(TransactionEnvelope()),
+                             xdr::xdr_to_opaque(res),
+                             xdr::xdr_to_opaque(TransactionMeta()));
+        batch.addFee(txid, static_cast<int>(i + 1),
+                     xdr::xdr_to_opaque(changes));
+    }
+    REQUIRE(batch.size() == 2 * nRows);
+
+    auto inserts = insertTimer.count();
+    {
+        soci::transaction sqlTx(db.getSession());
+        batch.flush();
+        sqlTx.commit();
+    }
+    CHECK(batch.size() == 0);
+    CHECK(insertTimer.count() - inserts == 5);
+
+    auto results = TransactionFrame::getTransactionHistoryMeta(db, ledgerSeq);
+    REQUIRE(results.results.size() == nRows);
+    for (size_t i = 0; i < nRows; ++i)
+    {
+        CHECK(results.results[i].transactionHash ==
+              sha256(std::to_string(i)));
+        CHECK(results.results[i].result.feeCharged ==
+              static_cast<int64>(i));
+    }
+    CHECK(TransactionFrame::getTransactionFeeMeta(db, ledgerSeq).size() ==
+          nRows);
+}
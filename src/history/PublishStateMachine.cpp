@@ -23,6 +23,7 @@
 #include "medida/counter.h"
 
 #include <soci.h>
+#include <cstdio>
 
 namespace stellar
 {
@@ -141,9 +142,12 @@ ArchivePublisher::enterObservedState(HistoryArchiveState const& has)
         bucketsByHash[binToHex(b->getHash())] = b;
     }
 
+    // The history files were already written compressed by the snapshot;
+    // each publisher tracks its own copy of their transfer state.
     std::vector<std::shared_ptr<FilePublishInfo>> filePublishInfos = {
-        mSnap->mLedgerSnapFile, mSnap->mTransactionSnapFile,
-        mSnap->mTransactionResultSnapFile};
+        std::make_shared<FilePublishInfo>(*mSnap->mLedgerSnapFile),
+        std::make_shared<FilePublishInfo>(*mSnap->mTransactionSnapFile),
+        std::make_shared<FilePublishInfo>(*mSnap->mTransactionResultSnapFile)};
 
     for (auto const& hash : bucketsToSend)
     {
@@ -175,6 +179,66 @@ ArchivePublisher::enterObservedState(HistoryArchiveState const& has)
     enterSendingState();
 }
 
+/**
+ * Write a gzipped copy of the bucket file `filename` next to it, on the worker
+ * pool. The local file may be block-compressed (see COMPRESS_BUCKETS), so
+ * rather than gzipping its bytes this re-encodes the entries as canonical XDR,
+ * which is what archives (and the bucket hash) are defined over. The output
+ * goes to a temporary name and is renamed into place, so concurrent publishers
+ * of the same bucket never see a partial file.
+ */
+static void
+compressBucketFile(Application& app, std::string const& filename,
+                   std::function<void(asio::error_code const&)> handler)
+{
+    static uint64_t tmpCounter = 0;
+    std::string filename_gz = filename + ".gz";
+    std::string tmp = filename_gz + ".tmp" + std::to_string(tmpCounter++);
+    app.getWorkerIOService().post(
+        [&app, filename, filename_gz, tmp, handler]()
+        {
+            asio::error_code ec;
+            try
+            {
+                XDRInputFileStream in;
+                XDROutputFileStream out;
+                in.open(filename);
+                out.open(tmp, XDROutputFileStream::GZIP);
+                BucketEntry e;
+                while (in && in.readOne(e))
+                {
+                    if (!out.writeOne(e))
+                    {
+                        ec = std::make_error_code(std::errc::io_error);
+                        break;
+                    }
+                }
+                if (!out.close())
+                {
+                    ec = std::make_error_code(std::errc::io_error);
+                }
+            }
+            catch (std::exception& ex)
+            {
+                CLOG(WARNING, "History") << "Failed compressing " << filename
+                                         << ": " << ex.what();
+                ec = std::make_error_code(std::errc::io_error);
+            }
+            if (!ec && std::rename(tmp.c_str(), filename_gz.c_str()) != 0)
+            {
+                ec = std::make_error_code(std::errc::io_error);
+            }
+            if (ec)
+            {
+                std::remove(tmp.c_str());
+            }
+            app.getClock().getIOService().post([ec, handler]()
+                                               {
+                                                   handler(ec);
+                                               });
+        });
+}
+
 /**
  * If `ec` is an error, set the state for `name` to FILE_FAILED, otherwise
  * set it to `newGoodState`. In either case, re-enter FETCHING state.
@@ -221,18 +285,17 @@ ArchivePublisher::enterSendingState()
         case FILE_PUBLISH_NEEDED:
             fi->setState(FILE_PUBLISH_COMPRESSING);
             CLOG(DEBUG, "History") << "Compressing " << name;
-            hm.compress(fi->localPath_nogz(),
-                        [weak, name](asio::error_code const& ec)
-                        {
-                            auto self = weak.lock();
-                            if (!self)
-                            {
-                                return;
-                            }
-                            self->fileStateChange(ec, name,
-                                                  FILE_PUBLISH_COMPRESSED);
-                        },
-                        true);
+            compressBucketFile(mApp, fi->localPath_nogz(),
+                               [weak, name](asio::error_code const& ec)
+                               {
+                                   auto self = weak.lock();
+                                   if (!self)
+                                   {
+                                       return;
+                                   }
+                                   self->fileStateChange(
+                                       ec, name, FILE_PUBLISH_COMPRESSED);
+                               });
             break;
 
         case FILE_PUBLISH_COMPRESSING:
@@ -277,8 +340,16 @@ ArchivePublisher::enterSendingState()
             break;
 
         case FILE_PUBLISH_UPLOADED:
-            std::remove(fi->localPath_gz().c_str());
-            break;
+        {
+            // History files live in the snapshot's tmpdir, which goes away
+            // with the snapshot once every archive is done with them.
+            std::string hashname;
+            if (fi->getBucketHashName(hashname))
+            {
+                std::remove(fi->localPath_gz().c_str());
+            }
+        }
+        break;
         }
 
         minimumState = std::min(fi->getState(), minimumState);
@@ -377,15 +448,15 @@ StateSnapshot::StateSnapshot(Application& app)
     , mLocalState(app.getHistoryManager().getLastClosedHistoryArchiveState())
     , mSnapDir(app.getTmpDirManager().tmpDir("snapshot"))
     , mLedgerSnapFile(std::make_shared<FilePublishInfo>(
-          FILE_PUBLISH_NEEDED, mSnapDir, HISTORY_FILE_TYPE_LEDGER,
+          FILE_PUBLISH_COMPRESSED, mSnapDir, HISTORY_FILE_TYPE_LEDGER,
           mLocalState.currentLedger))
 
     , mTransactionSnapFile(std::make_shared<FilePublishInfo>(
-          FILE_PUBLISH_NEEDED, mSnapDir, HISTORY_FILE_TYPE_TRANSACTIONS,
+          FILE_PUBLISH_COMPRESSED, mSnapDir, HISTORY_FILE_TYPE_TRANSACTIONS,
           mLocalState.currentLedger))
 
     , mTransactionResultSnapFile(std::make_shared<FilePublishInfo>(
-          FILE_PUBLISH_NEEDED, mSnapDir, HISTORY_FILE_TYPE_RESULTS,
+          FILE_PUBLISH_COMPRESSED, mSnapDir, HISTORY_FILE_TYPE_RESULTS,
           mLocalState.currentLedger))
     , mRetryTimer(app)
 {
@@ -415,11 +486,15 @@ StateSnapshot::writeHistoryBlocks() const
     // The current "history block" is stored in _three_ files, one just ledger
     // headers, one TransactionHistoryEntry (which contain txSets) and
     // one TransactionHistoryResultEntry containing transaction set results.
-    // All files are streamed out of the database, entry-by-entry.
+    // All files are streamed out of the database, entry-by-entry, through an
+    // in-process gzip compressor straight into the .xdr.gz files that get
+    // uploaded: there's no uncompressed copy and no gzip subprocess.
     XDROutputFileStream ledgerOut, txOut, txResultOut;
-    ledgerOut.open(mLedgerSnapFile->localPath_nogz());
-    txOut.open(mTransactionSnapFile->localPath_nogz());
-    txResultOut.open(mTransactionResultSnapFile->localPath_nogz());
+    ledgerOut.open(mLedgerSnapFile->localPath_gz(),
+                   XDROutputFileStream::GZIP);
+    txOut.open(mTransactionSnapFile->localPath_gz(), XDROutputFileStream::GZIP);
+    txResultOut.open(mTransactionResultSnapFile->localPath_gz(),
+                     XDROutputFileStream::GZIP);
 
     // 'mLocalState' describes the LCL, so its currentLedger will usually be 63,
     // 127, 191, etc. We want to start our snapshot at 64-before the _next_
@@ -437,11 +512,17 @@ StateSnapshot::writeHistoryBlocks() const
     size_t nTxs = TransactionFrame::copyTransactionsToStream(
         mApp.getNetworkID(), mApp.getDatabase(), sess, begin, count, txOut,
         txResultOut);
+    if (!(ledgerOut.close() && txOut.close() && txResultOut.close()))
+    {
+        CLOG(ERROR, "History") << "Failed writing history files to "
+                               << mSnapDir.getName();
+        return false;
+    }
     CLOG(DEBUG, "History") << "Wrote " << nHeaders << " ledger headers to "
-                           << mLedgerSnapFile->localPath_nogz();
+                           << mLedgerSnapFile->localPath_gz();
     CLOG(DEBUG, "History") << "Wrote " << nTxs << " transactions to "
-                           << mTransactionSnapFile->localPath_nogz() << " and "
-                           << mTransactionResultSnapFile->localPath_nogz();
+                           << mTransactionSnapFile->localPath_gz() << " and "
+                           << mTransactionResultSnapFile->localPath_gz();
 
     // When writing checkpoint 0x3f (63) we will have written 63 headers because
     // header 0 doesn't exist, ledger 1 is the first. For all later checkpoints
@@ -457,7 +538,7 @@ StateSnapshot::writeHistoryBlocks() const
     {
         CLOG(ERROR, "History")
             << "Only wrote " << nHeaders << " ledger headers for "
-            << mLedgerSnapFile->localPath_nogz() << ", expecting " << count;
+            << mLedgerSnapFile->localPath_gz() << ", expecting " << count;
         return false;
     }
 
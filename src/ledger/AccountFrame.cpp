@@ -6,10 +6,12 @@
 #include "crypto/SecretKey.h"
 #include "crypto/Hex.h"
 #include "database/Database.h"
+#include "database/ReadSnapshot.h"
 #include "LedgerDelta.h"
 #include "ledger/LedgerManager.h"
 #include "util/basen.h"
 #include <algorithm>
+#include <set>
 
 using namespace soci;
 using namespace std;
@@ -18,6 +20,12 @@ namespace stellar
 {
 using xdr::operator<;
 
+static const char* accountColumnSelector =
+    "SELECT a.accountid, a.balance, a.seqnum, a.numsubentries, "
+    "a.inflationdest, a.homedomain, a.thresholds, a.flags, a.lastmodified, "
+    "s.publickey, s.weight "
+    "FROM accounts a LEFT JOIN signers s ON s.accountid = a.accountid";
+
 const char* AccountFrame::kSQLCreateStatement1 =
     "CREATE TABLE accounts"
     "("
@@ -172,114 +180,264 @@ AccountFrame::getLowThreshold() const
     return mAccountEntry.thresholds[THRESHOLD_LOW];
 }
 
+template <typename Source>
 AccountFrame::pointer
-AccountFrame::loadAccount(AccountID const& accountID, Database& db)
+AccountFrame::loadAccountRow(AccountID const& accountID, Source& source)
 {
-    LedgerKey key;
-    key.type(ACCOUNT);
-    key.account().accountID = accountID;
-    if (cachedEntryExists(key, db))
+    if (auto kv = source.getEntryKVStore())
     {
-        auto p = getCachedEntry(key, db);
-        return p ? std::make_shared<AccountFrame>(*p) : nullptr;
+        LedgerKey key;
+        key.type(ACCOUNT);
+        key.account().accountID = accountID;
+        LedgerEntry entry;
+        {
+            auto timer = source.getSelectTimer("account");
+            if (!kv->load(key, entry))
+            {
+                return nullptr;
+            }
+        }
+        auto res = make_shared<AccountFrame>(entry);
+        res->mUpdateSigners = false;
+        return res;
     }
 
     std::string actIDStrKey = PubKeyUtils::toStrKey(accountID);
 
-    std::string publicKey, inflationDest, creditAuthKey;
-    std::string homeDomain, thresholds;
-    soci::indicator inflationDestInd, homeDomainInd, thresholdsInd;
+    auto query = std::string(accountColumnSelector);
+    query += " WHERE a.accountid = :v1";
+    auto prep = source.getPreparedStatement(query);
+    prep.statement().exchange(use(actIDStrKey));
+
+    AccountFrame::pointer res;
+    auto timer = source.getSelectTimer("account");
+    loadAccounts(prep, [&res](AccountFrame::pointer const& account)
+                 {
+                     res = account;
+                 });
+    return res;
+}
 
-    AccountFrame::pointer res = make_shared<AccountFrame>(accountID);
-    AccountEntry& account = res->getAccount();
+void
+AccountFrame::loadAccounts(
+    StatementContext& prep,
+    std::function<void(AccountFrame::pointer const&)> accountProcessor)
+{
+    std::string actIDStrKey, inflationDest, homeDomain, thresholds;
+    std::string signerStrKey;
+    soci::indicator inflationDestInd, homeDomainInd, thresholdsInd;
+    soci::indicator signerInd, weightInd;
+    AccountEntry row;
+    uint32 lastModified;
+    Signer signer;
 
-    auto prep =
-        db.getPreparedStatement("SELECT balance, seqnum, numsubentries, "
-                                "inflationdest, homedomain, thresholds, "
-                                "flags, lastmodified "
-                                "FROM accounts WHERE accountid=:v1");
+    // Signers come back in the same query, one row per signer (or a single
+    // row with NULL signer columns for an account without any).
     auto& st = prep.statement();
-    st.exchange(into(account.balance));
-    st.exchange(into(account.seqNum));
-    st.exchange(into(account.numSubEntries));
+    st.exchange(into(actIDStrKey));
+    st.exchange(into(row.balance));
+    st.exchange(into(row.seqNum));
+    st.exchange(into(row.numSubEntries));
     st.exchange(into(inflationDest, inflationDestInd));
     st.exchange(into(homeDomain, homeDomainInd));
     st.exchange(into(thresholds, thresholdsInd));
-    st.exchange(into(account.flags));
-    st.exchange(into(res->getLastModified()));
-    st.exchange(use(actIDStrKey));
+    st.exchange(into(row.flags));
+    st.exchange(into(lastModified));
+    st.exchange(into(signerStrKey, signerInd));
+    st.exchange(into(signer.weight, weightInd));
     st.define_and_bind();
-    {
-        auto timer = db.getSelectTimer("account");
-        st.execute(true);
-    }
+    st.execute(true);
 
-    if (!st.got_data())
+    AccountFrame::pointer res;
+    std::string resStrKey;
+    auto finish = [&]()
     {
-        putCachedEntry(key, nullptr, db);
-        return nullptr;
-    }
+        if (res)
+        {
+            res->normalize();
+            res->mUpdateSigners = false;
+            res->mKeyCalculated = false;
+            accountProcessor(res);
+        }
+    };
 
-    if (homeDomainInd == soci::i_ok)
+    while (st.got_data())
     {
-        account.homeDomain = homeDomain;
+        if (!res || actIDStrKey != resStrKey)
+        {
+            finish();
+            resStrKey = actIDStrKey;
+            res = make_shared<AccountFrame>(PubKeyUtils::fromStrKey(resStrKey));
+            AccountEntry& account = res->getAccount();
+            account.balance = row.balance;
+            account.seqNum = row.seqNum;
+            account.numSubEntries = row.numSubEntries;
+            account.flags = row.flags;
+            res->getLastModified() = lastModified;
+
+            if (homeDomainInd == soci::i_ok)
+            {
+                account.homeDomain = homeDomain;
+            }
+
+            if (thresholdsInd == soci::i_ok)
+            {
+                bn::decode_b64(thresholds.begin(), thresholds.end(),
+                               account.thresholds.begin());
+            }
+
+            if (inflationDestInd == soci::i_ok)
+            {
+                account.inflationDest.activate() =
+                    PubKeyUtils::fromStrKey(inflationDest);
+            }
+            account.signers.clear();
+        }
+
+        if (signerInd == soci::i_ok && weightInd == soci::i_ok)
+        {
+            signer.pubKey = PubKeyUtils::fromStrKey(signerStrKey);
+            res->getAccount().signers.push_back(signer);
+        }
+        st.fetch();
     }
+    finish();
+}
 
-    if (thresholdsInd == soci::i_ok)
+void
+AccountFrame::prefetchAccounts(std::vector<AccountID> const& accountIDs,
+                               Database& db)
+{
+    // one statement shape per batch size: short batches repeat their last id
+    size_t const batchSize = 64;
+    std::string query = std::string(accountColumnSelector) +
+                        " WHERE a.accountid IN (";
+    for (size_t i = 0; i < batchSize; i++)
     {
-        bn::decode_b64(thresholds.begin(), thresholds.end(),
-                       res->mAccountEntry.thresholds.begin());
+        query += (i == 0 ? ":v" : ", :v") + std::to_string(i);
     }
+    query += ") ORDER BY a.accountid";
 
-    if (inflationDestInd == soci::i_ok)
+    for (size_t first = 0; first < accountIDs.size(); first += batchSize)
     {
-        account.inflationDest.activate() =
-            PubKeyUtils::fromStrKey(inflationDest);
-    }
+        size_t last = std::min(first + batchSize, accountIDs.size());
+        std::vector<std::string> strKeys;
+        std::set<std::string> missing;
+        for (size_t i = first; i < last; i++)
+        {
+            strKeys.emplace_back(PubKeyUtils::toStrKey(accountIDs[i]));
+            missing.insert(strKeys.back());
+        }
+        strKeys.resize(batchSize, strKeys.back());
 
-    account.signers.clear();
+        auto prep = db.getPreparedStatement(query);
+        for (auto const& k : strKeys)
+        {
+            prep.statement().exchange(use(k));
+        }
+        {
+            auto timer = db.getSelectTimer("account");
+            loadAccounts(prep, [&](AccountFrame::pointer const& account)
+                         {
+                             account->putCachedEntry(db);
+                             missing.erase(PubKeyUtils::toStrKey(
+                                 account->getAccount().accountID));
+                         });
+        }
+        for (auto const& k : missing)
+        {
+            LedgerKey key;
+            key.type(ACCOUNT);
+            key.account().accountID = PubKeyUtils::fromStrKey(k);
+            putCachedEntry(key, nullptr, db);
+        }
+    }
+}
 
-    if (account.numSubEntries != 0)
+AccountFrame::pointer
+AccountFrame::loadAccount(AccountID const& accountID, Database& db)
+{
+    LedgerKey key;
+    key.type(ACCOUNT);
+    key.account().accountID = accountID;
+    std::shared_ptr<LedgerEntry const> pending;
+    if (db.getEntryOverlay().get(key, pending))
     {
-        string pubKey;
-        Signer signer;
-
-        auto prep2 = db.getPreparedStatement("SELECT publickey, weight from "
-                                             "signers where accountid =:id");
-        auto& st2 = prep2.statement();
-        st2.exchange(use(actIDStrKey));
-        st2.exchange(into(pubKey));
-        st2.exchange(into(signer.weight));
-        st2.define_and_bind();
+        if (!pending)
         {
-            auto timer = db.getSelectTimer("signer");
-            st2.execute(true);
+            return nullptr;
         }
-        while (st2.got_data())
+        auto res = std::make_shared<AccountFrame>(*pending);
+        res->mUpdateSigners = false;
+        return res;
+    }
+    bool cached = cachedEntryExists(key, db);
+    db.getEntryPrefetch().recordLookup(cached);
+    if (cached)
+    {
+        auto p = getCachedEntry(key, db);
+        if (!p)
         {
-            signer.pubKey = PubKeyUtils::fromStrKey(pubKey);
+            return nullptr;
+        }
+        auto res = std::make_shared<AccountFrame>(*p);
+        res->mUpdateSigners = false;
+        return res;
+    }
 
-            account.signers.push_back(signer);
+    auto res = loadAccountRow(accountID, db);
+    if (res)
+    {
+        res->putCachedEntry(db);
+    }
+    else
+    {
+        putCachedEntry(key, nullptr, db);
+    }
+    return res;
+}
 
-            st2.fetch();
+AccountFrame::pointer
+AccountFrame::loadAccount(AccountID const& accountID, ReadSnapshot& snapshot)
+{
+    LedgerKey key;
+    key.type(ACCOUNT);
+    key.account().accountID = accountID;
+    std::shared_ptr<LedgerEntry const> p;
+    if (snapshot.getCachedEntry(key, p))
+    {
+        if (!p)
+        {
+            return nullptr;
         }
+        auto res = std::make_shared<AccountFrame>(*p);
+        res->mUpdateSigners = false;
+        return res;
     }
 
-    res->normalize();
-    res->mUpdateSigners = false;
-
-    res->mKeyCalculated = false;
-    res->putCachedEntry(db);
+    auto res = loadAccountRow(accountID, snapshot);
+    snapshot.putCachedEntry(
+        key, res ? std::make_shared<LedgerEntry const>(res->mEntry) : nullptr);
     return res;
 }
 
 bool
 AccountFrame::exists(Database& db, LedgerKey const& key)
 {
+    std::shared_ptr<LedgerEntry const> pending;
+    if (db.getEntryOverlay().get(key, pending))
+    {
+        return pending != nullptr;
+    }
     if (cachedEntryExists(key, db) && getCachedEntry(key, db) != nullptr)
     {
         return true;
     }
+    if (auto kv = db.getEntryKVStore())
+    {
+        auto timer = db.getSelectTimer("account-exists");
+        return kv->exists(key);
+    }
 
     std::string actIDStrKey = PubKeyUtils::toStrKey(key.account().accountID);
     int exists = 0;
@@ -314,9 +472,35 @@ AccountFrame::storeDelete(LedgerDelta& delta, Database& db) const
 void
 AccountFrame::storeDelete(LedgerDelta& delta, Database& db,
                           LedgerKey const& key)
+{
+    auto& overlay = db.getEntryOverlay();
+    if (overlay.isEnabled())
+    {
+        flushCachedEntry(key, db);
+        overlay.store(delta, key, nullptr, LedgerEntryOverlay::DB_PRESENT);
+    }
+    else
+    {
+        storeDeleteEntry(db, key);
+    }
+    delta.deleteEntry(key);
+}
+
+void
+AccountFrame::storeDeleteEntry(Database& db, LedgerKey const& key)
 {
     flushCachedEntry(key, db);
 
+    if (auto kv = db.getEntryKVStore())
+    {
+        {
+            auto timer = db.getDeleteTimer("account");
+            kv->erase(key);
+        }
+        db.getInflationVoteTally().update(key.account().accountID, nullptr);
+        return;
+    }
+
     std::string actIDStrKey = PubKeyUtils::toStrKey(key.account().accountID);
     {
         auto timer = db.getDeleteTimer("account");
@@ -336,7 +520,7 @@ AccountFrame::storeDelete(LedgerDelta& delta, Database& db,
         st.define_and_bind();
         st.execute(true);
     }
-    delta.deleteEntry(key);
+    db.getInflationVoteTally().update(key.account().accountID, nullptr);
 }
 
 void
@@ -344,6 +528,69 @@ AccountFrame::storeUpdate(LedgerDelta& delta, Database& db, bool insert)
 {
     touch(delta);
 
+    auto& overlay = db.getEntryOverlay();
+    if (overlay.isEnabled())
+    {
+        flushCachedEntry(db);
+        overlay.store(delta, getKey(),
+                      std::make_shared<LedgerEntry const>(mEntry),
+                      insert ? LedgerEntryOverlay::DB_ABSENT
+                             : LedgerEntryOverlay::DB_PRESENT,
+                      mUpdateSigners);
+    }
+    else if (!storeRow(db, insert))
+    {
+        throw std::runtime_error("Could not update data in SQL");
+    }
+
+    if (insert)
+    {
+        delta.addEntry(*this);
+    }
+    else
+    {
+        delta.modEntry(*this);
+    }
+}
+
+bool
+AccountFrame::storeEntry(Database& db, LedgerEntry const& entry, bool insert,
+                         bool updateSigners)
+{
+    AccountFrame frame(entry);
+    frame.mUpdateSigners = updateSigners;
+    return frame.storeRow(db, insert);
+}
+
+bool
+AccountFrame::storeRow(Database& db, bool insert)
+{
+    if (auto kv = db.getEntryKVStore())
+    {
+        // signers are part of the stored entry: keep them in load order
+        flushCachedEntry(db);
+        normalize();
+        bool stored;
+        {
+            auto timer = insert ? db.getInsertTimer("account")
+                                : db.getUpdateTimer("account");
+            stored = insert ? kv->insert(mEntry) : kv->update(mEntry);
+        }
+        if (stored)
+        {
+            db.getInflationVoteTally().update(mAccountEntry.accountID,
+                                              &mAccountEntry);
+        }
+        return stored;
+    }
+
+    // a cached entry reflects the signers table, which saves reading it back
+    // to work out which signer rows changed
+    std::shared_ptr<LedgerEntry const> previous;
+    if (mUpdateSigners && !insert && cachedEntryExists(db))
+    {
+        previous = getCachedEntry(db);
+    }
     flushCachedEntry(db);
 
     std::string actIDStrKey = PubKeyUtils::toStrKey(mAccountEntry.accountID);
@@ -400,147 +647,123 @@ AccountFrame::storeUpdate(LedgerDelta& delta, Database& db, bool insert)
 
         if (st.get_affected_rows() != 1)
         {
-            throw std::runtime_error("Could not update data in SQL");
+            return false;
         }
-        if (insert)
+    }
+
+    if (mUpdateSigners)
+    {
+        storeSigners(db, insert, previous);
+    }
+    db.getInflationVoteTally().update(mAccountEntry.accountID, &mAccountEntry);
+    return true;
+}
+
+void
+AccountFrame::loadSigners(Database& db, std::string const& actIDStrKey,
+                          std::vector<Signer>& signers)
+{
+    std::string pubKey;
+    Signer signer;
+
+    auto prep = db.getPreparedStatement("SELECT publickey, weight FROM "
+                                        "signers WHERE accountid =:id");
+    auto& st = prep.statement();
+    st.exchange(use(actIDStrKey));
+    st.exchange(into(pubKey));
+    st.exchange(into(signer.weight));
+    st.define_and_bind();
+    {
+        auto timer = db.getSelectTimer("signer");
+        st.execute(true);
+    }
+    while (st.got_data())
+    {
+        signer.pubKey = PubKeyUtils::fromStrKey(pubKey);
+        signers.push_back(signer);
+        st.fetch();
+    }
+}
+
+void
+AccountFrame::storeSigners(Database& db, bool insert,
+                           std::shared_ptr<LedgerEntry const> previous)
+{
+    std::string actIDStrKey = PubKeyUtils::toStrKey(mAccountEntry.accountID);
+
+    // What the signers table holds now: nothing for a new account, otherwise
+    // the cached entry if there was one (the cache mirrors the database),
+    // and failing that a query.
+    std::vector<Signer> current;
+    if (previous)
+    {
+        current = previous->data.account().signers;
+    }
+    else if (!insert)
+    {
+        loadSigners(db, actIDStrKey, current);
+    }
+
+    auto byKey = [](Signer const& s1, Signer const& s2)
+    {
+        return s1.pubKey < s2.pubKey;
+    };
+    std::sort(current.begin(), current.end(), byKey);
+    normalize();
+    auto const& target = mAccountEntry.signers;
+
+    auto execute = [&](std::string const& sql, Signer const& signer,
+                       bool withWeight, medida::TimerContext timer)
+    {
+        std::string signerStrKey = PubKeyUtils::toStrKey(signer.pubKey);
+        auto prep = db.getPreparedStatement(sql);
+        auto& st = prep.statement();
+        st.exchange(use(actIDStrKey, "v1"));
+        st.exchange(use(signerStrKey, "v2"));
+        if (withWeight)
         {
-            delta.addEntry(*this);
+            st.exchange(use(signer.weight, "v3"));
         }
-        else
+        st.define_and_bind();
+        st.execute(true);
+        timer.Stop();
+        if (st.get_affected_rows() != 1)
         {
-            delta.modEntry(*this);
+            throw std::runtime_error("Could not update data in SQL");
         }
-    }
+    };
 
-    if (mUpdateSigners)
+    // Both lists are sorted by key: walk them together and only touch the
+    // rows that differ.
+    auto cur = current.begin();
+    auto tgt = target.begin();
+    while (cur != current.end() || tgt != target.end())
     {
-        // instead separate signatures from account, just like offers are
-        // separate entities
-        AccountFrame::pointer startAccountFrame;
-        startAccountFrame = loadAccount(getID(), db);
-        if (!startAccountFrame)
+        if (tgt == target.end() ||
+            (cur != current.end() && byKey(*cur, *tgt)))
         {
-            throw runtime_error("could not load account!");
+            execute("DELETE FROM signers WHERE accountid=:v1 AND publickey=:v2",
+                    *cur, false, db.getDeleteTimer("signer"));
+            ++cur;
         }
-        AccountEntry& startAccount = startAccountFrame->mAccountEntry;
-
-        // deal with changes to Signers
-        if (mAccountEntry.signers.size() < startAccount.signers.size())
-        { // some signers were removed
-            for (auto const& startSigner : startAccount.signers)
-            {
-                bool found = false;
-                for (auto const& finalSigner : mAccountEntry.signers)
-                {
-                    if (finalSigner.pubKey == startSigner.pubKey)
-                    {
-                        if (finalSigner.weight != startSigner.weight)
-                        {
-                            std::string signerStrKey =
-                                PubKeyUtils::toStrKey(finalSigner.pubKey);
-                            {
-                                auto timer = db.getUpdateTimer("signer");
-                                auto prep2 = db.getPreparedStatement(
-                                    "UPDATE signers set weight=:v1 where "
-                                    "accountid=:v2 and publickey=:v3");
-                                auto& st = prep2.statement();
-                                st.exchange(use(finalSigner.weight));
-                                st.exchange(use(actIDStrKey));
-                                st.exchange(use(signerStrKey));
-                                st.define_and_bind();
-                                st.execute(true);
-                            }
-                        }
-                        found = true;
-                        break;
-                    }
-                }
-                if (!found)
-                { // delete signer
-                    std::string signerStrKey =
-                        PubKeyUtils::toStrKey(startSigner.pubKey);
-
-                    auto prep2 =
-                        db.getPreparedStatement("DELETE from signers where "
-                                                "accountid=:v2 and "
-                                                "publickey=:v3");
-                    auto& st = prep2.statement();
-                    st.exchange(use(actIDStrKey));
-                    st.exchange(use(signerStrKey));
-                    st.define_and_bind();
-                    {
-                        auto timer = db.getDeleteTimer("signer");
-                        st.execute(true);
-                    }
-
-                    if (st.get_affected_rows() != 1)
-                    {
-                        throw std::runtime_error(
-                            "Could not update data in SQL");
-                    }
-                }
-            }
+        else if (cur == current.end() || byKey(*tgt, *cur))
+        {
+            execute("INSERT INTO signers (accountid, publickey, weight) "
+                    "VALUES (:v1, :v2, :v3)",
+                    *tgt, true, db.getInsertTimer("signer"));
+            ++tgt;
         }
         else
-        { // signers added or the same
-            for (auto const& finalSigner : mAccountEntry.signers)
+        {
+            if (cur->weight != tgt->weight)
             {
-                bool found = false;
-                for (auto const& startSigner : startAccount.signers)
-                {
-                    if (finalSigner.pubKey == startSigner.pubKey)
-                    {
-                        if (finalSigner.weight != startSigner.weight)
-                        {
-                            std::string signerStrKey =
-                                PubKeyUtils::toStrKey(finalSigner.pubKey);
-                            auto prep2 = db.getPreparedStatement(
-                                "UPDATE signers set weight=:v1 where "
-                                "accountid=:v2 and publickey=:v3");
-                            auto& st = prep2.statement();
-                            st.exchange(use(finalSigner.weight));
-                            st.exchange(use(actIDStrKey));
-                            st.exchange(use(signerStrKey));
-                            st.define_and_bind();
-                            st.execute(true);
-
-                            if (st.get_affected_rows() != 1)
-                            {
-                                throw std::runtime_error(
-                                    "Could not update data in SQL");
-                            }
-                        }
-                        found = true;
-                        break;
-                    }
-                }
-                if (!found)
-                { // new signer
-                    std::string signerStrKey =
-                        PubKeyUtils::toStrKey(finalSigner.pubKey);
-
-                    auto prep2 =
-                        db.getPreparedStatement("INSERT INTO signers "
-                                                "(accountid,publickey,weight) "
-                                                "VALUES (:v1,:v2,:v3)");
-                    auto& st = prep2.statement();
-                    st.exchange(use(actIDStrKey));
-                    st.exchange(use(signerStrKey));
-                    st.exchange(use(finalSigner.weight));
-                    st.define_and_bind();
-                    st.execute(true);
-
-                    if (st.get_affected_rows() != 1)
-                    {
-                        throw std::runtime_error(
-                            "Could not update data in SQL");
-                    }
-                }
+                execute("UPDATE signers SET weight=:v3 "
+                        "WHERE accountid=:v1 AND publickey=:v2",
+                        *tgt, true, db.getUpdateTimer("signer"));
             }
+            ++cur;
+            ++tgt;
         }
-
-        // Flush again to ensure changed signers are reloaded.
-        flushCachedEntry(db);
     }
 }
 
@@ -561,6 +784,15 @@ AccountFrame::processForInflation(
     std::function<bool(AccountFrame::InflationVotes const&)> inflationProcessor,
     int maxWinners, Database& db)
 {
+    // the tally is a query over all accounts
+    db.getEntryOverlay().writeOut(db, ACCOUNT);
+
+    if (auto kv = db.getEntryKVStore())
+    {
+        kv->processForInflation(inflationProcessor, maxWinners);
+        return;
+    }
+
     soci::session& session = db.getSession();
 
     InflationVotes v;
@@ -588,6 +820,43 @@ AccountFrame::processForInflation(
     }
 }
 
+void
+AccountFrame::loadInflationVoters(
+    Database& db, std::function<void(AccountEntry const&)> voterProcessor)
+{
+    if (auto kv = db.getEntryKVStore())
+    {
+        kv->loadInflationVoters(
+            [&](LedgerEntry const& entry)
+            {
+                voterProcessor(entry.data.account());
+            });
+        return;
+    }
+
+    AccountEntry account;
+    std::string accountID, inflationDest;
+
+    soci::statement st =
+        (db.getSession().prepare
+             << "SELECT accountid, inflationdest, balance FROM accounts "
+                "WHERE inflationdest IS NOT NULL AND balance >= 1000000000",
+         into(accountID), into(inflationDest), into(account.balance));
+
+    {
+        auto timer = db.getSelectTimer("account");
+        st.execute(true);
+    }
+    while (st.got_data())
+    {
+        account.accountID = PubKeyUtils::fromStrKey(accountID);
+        account.inflationDest.activate() =
+            PubKeyUtils::fromStrKey(inflationDest);
+        voterProcessor(account);
+        st.fetch();
+    }
+}
+
 void
 AccountFrame::dropAll(Database& db)
 {
@@ -20,10 +20,26 @@ class prepare_temp_type;
 namespace stellar
 {
 class LedgerManager;
+class StatementContext;
 
 class AccountFrame : public EntryFrame
 {
     void storeUpdate(LedgerDelta& delta, Database& db, bool insert);
+    bool storeRow(Database& db, bool insert);
+    void storeSigners(Database& db, bool insert,
+                      std::shared_ptr<LedgerEntry const> previous);
+    static void loadSigners(Database& db, std::string const& actIDStrKey,
+                            std::vector<Signer>& signers);
+    // the query part of loadAccount, shared by the Database and ReadSnapshot
+    // versions
+    template <typename Source>
+    static std::shared_ptr<AccountFrame>
+    loadAccountRow(AccountID const& accountID, Source& source);
+    // runs a query over accounts joined with signers, ordered by accountid
+    static void loadAccounts(
+        StatementContext& prep,
+        std::function<void(std::shared_ptr<AccountFrame> const&)>
+            accountProcessor);
     bool mUpdateSigners;
 
     AccountEntry& mAccountEntry;
@@ -112,9 +128,23 @@ class AccountFrame : public EntryFrame
     static bool exists(Database& db, LedgerKey const& key);
     static uint64_t countObjects(soci::session& sess);
 
+    // Write `entry` (and its signers, if `updateSigners`) or delete `key`
+    // directly in the database, bypassing the write-behind overlay. With
+    // `insert` unset, storeEntry returns false if there was no row to update.
+    static bool storeEntry(Database& db, LedgerEntry const& entry, bool insert,
+                           bool updateSigners);
+    static void storeDeleteEntry(Database& db, LedgerKey const& key);
+
     // database utilities
     static AccountFrame::pointer loadAccount(AccountID const& accountID,
                                              Database& db);
+    static AccountFrame::pointer loadAccount(AccountID const& accountID,
+                                             ReadSnapshot& snapshot);
+
+    // Load the accounts with a few batched queries into the entry cache,
+    // caching the absence of those that do not exist.
+    static void prefetchAccounts(std::vector<AccountID> const& accountIDs,
+                                 Database& db);
 
     // inflation helper
 
@@ -129,6 +159,11 @@ class AccountFrame : public EntryFrame
         std::function<bool(InflationVotes const&)> inflationProcessor,
         int maxWinners, Database& db);
 
+    // Pass every account that votes for inflation to voterProcessor; only
+    // accountID, balance and inflationDest are set.
+    static void loadInflationVoters(
+        Database& db, std::function<void(AccountEntry const&)> voterProcessor);
+
     static void dropAll(Database& db);
     static const char* kSQLCreateStatement1;
     static const char* kSQLCreateStatement2;
@@ -12,6 +12,8 @@
 #include "xdrpp/marshal.h"
 #include "crypto/Hex.h"
 #include "database/Database.h"
+#include "database/ReadSnapshot.h"
+#include "util/CachedXDR.h"
 
 namespace stellar
 {
@@ -37,8 +39,9 @@ EntryFrame::FromXDR(LedgerEntry const& from)
     return res;
 }
 
-EntryFrame::pointer
-EntryFrame::storeLoad(LedgerKey const& key, Database& db)
+template <typename Source>
+static EntryFrame::pointer
+storeLoadFrom(LedgerKey const& key, Source& source)
 {
     EntryFrame::pointer res;
 
@@ -46,26 +49,38 @@ EntryFrame::storeLoad(LedgerKey const& key, Database& db)
     {
     case ACCOUNT:
         res = std::static_pointer_cast<EntryFrame>(
-            AccountFrame::loadAccount(key.account().accountID, db));
+            AccountFrame::loadAccount(key.account().accountID, source));
         break;
     case TRUSTLINE:
     {
         auto const& tl = key.trustLine();
         res = std::static_pointer_cast<EntryFrame>(
-            TrustFrame::loadTrustLine(tl.accountID, tl.asset, db));
+            TrustFrame::loadTrustLine(tl.accountID, tl.asset, source));
     }
     break;
     case OFFER:
     {
         auto const& off = key.offer();
         res = std::static_pointer_cast<EntryFrame>(
-            OfferFrame::loadOffer(off.sellerID, off.offerID, db));
+            OfferFrame::loadOffer(off.sellerID, off.offerID, source));
     }
     break;
     }
     return res;
 }
 
+EntryFrame::pointer
+EntryFrame::storeLoad(LedgerKey const& key, Database& db)
+{
+    return storeLoadFrom(key, db);
+}
+
+EntryFrame::pointer
+EntryFrame::storeLoad(LedgerKey const& key, ReadSnapshot& snapshot)
+{
+    return storeLoadFrom(key, snapshot);
+}
+
 uint32
 EntryFrame::getLastModified() const
 {
@@ -95,24 +110,31 @@ EntryFrame::touch(LedgerDelta const& delta)
     }
 }
 
+std::string
+EntryFrame::cacheKey(LedgerKey const& key)
+{
+    CachedXDR::noteMade();
+    return binToHex(xdr::xdr_to_opaque(key));
+}
+
 void
 EntryFrame::flushCachedEntry(LedgerKey const& key, Database& db)
 {
-    auto s = binToHex(xdr::xdr_to_opaque(key));
+    auto s = cacheKey(key);
     db.getEntryCache().erase_if_exists(s);
 }
 
 bool
 EntryFrame::cachedEntryExists(LedgerKey const& key, Database& db)
 {
-    auto s = binToHex(xdr::xdr_to_opaque(key));
+    auto s = cacheKey(key);
     return db.getEntryCache().exists(s);
 }
 
 std::shared_ptr<LedgerEntry const>
 EntryFrame::getCachedEntry(LedgerKey const& key, Database& db)
 {
-    auto s = binToHex(xdr::xdr_to_opaque(key));
+    auto s = cacheKey(key);
     return db.getEntryCache().get(s);
 }
 
@@ -120,38 +142,64 @@ void
 EntryFrame::putCachedEntry(LedgerKey const& key,
                            std::shared_ptr<LedgerEntry const> p, Database& db)
 {
-    auto s = binToHex(xdr::xdr_to_opaque(key));
+    auto s = cacheKey(key);
     db.getEntryCache().put(s, p);
 }
 
 void
 EntryFrame::flushCachedEntry(Database& db) const
 {
-    flushCachedEntry(getKey(), db);
+    db.getEntryCache().erase_if_exists(getCacheKey());
 }
 
 void
 EntryFrame::putCachedEntry(Database& db) const
 {
-    putCachedEntry(getKey(), std::make_shared<LedgerEntry const>(mEntry), db);
+    db.getEntryCache().put(getCacheKey(),
+                           std::make_shared<LedgerEntry const>(mEntry));
 }
 
-void
-EntryFrame::checkAgainstDatabase(LedgerEntry const& entry, Database& db)
+bool
+EntryFrame::cachedEntryExists(Database& db) const
 {
-    auto key = LedgerEntryKey(entry);
-    flushCachedEntry(key, db);
-    auto const& fromDb = EntryFrame::storeLoad(key, db);
-    if (!(fromDb->mEntry == entry))
+    return db.getEntryCache().exists(getCacheKey());
+}
+
+std::shared_ptr<LedgerEntry const>
+EntryFrame::getCachedEntry(Database& db) const
+{
+    return db.getEntryCache().get(getCacheKey());
+}
+
+static void
+checkAgainstLoaded(LedgerEntry const& entry, EntryFrame::pointer const& fromDb)
+{
+    if (!fromDb || !(fromDb->mEntry == entry))
     {
         std::string s;
         s = "Inconsistent state between objects: ";
-        s += xdr::xdr_to_string(fromDb->mEntry, "db");
+        s += fromDb ? xdr::xdr_to_string(fromDb->mEntry, "db") : "db: missing";
         s += xdr::xdr_to_string(entry, "live");
         throw std::runtime_error(s);
     }
 }
 
+void
+EntryFrame::checkAgainstDatabase(LedgerEntry const& entry, Database& db)
+{
+    auto key = LedgerEntryKey(entry);
+    flushCachedEntry(key, db);
+    checkAgainstLoaded(entry, EntryFrame::storeLoad(key, db));
+}
+
+void
+EntryFrame::checkAgainstDatabase(LedgerEntry const& entry,
+                                 ReadSnapshot& snapshot)
+{
+    checkAgainstLoaded(entry,
+                       EntryFrame::storeLoad(LedgerEntryKey(entry), snapshot));
+}
+
 EntryFrame::EntryFrame(LedgerEntryType type) : mKeyCalculated(false)
 {
     mEntry.data.type(type);
@@ -169,10 +217,26 @@ EntryFrame::getKey() const
     {
         mKey = LedgerEntryKey(mEntry);
         mKeyCalculated = true;
+        mCacheKey.clear();
     }
     return mKey;
 }
 
+std::string const&
+EntryFrame::getCacheKey() const
+{
+    auto const& key = getKey();
+    if (mCacheKey.empty())
+    {
+        mCacheKey = cacheKey(key);
+    }
+    else
+    {
+        CachedXDR::noteReused();
+    }
+    return mCacheKey;
+}
+
 void
 EntryFrame::storeAddOrChange(LedgerDelta& delta, Database& db)
 {
@@ -19,12 +19,15 @@ namespace stellar
 {
 class Database;
 class LedgerDelta;
+class ReadSnapshot;
 
 class EntryFrame : public NonMovableOrCopyable
 {
   protected:
     mutable bool mKeyCalculated;
     mutable LedgerKey mKey;
+    // hex of the XDR of mKey, the entry's key in the entry cache
+    mutable std::string mCacheKey;
     void
     clearCached()
     {
@@ -41,8 +44,10 @@ class EntryFrame : public NonMovableOrCopyable
 
     static pointer FromXDR(LedgerEntry const& from);
     static pointer storeLoad(LedgerKey const& key, Database& db);
+    static pointer storeLoad(LedgerKey const& key, ReadSnapshot& snapshot);
 
     // Static helpers for working with the DB LedgerEntry cache.
+    static std::string cacheKey(LedgerKey const& key);
     static void flushCachedEntry(LedgerKey const& key, Database& db);
     static bool cachedEntryExists(LedgerKey const& key, Database& db);
     static std::shared_ptr<LedgerEntry const>
@@ -60,15 +65,21 @@ class EntryFrame : public NonMovableOrCopyable
     // a sequence that is not 0 (0 is used when importing buckets)
     void touch(LedgerDelta const& delta);
 
-    // Member helpers that call cache flush/put for self.
+    // Member helpers that call cache flush/put/lookup for self, with a cache
+    // key encoded once per key.
     void flushCachedEntry(Database& db) const;
     void putCachedEntry(Database& db) const;
+    bool cachedEntryExists(Database& db) const;
+    std::shared_ptr<LedgerEntry const> getCachedEntry(Database& db) const;
 
     static void checkAgainstDatabase(LedgerEntry const& entry, Database& db);
+    static void checkAgainstDatabase(LedgerEntry const& entry,
+                                     ReadSnapshot& snapshot);
 
     virtual EntryFrame::pointer copy() const = 0;
 
     LedgerKey const& getKey() const;
+    std::string const& getCacheKey() const;
     virtual void storeDelete(LedgerDelta& delta, Database& db) const = 0;
     // change/add may update the entry (last modified)
     virtual void storeChange(LedgerDelta& delta, Database& db) = 0;
@@ -0,0 +1,159 @@
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "ledger/HistoryPruner.h"
+#include "database/Database.h"
+#include "ledger/LedgerHeaderFrame.h"
+#include "main/Application.h"
+#include "transactions/TransactionFrame.h"
+#include "util/Logging.h"
+#include "util/make_unique.h"
+#include <algorithm>
+
+#include "medida/counter.h"
+#include "medida/meter.h"
+#include "medida/metrics_registry.h"
+#include "medida/timer.h"
+
+namespace stellar
+{
+
+uint32_t const HistoryPruner::LEDGERS_PER_CHUNK = 64;
+std::chrono::milliseconds const HistoryPruner::CHUNK_INTERVAL(100);
+
+HistoryPruner::HistoryPruner(Application& app)
+    : mApp(app)
+    , mTimer(app)
+    , mRowsDeleted(
+          app.getMetrics().NewMeter({"history", "prune", "rows"}, "row"))
+    , mChunkTime(app.getMetrics().NewTimer({"history", "prune", "chunk"}))
+    , mLedgersPending(
+          app.getMetrics().NewCounter({"history", "prune", "pending-ledgers"}))
+{
+}
+
+void
+HistoryPruner::pruneUpTo(uint32_t ledgerSeq)
+{
+    if (ledgerSeq <= mTarget)
+    {
+        return;
+    }
+    mTarget = ledgerSeq;
+    mLedgersPending.set_count(mTarget - std::min(mPruned, mTarget));
+    if (!mRunning)
+    {
+        mRunning = true;
+        scheduleChunk(std::chrono::milliseconds(0));
+    }
+}
+
+uint64_t
+HistoryPruner::getRowsDeleted() const
+{
+    return mRowsDeleted.count();
+}
+
+void
+HistoryPruner::scheduleChunk(std::chrono::milliseconds delay)
+{
+    mTimer.expires_from_now(delay);
+    mTimer.async_wait(
+        [this]()
+        {
+            pruneChunk();
+        },
+        VirtualTimer::onFailureNoop);
+}
+
+static bool
+lowestLedger(soci::session& sess, std::string const& table, uint32_t& seq)
+{
+    int m;
+    soci::indicator ind;
+    sess << "SELECT MIN(ledgerseq) FROM " << table, soci::into(m, ind);
+    if (!sess.got_data() || ind != soci::i_ok)
+    {
+        return false;
+    }
+    seq = static_cast<uint32_t>(m);
+    return true;
+}
+
+void
+HistoryPruner::pruneChunk()
+{
+    try
+    {
+        pruneChunkHelper();
+    }
+    catch (std::exception& e)
+    {
+        // leave the rest for the next time the queue is processed
+        CLOG(ERROR, "History") << "Error pruning history: " << e.what();
+        mTarget = mPruned;
+        mLedgersPending.set_count(0);
+        mRunning = false;
+    }
+}
+
+void
+HistoryPruner::pruneChunkHelper()
+{
+    auto& db = mApp.getDatabase();
+    auto timer = mChunkTime.TimeScope();
+
+    std::unique_ptr<soci::session> poolSess(
+        db.canUsePool() ? make_unique<soci::session>(db.getPool()) : nullptr);
+    soci::session& sess(poolSess ? *poolSess : db.getSession());
+
+    // Start each chunk at the oldest ledger still stored, so a cursor jump
+    // over a range that is already gone costs nothing.
+    uint32_t lowest = 0;
+    uint32_t seq;
+    bool found = false;
+    for (auto const& table : {"ledgerheaders", "txhistory"})
+    {
+        if (lowestLedger(sess, table, seq))
+        {
+            lowest = found ? std::min(lowest, seq) : seq;
+            found = true;
+        }
+    }
+
+    if (!found || lowest > mTarget)
+    {
+        mPruned = mTarget;
+    }
+    else
+    {
+        uint32_t upTo = mTarget;
+        if (mTarget - lowest >= LEDGERS_PER_CHUNK)
+        {
+            upTo = lowest + LEDGERS_PER_CHUNK - 1;
+        }
+
+        soci::transaction tx(sess);
+        size_t rows = LedgerHeaderFrame::deleteOldEntries(db, sess, upTo);
+        rows += TransactionFrame::deleteOldEntries(db, sess, upTo);
+        tx.commit();
+
+        mRowsDeleted.Mark(rows);
+        mPruned = upTo;
+        CLOG(DEBUG, "History") << "Pruned " << rows
+                               << " history rows up to ledger " << upTo;
+    }
+
+    mLedgersPending.set_count(mTarget - mPruned);
+    if (mPruned < mTarget)
+    {
+        scheduleChunk(CHUNK_INTERVAL);
+    }
+    else
+    {
+        mRunning = false;
+        CLOG(INFO, "History") << "History pruned up to ledger " << mPruned;
+    }
+}
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/NonCopyable.h"
+#include "util/Timer.h"
+#include <chrono>
+#include <cstdint>
+
+namespace medida
+{
+class Counter;
+class Meter;
+class Timer;
+}
+
+namespace stellar
+{
+class Application;
+
+/**
+ * Deletes old history (ledger headers, transactions and fee history) once
+ * every ExternalQueue consumer is past it.
+ *
+ * A single DELETE of everything below the cursor can touch millions of rows
+ * after a cursor jump and hold up ledger close for seconds, so instead rows
+ * are deleted LEDGERS_PER_CHUNK ledgers at a time, each chunk in its own
+ * transaction on a connection from the pool (when there is one), with
+ * CHUNK_INTERVAL between chunks. Chunks run from the main loop, so they
+ * interleave with ledger closes instead of competing with them.
+ */
+class HistoryPruner : NonMovableOrCopyable
+{
+    Application& mApp;
+    VirtualTimer mTimer;
+
+    // everything at or below mTarget should be deleted
+    uint32_t mTarget{0};
+    // everything at or below mPruned has been deleted
+    uint32_t mPruned{0};
+    bool mRunning{false};
+
+    medida::Meter& mRowsDeleted;
+    medida::Timer& mChunkTime;
+    medida::Counter& mLedgersPending;
+
+    void scheduleChunk(std::chrono::milliseconds delay);
+    void pruneChunk();
+    void pruneChunkHelper();
+
+  public:
+    static uint32_t const LEDGERS_PER_CHUNK;
+    static std::chrono::milliseconds const CHUNK_INTERVAL;
+
+    HistoryPruner(Application& app);
+
+    // Start (or extend) deleting history at or below `ledgerSeq`.
+    void pruneUpTo(uint32_t ledgerSeq);
+
+    bool
+    isIdle() const
+    {
+        return !mRunning;
+    }
+
+    uint32_t
+    getTarget() const
+    {
+        return mTarget;
+    }
+
+    uint32_t
+    getPruned() const
+    {
+        return mPruned;
+    }
+
+    // total rows deleted since startup
+    uint64_t getRowsDeleted() const;
+};
+}
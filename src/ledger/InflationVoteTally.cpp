@@ -0,0 +1,182 @@
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "ledger/InflationVoteTally.h"
+#include "database/Database.h"
+#include "util/Logging.h"
+#include <vector>
+
+#include "medida/metrics_registry.h"
+#include "medida/timer.h"
+
+namespace stellar
+{
+
+int64_t const InflationVoteTally::MIN_VOTER_BALANCE = 1000000000;
+
+bool
+InflationVoteTally::Rank::operator<(Rank const& other) const
+{
+    if (mVotes != other.mVotes)
+    {
+        return mVotes > other.mVotes;
+    }
+    return mStrKey > other.mStrKey;
+}
+
+InflationVoteTally::InflationVoteTally(medida::MetricsRegistry& metrics)
+    : mRebuildTimer(metrics.NewTimer({"ledger", "inflation", "rebuild"}))
+{
+}
+
+void
+InflationVoteTally::clear()
+{
+    mVoters.clear();
+    mVotes.clear();
+    mRanking.clear();
+    mStale.clear();
+    mValid = true;
+}
+
+void
+InflationVoteTally::rebuild(Database& db)
+{
+    auto timer = mRebuildTimer.TimeScope();
+    db.getEntryOverlay().writeOut(db, ACCOUNT);
+    clear();
+    try
+    {
+        AccountFrame::loadInflationVoters(
+            db, [this](AccountEntry const& account)
+            {
+                update(account.accountID, &account);
+            });
+    }
+    catch (...)
+    {
+        mValid = false;
+        throw;
+    }
+    CLOG(DEBUG, "Ledger") << "Inflation tally rebuilt: " << mVoters.size()
+                          << " voters, " << mRanking.size()
+                          << " destinations";
+}
+
+void
+InflationVoteTally::addVotes(AccountID const& dest, int64_t votes)
+{
+    if (votes == 0)
+    {
+        return;
+    }
+    auto it = mVotes.find(dest);
+    if (it == mVotes.end())
+    {
+        it = mVotes.emplace(dest, Rank{0, PubKeyUtils::toStrKey(dest), dest})
+                 .first;
+    }
+    auto& rank = it->second;
+    if (rank.mVotes > 0)
+    {
+        mRanking.erase(rank);
+    }
+    rank.mVotes += votes;
+    if (rank.mVotes > 0)
+    {
+        mRanking.insert(rank);
+    }
+    else
+    {
+        mVotes.erase(it);
+    }
+}
+
+void
+InflationVoteTally::update(AccountID const& id, AccountEntry const* account)
+{
+    if (!mValid)
+    {
+        // picked up by the rebuild
+        return;
+    }
+    mStale.erase(id);
+    auto it = mVoters.find(id);
+    if (it != mVoters.end())
+    {
+        addVotes(it->second.mInflationDest, -it->second.mBalance);
+    }
+    if (account && account->inflationDest &&
+        account->balance >= MIN_VOTER_BALANCE)
+    {
+        Voter voter{*account->inflationDest, account->balance};
+        addVotes(voter.mInflationDest, voter.mBalance);
+        if (it != mVoters.end())
+        {
+            it->second = voter;
+        }
+        else
+        {
+            mVoters.emplace(id, voter);
+        }
+    }
+    else if (it != mVoters.end())
+    {
+        mVoters.erase(it);
+    }
+}
+
+void
+InflationVoteTally::markStale(AccountID const& id)
+{
+    if (mValid)
+    {
+        mStale.insert(id);
+    }
+}
+
+void
+InflationVoteTally::processForInflation(
+    std::function<bool(AccountFrame::InflationVotes const&)>
+        inflationProcessor,
+    int maxWinners, Database& db)
+{
+    if (!mValid)
+    {
+        rebuild(db);
+    }
+    else
+    {
+        // the tally follows the rows, so pending rows must be written first
+        db.getEntryOverlay().writeOut(db, ACCOUNT);
+        std::unordered_set<AccountID> stale;
+        stale.swap(mStale);
+        for (auto const& id : stale)
+        {
+            auto account = AccountFrame::loadAccount(id, db);
+            update(id, account ? &account->getAccount() : nullptr);
+        }
+    }
+
+    // the processor stores the winning accounts: pick them all first
+    std::vector<AccountFrame::InflationVotes> winners;
+    for (auto it = mRanking.begin();
+         it != mRanking.end() && static_cast<int>(winners.size()) < maxWinners;
+         ++it)
+    {
+        AccountFrame::InflationVotes v;
+        v.mVotes = it->mVotes;
+        v.mInflationDest = it->mInflationDest;
+        winners.push_back(v);
+    }
+
+    for (auto const& v : winners)
+    {
+        if (!inflationProcessor(v))
+        {
+            break;
+        }
+    }
+}
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "crypto/SecretKey.h"
+#include "ledger/AccountFrame.h"
+#include "util/NonCopyable.h"
+#include <functional>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace medida
+{
+class MetricsRegistry;
+class Timer;
+}
+
+namespace stellar
+{
+class Database;
+
+/**
+ * Running total of inflation votes per destination, so that an inflation
+ * operation costs O(winners) rather than an aggregation over every account.
+ *
+ * The tally mirrors the accounts stored in the database: AccountFrame reports
+ * every account row it writes or deletes, whether directly, through the
+ * write-behind overlay or while applying buckets. It remembers the
+ * destination and balance of each account that currently votes, and the
+ * votes of each destination ranked the way AccountFrame::processForInflation
+ * orders them. Since a record is replaced rather than adjusted, reporting a
+ * state the tally already has is harmless.
+ *
+ * A rolled back LedgerDelta comes with a rolled back SQL savepoint (or, in
+ * tests, with rows that stay), so rather than guess, it marks the accounts it
+ * touched as stale and the next query reloads them.
+ *
+ * Database::initialize() empties it. It is rebuilt from the accounts when
+ * LedgerManager loads the last known ledger and when catchup has applied
+ * buckets; until then it ignores updates and rebuilds itself on first use.
+ */
+class InflationVoteTally : NonMovableOrCopyable
+{
+    struct Voter
+    {
+        AccountID mInflationDest;
+        int64_t mBalance;
+    };
+
+    struct Rank
+    {
+        int64_t mVotes;
+        std::string mStrKey;
+        AccountID mInflationDest;
+
+        // most votes first, ties broken by descending StrKey
+        bool operator<(Rank const& other) const;
+    };
+
+    // accounts with enough balance to vote and an inflation destination
+    std::unordered_map<AccountID, Voter> mVoters;
+    // destinations with votes, and the same ordered by rank
+    std::unordered_map<AccountID, Rank> mVotes;
+    std::set<Rank> mRanking;
+    // accounts to reload before the next query
+    std::unordered_set<AccountID> mStale;
+    bool mValid{false};
+
+    medida::Timer& mRebuildTimer;
+
+    void addVotes(AccountID const& dest, int64_t votes);
+
+  public:
+    // accounts with a lower balance do not vote
+    static int64_t const MIN_VOTER_BALANCE;
+
+    InflationVoteTally(medida::MetricsRegistry& metrics);
+
+    bool
+    isValid() const
+    {
+        return mValid;
+    }
+
+    // Forget everything: the tally of an empty ledger.
+    void clear();
+
+    // Recount from the database.
+    void rebuild(Database& db);
+
+    // Record the stored state of account `id`, nullptr if it was deleted.
+    void update(AccountID const& id, AccountEntry const* account);
+
+    // The stored state of account `id` is unknown until reloaded.
+    void markStale(AccountID const& id);
+
+    // Same contract as AccountFrame::processForInflation.
+    void processForInflation(
+        std::function<bool(AccountFrame::InflationVotes const&)>
+            inflationProcessor,
+        int maxWinners, Database& db);
+};
+}
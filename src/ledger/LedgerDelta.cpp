@@ -3,24 +3,143 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "ledger/LedgerDelta.h"
+#include "crypto/SecretKey.h"
+#include "database/Database.h"
 #include "xdr/Stellar-ledger.h"
 #include "main/Application.h"
 #include "main/Config.h"
-#include "medida/metrics_registry.h"
-#include "medida/meter.h"
+#include "transactions/ApplyMeters.h"
 #include "xdrpp/printer.h"
+#include "util/make_unique.h"
+#include <algorithm>
+#include <limits>
+#include <unordered_map>
 
 namespace stellar
 {
 using xdr::operator==;
 
+namespace
+{
+size_t const NO_UNDO = std::numeric_limits<size_t>::max();
+
+template <typename T>
+void
+hashCombine(size_t& seed, T const& v)
+{
+    seed ^= std::hash<T>()(v) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
+void
+hashAsset(size_t& seed, Asset const& asset)
+{
+    hashCombine(seed, static_cast<int>(asset.type()));
+    switch (asset.type())
+    {
+    case ASSET_TYPE_NATIVE:
+        break;
+    case ASSET_TYPE_CREDIT_ALPHANUM4:
+        hashCombine(seed, asset.alphaNum4().issuer);
+        for (auto c : asset.alphaNum4().assetCode)
+        {
+            hashCombine(seed, c);
+        }
+        break;
+    case ASSET_TYPE_CREDIT_ALPHANUM12:
+        hashCombine(seed, asset.alphaNum12().issuer);
+        for (auto c : asset.alphaNum12().assetCode)
+        {
+            hashCombine(seed, c);
+        }
+        break;
+    }
+}
+}
+
+size_t
+LedgerDelta::KeyHash::operator()(LedgerKey const& key) const
+{
+    size_t res = static_cast<size_t>(key.type());
+    switch (key.type())
+    {
+    case ACCOUNT:
+        hashCombine(res, key.account().accountID);
+        break;
+    case TRUSTLINE:
+        hashCombine(res, key.trustLine().accountID);
+        hashAsset(res, key.trustLine().asset);
+        break;
+    case OFFER:
+        hashCombine(res, key.offer().sellerID);
+        hashCombine(res, key.offer().offerID);
+        break;
+    }
+    return res;
+}
+
+bool
+LedgerDelta::KeyEq::operator()(LedgerKey const& a, LedgerKey const& b) const
+{
+    LedgerEntryIdCmp cmp;
+    return !cmp(a, b) && !cmp(b, a);
+}
+
+struct LedgerDelta::Store
+{
+    struct Record
+    {
+        LedgerKey mKey;
+        // relative to before the top-level delta
+        EntryState mState;
+        EntryFrame::pointer mEntry;
+        // latest entries of this record in the undo logs
+        size_t mLastUndo;
+        size_t mLastOverlayUndo;
+        // set by collectChanges to visit each record once
+        uint64_t mVisit;
+    };
+
+    // state of a record before a delta first changed it
+    struct Undo
+    {
+        size_t mRecord;
+        EntryState mState;
+        EntryFrame::pointer mEntry;
+        size_t mLastUndo;
+    };
+
+    // state of the write-behind overlay before a delta first stored a key
+    struct OverlayUndo
+    {
+        size_t mRecord;
+        std::unique_ptr<LedgerEntryOverlay::Pending> mPending;
+        size_t mLastOverlayUndo;
+    };
+
+    std::vector<Record> mRecords;
+    std::unordered_map<LedgerKey, size_t, KeyHash, KeyEq> mIndex;
+    std::vector<Undo> mUndo;
+    std::vector<OverlayUndo> mOverlayUndo;
+
+    // the delta that may be changed
+    LedgerDelta* mInnermost{nullptr};
+    uint64_t mVisit{0};
+};
+
 LedgerDelta::LedgerDelta(LedgerDelta& outerDelta)
     : mOuterDelta(&outerDelta)
     , mHeader(&outerDelta.getHeader())
     , mCurrentHeader(outerDelta.getHeader())
     , mPreviousHeaderValue(outerDelta.getHeader())
     , mDb(outerDelta.mDb)
+    , mStore(outerDelta.mStore)
+    , mRecordMark(mStore->mRecords.size())
+    , mUndoMark(mStore->mUndo.size())
+    , mOverlayUndoMark(mStore->mOverlayUndo.size())
+    , mUndoEnd(0)
 {
+    outerDelta.checkState();
+    mStore->mInnermost = this;
 }
 
 LedgerDelta::LedgerDelta(LedgerHeader& header, Database& db)
@@ -29,7 +148,14 @@ LedgerDelta::LedgerDelta(LedgerHeader& header, Database& db)
     , mCurrentHeader(header)
     , mPreviousHeaderValue(header)
     , mDb(db)
+    , mOwnStore(make_unique<Store>())
+    , mStore(mOwnStore.get())
+    , mRecordMark(0)
+    , mUndoMark(0)
+    , mOverlayUndoMark(0)
+    , mUndoEnd(0)
 {
+    mStore->mInnermost = this;
 }
 
 LedgerDelta::~LedgerDelta()
@@ -66,6 +192,51 @@ LedgerDelta::checkState()
         throw std::runtime_error(
             "Invalid operation: delta is already committed");
     }
+    if (mStore->mInnermost != this)
+    {
+        throw std::runtime_error(
+            "Invalid operation: a nested delta is still open");
+    }
+}
+
+size_t
+LedgerDelta::touch(LedgerKey const& key)
+{
+    auto& store = *mStore;
+    auto it = store.mIndex.find(key);
+    size_t r;
+    if (it == store.mIndex.end())
+    {
+        r = store.mRecords.size();
+        store.mRecords.push_back(
+            Store::Record{key, ENTRY_NONE, nullptr, NO_UNDO, NO_UNDO, 0});
+        store.mIndex.emplace(key, r);
+    }
+    else
+    {
+        r = it->second;
+    }
+
+    auto& rec = store.mRecords[r];
+    if (rec.mLastUndo == NO_UNDO || rec.mLastUndo < mUndoMark)
+    {
+        store.mUndo.push_back(
+            Store::Undo{r, rec.mState, rec.mEntry, rec.mLastUndo});
+        rec.mLastUndo = store.mUndo.size() - 1;
+    }
+    return r;
+}
+
+LedgerKey const&
+LedgerDelta::recordKey(size_t record) const
+{
+    return mStore->mRecords[record].mKey;
+}
+
+EntryFrame const&
+LedgerDelta::recordEntry(size_t record) const
+{
+    return *mStore->mRecords[record].mEntry;
 }
 
 void
@@ -90,20 +261,19 @@ void
 LedgerDelta::addEntry(EntryFrame::pointer entry)
 {
     checkState();
-    auto k = entry->getKey();
-    auto del_it = mDelete.find(k);
-    if (del_it != mDelete.end())
+    auto& rec = mStore->mRecords[touch(entry->getKey())];
+    if (rec.mState == ENTRY_REMOVED)
     {
         // delete + new is an update
-        mDelete.erase(del_it);
-        mMod[k] = entry;
+        rec.mState = ENTRY_UPDATED;
     }
     else
     {
-        assert(mNew.find(k) == mNew.end()); // double new
-        assert(mMod.find(k) == mMod.end()); // mod + new is invalid
-        mNew[k] = entry;
+        // double new, or mod + new, is invalid
+        assert(rec.mState == ENTRY_NONE);
+        rec.mState = ENTRY_CREATED;
     }
+    rec.mEntry = entry;
 }
 
 void
@@ -117,63 +287,50 @@ void
 LedgerDelta::deleteEntry(LedgerKey const& k)
 {
     checkState();
-    auto new_it = mNew.find(k);
-    if (new_it != mNew.end())
+    auto& rec = mStore->mRecords[touch(k)];
+    if (rec.mState == ENTRY_CREATED)
     {
         // new + delete -> don't add it in the first place
-        mNew.erase(new_it);
+        rec.mState = ENTRY_NONE;
     }
     else
     {
-        assert(mDelete.find(k) == mDelete.end()); // double delete is invalid
+        assert(rec.mState != ENTRY_REMOVED); // double delete is invalid
         // only keep the delete
-        mMod.erase(k);
-        mDelete.insert(k);
+        rec.mState = ENTRY_REMOVED;
     }
+    rec.mEntry.reset();
 }
 
 void
 LedgerDelta::modEntry(EntryFrame::pointer entry)
 {
     checkState();
-    auto k = entry->getKey();
-    auto mod_it = mMod.find(k);
-    if (mod_it != mMod.end())
+    auto& rec = mStore->mRecords[touch(entry->getKey())];
+    // new + mod = new (with latest value), mod + mod collapses
+    if (rec.mState != ENTRY_CREATED)
     {
-        // collapse mod
-        mod_it->second = entry;
-    }
-    else
-    {
-        auto new_it = mNew.find(k);
-        if (new_it != mNew.end())
-        {
-            // new + mod = new (with latest value)
-            new_it->second = entry;
-        }
-        else
-        {
-            assert(mDelete.find(k) == mDelete.end()); // delete + mod is illegal
-            mMod[k] = entry;
-        }
+        assert(rec.mState != ENTRY_REMOVED); // delete + mod is illegal
+        rec.mState = ENTRY_UPDATED;
     }
+    rec.mEntry = entry;
 }
 
 void
-LedgerDelta::mergeEntries(LedgerDelta& other)
+LedgerDelta::saveOverlayState(LedgerKey const& key,
+                              LedgerEntryOverlay::Pending const* prev)
 {
     checkState();
-    for (auto& d : other.mDelete)
-    {
-        deleteEntry(d);
-    }
-    for (auto& n : other.mNew)
+    auto& store = *mStore;
+    auto r = touch(key);
+    auto& rec = store.mRecords[r];
+    if (rec.mLastOverlayUndo == NO_UNDO ||
+        rec.mLastOverlayUndo < mOverlayUndoMark)
     {
-        addEntry(n.second);
-    }
-    for (auto& m : other.mMod)
-    {
-        modEntry(m.second);
+        store.mOverlayUndo.push_back(Store::OverlayUndo{
+            r, prev ? make_unique<LedgerEntryOverlay::Pending>(*prev) : nullptr,
+            rec.mLastOverlayUndo});
+        rec.mLastOverlayUndo = store.mOverlayUndo.size() - 1;
     }
 }
 
@@ -187,11 +344,10 @@ LedgerDelta::commit()
     {
         throw std::runtime_error("unexpected header state");
     }
-    if (mOuterDelta)
-    {
-        mOuterDelta->mergeEntries(*this);
-        mOuterDelta = nullptr;
-    }
+    // the outer delta takes over this delta's records and undo entries
+    mStore->mInnermost = mOuterDelta;
+    mUndoEnd = mStore->mUndo.size();
+    mOuterDelta = nullptr;
     *mHeader = mCurrentHeader.mHeader;
     mHeader = nullptr;
 }
@@ -201,41 +357,149 @@ LedgerDelta::rollback()
 {
     checkState();
     mHeader = nullptr;
-
-    for (auto& d : mDelete)
+    auto& store = *mStore;
+    store.mInnermost = mOuterDelta;
+    mUndoEnd = mUndoMark;
+
+    // the overlay goes back to its state before this delta first stored each
+    // key: walking the log backwards leaves that oldest state
+    LedgerEntryOverlay::UndoMap overlayUndo;
+    for (size_t i = store.mOverlayUndo.size(); i-- > mOverlayUndoMark;)
     {
-        EntryFrame::flushCachedEntry(d, mDb);
+        auto& u = store.mOverlayUndo[i];
+        auto& rec = store.mRecords[u.mRecord];
+        overlayUndo[rec.mKey] = std::move(u.mPending);
+        rec.mLastOverlayUndo = u.mLastOverlayUndo;
     }
-    for (auto& n : mNew)
+    store.mOverlayUndo.erase(store.mOverlayUndo.begin() + mOverlayUndoMark,
+                             store.mOverlayUndo.end());
+    mDb.getEntryOverlay().rollback(overlayUndo);
+
+    // whether the rows of these accounts and offers are rolled back depends
+    // on the caller's SQL transaction: the vote tally reloads the accounts
+    // when next used, and the books holding the offers are dropped
+    auto& tally = mDb.getInflationVoteTally();
+    auto& books = mDb.getOrderBookCache();
+    for (size_t i = store.mUndo.size(); i-- > mUndoMark;)
     {
-        EntryFrame::flushCachedEntry(n.first, mDb);
+        auto& u = store.mUndo[i];
+        auto& rec = store.mRecords[u.mRecord];
+        rec.mState = u.mState;
+        rec.mEntry = std::move(u.mEntry);
+        rec.mLastUndo = u.mLastUndo;
+        if (rec.mLastUndo == NO_UNDO || rec.mLastUndo < mUndoMark)
+        {
+            // oldest entry of this record in the delta's part of the log
+            EntryFrame::flushCachedEntry(rec.mKey, mDb);
+            if (rec.mKey.type() == ACCOUNT)
+            {
+                tally.markStale(rec.mKey.account().accountID);
+            }
+            else if (rec.mKey.type() == OFFER)
+            {
+                books.invalidate(rec.mKey.offer().offerID);
+            }
+        }
     }
-    for (auto& m : mMod)
+    store.mUndo.erase(store.mUndo.begin() + mUndoMark, store.mUndo.end());
+
+    for (size_t r = mRecordMark; r < store.mRecords.size(); r++)
     {
-        EntryFrame::flushCachedEntry(m.first, mDb);
+        assert(store.mRecords[r].mState == ENTRY_NONE);
+        store.mIndex.erase(store.mRecords[r].mKey);
+    }
+    store.mRecords.erase(store.mRecords.begin() + mRecordMark,
+                         store.mRecords.end());
+}
+
+void
+LedgerDelta::collectChanges(std::vector<size_t>& created,
+                            std::vector<size_t>& updated,
+                            std::vector<size_t>& removed) const
+{
+    auto& store = *mStore;
+    size_t end = mHeader ? store.mUndo.size()
+                         : std::min(mUndoEnd, store.mUndo.size());
+    uint64_t visit = ++store.mVisit;
+
+    // the first log entry of each record holds its state before this delta
+    for (size_t i = mUndoMark; i < end; i++)
+    {
+        auto const& u = store.mUndo[i];
+        auto& rec = store.mRecords[u.mRecord];
+        if (rec.mVisit == visit)
+        {
+            continue;
+        }
+        rec.mVisit = visit;
+
+        auto state = rec.mState;
+        switch (u.mState)
+        {
+        case ENTRY_NONE:
+            break;
+        case ENTRY_CREATED:
+        case ENTRY_UPDATED:
+            // the entry existed before this delta
+            state = (state == ENTRY_CREATED || state == ENTRY_UPDATED)
+                        ? ENTRY_UPDATED
+                        : ENTRY_REMOVED;
+            break;
+        case ENTRY_REMOVED:
+            // the entry did not exist before this delta
+            state = state == ENTRY_REMOVED ? ENTRY_NONE : ENTRY_CREATED;
+            break;
+        }
+
+        switch (state)
+        {
+        case ENTRY_NONE:
+            break;
+        case ENTRY_CREATED:
+            created.push_back(u.mRecord);
+            break;
+        case ENTRY_UPDATED:
+            updated.push_back(u.mRecord);
+            break;
+        case ENTRY_REMOVED:
+            removed.push_back(u.mRecord);
+            break;
+        }
     }
+
+    auto byKey = [&store](size_t a, size_t b)
+    {
+        return LedgerEntryIdCmp()(store.mRecords[a].mKey,
+                                  store.mRecords[b].mKey);
+    };
+    std::sort(created.begin(), created.end(), byKey);
+    std::sort(updated.begin(), updated.end(), byKey);
+    std::sort(removed.begin(), removed.end(), byKey);
 }
 
 LedgerEntryChanges
 LedgerDelta::getChanges() const
 {
     LedgerEntryChanges changes;
+    std::vector<size_t> created, updated, removed;
+    collectChanges(created, updated, removed);
 
-    for (auto const& k : mNew)
+    changes.reserve(created.size() + updated.size() + removed.size());
+    for (auto r : created)
     {
         changes.emplace_back(LEDGER_ENTRY_CREATED);
-        changes.back().created() = k.second->mEntry;
+        changes.back().created() = recordEntry(r).mEntry;
     }
-    for (auto const& k : mMod)
+    for (auto r : updated)
     {
         changes.emplace_back(LEDGER_ENTRY_UPDATED);
-        changes.back().updated() = k.second->mEntry;
+        changes.back().updated() = recordEntry(r).mEntry;
     }
 
-    for (auto const& k : mDelete)
+    for (auto r : removed)
     {
         changes.emplace_back(LEDGER_ENTRY_REMOVED);
-        changes.back().removed() = k;
+        changes.back().removed() = recordKey(r);
     }
 
     return changes;
@@ -245,16 +509,18 @@ std::vector<LedgerEntry>
 LedgerDelta::getLiveEntries() const
 {
     std::vector<LedgerEntry> live;
+    std::vector<size_t> created, updated, removed;
+    collectChanges(created, updated, removed);
 
-    live.reserve(mNew.size() + mMod.size());
+    live.reserve(created.size() + updated.size());
 
-    for (auto const& k : mNew)
+    for (auto r : created)
     {
-        live.push_back(k.second->mEntry);
+        live.push_back(recordEntry(r).mEntry);
     }
-    for (auto const& k : mMod)
+    for (auto r : updated)
     {
-        live.push_back(k.second->mEntry);
+        live.push_back(recordEntry(r).mEntry);
     }
 
     return live;
@@ -264,12 +530,14 @@ std::vector<LedgerKey>
 LedgerDelta::getDeadEntries() const
 {
     std::vector<LedgerKey> dead;
+    std::vector<size_t> created, updated, removed;
+    collectChanges(created, updated, removed);
 
-    dead.reserve(mDelete.size());
+    dead.reserve(removed.size());
 
-    for (auto const& k : mDelete)
+    for (auto r : removed)
     {
-        dead.push_back(k);
+        dead.push_back(recordKey(r));
     }
     return dead;
 }
@@ -277,69 +545,63 @@ LedgerDelta::getDeadEntries() const
 void
 LedgerDelta::markMeters(Application& app) const
 {
-    for (auto const& ke : mNew)
+    auto& meters = app.getApplyMeters();
+    uint64_t added[3] = {0, 0, 0};
+    uint64_t modified[3] = {0, 0, 0};
+    uint64_t deleted[3] = {0, 0, 0};
+    auto index = [](LedgerEntryType t) -> int
     {
-        switch (ke.first.type())
+        switch (t)
         {
         case ACCOUNT:
-            app.getMetrics()
-                .NewMeter({"ledger", "account", "add"}, "entry")
-                .Mark();
-            break;
+            return 0;
         case TRUSTLINE:
-            app.getMetrics()
-                .NewMeter({"ledger", "trust", "add"}, "entry")
-                .Mark();
-            break;
+            return 1;
         case OFFER:
-            app.getMetrics()
-                .NewMeter({"ledger", "offer", "add"}, "entry")
-                .Mark();
-            break;
+            return 2;
         }
-    }
+        return -1;
+    };
 
-    for (auto const& ke : mMod)
+    std::vector<size_t> created, updated, removed;
+    collectChanges(created, updated, removed);
+    auto count = [&](std::vector<size_t> const& records, uint64_t* counts)
     {
-        switch (ke.first.type())
+        for (auto r : records)
         {
-        case ACCOUNT:
-            app.getMetrics()
-                .NewMeter({"ledger", "account", "modify"}, "entry")
-                .Mark();
-            break;
-        case TRUSTLINE:
-            app.getMetrics()
-                .NewMeter({"ledger", "trust", "modify"}, "entry")
-                .Mark();
-            break;
-        case OFFER:
-            app.getMetrics()
-                .NewMeter({"ledger", "offer", "modify"}, "entry")
-                .Mark();
-            break;
+            int i = index(recordKey(r).type());
+            if (i >= 0)
+            {
+                counts[i]++;
+            }
         }
-    }
-
-    for (auto const& ke : mDelete)
+    };
+    count(created, added);
+    count(updated, modified);
+    count(removed, deleted);
+
+    static ApplyMeters::Meter const addMeters[3] = {
+        ApplyMeters::LEDGER_ACCOUNT_ADD, ApplyMeters::LEDGER_TRUST_ADD,
+        ApplyMeters::LEDGER_OFFER_ADD};
+    static ApplyMeters::Meter const modifyMeters[3] = {
+        ApplyMeters::LEDGER_ACCOUNT_MODIFY, ApplyMeters::LEDGER_TRUST_MODIFY,
+        ApplyMeters::LEDGER_OFFER_MODIFY};
+    static ApplyMeters::Meter const deleteMeters[3] = {
+        ApplyMeters::LEDGER_ACCOUNT_DELETE, ApplyMeters::LEDGER_TRUST_DELETE,
+        ApplyMeters::LEDGER_OFFER_DELETE};
+    for (int i = 0; i < 3; i++)
     {
-        switch (ke.type())
+        if (added[i])
         {
-        case ACCOUNT:
-            app.getMetrics()
-                .NewMeter({"ledger", "account", "delete"}, "entry")
-                .Mark();
-            break;
-        case TRUSTLINE:
-            app.getMetrics()
-                .NewMeter({"ledger", "trust", "delete"}, "entry")
-                .Mark();
-            break;
-        case OFFER:
-            app.getMetrics()
-                .NewMeter({"ledger", "offer", "delete"}, "entry")
-                .Mark();
-            break;
+            meters.mark(addMeters[i], added[i]);
+        }
+        if (modified[i])
+        {
+            meters.mark(modifyMeters[i], modified[i]);
+        }
+        if (deleted[i])
+        {
+            meters.mark(deleteMeters[i], deleted[i]);
         }
     }
 }
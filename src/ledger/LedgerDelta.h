@@ -4,10 +4,11 @@
 // under the Apache License, Version 2.0. See the COPYING file at the root
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
-#include <map>
-#include <set>
+#include <memory>
+#include <vector>
 #include "ledger/EntryFrame.h"
 #include "ledger/LedgerHeaderFrame.h"
+#include "ledger/LedgerEntryOverlay.h"
 #include "bucket/LedgerCmp.h"
 #include "xdrpp/marshal.h"
 
@@ -16,10 +17,46 @@ namespace stellar
 class Application;
 class Database;
 
+/**
+ * Changes made to the ledger header and entries by a ledger close, a
+ * transaction or an operation.
+ *
+ * Deltas nest: a top-level delta owns the storage shared by all the deltas
+ * opened inside it, and only the innermost open delta may be changed.
+ *
+ * The storage holds one record per key changed since the top-level delta was
+ * opened, with the key's state (created, updated or removed) and latest
+ * entry, found through a hash index. The first time a delta changes a key,
+ * the record's previous state goes to an undo log. So:
+ * - commit() leaves records and log as they are: the outer delta takes over
+ *   the log entries, at a cost that does not depend on the number of changes
+ * - rollback() replays the delta's part of the log backwards and drops the
+ *   records it created
+ * - a delta's own changes (getChanges() and friends) are worked out from the
+ *   state each record it logged had before and has now.
+ */
 class LedgerDelta
 {
-    typedef std::map<LedgerKey, EntryFrame::pointer, LedgerEntryIdCmp>
-        KeyEntryMap;
+  public:
+    enum EntryState : uint8_t
+    {
+        ENTRY_NONE,
+        ENTRY_CREATED,
+        ENTRY_UPDATED,
+        ENTRY_REMOVED
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(LedgerKey const& key) const;
+    };
+    struct KeyEq
+    {
+        bool operator()(LedgerKey const& a, LedgerKey const& b) const;
+    };
+
+  private:
+    struct Store; // defined in LedgerDelta.cpp
 
     LedgerDelta*
         mOuterDelta;       // set when this delta is nested inside another delta
@@ -29,20 +66,34 @@ class LedgerDelta
     // ledger header itself
     LedgerHeaderFrame mCurrentHeader;
     LedgerHeader mPreviousHeaderValue;
-    // ledger entries
-    KeyEntryMap mNew;
-    KeyEntryMap mMod;
-    std::set<LedgerKey, LedgerEntryIdCmp> mDelete;
 
     Database& mDb; // Used strictly for rollback of db entry cache.
 
+    // ledger entries: owned by the top-level delta
+    std::unique_ptr<Store> mOwnStore;
+    Store* mStore;
+    // where this delta's part of the store starts: the records it created
+    // and its entries in the undo logs
+    size_t mRecordMark;
+    size_t mUndoMark;
+    size_t mOverlayUndoMark;
+    // end of this delta's part of the undo log, once committed
+    size_t mUndoEnd;
+
     void checkState();
+    // record of `key`, saving its state if this delta did not change it yet
+    size_t touch(LedgerKey const& key);
     void addEntry(EntryFrame::pointer entry);
     void deleteEntry(EntryFrame::pointer entry);
     void modEntry(EntryFrame::pointer entry);
 
-    // merge "other" into current ledgerDelta
-    void mergeEntries(LedgerDelta& other);
+    // the records this delta changed, by state relative to before the delta,
+    // each sorted by key
+    void collectChanges(std::vector<size_t>& created,
+                        std::vector<size_t>& updated,
+                        std::vector<size_t>& removed) const;
+    LedgerKey const& recordKey(size_t record) const;
+    EntryFrame const& recordEntry(size_t record) const;
 
   public:
     // keeps an internal reference to the outerDelta,
@@ -66,7 +117,13 @@ class LedgerDelta
     void deleteEntry(LedgerKey const& key);
     void modEntry(EntryFrame const& entry);
 
-    // commits this delta into outer delta
+    // called by LedgerEntryOverlay when this delta stores `key`; `prev` is
+    // the key's overlay state, or nullptr if the overlay did not hold it
+    void saveOverlayState(LedgerKey const& key,
+                          LedgerEntryOverlay::Pending const* prev);
+
+    // commits this delta into outer delta; this delta must be the innermost
+    // one open
     void commit();
     // aborts any changes pending, flush db cache entries
     void rollback();
@@ -0,0 +1,222 @@
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "ledger/LedgerEntryOverlay.h"
+#include "database/Database.h"
+#include "ledger/AccountFrame.h"
+#include "ledger/LedgerDelta.h"
+#include "ledger/TrustFrame.h"
+#include <cassert>
+
+#include "medida/meter.h"
+#include "medida/metrics_registry.h"
+#include "medida/timer.h"
+
+namespace stellar
+{
+
+LedgerEntryOverlay::LedgerEntryOverlay(medida::MetricsRegistry& metrics)
+    : mStoreMeter(metrics.NewMeter({"ledger", "write-behind", "store"},
+                                   "entry"))
+    , mWriteMeter(metrics.NewMeter({"ledger", "write-behind", "write"},
+                                   "entry"))
+    , mWriteTimer(metrics.NewTimer({"ledger", "write-behind", "flush"}))
+{
+}
+
+void
+LedgerEntryOverlay::begin()
+{
+    assert(mPending.empty());
+    mEnabled = true;
+    mBarrierWritten = false;
+}
+
+void
+LedgerEntryOverlay::end()
+{
+    mPending.clear();
+    mEnabled = false;
+    mBarrierWritten = false;
+}
+
+bool
+LedgerEntryOverlay::get(LedgerKey const& key,
+                        std::shared_ptr<LedgerEntry const>& entry) const
+{
+    if (!mEnabled)
+    {
+        return false;
+    }
+    auto it = mPending.find(key);
+    if (it == mPending.end())
+    {
+        return false;
+    }
+    entry = it->second.mEntry;
+    return true;
+}
+
+void
+LedgerEntryOverlay::store(LedgerDelta& delta, LedgerKey const& key,
+                          std::shared_ptr<LedgerEntry const> entry,
+                          DatabaseState state, bool updateSigners)
+{
+    assert(mEnabled);
+    auto it = mPending.find(key);
+    delta.saveOverlayState(key, it == mPending.end() ? nullptr : &it->second);
+    if (it == mPending.end())
+    {
+        it = mPending.insert(std::make_pair(
+                                 key, Pending{nullptr, state, true, false}))
+                 .first;
+    }
+    auto& p = it->second;
+    p.mEntry = entry;
+    p.mDirty = true;
+    p.mUpdateSigners = p.mUpdateSigners || updateSigners;
+    mStoreMeter.Mark();
+}
+
+void
+LedgerEntryOverlay::rollback(UndoMap const& undo)
+{
+    if (!mEnabled || undo.empty())
+    {
+        return;
+    }
+    for (auto const& u : undo)
+    {
+        if (u.second)
+        {
+            mPending[u.first] = *u.second;
+        }
+        else
+        {
+            mPending.erase(u.first);
+        }
+    }
+    if (mBarrierWritten)
+    {
+        for (auto& p : mPending)
+        {
+            p.second.mDatabaseState = DB_UNKNOWN;
+            p.second.mDirty = true;
+            p.second.mUpdateSigners = (p.first.type() == ACCOUNT);
+        }
+    }
+}
+
+void
+LedgerEntryOverlay::writeOutEntry(Database& db, LedgerKey const& key,
+                                  Pending& p)
+{
+    if (p.mEntry)
+    {
+        auto storeEntry = [&](bool insert) -> bool
+        {
+            switch (key.type())
+            {
+            case ACCOUNT:
+                return AccountFrame::storeEntry(db, *p.mEntry, insert,
+                                                p.mUpdateSigners);
+            case TRUSTLINE:
+                return TrustFrame::storeEntry(db, *p.mEntry, insert);
+            default:
+                throw std::runtime_error("unexpected write-behind entry");
+            }
+        };
+        bool stored = (p.mDatabaseState != DB_ABSENT) && storeEntry(false);
+        if (!stored)
+        {
+            if (p.mDatabaseState == DB_PRESENT || !storeEntry(true))
+            {
+                throw std::runtime_error("Could not update data in SQL");
+            }
+        }
+        p.mDatabaseState = DB_PRESENT;
+        p.mUpdateSigners = false;
+        EntryFrame::putCachedEntry(key, p.mEntry, db);
+        mWriteMeter.Mark();
+    }
+    else
+    {
+        if (p.mDatabaseState != DB_ABSENT)
+        {
+            switch (key.type())
+            {
+            case ACCOUNT:
+                AccountFrame::storeDeleteEntry(db, key);
+                break;
+            case TRUSTLINE:
+                TrustFrame::storeDeleteEntry(db, key);
+                break;
+            default:
+                throw std::runtime_error("unexpected write-behind entry");
+            }
+            mWriteMeter.Mark();
+        }
+        p.mDatabaseState = DB_ABSENT;
+        EntryFrame::putCachedEntry(key, nullptr, db);
+    }
+    p.mDirty = false;
+}
+
+void
+LedgerEntryOverlay::writeOutMatching(Database& db, bool allTypes,
+                                     LedgerEntryType type)
+{
+    if (!mEnabled)
+    {
+        return;
+    }
+    auto timer = mWriteTimer.TimeScope();
+    // Frames writing rows load the current database state (signers), which
+    // must not be answered from the overlay.
+    mEnabled = false;
+    try
+    {
+        for (auto& p : mPending)
+        {
+            if (p.second.mDirty && (allTypes || p.first.type() == type))
+            {
+                writeOutEntry(db, p.first, p.second);
+            }
+        }
+    }
+    catch (...)
+    {
+        mEnabled = true;
+        throw;
+    }
+    mEnabled = true;
+    mBarrierWritten = true;
+}
+
+void
+LedgerEntryOverlay::writeOut(Database& db)
+{
+    writeOutMatching(db, true, ACCOUNT);
+}
+
+void
+LedgerEntryOverlay::writeOut(Database& db, LedgerEntryType type)
+{
+    writeOutMatching(db, false, type);
+}
+
+LedgerEntryOverlay::Scope::Scope(LedgerEntryOverlay& overlay, bool enabled)
+    : mOverlay(overlay)
+{
+    if (enabled)
+    {
+        mOverlay.begin();
+    }
+}
+
+LedgerEntryOverlay::Scope::~Scope()
+{
+    mOverlay.end();
+}
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "bucket/LedgerCmp.h"
+#include "overlay/StellarXDR.h"
+#include "util/NonCopyable.h"
+#include <map>
+#include <memory>
+
+namespace medida
+{
+class MetricsRegistry;
+class Meter;
+class Timer;
+}
+
+namespace stellar
+{
+class Database;
+class LedgerDelta;
+
+/**
+ * Write-behind buffer for account and trustline entries.
+ *
+ * Between begin() and end() -- which LedgerManager brackets around a ledger
+ * close when WRITE_BEHIND_LEDGER_ENTRIES is set -- AccountFrame and
+ * TrustFrame store operations record the new state of the entry here instead
+ * of executing SQL, and key lookups consult the overlay before the entry
+ * cache and the database. writeOut() then issues a single INSERT, UPDATE or
+ * DELETE per changed key, however many times it was stored during the
+ * ledger. Offers are always written through, since the order book is read
+ * with range queries.
+ *
+ * Rollback is driven by LedgerDelta: the first time a delta stores a key, the
+ * overlay hands it the key's previous state, and a delta that is rolled back
+ * puts those states back.
+ *
+ * The few non-key queries over accounts and trustlines that can run during
+ * apply call writeOut() first as a barrier: AccountFrame::processForInflation,
+ * InflationVoteTally (rebuild and processForInflation), TrustFrame::hasIssued
+ * and TrustFrame::loadLines. Those rows are written inside whatever SQL
+ * savepoint is open, and a later savepoint rollback may or may not undo them,
+ * so once any delta rolls back after a barrier every pending entry is marked
+ * dirty again, with unknown database state, and is rewritten by the final
+ * writeOut().
+ *
+ * Unlike the history rows of TxHistoryBatch, which are only ever inserted,
+ * entries are written one statement per key rather than in multi-row
+ * statements. An entry whose database state is unknown needs an upsert, and
+ * neither the bundled SQLite (3.8) nor PostgreSQL 9.4 has ON CONFLICT; an
+ * account may also need its signers rewritten. The gain is in the number of
+ * statements, one per changed key per ledger instead of one per store.
+ */
+class LedgerEntryOverlay : NonMovableOrCopyable
+{
+  public:
+    enum DatabaseState
+    {
+        DB_UNKNOWN,
+        DB_ABSENT,
+        DB_PRESENT
+    };
+
+    struct Pending
+    {
+        // latest state of the entry, nullptr if it was deleted
+        std::shared_ptr<LedgerEntry const> mEntry;
+        // whether the entry's row is in the database right now
+        DatabaseState mDatabaseState;
+        bool mDirty;
+        // accounts only: signers may differ from the signers table
+        bool mUpdateSigners;
+    };
+
+    // Previous state of each key stored by a LedgerDelta; nullptr for keys
+    // that were not in the overlay.
+    typedef std::map<LedgerKey, std::unique_ptr<Pending>, LedgerEntryIdCmp>
+        UndoMap;
+
+  private:
+    std::map<LedgerKey, Pending, LedgerEntryIdCmp> mPending;
+    bool mEnabled{false};
+    bool mBarrierWritten{false};
+
+    medida::Meter& mStoreMeter;
+    medida::Meter& mWriteMeter;
+    medida::Timer& mWriteTimer;
+
+    void writeOutEntry(Database& db, LedgerKey const& key, Pending& p);
+    void writeOutMatching(Database& db, bool allTypes, LedgerEntryType type);
+
+  public:
+    LedgerEntryOverlay(medida::MetricsRegistry& metrics);
+
+    bool
+    isEnabled() const
+    {
+        return mEnabled;
+    }
+
+    // Start buffering stores.
+    void begin();
+
+    // Drop anything still pending and go back to writing through.
+    void end();
+
+    // Return true if the overlay holds `key`, setting `entry` to its latest
+    // state (nullptr if deleted).
+    bool get(LedgerKey const& key,
+             std::shared_ptr<LedgerEntry const>& entry) const;
+
+    // Record that `delta` stored `entry` under `key`, or deleted `key` if
+    // `entry` is nullptr. `state` says whether the row was in the database
+    // before the store: it is only used the first time the key is seen.
+    void store(LedgerDelta& delta, LedgerKey const& key,
+               std::shared_ptr<LedgerEntry const> entry, DatabaseState state,
+               bool updateSigners = false);
+
+    // Put back the states saved by a LedgerDelta that is rolled back.
+    void rollback(UndoMap const& undo);
+
+    // Write every dirty entry to the database.
+    void writeOut(Database& db);
+
+    // Write dirty entries of one type only; used as a read barrier.
+    void writeOut(Database& db, LedgerEntryType type);
+
+    // Calls begin() on construction if `enabled` and end() on destruction,
+    // so an aborted ledger close leaves nothing behind.
+    class Scope : NonMovableOrCopyable
+    {
+        LedgerEntryOverlay& mOverlay;
+
+      public:
+        Scope(LedgerEntryOverlay& overlay, bool enabled);
+        ~Scope();
+    };
+};
+}
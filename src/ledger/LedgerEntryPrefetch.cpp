@@ -0,0 +1,129 @@
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "ledger/LedgerEntryPrefetch.h"
+#include "database/Database.h"
+#include "ledger/AccountFrame.h"
+#include "ledger/TrustFrame.h"
+#include "util/Logging.h"
+
+#include "medida/meter.h"
+#include "medida/metrics_registry.h"
+#include "medida/timer.h"
+
+namespace stellar
+{
+
+size_t const LedgerEntryPrefetch::MAX_KEYS = 2048;
+
+LedgerEntryPrefetch::LedgerEntryPrefetch(medida::MetricsRegistry& metrics)
+    : mLoadMeter(metrics.NewMeter({"ledger", "prefetch", "load"}, "entry"))
+    , mHitMeter(metrics.NewMeter({"ledger", "prefetch", "hit"}, "entry"))
+    , mMissMeter(metrics.NewMeter({"ledger", "prefetch", "miss"}, "entry"))
+    , mLoadTimer(metrics.NewTimer({"ledger", "prefetch", "fetch"}))
+{
+}
+
+void
+LedgerEntryPrefetch::begin(Database& db, std::vector<LedgerKey> const& keys)
+{
+    mHits = 0;
+    mMisses = 0;
+    if (!db.getEntryKVStore())
+    {
+        load(db, keys);
+    }
+    mActive = true;
+}
+
+void
+LedgerEntryPrefetch::preload(Database& db, std::vector<LedgerKey> const& keys)
+{
+    if (!db.getEntryKVStore())
+    {
+        load(db, keys);
+    }
+}
+
+void
+LedgerEntryPrefetch::load(Database& db, std::vector<LedgerKey> const& keys)
+{
+    auto timer = mLoadTimer.TimeScope();
+    auto& overlay = db.getEntryOverlay();
+    std::vector<AccountID> accounts;
+    std::vector<LedgerKey> lines;
+    for (auto const& key : keys)
+    {
+        if (accounts.size() + lines.size() >= MAX_KEYS)
+        {
+            break;
+        }
+        std::shared_ptr<LedgerEntry const> pending;
+        if (overlay.get(key, pending) ||
+            EntryFrame::cachedEntryExists(key, db))
+        {
+            continue;
+        }
+        switch (key.type())
+        {
+        case ACCOUNT:
+            accounts.push_back(key.account().accountID);
+            break;
+        case TRUSTLINE:
+            lines.push_back(key);
+            break;
+        default:
+            break;
+        }
+    }
+
+    AccountFrame::prefetchAccounts(accounts, db);
+    TrustFrame::prefetchTrustLines(lines, db);
+    mLoadMeter.Mark(accounts.size() + lines.size());
+}
+
+void
+LedgerEntryPrefetch::end()
+{
+    if (mActive && (mHits + mMisses) != 0)
+    {
+        CLOG(DEBUG, "Ledger") << "Entry lookups during apply: " << mHits
+                              << " cached, " << mMisses << " loaded ("
+                              << (100 * mHits / (mHits + mMisses))
+                              << "% hit rate)";
+    }
+    mActive = false;
+}
+
+void
+LedgerEntryPrefetch::recordLookup(bool cached)
+{
+    if (!mActive)
+    {
+        return;
+    }
+    if (cached)
+    {
+        mHits++;
+        mHitMeter.Mark();
+    }
+    else
+    {
+        mMisses++;
+        mMissMeter.Mark();
+    }
+}
+
+LedgerEntryPrefetch::Scope::Scope(LedgerEntryPrefetch& prefetch, Database& db,
+                                  std::vector<LedgerKey> const& keys)
+    : mPrefetch(prefetch)
+{
+    mPrefetch.begin(db, keys);
+}
+
+LedgerEntryPrefetch::Scope::~Scope()
+{
+    mPrefetch.end();
+}
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "overlay/StellarXDR.h"
+#include "util/NonCopyable.h"
+#include <vector>
+
+namespace medida
+{
+class MetricsRegistry;
+class Meter;
+class Timer;
+}
+
+namespace stellar
+{
+class Database;
+
+/**
+ * Warms the entry cache before a ledger close applies its transactions.
+ *
+ * Most of the accounts and trustlines a transaction set loads can be read off
+ * the transactions themselves (see TxSetFrame::getPrefetchKeys). begin()
+ * loads those missing from the cache with a few batched IN (...) queries
+ * instead of one SELECT per key during apply, caching absent keys as such.
+ *
+ * Until end(), AccountFrame and TrustFrame report whether each key lookup
+ * that got past the write-behind overlay was served by the cache (a hit) or
+ * needed a query (a miss); end() logs the ledger's hit rate, and the meters
+ * keep the running totals.
+ *
+ * preload() only loads, so that the herder can warm the cache for a tx set
+ * before it is externalized (see PRELOAD_PREPARED_TX_SET).
+ *
+ * With the key-value backend lookups never leave the process, so nothing is
+ * loaded, though lookups are still counted.
+ */
+class LedgerEntryPrefetch : NonMovableOrCopyable
+{
+    bool mActive{false};
+    uint64_t mHits{0};
+    uint64_t mMisses{0};
+
+    medida::Meter& mLoadMeter;
+    medida::Meter& mHitMeter;
+    medida::Meter& mMissMeter;
+    medida::Timer& mLoadTimer;
+
+    void load(Database& db, std::vector<LedgerKey> const& keys);
+
+  public:
+    // Keys loaded per ledger at most, well below the entry cache size so
+    // that prefetched entries are not evicted before they are used.
+    static size_t const MAX_KEYS;
+
+    LedgerEntryPrefetch(medida::MetricsRegistry& metrics);
+
+    // Load `keys` into the entry cache and start counting lookups.
+    void begin(Database& db, std::vector<LedgerKey> const& keys);
+
+    // Stop counting lookups.
+    void end();
+
+    // Load `keys` into the entry cache, without counting lookups.
+    void preload(Database& db, std::vector<LedgerKey> const& keys);
+
+    // Called by lookups of accounts and trustlines in the entry cache.
+    void recordLookup(bool cached);
+
+    // Calls begin() on construction and end() on destruction.
+    class Scope : NonMovableOrCopyable
+    {
+        LedgerEntryPrefetch& mPrefetch;
+
+      public:
+        Scope(LedgerEntryPrefetch& prefetch, Database& db,
+              std::vector<LedgerKey> const& keys);
+        ~Scope();
+    };
+};
+}
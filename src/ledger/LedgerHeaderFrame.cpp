@@ -213,11 +213,16 @@ LedgerHeaderFrame::copyLedgerHeadersToStream(Database& db, soci::session& sess,
     return n;
 }
 
-void
-LedgerHeaderFrame::deleteOldEntries(Database& db, uint32_t ledgerSeq)
+size_t
+LedgerHeaderFrame::deleteOldEntries(Database& db, soci::session& sess,
+                                    uint32_t ledgerSeq)
 {
-    db.getSession() << "DELETE FROM ledgerheaders WHERE ledgerseq <= "
-                    << ledgerSeq;
+    auto timer = db.getDeleteTimer("ledger-header-history");
+    soci::statement st =
+        (sess.prepare << "DELETE FROM ledgerheaders WHERE ledgerseq <= :v1",
+         use(ledgerSeq));
+    st.execute(true);
+    return static_cast<size_t>(st.get_affected_rows());
 }
 
 void
@@ -54,7 +54,9 @@ class LedgerHeaderFrame
                                             uint32_t ledgerCount,
                                             XDROutputFileStream& headersOut);
 
-    static void deleteOldEntries(Database& db, uint32_t ledgerSeq);
+    // Deletes headers at or below ledgerSeq, returning the number deleted.
+    static size_t deleteOldEntries(Database& db, soci::session& sess,
+                                   uint32_t ledgerSeq);
 
     static void dropAll(Database& db);
     static const char* kSQLCreateStatement;
@@ -11,6 +11,7 @@ namespace stellar
 {
 
 class LedgerHeaderFrame;
+class HistoryPruner;
 class LedgerCloseData;
 class Database;
 
@@ -160,8 +161,11 @@ class LedgerManager
     // permit testing.
     virtual void closeLedger(LedgerCloseData const& ledgerData) = 0;
 
-    // deletes old entries stored in the database
-    virtual void deleteOldEntries(Database& db, uint32_t ledgerSeq) = 0;
+    // Schedules deletion of history stored in the database at or below
+    // ledgerSeq; see HistoryPruner.
+    virtual void deleteOldEntries(uint32_t ledgerSeq) = 0;
+
+    virtual HistoryPruner& getHistoryPruner() = 0;
 
     virtual ~LedgerManager()
     {
@@ -105,10 +105,12 @@ LedgerManagerImpl::LedgerManagerImpl(Application& app)
           app.getMetrics().NewCounter({"ledger", "state", "current"}))
     , mLedgerStateChanges(
           app.getMetrics().NewTimer({"ledger", "state", "changes"}))
+    , mHistoryWrite(app.getMetrics().NewTimer({"ledger", "history", "write"}))
     , mLastClose(mApp.getClock().now())
     , mLastStateChange(mApp.getClock().now())
     , mSyncingLedgersSize(
           app.getMetrics().NewCounter({"ledger", "memory", "syncing-ledgers"}))
+    , mHistoryPruner(app)
     , mState(LM_BOOTING_STATE)
 
 {
@@ -212,6 +214,8 @@ LedgerManagerImpl::loadLastKnownLedger(
                 else
                 {
                     mApp.getBucketManager().assumeState(has);
+                    getDatabase().getInflationVoteTally().rebuild(
+                        getDatabase());
 
                     CLOG(INFO, "Ledger") << "Loaded last known ledger: "
                                          << ledgerAbbrev(mCurrentLedger);
@@ -628,6 +632,9 @@ LedgerManagerImpl::closeLedger(LedgerCloseData const& ledgerData)
         throw std::runtime_error("corrupt transaction set");
     }
 
+    SQLProfiler::LedgerScope sqlProfile(getDatabase().getSQLProfiler(),
+                                        mCurrentLedger->mHeader.ledgerSeq);
+
     soci::transaction txscope(getDatabase().getSession());
 
     auto ledgerTime = mLedgerClose.TimeScope();
@@ -635,6 +642,12 @@ LedgerManagerImpl::closeLedger(LedgerCloseData const& ledgerData)
     auto const& sv = ledgerData.mValue;
     mCurrentLedger->mHeader.scpValue = sv;
 
+    // in write-behind mode, account and trustline stores made while applying
+    // this ledger are buffered and written once per key before validation
+    auto& overlay = getDatabase().getEntryOverlay();
+    LedgerEntryOverlay::Scope writeBehind(
+        overlay, mApp.getConfig().WRITE_BEHIND_LEDGER_ENTRIES);
+
     LedgerDelta ledgerDelta(mCurrentLedger->mHeader, getDatabase());
 
     // the transaction set that was agreed upon by consensus
@@ -642,13 +655,26 @@ LedgerManagerImpl::closeLedger(LedgerCloseData const& ledgerData)
     // sorted such that sequence numbers are respected
     vector<TransactionFramePtr> txs = ledgerData.mTxSet->sortForApply();
 
+    // load the entries the transactions name in a few batched queries,
+    // rather than one by one as they are applied
+    LedgerEntryPrefetch::Scope prefetch(getDatabase().getEntryPrefetch(),
+                                        getDatabase(),
+                                        ledgerData.mTxSet->getPrefetchKeys());
+
+    // the books crossed by offers and path payments are shared by all the
+    // transactions of the ledger
+    OrderBookCache::Scope books(getDatabase().getOrderBookCache());
+
+    // history rows are accumulated here and written together at the end
+    TxHistoryBatch history(getDatabase(), mCurrentLedger->mHeader.ledgerSeq);
+
     // first, charge fees
-    processFeesSeqNums(txs, ledgerDelta);
+    processFeesSeqNums(txs, ledgerDelta, history);
 
     TransactionResultSet txResultSet;
     txResultSet.results.reserve(txs.size());
 
-    applyTransactions(txs, ledgerDelta, txResultSet);
+    applyTransactions(txs, ledgerDelta, txResultSet, history);
 
     ledgerDelta.getHeader().txSetResultHash =
         sha256(xdr::xdr_to_opaque(txResultSet));
@@ -686,10 +712,13 @@ LedgerManagerImpl::closeLedger(LedgerCloseData const& ledgerData)
         }
     }
 
+    overlay.writeOut(getDatabase());
+    overlay.end();
+
     ledgerDelta.checkAgainstDatabase(mApp);
 
     ledgerDelta.commit();
-    closeLedgerHelper(ledgerDelta);
+    closeLedgerHelper(ledgerDelta, history);
     txscope.commit();
 
     // Notify ledger close to other components.
@@ -702,10 +731,15 @@ LedgerManagerImpl::closeLedger(LedgerCloseData const& ledgerData)
 }
 
 void
-LedgerManagerImpl::deleteOldEntries(Database& db, uint32_t ledgerSeq)
+LedgerManagerImpl::deleteOldEntries(uint32_t ledgerSeq)
 {
-    LedgerHeaderFrame::deleteOldEntries(db, ledgerSeq);
-    TransactionFrame::deleteOldEntries(db, ledgerSeq);
+    mHistoryPruner.pruneUpTo(ledgerSeq);
+}
+
+HistoryPruner&
+LedgerManagerImpl::getHistoryPruner()
+{
+    return mHistoryPruner;
 }
 
 void
@@ -724,7 +758,8 @@ LedgerManagerImpl::advanceLedgerPointers()
 
 void
 LedgerManagerImpl::processFeesSeqNums(std::vector<TransactionFramePtr>& txs,
-                                      LedgerDelta& delta)
+                                      LedgerDelta& delta,
+                                      TxHistoryBatch& history)
 {
     CLOG(DEBUG, "Ledger") << "processing fees and sequence numbers";
     int index = 0;
@@ -735,7 +770,7 @@ LedgerManagerImpl::processFeesSeqNums(std::vector<TransactionFramePtr>& txs,
         {
             LedgerDelta thisTxDelta(delta);
             tx->processFeeSeqNum(thisTxDelta, *this);
-            tx->storeTransactionFee(*this, thisTxDelta.getChanges(), ++index);
+            tx->storeTransactionFee(history, thisTxDelta.getChanges(), ++index);
             thisTxDelta.commit();
         }
         sqlTx.commit();
@@ -751,7 +786,8 @@ LedgerManagerImpl::processFeesSeqNums(std::vector<TransactionFramePtr>& txs,
 void
 LedgerManagerImpl::applyTransactions(std::vector<TransactionFramePtr>& txs,
                                      LedgerDelta& ledgerDelta,
-                                     TransactionResultSet& txResultSet)
+                                     TransactionResultSet& txResultSet,
+                                     TxHistoryBatch& history)
 {
     CLOG(DEBUG, "Tx") << "applyTransactions: ledger = "
                       << mCurrentLedger->mHeader.ledgerSeq;
@@ -789,12 +825,13 @@ LedgerManagerImpl::applyTransactions(std::vector<TransactionFramePtr>& txs,
             CLOG(ERROR, "Ledger") << "Unknown exception during tx->apply";
             tx->getResult().result.code(txINTERNAL_ERROR);
         }
-        tx->storeTransaction(*this, tm, ++index, txResultSet);
+        tx->storeTransaction(history, tm, ++index, txResultSet);
     }
 }
 
 void
-LedgerManagerImpl::closeLedgerHelper(LedgerDelta const& delta)
+LedgerManagerImpl::closeLedgerHelper(LedgerDelta const& delta,
+                                     TxHistoryBatch& history)
 {
     delta.markMeters(mApp);
     mApp.getBucketManager().addBatch(mApp, mCurrentLedger->mHeader.ledgerSeq,
@@ -803,7 +840,11 @@ LedgerManagerImpl::closeLedgerHelper(LedgerDelta const& delta)
 
     mApp.getBucketManager().snapshotLedger(mCurrentLedger->mHeader);
 
-    mCurrentLedger->storeInsert(*this);
+    {
+        auto timer = mHistoryWrite.TimeScope();
+        history.flush();
+        mCurrentLedger->storeInsert(*this);
+    }
 
     mApp.getPersistentState().setState(PersistentState::kLastClosedLedger,
                                        binToHex(mCurrentLedger->getHash()));
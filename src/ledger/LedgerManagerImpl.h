@@ -7,6 +7,7 @@
 
 #include <string>
 #include "ledger/LedgerManager.h"
+#include "ledger/HistoryPruner.h"
 #include "ledger/LedgerHeaderFrame.h"
 #include "main/PersistentState.h"
 #include "history/HistoryManager.h"
@@ -29,6 +30,7 @@ namespace stellar
 class Application;
 class Database;
 class LedgerDelta;
+class TxHistoryBatch;
 
 class LedgerManagerImpl : public LedgerManager
 {
@@ -42,6 +44,7 @@ class LedgerManagerImpl : public LedgerManager
     medida::Counter& mLedgerAge;
     medida::Counter& mLedgerStateCurrent;
     medida::Timer& mLedgerStateChanges;
+    medida::Timer& mHistoryWrite;
     VirtualClock::time_point mLastClose;
     VirtualClock::time_point mLastStateChange;
 
@@ -49,17 +52,20 @@ class LedgerManagerImpl : public LedgerManager
 
     std::vector<LedgerCloseData> mSyncingLedgers;
 
+    HistoryPruner mHistoryPruner;
+
     void historyCaughtup(asio::error_code const& ec,
                          HistoryManager::CatchupMode mode,
                          LedgerHeaderHistoryEntry const& lastClosed);
 
     void processFeesSeqNums(std::vector<TransactionFramePtr>& txs,
-                            LedgerDelta& delta);
+                            LedgerDelta& delta, TxHistoryBatch& history);
     void applyTransactions(std::vector<TransactionFramePtr>& txs,
                            LedgerDelta& ledgerDelta,
-                           TransactionResultSet& txResultSet);
+                           TransactionResultSet& txResultSet,
+                           TxHistoryBatch& history);
 
-    void closeLedgerHelper(LedgerDelta const& delta);
+    void closeLedgerHelper(LedgerDelta const& delta, TxHistoryBatch& history);
     void advanceLedgerPointers();
 
     State mState;
@@ -96,6 +102,7 @@ class LedgerManagerImpl : public LedgerManager
     HistoryManager::VerifyHashStatus
     verifyCatchupCandidate(LedgerHeaderHistoryEntry const&) const override;
     void closeLedger(LedgerCloseData const& ledgerData) override;
-    void deleteOldEntries(Database& db, uint32_t ledgerSeq) override;
+    void deleteOldEntries(uint32_t ledgerSeq) override;
+    HistoryPruner& getHistoryPruner() override;
 };
 }
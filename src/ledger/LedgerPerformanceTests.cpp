@@ -20,6 +20,10 @@
 #include "bucket/BucketManager.h"
 #include "util/optional.h"
 #include "util/Math.h"
+#include "ledger/LedgerDelta.h"
+#include "crypto/SecretKey.h"
+#include "util/CachedXDR.h"
+#include <chrono>
 
 using namespace stellar;
 using namespace std;
@@ -227,3 +231,193 @@ TEST_CASE("ledger performance test", "[performance][hide]")
         LOG(INFO) << "done";
     }
 }
+
+TEST_CASE("ledger entry backend comparison", "[performance][kv][hide]")
+{
+    size_t const nAccounts = 100000;
+    size_t const nOps = 100000;
+
+    for (bool useKV : {false, true})
+    {
+        Config cfg(getTestConfig(0, Config::TESTDB_ON_DISK_SQLITE));
+        if (useKV)
+        {
+            cfg.DATABASE = EntryKVStore::DATABASE_PREFIX + cfg.DATABASE;
+        }
+        VirtualClock clock;
+        Application::pointer app = Application::create(clock, cfg);
+        app->start();
+        auto& db = app->getDatabase();
+        auto& lm = app->getLedgerManager();
+
+        vector<AccountFrame::pointer> accounts;
+        for (size_t i = 0; i < nAccounts; i++)
+        {
+            auto acc = make_shared<AccountFrame>(
+                SecretKey::random().getPublicKey());
+            acc->getAccount().balance = 1000000000;
+            accounts.push_back(acc);
+        }
+
+        auto start = chrono::steady_clock::now();
+        {
+            soci::transaction tx(db.getSession());
+            LedgerDelta delta(lm.getCurrentLedgerHeader(), db);
+            for (auto& acc : accounts)
+            {
+                acc->storeAdd(delta, db);
+            }
+            delta.commit();
+            tx.commit();
+        }
+        chrono::duration<double> insertTime =
+            chrono::steady_clock::now() - start;
+
+        // cold point lookups
+        db.getEntryCache().clear();
+        start = chrono::steady_clock::now();
+        for (size_t i = 0; i < nOps; i++)
+        {
+            auto const& acc = accounts[rand_uniform<size_t>(0, nAccounts - 1)];
+            AccountFrame::flushCachedEntry(acc->getKey(), db);
+            REQUIRE(AccountFrame::loadAccount(acc->getID(), db));
+        }
+        chrono::duration<double> loadTime =
+            chrono::steady_clock::now() - start;
+
+        start = chrono::steady_clock::now();
+        {
+            soci::transaction tx(db.getSession());
+            LedgerDelta delta(lm.getCurrentLedgerHeader(), db);
+            for (size_t i = 0; i < nOps; i++)
+            {
+                auto& acc = accounts[rand_uniform<size_t>(0, nAccounts - 1)];
+                acc->getAccount().balance++;
+                acc->storeChange(delta, db);
+            }
+            delta.commit();
+            tx.commit();
+        }
+        chrono::duration<double> updateTime =
+            chrono::steady_clock::now() - start;
+
+        LOG(INFO) << (useKV ? "key-value" : "sql") << " backend, "
+                  << nAccounts << " accounts: "
+                  << nAccounts / insertTime.count() << " inserts/s, "
+                  << nOps / loadTime.count() << " loads/s, "
+                  << nOps / updateTime.count() << " updates/s";
+    }
+}
+
+TEST_CASE("nested ledger delta bench", "[ledger][delta][bench][hide]")
+{
+    size_t const nAccounts = 2000;
+    size_t const nTxs = 1000;
+    size_t const nOpsPerTx = 3;
+    int const nLedgers = 20;
+
+    VirtualClock clock;
+    Application::pointer app = Application::create(clock, getTestConfig());
+    app->start();
+    auto& db = app->getDatabase();
+    auto& lm = app->getLedgerManager();
+
+    vector<AccountFrame> accounts;
+    for (size_t i = 0; i < nAccounts; i++)
+    {
+        accounts.emplace_back(SecretKey::random().getPublicKey());
+    }
+
+    size_t nChanges = 0;
+    auto start = chrono::steady_clock::now();
+    for (int l = 0; l < nLedgers; l++)
+    {
+        LedgerDelta ledgerDelta(lm.getCurrentLedgerHeader(), db);
+        for (size_t t = 0; t < nTxs; t++)
+        {
+            LedgerDelta txDelta(ledgerDelta);
+            for (size_t o = 0; o < nOpsPerTx; o++)
+            {
+                LedgerDelta opDelta(txDelta);
+                {
+                    // as ManageOfferOpFrame does when crossing offers
+                    LedgerDelta tempDelta(opDelta);
+                    for (int k = 0; k < 2; k++)
+                    {
+                        auto& acc =
+                            accounts[rand_uniform<size_t>(0, nAccounts - 1)];
+                        acc.getAccount().balance++;
+                        tempDelta.modEntry(acc);
+                    }
+                    tempDelta.commit();
+                }
+                nChanges += opDelta.getChanges().size();
+                opDelta.commit();
+            }
+            // one transaction in ten fails and is rolled back
+            if (t % 10 != 0)
+            {
+                txDelta.commit();
+            }
+        }
+        nChanges += ledgerDelta.getLiveEntries().size();
+        ledgerDelta.commit();
+    }
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+    LOG(INFO) << nLedgers << " ledgers of " << nTxs << " transactions: "
+              << (nLedgers * nTxs) / elapsed.count() << " transactions/s, "
+              << nChanges << " changes reported";
+}
+
+TEST_CASE("xdr encoding reuse bench", "[ledger][xdr][bench][hide]")
+{
+    using namespace txtest;
+    size_t const nAccounts = 200;
+    size_t const nTxs = 1000;
+
+    VirtualClock clock;
+    Application::pointer app = Application::create(clock, getTestConfig());
+    app->start();
+    auto const& networkID = app->getNetworkID();
+    auto& lm = app->getLedgerManager();
+
+    SecretKey root = getRoot(networkID);
+    SequenceNumber rootSeq = getAccountSeqNum(root, *app) + 1;
+    int64_t const startingBalance = lm.getMinBalance(0) + 100000000;
+
+    vector<SecretKey> accounts;
+    auto txSet = make_shared<TxSetFrame>(lm.getLastClosedLedgerHeader().hash);
+    for (size_t i = 0; i < nAccounts; i++)
+    {
+        accounts.push_back(SecretKey::random());
+        txSet->add(createCreateAccountTx(networkID, root, accounts.back(),
+                                         rootSeq++, startingBalance));
+    }
+    closeLedgerOn(*app, 2, 1, 1, 2016, txSet);
+
+    vector<SequenceNumber> seqs;
+    for (auto& a : accounts)
+    {
+        seqs.push_back(getAccountSeqNum(a, *app) + 1);
+    }
+    txSet = make_shared<TxSetFrame>(lm.getLastClosedLedgerHeader().hash);
+    for (size_t t = 0; t < nTxs; t++)
+    {
+        size_t from = t % nAccounts;
+        txSet->add(createPaymentTx(networkID, accounts[from],
+                                   accounts[(from + 1) % nAccounts],
+                                   seqs[from]++, 100));
+    }
+
+    uint64_t made = 0, reused = 0;
+    CachedXDR::flushCounts(made, reused);
+    auto start = chrono::steady_clock::now();
+    closeLedgerOn(*app, 3, 2, 1, 2016, txSet);
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    CachedXDR::flushCounts(made, reused);
+
+    LOG(INFO) << "ledger of " << nTxs << " payments closed in "
+              << elapsed.count() << "s: " << made << " encodings made, "
+              << reused << " reused";
+}
@@ -7,13 +7,24 @@
 #include "main/test.h"
 #include "main/Config.h"
 #include "lib/catch.hpp"
+#include "crypto/SecretKey.h"
 #include "database/Database.h"
+#include "ledger/AccountFrame.h"
 #include "ledger/LedgerDelta.h"
 #include "ledger/LedgerManager.h"
 #include "ledger/EntryFrame.h"
+#include "ledger/HistoryPruner.h"
+#include "ledger/LedgerHeaderFrame.h"
+#include "herder/TxSetFrame.h"
+#include "transactions/TxTests.h"
 #include "util/Logging.h"
 #include "util/types.h"
+#include "medida/meter.h"
+#include "medida/metrics_registry.h"
+#include "medida/timer.h"
+#include "xdrpp/marshal.h"
 #include <xdrpp/autocheck.h>
+#include <algorithm>
 
 using namespace stellar;
 
@@ -209,3 +220,565 @@ TEST_CASE("DB cache interaction with transactions", "[ledger][dbcache]")
 
     CHECK(balance0 == acc->getAccount().balance);
 }
+
+static int64_t
+balanceInDatabase(Database& db, AccountID const& id)
+{
+    int64_t balance = -1;
+    std::string idStr = PubKeyUtils::toStrKey(id);
+    db.getSession() << "SELECT balance FROM accounts WHERE accountid = :id",
+        soci::into(balance), soci::use(idStr);
+    return balance;
+}
+
+TEST_CASE("write-behind ledger entries", "[ledger][writebehind]")
+{
+    VirtualClock clock;
+    Application::pointer app = Application::create(clock, getTestConfig());
+    app->start();
+
+    auto& db = app->getDatabase();
+    auto& session = db.getSession();
+    auto& overlay = db.getEntryOverlay();
+    auto& updateTimer =
+        app->getMetrics().NewTimer({"database", "update", "account"});
+
+    EntryFrame::pointer le;
+    do
+    {
+        le = EntryFrame::FromXDR(validLedgerEntryGenerator(3));
+    } while (le->mEntry.data.type() != ACCOUNT);
+    auto id = le->mEntry.data.account().accountID;
+    le->mEntry.data.account().balance = 1000;
+    {
+        LedgerDelta delta(app->getLedgerManager().getCurrentLedgerHeader(),
+                          db);
+        le->storeAdd(delta, db);
+        delta.commit();
+    }
+
+    auto addBalance = [&](LedgerDelta& delta, int64_t amount)
+    {
+        auto acc = AccountFrame::loadAccount(id, db);
+        REQUIRE(acc);
+        acc->getAccount().balance += amount;
+        acc->storeChange(delta, db);
+    };
+
+    soci::transaction sqlTx(session);
+    LedgerEntryOverlay::Scope scope(overlay, true);
+    LedgerDelta ledgerDelta(app->getLedgerManager().getCurrentLedgerHeader(),
+                            db);
+    auto updates = updateTimer.count();
+
+    SECTION("stores are coalesced into one write")
+    {
+        for (int i = 0; i < 10; ++i)
+        {
+            LedgerDelta txDelta(ledgerDelta);
+            addBalance(txDelta, 1);
+            txDelta.commit();
+        }
+        CHECK(AccountFrame::loadAccount(id, db)->getBalance() == 1010);
+        CHECK(balanceInDatabase(db, id) == 1000);
+
+        {
+            // a rolled back delta leaves the overlay as it was
+            LedgerDelta txDelta(ledgerDelta);
+            addBalance(txDelta, 100);
+            CHECK(AccountFrame::loadAccount(id, db)->getBalance() == 1110);
+        }
+        CHECK(AccountFrame::loadAccount(id, db)->getBalance() == 1010);
+
+        overlay.writeOut(db);
+        CHECK(updateTimer.count() - updates == 1);
+        CHECK(balanceInDatabase(db, id) == 1010);
+    }
+
+    SECTION("rollback after a read barrier")
+    {
+        {
+            LedgerDelta txDelta(ledgerDelta);
+            addBalance(txDelta, 5);
+            txDelta.commit();
+        }
+        {
+            soci::transaction txSql(session);
+            LedgerDelta txDelta(ledgerDelta);
+            addBalance(txDelta, 100);
+            overlay.writeOut(db, ACCOUNT);
+            CHECK(balanceInDatabase(db, id) == 1105);
+            // scope end rolls back both the savepoint and the delta,
+            // undoing the barrier's write of the committed +5 as well
+        }
+        CHECK(balanceInDatabase(db, id) == 1000);
+        CHECK(AccountFrame::loadAccount(id, db)->getBalance() == 1005);
+
+        overlay.writeOut(db);
+        CHECK(balanceInDatabase(db, id) == 1005);
+    }
+
+    SECTION("entries created and deleted within the ledger are not written")
+    {
+        EntryFrame::pointer other;
+        do
+        {
+            other = EntryFrame::FromXDR(validLedgerEntryGenerator(3));
+        } while (other->mEntry.data.type() != ACCOUNT);
+
+        {
+            LedgerDelta txDelta(ledgerDelta);
+            other->storeAdd(txDelta, db);
+            txDelta.commit();
+        }
+        CHECK(EntryFrame::exists(db, other->getKey()));
+        {
+            LedgerDelta txDelta(ledgerDelta);
+            other->storeDelete(txDelta, db);
+            txDelta.commit();
+        }
+        CHECK(!EntryFrame::exists(db, other->getKey()));
+
+        auto& inserts =
+            app->getMetrics().NewTimer({"database", "insert", "account"});
+        auto insertCount = inserts.count();
+        overlay.writeOut(db);
+        overlay.end();
+        CHECK(inserts.count() == insertCount);
+        CHECK(!EntryFrame::exists(db, other->getKey()));
+    }
+}
+
+TEST_CASE("chunked history pruning", "[ledger][prune]")
+{
+    VirtualClock clock;
+    Application::pointer app = Application::create(clock, getTestConfig());
+    app->start();
+
+    auto& lm = app->getLedgerManager();
+    auto& session = app->getDatabase().getSession();
+    auto& pruner = lm.getHistoryPruner();
+    auto& chunkTimer =
+        app->getMetrics().NewTimer({"history", "prune", "chunk"});
+    auto& rowsMeter =
+        app->getMetrics().NewMeter({"history", "prune", "rows"}, "row");
+
+    // ledger 1 is already stored
+    LedgerHeader header = lm.getCurrentLedgerHeader();
+    for (uint32_t seq = 2; seq <= 300; seq++)
+    {
+        header.ledgerSeq = seq;
+        LedgerHeaderFrame(header).storeInsert(lm);
+    }
+
+    auto countHeaders = [&](uint32_t upTo)
+    {
+        int n = 0;
+        session << "SELECT COUNT(*) FROM ledgerheaders WHERE ledgerseq <= :s",
+            soci::into(n), soci::use(upTo);
+        return n;
+    };
+
+    lm.deleteOldEntries(200);
+    REQUIRE(!pruner.isIdle());
+    // nothing happens until the main loop runs
+    REQUIRE(countHeaders(200) == 200);
+
+    while (pruner.getPruned() == 0)
+    {
+        clock.crank(true);
+    }
+    REQUIRE(pruner.getPruned() == HistoryPruner::LEDGERS_PER_CHUNK);
+    REQUIRE(countHeaders(200) ==
+            200 - static_cast<int>(HistoryPruner::LEDGERS_PER_CHUNK));
+
+    while (!pruner.isIdle())
+    {
+        clock.crank(true);
+    }
+    REQUIRE(pruner.getPruned() == 200);
+    REQUIRE(countHeaders(200) == 0);
+    REQUIRE(countHeaders(300) == 100);
+    REQUIRE(chunkTimer.count() == 4);
+    REQUIRE(rowsMeter.count() == 200);
+
+    // a cursor that does not move is a no-op
+    lm.deleteOldEntries(200);
+    REQUIRE(pruner.isIdle());
+}
+
+TEST_CASE("ledger entry prefetch", "[ledger][prefetch]")
+{
+    using xdr::operator==;
+    VirtualClock clock;
+    Application::pointer app = Application::create(clock, getTestConfig());
+    app->start();
+
+    auto& db = app->getDatabase();
+    auto& prefetch = db.getEntryPrefetch();
+    auto& accountSelects =
+        app->getMetrics().NewTimer({"database", "select", "account"});
+    auto& trustSelects =
+        app->getMetrics().NewTimer({"database", "select", "trust"});
+    auto& hits =
+        app->getMetrics().NewMeter({"ledger", "prefetch", "hit"}, "entry");
+
+    // stored accounts and trustlines, then keys that are not stored
+    std::vector<LedgerKey> keys;
+    {
+        LedgerDelta delta(app->getLedgerManager().getCurrentLedgerHeader(),
+                          db);
+        while (keys.size() < 150)
+        {
+            auto le = EntryFrame::FromXDR(validLedgerEntryGenerator(5));
+            if (le->mEntry.data.type() != OFFER &&
+                !EntryFrame::exists(db, le->getKey()))
+            {
+                le->storeAdd(delta, db);
+                keys.push_back(le->getKey());
+            }
+        }
+        while (keys.size() < 160)
+        {
+            auto le = EntryFrame::FromXDR(validLedgerEntryGenerator(5));
+            if (le->mEntry.data.type() != OFFER)
+            {
+                keys.push_back(le->getKey());
+            }
+        }
+        delta.commit();
+    }
+
+    // what loading the keys one by one returns
+    db.getEntryCache().clear();
+    std::vector<EntryFrame::pointer> expected;
+    for (auto const& key : keys)
+    {
+        expected.push_back(EntryFrame::storeLoad(key, db));
+    }
+    REQUIRE(expected[0]);
+    REQUIRE(!expected.back());
+
+    db.getEntryCache().clear();
+    auto selects = accountSelects.count() + trustSelects.count();
+    auto hitCount = hits.count();
+    {
+        LedgerEntryPrefetch::Scope scope(prefetch, db, keys);
+        // a handful of IN (...) queries for all the keys
+        CHECK(accountSelects.count() + trustSelects.count() - selects <= 6);
+        selects = accountSelects.count() + trustSelects.count();
+
+        for (size_t i = 0; i < keys.size(); i++)
+        {
+            auto le = EntryFrame::storeLoad(keys[i], db);
+            REQUIRE(!!le == !!expected[i]);
+            if (le)
+            {
+                REQUIRE(le->mEntry == expected[i]->mEntry);
+            }
+        }
+        CHECK(accountSelects.count() + trustSelects.count() == selects);
+        CHECK(hits.count() - hitCount == keys.size());
+    }
+
+    // lookups are only counted during a prefetch scope
+    hitCount = hits.count();
+    EntryFrame::storeLoad(keys[0], db);
+    CHECK(hits.count() == hitCount);
+}
+
+TEST_CASE("prefetch keys of a decoded tx set", "[ledger][prefetch]")
+{
+    using xdr::operator==;
+    VirtualClock clock;
+    Application::pointer app = Application::create(clock, getTestConfig());
+    app->start();
+    auto const& networkID = app->getNetworkID();
+
+    SecretKey a = getAccount("a");
+    SecretKey b = getAccount("b");
+    SecretKey c = getAccount("c");
+    SecretKey issuer = getAccount("issuer");
+    Asset usd = makeAsset(issuer, "USD");
+    Asset xlm;
+    xlm.type(ASSET_TYPE_NATIVE);
+
+    TxSetFrame built(app->getLedgerManager().getLastClosedLedgerHeader().hash);
+    built.add(createPaymentTx(networkID, a, b, 1, 100));
+    built.add(createCreditPaymentTx(networkID, a, c, usd, 2, 100));
+    built.add(manageOfferOp(networkID, 42, a, usd, xlm, Price{1, 1}, 100, 3));
+
+    // as received from a peer or read from history: no transaction has been
+    // through checkValid or processFeeSeqNum
+    TransactionSet xdrSet;
+    built.toXDR(xdrSet);
+    TransactionSet decoded;
+    xdr::xdr_from_opaque(xdr::xdr_to_opaque(xdrSet), decoded);
+    TxSetFrame txSet(networkID, decoded);
+
+    auto keys = txSet.getPrefetchKeys();
+    auto has = [&](LedgerKey const& key)
+    {
+        return std::find(keys.begin(), keys.end(), key) != keys.end();
+    };
+
+    LedgerKey key(ACCOUNT);
+    key.account().accountID = a.getPublicKey();
+    REQUIRE(has(key));
+    key.account().accountID = b.getPublicKey();
+    REQUIRE(has(key));
+    key.account().accountID = c.getPublicKey();
+    REQUIRE(has(key));
+
+    key.type(TRUSTLINE);
+    key.trustLine().accountID = a.getPublicKey();
+    key.trustLine().asset = usd;
+    REQUIRE(has(key));
+    key.trustLine().accountID = c.getPublicKey();
+    REQUIRE(has(key));
+
+    key.type(OFFER);
+    key.offer().sellerID = a.getPublicKey();
+    key.offer().offerID = 42;
+    REQUIRE(has(key));
+
+    // each key once: a, b, c, two trustlines and the offer
+    REQUIRE(keys.size() == 6);
+}
+
+TEST_CASE("nested ledger deltas", "[ledger][delta]")
+{
+    using xdr::operator==;
+    VirtualClock clock;
+    Application::pointer app = Application::create(clock, getTestConfig());
+    app->start();
+    auto& db = app->getDatabase();
+
+    AccountFrame a(SecretKey::random().getPublicKey());
+    AccountFrame b(SecretKey::random().getPublicKey());
+    AccountFrame c(SecretKey::random().getPublicKey());
+
+    LedgerDelta ledgerDelta(app->getLedgerManager().getCurrentLedgerHeader(),
+                            db);
+    ledgerDelta.addEntry(a);
+    ledgerDelta.modEntry(b);
+
+    SECTION("changes are relative to the outer delta")
+    {
+        LedgerDelta txDelta(ledgerDelta);
+        a.getAccount().balance = 10;
+        txDelta.modEntry(a);
+        txDelta.deleteEntry(b);
+        txDelta.addEntry(c);
+        {
+            LedgerDelta opDelta(txDelta);
+            opDelta.deleteEntry(c);
+            opDelta.addEntry(b);
+
+            auto live = opDelta.getLiveEntries();
+            auto dead = opDelta.getDeadEntries();
+            REQUIRE(live.size() == 1);
+            CHECK(live[0].data.account().accountID == b.getID());
+            REQUIRE(dead.size() == 1);
+            CHECK(dead[0] == c.getKey());
+            opDelta.commit();
+        }
+
+        // c was created then removed, b removed then added back
+        auto changes = txDelta.getChanges();
+        REQUIRE(changes.size() == 2);
+        CHECK(changes[0].type() == LEDGER_ENTRY_UPDATED);
+        CHECK(changes[1].type() == LEDGER_ENTRY_UPDATED);
+        txDelta.commit();
+
+        changes = ledgerDelta.getChanges();
+        REQUIRE(changes.size() == 2);
+        REQUIRE(changes[0].type() == LEDGER_ENTRY_CREATED);
+        CHECK(changes[0].created().data.account().balance == 10);
+        CHECK(changes[1].type() == LEDGER_ENTRY_UPDATED);
+        CHECK(ledgerDelta.getDeadEntries().empty());
+    }
+
+    SECTION("rollback restores the outer delta")
+    {
+        {
+            LedgerDelta txDelta(ledgerDelta);
+            txDelta.deleteEntry(a);
+            txDelta.addEntry(c);
+            LedgerDelta opDelta(txDelta);
+            opDelta.deleteEntry(b);
+            opDelta.commit();
+        }
+
+        auto changes = ledgerDelta.getChanges();
+        REQUIRE(changes.size() == 2);
+        REQUIRE(changes[0].type() == LEDGER_ENTRY_CREATED);
+        CHECK(changes[0].created().data.account().accountID == a.getID());
+        REQUIRE(changes[1].type() == LEDGER_ENTRY_UPDATED);
+        CHECK(changes[1].updated().data.account().accountID == b.getID());
+    }
+
+    SECTION("only the innermost delta can change")
+    {
+        LedgerDelta txDelta(ledgerDelta);
+        REQUIRE_THROWS(ledgerDelta.addEntry(c));
+        REQUIRE_THROWS(ledgerDelta.commit());
+        txDelta.commit();
+        ledgerDelta.addEntry(c);
+        CHECK(ledgerDelta.getLiveEntries().size() == 3);
+    }
+}
+
+TEST_CASE("order book cache", "[ledger][orderbook]")
+{
+    using xdr::operator==;
+    VirtualClock clock;
+    Application::pointer app = Application::create(clock, getTestConfig());
+    app->start();
+
+    auto& db = app->getDatabase();
+    auto& books = db.getOrderBookCache();
+    auto& header = app->getLedgerManager().getCurrentLedgerHeader();
+    auto& offerSelects =
+        app->getMetrics().NewTimer({"database", "select", "offer"});
+    auto& hits =
+        app->getMetrics().NewMeter({"ledger", "order-book", "hit"}, "query");
+
+    SecretKey seller = getAccount("seller");
+    SecretKey issuer = getAccount("issuer");
+    Asset selling;
+    selling.type(ASSET_TYPE_NATIVE);
+    Asset buying = txtest::makeAsset(issuer, "USD");
+
+    std::vector<OfferFrame::pointer> offers;
+    for (int i = 0; i < 40; i++)
+    {
+        auto offer = std::make_shared<OfferFrame>();
+        auto& oe = offer->getOffer();
+        oe.sellerID = seller.getPublicKey();
+        oe.offerID = i + 1;
+        oe.selling = selling;
+        oe.buying = buying;
+        oe.amount = 1000;
+        oe.price = Price{i % 7 + 1, 3};
+        offers.push_back(offer);
+    }
+    {
+        LedgerDelta delta(header, db);
+        for (auto& offer : offers)
+        {
+            offer->storeAdd(delta, db);
+        }
+        delta.commit();
+    }
+
+    // the book, page by page the way OfferExchange reads it
+    auto readBook = [&](size_t maxPages) -> std::vector<OfferEntry>
+    {
+        std::vector<OfferEntry> res;
+        for (size_t page = 0; page < maxPages; page++)
+        {
+            std::vector<OfferFrame::pointer> ret;
+            OfferFrame::loadBestOffers(5, res.size(), selling, buying, ret,
+                                       db);
+            for (auto const& offer : ret)
+            {
+                res.push_back(offer->getOffer());
+            }
+            if (ret.size() < 5)
+            {
+                break;
+            }
+        }
+        return res;
+    };
+    auto checkSame = [](std::vector<OfferEntry> const& a,
+                        std::vector<OfferEntry> const& b)
+    {
+        REQUIRE(a.size() == b.size());
+        for (size_t i = 0; i < a.size(); i++)
+        {
+            REQUIRE(a[i] == b[i]);
+        }
+    };
+
+    auto expected = readBook(100);
+    REQUIRE(expected.size() == offers.size());
+
+    SECTION("pages are served from the cache")
+    {
+        OrderBookCache::Scope scope(books);
+        checkSame(readBook(100), expected);
+        auto selects = offerSelects.count();
+        auto hitCount = hits.count();
+        checkSame(readBook(100), expected);
+        REQUIRE(offerSelects.count() == selects);
+        REQUIRE(hits.count() - hitCount == 9);
+    }
+
+    SECTION("offer changes update the cached books")
+    {
+        std::vector<OfferEntry> cached;
+        {
+            OrderBookCache::Scope scope(books);
+            // only part of the book is loaded
+            readBook(1);
+            LedgerDelta delta(header, db);
+
+            // crossed in part
+            auto top = OfferFrame::loadOffer(seller.getPublicKey(),
+                                             expected[0].offerID, db);
+            top->getOffer().amount = 10;
+            top->storeChange(delta, db);
+            // taken
+            auto second = OfferFrame::loadOffer(seller.getPublicKey(),
+                                                expected[1].offerID, db);
+            second->storeDelete(delta, db);
+            // from the end of the book to the top, and the other way
+            auto last = OfferFrame::loadOffer(seller.getPublicKey(),
+                                              expected.back().offerID, db);
+            last->getOffer().price = Price{1, 100};
+            last->storeChange(delta, db);
+            auto third = OfferFrame::loadOffer(seller.getPublicKey(),
+                                               expected[2].offerID, db);
+            third->getOffer().price = Price{100, 1};
+            third->storeChange(delta, db);
+            // a new offer in the middle of the book
+            auto added = std::make_shared<OfferFrame>(offers[0]->mEntry);
+            added->getOffer().offerID = 1000;
+            added->getOffer().price = Price{4, 3};
+            added->storeAdd(delta, db);
+            delta.commit();
+
+            cached = readBook(100);
+        }
+        checkSame(cached, readBook(100));
+        REQUIRE(cached.front().offerID == expected.back().offerID);
+    }
+
+    SECTION("rolled back offer changes drop the cached books")
+    {
+        std::vector<OfferEntry> cached;
+        {
+            OrderBookCache::Scope scope(books);
+            LedgerDelta delta(header, db);
+            readBook(1);
+            {
+                soci::transaction sqlTx(db.getSession());
+                LedgerDelta nested(delta);
+                auto top = OfferFrame::loadOffer(seller.getPublicKey(),
+                                                 expected[0].offerID, db);
+                top->storeDelete(nested, db);
+                auto next = OfferFrame::loadOffer(seller.getPublicKey(),
+                                                  expected[5].offerID, db);
+                next->getOffer().price = Price{1, 100};
+                next->storeChange(nested, db);
+                nested.rollback();
+            }
+            delta.commit();
+            cached = readBook(100);
+        }
+        checkSame(cached, expected);
+        checkSame(readBook(100), expected);
+    }
+}
@@ -5,6 +5,7 @@
 #include "ledger/OfferFrame.h"
 #include "transactions/ManageOfferOpFrame.h"
 #include "database/Database.h"
+#include "database/ReadSnapshot.h"
 #include "crypto/SecretKey.h"
 #include "crypto/SHA.h"
 #include "LedgerDelta.h"
@@ -70,6 +71,7 @@ OfferFrame& OfferFrame::operator=(OfferFrame const& other)
         mOffer = other.mOffer;
         mKey = other.mKey;
         mKeyCalculated = other.mKeyCalculated;
+        mCacheKey = other.mCacheKey;
     }
     return *this;
 }
@@ -127,8 +129,10 @@ OfferFrame::isValid() const
     return isValid(mOffer);
 }
 
+template <typename Source>
 OfferFrame::pointer
-OfferFrame::loadOffer(AccountID const& sellerID, uint64_t offerID, Database& db)
+OfferFrame::loadOfferFrom(AccountID const& sellerID, uint64_t offerID,
+                          Source& source)
 {
     OfferFrame::pointer retOffer;
 
@@ -136,12 +140,12 @@ OfferFrame::loadOffer(AccountID const& sellerID, uint64_t offerID, Database& db)
 
     std::string sql = offerColumnSelector;
     sql += " WHERE sellerid = :id AND offerid = :offerid";
-    auto prep = db.getPreparedStatement(sql);
+    auto prep = source.getPreparedStatement(sql);
     auto& st = prep.statement();
     st.exchange(use(actIDStrKey));
     st.exchange(use(offerID));
 
-    auto timer = db.getSelectTimer("offer");
+    auto timer = source.getSelectTimer("offer");
     loadOffers(prep, [&retOffer](LedgerEntry const& offer)
                {
                    retOffer = make_shared<OfferFrame>(offer);
@@ -150,6 +154,19 @@ OfferFrame::loadOffer(AccountID const& sellerID, uint64_t offerID, Database& db)
     return retOffer;
 }
 
+OfferFrame::pointer
+OfferFrame::loadOffer(AccountID const& sellerID, uint64_t offerID, Database& db)
+{
+    return loadOfferFrom(sellerID, offerID, db);
+}
+
+OfferFrame::pointer
+OfferFrame::loadOffer(AccountID const& sellerID, uint64_t offerID,
+                      ReadSnapshot& snapshot)
+{
+    return loadOfferFrom(sellerID, offerID, snapshot);
+}
+
 void
 OfferFrame::loadOffers(StatementContext& prep,
                        std::function<void(LedgerEntry const&)> offerProcessor)
@@ -249,10 +266,12 @@ OfferFrame::loadOffers(StatementContext& prep,
     }
 }
 
+template <typename Source>
 void
-OfferFrame::loadBestOffers(size_t numOffers, size_t offset,
-                           Asset const& selling, Asset const& buying,
-                           vector<OfferFrame::pointer>& retOffers, Database& db)
+OfferFrame::loadBestOffersFrom(size_t numOffers, size_t offset,
+                               Asset const& selling, Asset const& buying,
+                               vector<OfferFrame::pointer>& retOffers,
+                               Source& source)
 {
     std::string sql = offerColumnSelector;
 
@@ -320,7 +339,7 @@ OfferFrame::loadBestOffers(size_t numOffers, size_t offset,
     // ordering by offerid gives precendence to older offers for fairness
     sql += " ORDER BY price, offerid LIMIT :n OFFSET :o";
 
-    auto prep = db.getPreparedStatement(sql);
+    auto prep = source.getPreparedStatement(sql);
     auto& st = prep.statement();
 
     if (useSellingAsset)
@@ -338,13 +357,36 @@ OfferFrame::loadBestOffers(size_t numOffers, size_t offset,
     st.exchange(use(numOffers));
     st.exchange(use(offset));
 
-    auto timer = db.getSelectTimer("offer");
+    auto timer = source.getSelectTimer("offer");
     loadOffers(prep, [&retOffers](LedgerEntry const& of)
                {
                    retOffers.emplace_back(make_shared<OfferFrame>(of));
                });
 }
 
+void
+OfferFrame::loadBestOffers(size_t numOffers, size_t offset,
+                           Asset const& selling, Asset const& buying,
+                           vector<OfferFrame::pointer>& retOffers, Database& db)
+{
+    db.getOrderBookCache().loadBestOffers(
+        numOffers, offset, selling, buying, retOffers,
+        [&](size_t n, size_t o, vector<OfferFrame::pointer>& ret)
+        {
+            loadBestOffersFrom(n, o, selling, buying, ret, db);
+        });
+}
+
+void
+OfferFrame::loadBestOffers(size_t numOffers, size_t offset,
+                           Asset const& selling, Asset const& buying,
+                           vector<OfferFrame::pointer>& retOffers,
+                           ReadSnapshot& snapshot)
+{
+    loadBestOffersFrom(numOffers, offset, selling, buying, retOffers,
+                       snapshot);
+}
+
 void
 OfferFrame::loadOffers(AccountID const& accountID,
                        std::vector<OfferFrame::pointer>& retOffers,
@@ -407,6 +449,7 @@ OfferFrame::storeDelete(LedgerDelta& delta, Database& db, LedgerKey const& key)
     st.exchange(use(key.offer().offerID));
     st.define_and_bind();
     st.execute(true);
+    db.getOrderBookCache().deleteOffer(key.offer().offerID);
     delta.deleteEntry(key);
 }
 
@@ -526,6 +569,7 @@ OfferFrame::storeUpdateHelper(LedgerDelta& delta, Database& db, bool insert)
     {
         throw std::runtime_error("could not update SQL");
     }
+    db.getOrderBookCache().storeOffer(mEntry);
 
     if (insert)
     {
@@ -23,6 +23,17 @@ class OfferFrame : public EntryFrame
     loadOffers(StatementContext& prep,
                std::function<void(LedgerEntry const&)> offerProcessor);
 
+    // shared by the Database and ReadSnapshot versions of the loaders
+    template <typename Source>
+    static std::shared_ptr<OfferFrame>
+    loadOfferFrom(AccountID const& sellerID, uint64_t offerID, Source& source);
+    template <typename Source>
+    static void
+    loadBestOffersFrom(size_t numOffers, size_t offset, Asset const& selling,
+                       Asset const& buying,
+                       std::vector<std::shared_ptr<OfferFrame>>& retOffers,
+                       Source& source);
+
     double computePrice() const;
 
     OfferEntry& mOffer;
@@ -86,11 +97,17 @@ class OfferFrame : public EntryFrame
     // database utilities
     static pointer loadOffer(AccountID const& accountID, uint64_t offerID,
                              Database& db);
+    static pointer loadOffer(AccountID const& accountID, uint64_t offerID,
+                             ReadSnapshot& snapshot);
 
     static void loadBestOffers(size_t numOffers, size_t offset,
                                Asset const& pays, Asset const& gets,
                                std::vector<OfferFrame::pointer>& retOffers,
                                Database& db);
+    static void loadBestOffers(size_t numOffers, size_t offset,
+                               Asset const& pays, Asset const& gets,
+                               std::vector<OfferFrame::pointer>& retOffers,
+                               ReadSnapshot& snapshot);
 
     static void loadOffers(AccountID const& accountID,
                            std::vector<OfferFrame::pointer>& retOffers,
@@ -0,0 +1,583 @@
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "database/Database.h"
+#include "database/SQLProfiler.h"
+#include "herder/LedgerCloseData.h"
+#include "herder/TxSetFrame.h"
+#include "ledger/LedgerHeaderFrame.h"
+#include "ledger/LedgerManager.h"
+#include "lib/catch.hpp"
+#include "lib/json/json.h"
+#include "main/Application.h"
+#include "main/Config.h"
+#include "main/test.h"
+#include "transactions/TransactionFrame.h"
+#include "transactions/TxTests.h"
+#include "util/AllocationCounter.h"
+#include "util/Logging.h"
+#include "util/Timer.h"
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+
+using namespace stellar;
+using namespace stellar::txtest;
+
+/*
+  Cost of applying each kind of operation.
+
+  Each benchmark builds the same ledger state from named accounts on every
+  run, then closes ledgers of one kind of operation, one per transaction,
+  through LedgerManager::closeLedger. It reports the operations applied per
+  second of ledger close, the SQL statements per operation that the
+  SQLProfiler counts (prepared statements, including the ledger close's own
+  share) and, in builds configured with --enable-alloc-counting, the heap
+  allocations per operation.
+
+  Results are logged and, when STELLAR_BENCH_JSON names a file, written to it
+  as a JSON array, to track regressions from build to build.
+*/
+
+namespace
+{
+
+size_t const NUM_ACCOUNTS = 1000;
+size_t const TXS_PER_LEDGER = 500;
+size_t const NUM_LEDGERS = 10;
+size_t const MAX_SETUP_TXS = 1000;
+int64_t const ACCOUNT_BALANCE = 1000000000000;
+
+struct Account
+{
+    SecretKey mKey;
+    // last sequence number used
+    SequenceNumber mSeq;
+};
+
+struct BenchResult
+{
+    std::string mOperation;
+    Json::Value mParams;
+    size_t mOps{0};
+    double mSeconds{0};
+    uint64_t mStatements{0};
+    uint64_t mAllocations{0};
+};
+
+std::vector<BenchResult> gResults;
+
+Json::Value
+toJson(BenchResult const& r)
+{
+    double ops = static_cast<double>(r.mOps);
+    Json::Value res;
+    res["operation"] = r.mOperation;
+    res["params"] = r.mParams;
+    res["ops"] = static_cast<Json::UInt64>(r.mOps);
+    res["seconds"] = r.mSeconds;
+    res["opsPerSecond"] = ops / r.mSeconds;
+    res["sqlStatementsPerOp"] = r.mStatements / ops;
+    if (AllocationCounter::isEnabled())
+    {
+        res["allocationsPerOp"] = r.mAllocations / ops;
+    }
+    else
+    {
+        res["allocationsPerOp"] = Json::Value();
+    }
+    return res;
+}
+
+void
+reportResult(BenchResult const& r)
+{
+    gResults.push_back(r);
+
+    auto json = toJson(r);
+    std::string name = r.mOperation;
+    for (auto const& p : r.mParams.getMemberNames())
+    {
+        name += " " + p + "=" + r.mParams[p].asString();
+    }
+    LOG(INFO) << name << ": " << json["opsPerSecond"].asDouble()
+              << " ops/s, " << json["sqlStatementsPerOp"].asDouble()
+              << " SQL statements/op"
+              << (AllocationCounter::isEnabled()
+                      ? ", " + std::to_string(json["allocationsPerOp"]
+                                                  .asDouble()) +
+                            " allocations/op"
+                      : "");
+
+    if (char const* path = std::getenv("STELLAR_BENCH_JSON"))
+    {
+        Json::Value all(Json::arrayValue);
+        for (auto const& res : gResults)
+        {
+            all.append(toJson(res));
+        }
+        std::ofstream out(path);
+        out << all.toStyledString();
+    }
+}
+
+class OperationBench
+{
+    VirtualClock mClock;
+    Application::pointer mApp;
+    Account mRoot;
+    time_t mCloseTime;
+
+    struct Sample
+    {
+        double mSeconds;
+        uint64_t mStatements;
+        uint64_t mAllocations;
+    };
+
+    // close a ledger of `txs`, which must all succeed
+    Sample
+    closeLedger(std::vector<TransactionFramePtr> const& txs)
+    {
+        auto& lm = mApp->getLedgerManager();
+        auto& db = mApp->getDatabase();
+        auto txSet =
+            std::make_shared<TxSetFrame>(lm.getLastClosedLedgerHeader().hash);
+        for (auto const& tx : txs)
+        {
+            txSet->add(tx);
+        }
+        txSet->sortForHash();
+
+        uint32 ledgerSeq = lm.getLedgerNum();
+        StellarValue sv(txSet->getContentsHash(), ++mCloseTime,
+                        emptyUpgradeSteps, 0);
+        LedgerCloseData ledgerData(ledgerSeq, txSet, sv);
+
+        Sample res;
+        uint64_t allocations = AllocationCounter::getCount();
+        auto start = std::chrono::steady_clock::now();
+        lm.closeLedger(ledgerData);
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+        res.mSeconds = elapsed.count();
+        res.mAllocations = AllocationCounter::getCount() - allocations;
+        res.mStatements = 0;
+        for (auto const& s : db.getSQLProfiler().getLastLedger())
+        {
+            res.mStatements += s.second.mCalls;
+        }
+
+        auto results =
+            TransactionFrame::getTransactionHistoryMeta(db, ledgerSeq).results;
+        REQUIRE(results.size() == txs.size());
+        for (auto const& r : results)
+        {
+            REQUIRE(r.result.result.code() == txSUCCESS);
+        }
+        return res;
+    }
+
+  public:
+    OperationBench()
+    {
+        Config cfg(getTestConfig());
+        cfg.SQL_PROFILING = true;
+        mApp = Application::create(mClock, cfg);
+        mApp->start();
+        mRoot.mKey = getRoot(mApp->getNetworkID());
+        mRoot.mSeq = getAccountSeqNum(mRoot.mKey, *mApp);
+        mCloseTime = getTestDate(1, 1, 2016);
+    }
+
+    Application&
+    app()
+    {
+        return *mApp;
+    }
+
+    Hash const&
+    networkID()
+    {
+        return mApp->getNetworkID();
+    }
+
+    Account&
+    root()
+    {
+        return mRoot;
+    }
+
+    // Apply `txs`, which must all succeed, in as many ledgers as needed.
+    void
+    setup(std::vector<TransactionFramePtr> const& txs)
+    {
+        for (size_t i = 0; i < txs.size(); i += MAX_SETUP_TXS)
+        {
+            auto end = std::min(txs.size(), i + MAX_SETUP_TXS);
+            closeLedger(std::vector<TransactionFramePtr>(txs.begin() + i,
+                                                         txs.begin() + end));
+        }
+    }
+
+    // Accounts `prefix`-0 to `prefix`-(n-1), funded by the root account.
+    std::vector<Account>
+    createAccounts(std::string const& prefix, size_t n, int64_t balance)
+    {
+        std::vector<Account> res;
+        auto& lm = mApp->getLedgerManager();
+        for (size_t i = 0; i < n; i += MAX_SETUP_TXS)
+        {
+            SequenceNumber seq =
+                LedgerHeaderFrame(lm.getCurrentLedgerHeader())
+                    .getStartingSequenceNumber();
+            std::vector<TransactionFramePtr> txs;
+            for (size_t j = i; j < std::min(n, i + MAX_SETUP_TXS); j++)
+            {
+                auto name = prefix + "-" + std::to_string(j);
+                res.push_back(Account{getAccount(name.c_str()), seq});
+                txs.push_back(createCreateAccountTx(networkID(), mRoot.mKey,
+                                                    res.back().mKey,
+                                                    ++mRoot.mSeq, balance));
+            }
+            closeLedger(txs);
+        }
+        return res;
+    }
+
+    // Close NUM_LEDGERS ledgers of `txsPerLedger` transactions, the n-th
+    // made by makeTx(n), and report what their close cost.
+    void
+    measure(std::string const& operation, Json::Value const& params,
+            size_t txsPerLedger,
+            std::function<TransactionFramePtr(size_t n)> const& makeTx)
+    {
+        BenchResult res;
+        res.mOperation = operation;
+        res.mParams = params;
+        for (size_t l = 0; l < NUM_LEDGERS; l++)
+        {
+            std::vector<TransactionFramePtr> txs;
+            for (size_t i = 0; i < txsPerLedger; i++)
+            {
+                txs.push_back(makeTx(l * txsPerLedger + i));
+            }
+            auto sample = closeLedger(txs);
+            for (auto const& tx : txs)
+            {
+                res.mOps += tx->getEnvelope().tx.operations.size();
+            }
+            res.mSeconds += sample.mSeconds;
+            res.mStatements += sample.mStatements;
+            res.mAllocations += sample.mAllocations;
+        }
+        reportResult(res);
+    }
+};
+
+Json::Value
+noParams()
+{
+    return Json::Value(Json::objectValue);
+}
+}
+
+TEST_CASE("payment apply bench", "[performance][ops][hide]")
+{
+    OperationBench bench;
+    auto accounts =
+        bench.createAccounts("pay", NUM_ACCOUNTS, ACCOUNT_BALANCE);
+
+    bench.measure("Payment", noParams(), TXS_PER_LEDGER,
+                  [&](size_t n) -> TransactionFramePtr
+                  {
+                      auto& from = accounts[n % NUM_ACCOUNTS];
+                      auto& to = accounts[(n + 1) % NUM_ACCOUNTS];
+                      return createPaymentTx(bench.networkID(), from.mKey,
+                                             to.mKey, ++from.mSeq, 1000);
+                  });
+}
+
+TEST_CASE("path payment apply bench", "[performance][ops][hide]")
+{
+    size_t const maxHops = 5;
+    int64_t const issued = 1000000000000000;
+
+    OperationBench bench;
+    auto const& networkID = bench.networkID();
+    auto issuer = bench.createAccounts("pp-issuer", 1, ACCOUNT_BALANCE)[0];
+    auto makers = bench.createAccounts("pp-maker", maxHops, ACCOUNT_BALANCE);
+    auto dests = bench.createAccounts("pp-dest", 10, ACCOUNT_BALANCE);
+    auto accounts = bench.createAccounts("pp", NUM_ACCOUNTS, ACCOUNT_BALANCE);
+
+    // assets[0] is native, maker j sells assets[j + 1] for assets[j]
+    std::vector<Asset> assets(1);
+    assets[0].type(ASSET_TYPE_NATIVE);
+    for (size_t j = 1; j <= maxHops; j++)
+    {
+        assets.push_back(makeAsset(issuer.mKey, "C" + std::to_string(j)));
+    }
+
+    std::vector<TransactionFramePtr> txs;
+    for (size_t j = 0; j < maxHops; j++)
+    {
+        auto& maker = makers[j];
+        for (size_t a = std::max<size_t>(j, 1); a <= j + 1; a++)
+        {
+            txs.push_back(createChangeTrust(
+                networkID, maker.mKey, issuer.mKey, ++maker.mSeq,
+                "C" + std::to_string(a), INT64_MAX));
+        }
+    }
+    for (auto& dest : dests)
+    {
+        for (size_t a = 1; a <= maxHops; a++)
+        {
+            txs.push_back(createChangeTrust(networkID, dest.mKey, issuer.mKey,
+                                            ++dest.mSeq,
+                                            "C" + std::to_string(a),
+                                            INT64_MAX));
+        }
+    }
+    bench.setup(txs);
+
+    txs.clear();
+    for (size_t j = 0; j < maxHops; j++)
+    {
+        txs.push_back(createCreditPaymentTx(networkID, issuer.mKey,
+                                            makers[j].mKey, assets[j + 1],
+                                            ++issuer.mSeq, issued));
+    }
+    bench.setup(txs);
+
+    txs.clear();
+    Price const oneone(1, 1);
+    for (size_t j = 0; j < maxHops; j++)
+    {
+        auto& maker = makers[j];
+        txs.push_back(manageOfferOp(networkID, 0, maker.mKey, assets[j + 1],
+                                    assets[j], oneone, issued, ++maker.mSeq));
+    }
+    bench.setup(txs);
+
+    for (size_t hops = 1; hops <= maxHops; hops++)
+    {
+        std::vector<Asset> path(assets.begin() + 1, assets.begin() + hops);
+        Json::Value params;
+        params["hops"] = static_cast<Json::UInt>(hops);
+        bench.measure("PathPayment", params, TXS_PER_LEDGER,
+                      [&](size_t n) -> TransactionFramePtr
+                      {
+                          auto& from = accounts[n % NUM_ACCOUNTS];
+                          auto& to = dests[n % dests.size()];
+                          return createPathPaymentTx(
+                              networkID, from.mKey, to.mKey, assets[0], 1000,
+                              assets[hops], 100, ++from.mSeq, &path);
+                      });
+    }
+}
+
+TEST_CASE("manage offer apply bench", "[performance][ops][hide]")
+{
+    // each taker crosses and takes `crossed` offers of OFFER_AMOUNT
+    size_t const txsPerLedger = 100;
+    size_t const numMakers = 20;
+    int64_t const offerAmount = 100;
+
+    OperationBench bench;
+    auto const& networkID = bench.networkID();
+    auto issuer = bench.createAccounts("mo-issuer", 1, ACCOUNT_BALANCE)[0];
+    auto makers = bench.createAccounts("mo-maker", numMakers, ACCOUNT_BALANCE);
+    auto takers = bench.createAccounts("mo", NUM_ACCOUNTS, ACCOUNT_BALANCE);
+
+    Asset xlm;
+    xlm.type(ASSET_TYPE_NATIVE);
+    Asset asset = makeAsset(issuer.mKey, "A");
+    Price const oneone(1, 1);
+
+    std::vector<TransactionFramePtr> txs;
+    for (auto& acc : makers)
+    {
+        txs.push_back(createChangeTrust(networkID, acc.mKey, issuer.mKey,
+                                        ++acc.mSeq, "A", INT64_MAX));
+    }
+    for (auto& acc : takers)
+    {
+        txs.push_back(createChangeTrust(networkID, acc.mKey, issuer.mKey,
+                                        ++acc.mSeq, "A", INT64_MAX));
+    }
+    bench.setup(txs);
+
+    txs.clear();
+    for (auto& maker : makers)
+    {
+        txs.push_back(createCreditPaymentTx(networkID, issuer.mKey,
+                                            maker.mKey, asset, ++issuer.mSeq,
+                                            ACCOUNT_BALANCE));
+    }
+    bench.setup(txs);
+
+    size_t taker = 0;
+    for (size_t crossed : {1, 5, 10})
+    {
+        txs.clear();
+        for (size_t i = 0; i < crossed * txsPerLedger * NUM_LEDGERS; i++)
+        {
+            auto& maker = makers[i % numMakers];
+            txs.push_back(manageOfferOp(networkID, 0, maker.mKey, asset, xlm,
+                                        oneone, offerAmount, ++maker.mSeq));
+        }
+        bench.setup(txs);
+
+        Json::Value params;
+        params["crossed"] = static_cast<Json::UInt>(crossed);
+        bench.measure("ManageOffer", params, txsPerLedger,
+                      [&](size_t) -> TransactionFramePtr
+                      {
+                          auto& acc = takers[taker++ % NUM_ACCOUNTS];
+                          return manageOfferOp(networkID, 0, acc.mKey, xlm,
+                                               asset, oneone,
+                                               crossed * offerAmount,
+                                               ++acc.mSeq);
+                      });
+    }
+}
+
+TEST_CASE("create account apply bench", "[performance][ops][hide]")
+{
+    OperationBench bench;
+    auto accounts =
+        bench.createAccounts("ca", NUM_ACCOUNTS, ACCOUNT_BALANCE);
+    int64_t const balance =
+        bench.app().getLedgerManager().getMinBalance(0) + 1000000;
+
+    bench.measure("CreateAccount", noParams(), TXS_PER_LEDGER,
+                  [&](size_t n) -> TransactionFramePtr
+                  {
+                      auto& from = accounts[n % NUM_ACCOUNTS];
+                      auto name = "ca-new-" + std::to_string(n);
+                      SecretKey to = getAccount(name.c_str());
+                      return createCreateAccountTx(bench.networkID(),
+                                                   from.mKey, to, ++from.mSeq,
+                                                   balance);
+                  });
+}
+
+TEST_CASE("change trust apply bench", "[performance][ops][hide]")
+{
+    OperationBench bench;
+    auto issuer = bench.createAccounts("ct-issuer", 1, ACCOUNT_BALANCE)[0];
+    auto accounts =
+        bench.createAccounts("ct", NUM_ACCOUNTS, ACCOUNT_BALANCE);
+
+    // a new asset each ledger, so that every operation adds a trust line
+    bench.measure("ChangeTrust", noParams(), TXS_PER_LEDGER,
+                  [&](size_t n) -> TransactionFramePtr
+                  {
+                      auto& acc = accounts[n % NUM_ACCOUNTS];
+                      auto code = "T" + std::to_string(n / TXS_PER_LEDGER);
+                      return createChangeTrust(bench.networkID(), acc.mKey,
+                                               issuer.mKey, ++acc.mSeq, code,
+                                               INT64_MAX);
+                  });
+}
+
+TEST_CASE("set options apply bench", "[performance][ops][hide]")
+{
+    // each operation adds a signer to an account that already has `signers`
+    // or more
+    for (size_t signers : {0, 10})
+    {
+        OperationBench bench;
+        auto const& networkID = bench.networkID();
+        auto accounts =
+            bench.createAccounts("so", NUM_ACCOUNTS, ACCOUNT_BALANCE);
+        auto signer = [](size_t k) -> Signer
+        {
+            auto name = "so-signer-" + std::to_string(k);
+            return Signer(getAccount(name.c_str()).getPublicKey(), 1);
+        };
+
+        std::vector<TransactionFramePtr> txs;
+        for (auto& acc : accounts)
+        {
+            for (size_t k = 0; k < signers; k++)
+            {
+                auto sk = signer(k);
+                txs.push_back(createSetOptions(networkID, acc.mKey,
+                                               ++acc.mSeq, nullptr, nullptr,
+                                               nullptr, nullptr, &sk));
+            }
+        }
+        bench.setup(txs);
+
+        Json::Value params;
+        params["signers"] = static_cast<Json::UInt>(signers);
+        bench.measure("SetOptions", params, TXS_PER_LEDGER,
+                      [&](size_t n) -> TransactionFramePtr
+                      {
+                          auto& acc = accounts[n % NUM_ACCOUNTS];
+                          auto sk = signer(signers + n / NUM_ACCOUNTS);
+                          return createSetOptions(networkID, acc.mKey,
+                                                  ++acc.mSeq, nullptr, nullptr,
+                                                  nullptr, nullptr, &sk);
+                      });
+    }
+}
+
+TEST_CASE("account merge apply bench", "[performance][ops][hide]")
+{
+    OperationBench bench;
+    auto accounts =
+        bench.createAccounts("am", NUM_ACCOUNTS, ACCOUNT_BALANCE);
+    auto merged =
+        bench.createAccounts("am-merged", TXS_PER_LEDGER * NUM_LEDGERS,
+                             bench.app().getLedgerManager().getMinBalance(0) +
+                                 1000000);
+
+    bench.measure("AccountMerge", noParams(), TXS_PER_LEDGER,
+                  [&](size_t n) -> TransactionFramePtr
+                  {
+                      auto& from = merged[n];
+                      auto& to = accounts[n % NUM_ACCOUNTS];
+                      return createAccountMerge(bench.networkID(), from.mKey,
+                                                to.mKey, ++from.mSeq);
+                  });
+}
+
+TEST_CASE("inflation apply bench", "[performance][ops][hide]")
+{
+    size_t const numWinners = 10;
+
+    OperationBench bench;
+    auto const& networkID = bench.networkID();
+    auto accounts =
+        bench.createAccounts("inf", NUM_ACCOUNTS, ACCOUNT_BALANCE);
+
+    // every account votes, and the root account's votes make a winner
+    std::vector<TransactionFramePtr> txs;
+    for (size_t i = 0; i < NUM_ACCOUNTS; i++)
+    {
+        auto& acc = accounts[i];
+        AccountID dest = accounts[i % numWinners].mKey.getPublicKey();
+        txs.push_back(createSetOptions(networkID, acc.mKey, ++acc.mSeq, &dest,
+                                       nullptr, nullptr, nullptr, nullptr));
+    }
+    auto& root = bench.root();
+    AccountID rootDest = accounts[0].mKey.getPublicKey();
+    txs.push_back(createSetOptions(networkID, root.mKey, ++root.mSeq,
+                                   &rootDest, nullptr, nullptr, nullptr,
+                                   nullptr));
+    bench.setup(txs);
+
+    // the ledgers close weeks after the inflation start time, so inflation
+    // runs in every one of them
+    bench.measure("Inflation", noParams(), 1,
+                  [&](size_t n) -> TransactionFramePtr
+                  {
+                      auto& acc = accounts[n % NUM_ACCOUNTS];
+                      return createInflation(networkID, acc.mKey, ++acc.mSeq);
+                  });
+}
@@ -0,0 +1,218 @@
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "ledger/OrderBookCache.h"
+#include "util/Logging.h"
+#include "xdrpp/marshal.h"
+#include <algorithm>
+
+#include "medida/meter.h"
+#include "medida/metrics_registry.h"
+
+namespace stellar
+{
+
+size_t const OrderBookCache::MIN_LOAD = 20;
+
+namespace
+{
+// the order of OfferFrame::loadBestOffers: by the price column, which holds
+// n/d as a double, then by offer id
+bool
+offerBefore(LedgerEntry const& a, LedgerEntry const& b)
+{
+    auto const& oa = a.data.offer();
+    auto const& ob = b.data.offer();
+    double pa = double(oa.price.n) / double(oa.price.d);
+    double pb = double(ob.price.n) / double(ob.price.d);
+    if (pa != pb)
+    {
+        return pa < pb;
+    }
+    return oa.offerID < ob.offerID;
+}
+}
+
+OrderBookCache::OrderBookCache(medida::MetricsRegistry& metrics)
+    : mHitMeter(metrics.NewMeter({"ledger", "order-book", "hit"}, "query"))
+    , mMissMeter(metrics.NewMeter({"ledger", "order-book", "miss"}, "query"))
+    , mLoadMeter(metrics.NewMeter({"ledger", "order-book", "load"}, "offer"))
+{
+}
+
+std::string
+OrderBookCache::bookKey(Asset const& selling, Asset const& buying)
+{
+    auto bytes = xdr::xdr_to_opaque(selling, buying);
+    return std::string(bytes.begin(), bytes.end());
+}
+
+void
+OrderBookCache::noteBook(uint64 offerID, std::string const& key)
+{
+    auto& books = mOfferBooks[offerID];
+    if (std::find(books.begin(), books.end(), key) == books.end())
+    {
+        books.push_back(key);
+    }
+}
+
+void
+OrderBookCache::clear()
+{
+    mBooks.clear();
+    mOfferBooks.clear();
+    mHits = 0;
+    mMisses = 0;
+}
+
+void
+OrderBookCache::loadBestOffers(size_t numOffers, size_t offset,
+                               Asset const& selling, Asset const& buying,
+                               std::vector<OfferFrame::pointer>& retOffers,
+                               Loader const& load)
+{
+    if (!mActive)
+    {
+        load(numOffers, offset, retOffers);
+        return;
+    }
+
+    auto key = bookKey(selling, buying);
+    auto& book = mBooks[key];
+    size_t end = offset + numOffers;
+    if (book.mOffers.size() >= end || book.mComplete)
+    {
+        mHits++;
+        mHitMeter.Mark();
+    }
+    else
+    {
+        mMisses++;
+        mMissMeter.Mark();
+        size_t have = book.mOffers.size();
+        if (offset > have)
+        {
+            // the prefix cannot be extended up to this page
+            load(numOffers, offset, retOffers);
+            return;
+        }
+
+        size_t want = std::max(end - have, MIN_LOAD);
+        std::vector<OfferFrame::pointer> loaded;
+        load(want, have, loaded);
+        mLoadMeter.Mark(loaded.size());
+        for (auto const& offer : loaded)
+        {
+            noteBook(offer->getOfferID(), key);
+            book.mOffers.emplace_back(offer->mEntry);
+        }
+        book.mComplete = loaded.size() < want;
+    }
+
+    for (size_t i = offset; i < end && i < book.mOffers.size(); i++)
+    {
+        retOffers.emplace_back(std::make_shared<OfferFrame>(book.mOffers[i]));
+    }
+}
+
+void
+OrderBookCache::removeOffer(uint64 offerID)
+{
+    auto it = mOfferBooks.find(offerID);
+    if (it == mOfferBooks.end())
+    {
+        return;
+    }
+    for (auto const& key : it->second)
+    {
+        auto book = mBooks.find(key);
+        if (book == mBooks.end())
+        {
+            continue;
+        }
+        // the offers that remain are still the best ones of the book
+        auto& offers = book->second.mOffers;
+        offers.erase(std::remove_if(offers.begin(), offers.end(),
+                                    [offerID](LedgerEntry const& le)
+                                    {
+                                        return le.data.offer().offerID ==
+                                               offerID;
+                                    }),
+                     offers.end());
+    }
+}
+
+void
+OrderBookCache::storeOffer(LedgerEntry const& entry)
+{
+    if (!mActive)
+    {
+        return;
+    }
+    auto const& offer = entry.data.offer();
+    removeOffer(offer.offerID);
+
+    auto key = bookKey(offer.selling, offer.buying);
+    noteBook(offer.offerID, key);
+    auto it = mBooks.find(key);
+    if (it == mBooks.end())
+    {
+        return;
+    }
+    auto& book = it->second;
+    auto pos = std::lower_bound(book.mOffers.begin(), book.mOffers.end(),
+                                entry, offerBefore);
+    // past the end of a partial prefix, the offer is among those not loaded
+    if (pos != book.mOffers.end() || book.mComplete)
+    {
+        book.mOffers.insert(pos, entry);
+    }
+}
+
+void
+OrderBookCache::deleteOffer(uint64 offerID)
+{
+    if (mActive)
+    {
+        removeOffer(offerID);
+    }
+}
+
+void
+OrderBookCache::invalidate(uint64 offerID)
+{
+    if (!mActive)
+    {
+        return;
+    }
+    auto it = mOfferBooks.find(offerID);
+    if (it != mOfferBooks.end())
+    {
+        for (auto const& key : it->second)
+        {
+            mBooks.erase(key);
+        }
+    }
+}
+
+OrderBookCache::Scope::Scope(OrderBookCache& cache) : mCache(cache)
+{
+    mCache.clear();
+    mCache.mActive = true;
+}
+
+OrderBookCache::Scope::~Scope()
+{
+    if (mCache.mHits + mCache.mMisses != 0)
+    {
+        CLOG(DEBUG, "Ledger") << "Order book queries during apply: "
+                              << mCache.mHits << " cached, " << mCache.mMisses
+                              << " loaded, " << mCache.mBooks.size()
+                              << " books";
+    }
+    mCache.mActive = false;
+    mCache.clear();
+}
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "ledger/OfferFrame.h"
+#include "util/NonCopyable.h"
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace medida
+{
+class MetricsRegistry;
+class Meter;
+}
+
+namespace stellar
+{
+
+/**
+ * Best offers of the order books crossed while a ledger's transactions are
+ * applied.
+ *
+ * Offers and path payments page through a book with
+ * OfferFrame::loadBestOffers each time they cross it, and the transactions of
+ * a ledger tend to cross the same few books. While a Scope is open, each book
+ * keeps the offers loaded so far: a prefix of the book in the order of the
+ * query (price, then offer id). Pages that prefix covers are served without
+ * a query; the others extend it.
+ *
+ * The prefixes follow the offers table: OfferFrame reports every offer row it
+ * writes or deletes, which updates the books in place. A rolled back
+ * LedgerDelta may or may not come with rolled back rows, so it drops the
+ * books holding any offer it touched, to be reloaded when next crossed.
+ */
+class OrderBookCache : NonMovableOrCopyable
+{
+    struct Book
+    {
+        std::vector<LedgerEntry> mOffers;
+        // whether mOffers holds the whole book
+        bool mComplete{false};
+    };
+
+    bool mActive{false};
+    // keyed by the XDR of the selling and buying assets
+    std::unordered_map<std::string, Book> mBooks;
+    // books each offer was reported in since the Scope opened
+    std::unordered_map<uint64, std::vector<std::string>> mOfferBooks;
+
+    uint64_t mHits{0};
+    uint64_t mMisses{0};
+
+    medida::Meter& mHitMeter;
+    medida::Meter& mMissMeter;
+    medida::Meter& mLoadMeter;
+
+    static std::string bookKey(Asset const& selling, Asset const& buying);
+    void noteBook(uint64 offerID, std::string const& key);
+    void removeOffer(uint64 offerID);
+    void clear();
+
+  public:
+    // Offers loaded at least when a book is extended.
+    static size_t const MIN_LOAD;
+
+    typedef std::function<void(size_t numOffers, size_t offset,
+                               std::vector<OfferFrame::pointer>& retOffers)>
+        Loader;
+
+    OrderBookCache(medida::MetricsRegistry& metrics);
+
+    bool
+    isActive() const
+    {
+        return mActive;
+    }
+
+    // Offers [offset, offset + numOffers) of the book, as
+    // OfferFrame::loadBestOffers returns them; `load` runs that query for
+    // what the cached prefix does not cover.
+    void loadBestOffers(size_t numOffers, size_t offset, Asset const& selling,
+                        Asset const& buying,
+                        std::vector<OfferFrame::pointer>& retOffers,
+                        Loader const& load);
+
+    // Called when an offer row is written or deleted.
+    void storeOffer(LedgerEntry const& entry);
+    void deleteOffer(uint64 offerID);
+
+    // Called when a LedgerDelta rolls back a change to an offer.
+    void invalidate(uint64 offerID);
+
+    // Caches books until destruction.
+    class Scope : NonMovableOrCopyable
+    {
+        OrderBookCache& mCache;
+
+      public:
+        Scope(OrderBookCache& cache);
+        ~Scope();
+    };
+};
+}
@@ -7,8 +7,11 @@
 #include "crypto/SecretKey.h"
 #include "crypto/SHA.h"
 #include "database/Database.h"
+#include "database/ReadSnapshot.h"
 #include "LedgerDelta.h"
 #include "util/types.h"
+#include <algorithm>
+#include <set>
 
 using namespace std;
 using namespace soci;
@@ -59,6 +62,7 @@ TrustFrame& TrustFrame::operator=(TrustFrame const& other)
         mTrustLine = other.mTrustLine;
         mKey = other.mKey;
         mKeyCalculated = other.mKeyCalculated;
+        mCacheKey = other.mCacheKey;
         mIsIssuer = other.mIsIssuer;
     }
     return *this;
@@ -174,10 +178,20 @@ TrustFrame::isValid() const
 bool
 TrustFrame::exists(Database& db, LedgerKey const& key)
 {
+    std::shared_ptr<LedgerEntry const> pending;
+    if (db.getEntryOverlay().get(key, pending))
+    {
+        return pending != nullptr;
+    }
     if (cachedEntryExists(key, db) && getCachedEntry(key, db) != nullptr)
     {
         return true;
     }
+    if (auto kv = db.getEntryKVStore())
+    {
+        auto timer = db.getSelectTimer("trust-exists");
+        return kv->exists(key);
+    }
 
     std::string actIDStrKey, issuerStrKey, assetCode;
     getKeyFields(key, actIDStrKey, issuerStrKey, assetCode);
@@ -212,9 +226,32 @@ TrustFrame::storeDelete(LedgerDelta& delta, Database& db) const
 
 void
 TrustFrame::storeDelete(LedgerDelta& delta, Database& db, LedgerKey const& key)
+{
+    auto& overlay = db.getEntryOverlay();
+    if (overlay.isEnabled())
+    {
+        flushCachedEntry(key, db);
+        overlay.store(delta, key, nullptr, LedgerEntryOverlay::DB_PRESENT);
+    }
+    else
+    {
+        storeDeleteEntry(db, key);
+    }
+    delta.deleteEntry(key);
+}
+
+void
+TrustFrame::storeDeleteEntry(Database& db, LedgerKey const& key)
 {
     flushCachedEntry(key, db);
 
+    if (auto kv = db.getEntryKVStore())
+    {
+        auto timer = db.getDeleteTimer("trust");
+        kv->erase(key);
+        return;
+    }
+
     std::string actIDStrKey, issuerStrKey, assetCode;
     getKeyFields(key, actIDStrKey, issuerStrKey, assetCode);
 
@@ -222,12 +259,22 @@ TrustFrame::storeDelete(LedgerDelta& delta, Database& db, LedgerKey const& key)
     db.getSession() << "DELETE FROM trustlines "
                        "WHERE accountid=:v1 AND issuer=:v2 AND assetcode=:v3",
         use(actIDStrKey), use(issuerStrKey), use(assetCode);
-
-    delta.deleteEntry(key);
 }
 
 void
 TrustFrame::storeChange(LedgerDelta& delta, Database& db)
+{
+    storeUpdate(delta, db, false);
+}
+
+void
+TrustFrame::storeAdd(LedgerDelta& delta, Database& db)
+{
+    storeUpdate(delta, db, true);
+}
+
+void
+TrustFrame::storeUpdate(LedgerDelta& delta, Database& db, bool insert)
 {
     if (!isValid())
     {
@@ -242,80 +289,88 @@ TrustFrame::storeChange(LedgerDelta& delta, Database& db)
 
     touch(delta);
 
-    std::string actIDStrKey, issuerStrKey, assetCode;
-    getKeyFields(key, actIDStrKey, issuerStrKey, assetCode);
-
-    auto prep = db.getPreparedStatement(
-        "UPDATE trustlines "
-        "SET balance=:b, tlimit=:tl, flags=:a, lastmodified=:lm "
-        "WHERE accountid=:v1 AND issuer=:v2 AND assetcode=:v3");
-    auto& st = prep.statement();
-    st.exchange(use(mTrustLine.balance));
-    st.exchange(use(mTrustLine.limit));
-    st.exchange(use(mTrustLine.flags));
-    st.exchange(use(getLastModified()));
-    st.exchange(use(actIDStrKey));
-    st.exchange(use(issuerStrKey));
-    st.exchange(use(assetCode));
-    st.define_and_bind();
+    auto& overlay = db.getEntryOverlay();
+    if (overlay.isEnabled())
     {
-        auto timer = db.getUpdateTimer("trust");
-        st.execute(true);
+        overlay.store(delta, key, std::make_shared<LedgerEntry const>(mEntry),
+                      insert ? LedgerEntryOverlay::DB_ABSENT
+                             : LedgerEntryOverlay::DB_PRESENT);
     }
-    if (st.get_affected_rows() != 1)
+    else if (!storeEntry(db, mEntry, insert))
     {
         throw std::runtime_error("Could not update data in SQL");
     }
 
-    delta.modEntry(*this);
-}
-
-void
-TrustFrame::storeAdd(LedgerDelta& delta, Database& db)
-{
-    if (!isValid())
+    if (insert)
     {
-        throw std::runtime_error("Invalid TrustEntry");
+        delta.addEntry(*this);
     }
+    else
+    {
+        delta.modEntry(*this);
+    }
+}
 
-    auto key = getKey();
+bool
+TrustFrame::storeEntry(Database& db, LedgerEntry const& entry, bool insert)
+{
+    auto const& tl = entry.data.trustLine();
+    LedgerKey key = LedgerEntryKey(entry);
     flushCachedEntry(key, db);
 
-    if (mIsIssuer)
-        return;
-
-    touch(delta);
+    if (auto kv = db.getEntryKVStore())
+    {
+        auto timer = insert ? db.getInsertTimer("trust")
+                            : db.getUpdateTimer("trust");
+        return insert ? kv->insert(entry) : kv->update(entry);
+    }
 
     std::string actIDStrKey, issuerStrKey, assetCode;
-    unsigned int assetType = getKey().trustLine().asset.type();
-    getKeyFields(getKey(), actIDStrKey, issuerStrKey, assetCode);
+    getKeyFields(key, actIDStrKey, issuerStrKey, assetCode);
+
+    if (insert)
+    {
+        unsigned int assetType = tl.asset.type();
+        auto prep = db.getPreparedStatement(
+            "INSERT INTO trustlines "
+            "(accountid, assettype, issuer, assetcode, balance, tlimit, "
+            "flags, lastmodified) "
+            "VALUES (:v1, :v2, :v3, :v4, :v5, :v6, :v7, :v8)");
+        auto& st = prep.statement();
+        st.exchange(use(actIDStrKey));
+        st.exchange(use(assetType));
+        st.exchange(use(issuerStrKey));
+        st.exchange(use(assetCode));
+        st.exchange(use(tl.balance));
+        st.exchange(use(tl.limit));
+        st.exchange(use(tl.flags));
+        st.exchange(use(entry.lastModifiedLedgerSeq));
+        st.define_and_bind();
+        {
+            auto timer = db.getInsertTimer("trust");
+            st.execute(true);
+        }
+        return st.get_affected_rows() == 1;
+    }
 
     auto prep = db.getPreparedStatement(
-        "INSERT INTO trustlines "
-        "(accountid, assettype, issuer, assetcode, balance, tlimit, flags, "
-        "lastmodified) "
-        "VALUES (:v1, :v2, :v3, :v4, :v5, :v6, :v7, :v8)");
+        "UPDATE trustlines "
+        "SET balance=:b, tlimit=:tl, flags=:a, lastmodified=:lm "
+        "WHERE accountid=:v1 AND issuer=:v2 AND assetcode=:v3");
     auto& st = prep.statement();
+    st.exchange(use(tl.balance));
+    st.exchange(use(tl.limit));
+    st.exchange(use(tl.flags));
+    st.exchange(use(entry.lastModifiedLedgerSeq));
     st.exchange(use(actIDStrKey));
-    st.exchange(use(assetType));
     st.exchange(use(issuerStrKey));
     st.exchange(use(assetCode));
-    st.exchange(use(mTrustLine.balance));
-    st.exchange(use(mTrustLine.limit));
-    st.exchange(use(mTrustLine.flags));
-    st.exchange(use(getLastModified()));
     st.define_and_bind();
     {
-        auto timer = db.getInsertTimer("trust");
+        auto timer = db.getUpdateTimer("trust");
         st.execute(true);
     }
-
-    if (st.get_affected_rows() != 1)
-    {
-        throw std::runtime_error("Could not update data in SQL");
-    }
-
-    delta.addEntry(*this);
+    return st.get_affected_rows() == 1;
 }
 
 static const char* trustLineColumnSelector =
@@ -347,8 +402,7 @@ TrustFrame::createIssuerFrame(Asset const& issuer)
 }
 
 TrustFrame::pointer
-TrustFrame::loadTrustLine(AccountID const& accountID, Asset const& asset,
-                          Database& db)
+TrustFrame::loadIssuerFrame(AccountID const& accountID, Asset const& asset)
 {
     if (asset.type() == ASSET_TYPE_CREDIT_ALPHANUM4)
     {
@@ -362,15 +416,23 @@ TrustFrame::loadTrustLine(AccountID const& accountID, Asset const& asset,
     }
     else
         throw std::runtime_error("XLM TrustLine?");
+    return nullptr;
+}
 
-    LedgerKey key;
-    key.type(TRUSTLINE);
-    key.trustLine().accountID = accountID;
-    key.trustLine().asset = asset;
-    if (cachedEntryExists(key, db))
+template <typename Source>
+TrustFrame::pointer
+TrustFrame::loadTrustLineRow(AccountID const& accountID, Asset const& asset,
+                             Source& source)
+{
+    if (auto kv = source.getEntryKVStore())
     {
-        auto p = getCachedEntry(key, db);
-        return p ? std::make_shared<TrustFrame>(*p) : nullptr;
+        LedgerKey key;
+        key.type(TRUSTLINE);
+        key.trustLine().accountID = accountID;
+        key.trustLine().asset = asset;
+        LedgerEntry entry;
+        auto timer = source.getSelectTimer("trust");
+        return kv->load(key, entry) ? make_shared<TrustFrame>(entry) : nullptr;
     }
 
     std::string accStr, issuerStr, assetStr;
@@ -391,19 +453,49 @@ TrustFrame::loadTrustLine(AccountID const& accountID, Asset const& asset,
     query += (" WHERE accountid = :id "
               " AND issuer = :issuer "
               " AND assetcode = :asset");
-    auto prep = db.getPreparedStatement(query);
+    auto prep = source.getPreparedStatement(query);
     auto& st = prep.statement();
     st.exchange(use(accStr));
     st.exchange(use(issuerStr));
     st.exchange(use(assetStr));
 
     pointer retLine;
-    auto timer = db.getSelectTimer("trust");
+    auto timer = source.getSelectTimer("trust");
     loadLines(prep, [&retLine](LedgerEntry const& trust)
               {
                   retLine = make_shared<TrustFrame>(trust);
               });
+    return retLine;
+}
 
+TrustFrame::pointer
+TrustFrame::loadTrustLine(AccountID const& accountID, Asset const& asset,
+                          Database& db)
+{
+    auto issuer = loadIssuerFrame(accountID, asset);
+    if (issuer)
+    {
+        return issuer;
+    }
+
+    LedgerKey key;
+    key.type(TRUSTLINE);
+    key.trustLine().accountID = accountID;
+    key.trustLine().asset = asset;
+    std::shared_ptr<LedgerEntry const> pending;
+    if (db.getEntryOverlay().get(key, pending))
+    {
+        return pending ? std::make_shared<TrustFrame>(*pending) : nullptr;
+    }
+    bool cached = cachedEntryExists(key, db);
+    db.getEntryPrefetch().recordLookup(cached);
+    if (cached)
+    {
+        auto p = getCachedEntry(key, db);
+        return p ? std::make_shared<TrustFrame>(*p) : nullptr;
+    }
+
+    auto retLine = loadTrustLineRow(accountID, asset, db);
     if (retLine)
     {
         retLine->putCachedEntry(db);
@@ -415,9 +507,44 @@ TrustFrame::loadTrustLine(AccountID const& accountID, Asset const& asset,
     return retLine;
 }
 
+TrustFrame::pointer
+TrustFrame::loadTrustLine(AccountID const& accountID, Asset const& asset,
+                          ReadSnapshot& snapshot)
+{
+    auto issuer = loadIssuerFrame(accountID, asset);
+    if (issuer)
+    {
+        return issuer;
+    }
+
+    LedgerKey key;
+    key.type(TRUSTLINE);
+    key.trustLine().accountID = accountID;
+    key.trustLine().asset = asset;
+    std::shared_ptr<LedgerEntry const> p;
+    if (snapshot.getCachedEntry(key, p))
+    {
+        return p ? std::make_shared<TrustFrame>(*p) : nullptr;
+    }
+
+    auto retLine = loadTrustLineRow(accountID, asset, snapshot);
+    snapshot.putCachedEntry(
+        key, retLine ? std::make_shared<LedgerEntry const>(retLine->mEntry)
+                     : nullptr);
+    return retLine;
+}
+
 bool
 TrustFrame::hasIssued(AccountID const& issuerID, Database& db)
 {
+    db.getEntryOverlay().writeOut(db, TRUSTLINE);
+
+    if (auto kv = db.getEntryKVStore())
+    {
+        auto timer = db.getSelectTimer("trust");
+        return kv->hasIssued(issuerID);
+    }
+
     std::string accStrKey;
     accStrKey = PubKeyUtils::toStrKey(issuerID);
     int balance = 0;
@@ -497,6 +624,22 @@ void
 TrustFrame::loadLines(AccountID const& accountID,
                       std::vector<TrustFrame::pointer>& retLines, Database& db)
 {
+    db.getEntryOverlay().writeOut(db, TRUSTLINE);
+
+    if (auto kv = db.getEntryKVStore())
+    {
+        std::vector<LedgerEntry> lines;
+        {
+            auto timer = db.getSelectTimer("trust");
+            kv->loadLines(accountID, lines);
+        }
+        for (auto const& cur : lines)
+        {
+            retLines.emplace_back(make_shared<TrustFrame>(cur));
+        }
+        return;
+    }
+
     std::string actIDStrKey;
     actIDStrKey = PubKeyUtils::toStrKey(accountID);
 
@@ -513,6 +656,66 @@ TrustFrame::loadLines(AccountID const& accountID,
               });
 }
 
+void
+TrustFrame::prefetchTrustLines(std::vector<LedgerKey> const& keys,
+                               Database& db)
+{
+    std::set<LedgerKey, LedgerEntryIdCmp> missing;
+    std::set<std::string> accounts;
+    for (auto const& key : keys)
+    {
+        auto const& tl = key.trustLine();
+        if (!loadIssuerFrame(tl.accountID, tl.asset))
+        {
+            missing.insert(key);
+            accounts.insert(PubKeyUtils::toStrKey(tl.accountID));
+        }
+    }
+    std::vector<std::string> strKeys(accounts.begin(), accounts.end());
+
+    // all the lines of a batch of accounts, keeping those that were asked
+    // for; short batches repeat their last account
+    size_t const batchSize = 64;
+    std::string query =
+        std::string(trustLineColumnSelector) + " WHERE accountid IN (";
+    for (size_t i = 0; i < batchSize; i++)
+    {
+        query += (i == 0 ? ":v" : ", :v") + std::to_string(i);
+    }
+    query += ")";
+
+    for (size_t first = 0; first < strKeys.size(); first += batchSize)
+    {
+        size_t last = std::min(first + batchSize, strKeys.size());
+        std::vector<std::string> batch(strKeys.begin() + first,
+                                       strKeys.begin() + last);
+        batch.resize(batchSize, batch.back());
+
+        auto prep = db.getPreparedStatement(query);
+        for (auto const& k : batch)
+        {
+            prep.statement().exchange(use(k));
+        }
+        auto timer = db.getSelectTimer("trust");
+        loadLines(prep, [&](LedgerEntry const& cur)
+                  {
+                      auto it = missing.find(LedgerEntryKey(cur));
+                      if (it != missing.end())
+                      {
+                          putCachedEntry(*it,
+                                         make_shared<LedgerEntry const>(cur),
+                                         db);
+                          missing.erase(it);
+                      }
+                  });
+    }
+
+    for (auto const& key : missing)
+    {
+        putCachedEntry(key, nullptr, db);
+    }
+}
+
 void
 TrustFrame::dropAll(Database& db)
 {
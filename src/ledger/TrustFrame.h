@@ -38,11 +38,22 @@ class TrustFrame : public EntryFrame
     TrustLineEntry& mTrustLine;
 
     static TrustFrame::pointer createIssuerFrame(Asset const& issuer);
+    // the generated trustline if accountID issued asset, nullptr otherwise
+    static TrustFrame::pointer loadIssuerFrame(AccountID const& accountID,
+                                               Asset const& asset);
+    // the query part of loadTrustLine, shared by the Database and
+    // ReadSnapshot versions
+    template <typename Source>
+    static TrustFrame::pointer loadTrustLineRow(AccountID const& accountID,
+                                                Asset const& asset,
+                                                Source& source);
     bool mIsIssuer; // the TrustFrame fakes an infinite trustline for issuers
 
     TrustFrame(TrustFrame const& from);
     TrustFrame& operator=(TrustFrame const& other);
 
+    void storeUpdate(LedgerDelta& delta, Database& db, bool insert);
+
   public:
     TrustFrame();
     TrustFrame(LedgerEntry const& from);
@@ -64,15 +75,29 @@ class TrustFrame : public EntryFrame
     static bool exists(Database& db, LedgerKey const& key);
     static uint64_t countObjects(soci::session& sess);
 
+    // Write `entry` or delete `key` directly in the database, bypassing the
+    // write-behind overlay. With `insert` unset, storeEntry returns false if
+    // there was no row to update.
+    static bool storeEntry(Database& db, LedgerEntry const& entry,
+                           bool insert);
+    static void storeDeleteEntry(Database& db, LedgerKey const& key);
+
     // returns the specified trustline or a generated one for issuers
     static pointer loadTrustLine(AccountID const& accountID, Asset const& asset,
                                  Database& db);
+    static pointer loadTrustLine(AccountID const& accountID, Asset const& asset,
+                                 ReadSnapshot& snapshot);
 
     // note: only returns trust lines stored in the database
     static void loadLines(AccountID const& accountID,
                           std::vector<TrustFrame::pointer>& retLines,
                           Database& db);
 
+    // Load the trustlines of `keys` with a few batched queries into the
+    // entry cache, caching the absence of those that do not exist.
+    static void prefetchTrustLines(std::vector<LedgerKey> const& keys,
+                                   Database& db);
+
     static bool hasIssued(AccountID const& issuerID, Database& db);
 
     int64_t getBalance() const;
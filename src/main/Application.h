@@ -33,6 +33,7 @@ class Database;
 class PersistentState;
 class LoadGenerator;
 class CommandHandler;
+class ApplyMeters;
 
 /*
  * State of a single instance of the stellar-core application.
@@ -165,6 +166,10 @@ class Application
     // reported through the administrative HTTP interface, see CommandHandler.
     virtual medida::MetricsRegistry& getMetrics() = 0;
 
+    // Get the meters marked while validating and applying transactions,
+    // registered in getMetrics() once on construction.
+    virtual ApplyMeters& getApplyMeters() = 0;
+
     // Ensure any App-local metrics that are "current state" gauge-like counters
     // reflect the current reality as best as possible.
     virtual void syncOwnMetrics() = 0;
@@ -19,6 +19,7 @@
 #include "process/ProcessManager.h"
 #include "main/CommandHandler.h"
 #include "simulation/LoadGenerator.h"
+#include "transactions/ApplyMeters.h"
 #include "crypto/SecretKey.h"
 #include "crypto/SHA.h"
 #include "medida/metrics_registry.h"
@@ -27,6 +28,7 @@
 #include "medida/counter.h"
 #include "medida/timer.h"
 
+#include "util/CachedXDR.h"
 #include "util/TmpDir.h"
 #include "util/Logging.h"
 #include "util/make_unique.h"
@@ -51,6 +53,7 @@ ApplicationImpl::ApplicationImpl(VirtualClock& clock, Config const& cfg)
     , mMetrics(make_unique<medida::MetricsRegistry>())
     , mAppStateCurrent(mMetrics->NewCounter({"app", "state", "current"}))
     , mAppStateChanges(mMetrics->NewTimer({"app", "state", "changes"}))
+    , mApplyMeters(make_unique<ApplyMeters>(*mMetrics))
     , mLastStateChange(clock.now())
 {
 #ifdef SIGQUIT
@@ -62,6 +65,10 @@ ApplicationImpl::ApplicationImpl(VirtualClock& clock, Config const& cfg)
 
     mNetworkID = sha256(mConfig.NETWORK_PASSPHRASE);
 
+    // the cache is process-wide: the last application created sizes it,
+    // which only empties it if the size changes
+    PubKeyUtils::resizeVerifySigCache(mConfig.SIGNATURE_CACHE_SIZE);
+
     unsigned t = std::thread::hardware_concurrency();
     LOG(INFO) << "Application constructing "
               << "(worker threads: " << t << ")";
@@ -81,7 +88,9 @@ ApplicationImpl::ApplicationImpl(VirtualClock& clock, Config const& cfg)
     mPersistentState = make_unique<PersistentState>(*this);
 
     bool initializeDB =
-        (mConfig.REBUILD_DB || mConfig.DATABASE == "sqlite3://:memory:");
+        (mConfig.REBUILD_DB ||
+         Database::getConnectionString(mConfig.DATABASE) ==
+             "sqlite3://:memory:");
     if (initializeDB)
     {
         auto wipeMsg = (getPersistentState().getState(
@@ -95,10 +104,18 @@ ApplicationImpl::ApplicationImpl(VirtualClock& clock, Config const& cfg)
         LOG(INFO) << "* The database has been" << wipeMsg;
         LOG(INFO) << "* ";
     }
-    else if (mPersistentState->getState(
-                 PersistentState::kForceSCPOnNextLaunch) == "true")
+    else
     {
-        mConfig.FORCE_SCP = true;
+        if (mPersistentState->getState(
+                PersistentState::kDatabaseInitialized) == "true")
+        {
+            mDatabase->upgradeToCurrentSchema();
+        }
+        if (mPersistentState->getState(
+                PersistentState::kForceSCPOnNextLaunch) == "true")
+        {
+            mConfig.FORCE_SCP = true;
+        }
     }
 
     mTmpDirManager = make_unique<TmpDirManager>(cfg.TMP_DIR_PATH);
@@ -353,8 +370,7 @@ ApplicationImpl::checkDB()
     getClock().getIOService().post(
         [this]
         {
-            checkDBAgainstBuckets(this->getMetrics(), this->getBucketManager(),
-                                  this->getDatabase(),
+            checkDBAgainstBuckets(*this,
                                   this->getBucketManager().getBucketList());
         });
 }
@@ -433,6 +449,12 @@ ApplicationImpl::getMetrics()
     return *mMetrics;
 }
 
+ApplyMeters&
+ApplicationImpl::getApplyMeters()
+{
+    return *mApplyMeters;
+}
+
 void
 ApplicationImpl::syncOwnMetrics()
 {
@@ -457,6 +479,11 @@ ApplicationImpl::syncOwnMetrics()
         .Mark(vignore);
     mMetrics->NewMeter({"crypto", "verify", "total"}, "signature")
         .Mark(vhit + vmiss + vignore);
+
+    uint64_t made = 0, reused = 0;
+    CachedXDR::flushCounts(made, reused);
+    mMetrics->NewMeter({"xdr", "encode", "made"}, "encoding").Mark(made);
+    mMetrics->NewMeter({"xdr", "encode", "reused"}, "encoding").Mark(reused);
 }
 
 void
@@ -28,6 +28,7 @@ class ProcessManager;
 class CommandHandler;
 class Database;
 class LoadGenerator;
+class ApplyMeters;
 
 class ApplicationImpl : public Application
 {
@@ -44,6 +45,7 @@ class ApplicationImpl : public Application
     virtual bool isStopping() const override;
     virtual VirtualClock& getClock() override;
     virtual medida::MetricsRegistry& getMetrics() override;
+    virtual ApplyMeters& getApplyMeters() override;
     virtual void syncOwnMetrics() override;
     virtual void syncAllMetrics() override;
     virtual TmpDirManager& getTmpDirManager() override;
@@ -128,6 +130,7 @@ class ApplicationImpl : public Application
     std::unique_ptr<medida::MetricsRegistry> mMetrics;
     medida::Counter& mAppStateCurrent;
     medida::Timer& mAppStateChanges;
+    std::unique_ptr<ApplyMeters> mApplyMeters;
     VirtualClock::time_point mLastStateChange;
 
     Hash mNetworkID;
@@ -3,6 +3,7 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "crypto/Hex.h"
+#include "database/Database.h"
 #include "herder/Herder.h"
 #include "ledger/LedgerManager.h"
 #include "lib/http/server.hpp"
@@ -85,6 +86,8 @@ CommandHandler::CommandHandler(Application& app) : mApp(app)
     mServer->addRoute("setcursor",
                       std::bind(&CommandHandler::setcursor, this, _1, _2));
     mServer->addRoute("scp", std::bind(&CommandHandler::scpInfo, this, _1, _2));
+    mServer->addRoute("sqlprofile",
+                      std::bind(&CommandHandler::sqlProfile, this, _1, _2));
     mServer->addRoute("testacc",
                       std::bind(&CommandHandler::testAcc, this, _1, _2));
     mServer->addRoute("testtx",
@@ -297,8 +300,17 @@ CommandHandler::fileNotFound(std::string const& params, std::string& retStr)
         "endpoint."
         "</p><p><h1> /maintenance[?queue=true]</h1> Performs maintenance tasks "
         "on the instance."
-        "<ul><li><i>queue</i> performs deletion of queue data.See setcursor "
-        "for more information</li></ul"
+        "<ul><li><i>queue</i> schedules deletion of queue data.See setcursor "
+        "for more information</li></ul>"
+        "Old history is deleted in the background, a few ledgers at a time; "
+        "the history.prune metrics report how far that has got."
+        "</p><p><h1> /sqlprofile[?enable=true|false][&reset=true][&top=N]</h1>"
+        "returns a JSON object with the N (default 10) prepared SQL statements "
+        "that took the most time, and those run while closing the last "
+        "ledger, with their call count, affected rows and latency "
+        "percentiles in microseconds.<br>"
+        "<i>enable</i> turns profiling on or off (see SQL_PROFILING), "
+        "<i>reset</i> zeroes the counts first."
         "</p>"
 
         "<br>";
@@ -753,4 +765,60 @@ CommandHandler::maintenance(std::string const& params, std::string& retStr)
         retStr = "No work performed";
     }
 }
+
+static Json::Value
+sqlProfileToJson(SQLProfiler::Report const& report, size_t n)
+{
+    Json::Value res(Json::arrayValue);
+    for (auto const& s : report)
+    {
+        if (res.size() == n)
+        {
+            break;
+        }
+        Json::Value st;
+        st["sql"] = s.first;
+        st["calls"] = (Json::UInt64)s.second.mCalls;
+        st["rows"] = (Json::UInt64)s.second.mRows;
+        st["total_us"] = (Json::UInt64)s.second.mTotalMicros;
+        st["mean_us"] = (Json::UInt64)(s.second.mTotalMicros / s.second.mCalls);
+        st["p50_us"] = (Json::UInt64)s.second.quantile(0.5);
+        st["p99_us"] = (Json::UInt64)s.second.quantile(0.99);
+        st["max_us"] = (Json::UInt64)s.second.mMaxMicros;
+        res.append(st);
+    }
+    return res;
+}
+
+void
+CommandHandler::sqlProfile(std::string const& params, std::string& retStr)
+{
+    std::map<std::string, std::string> map;
+    http::server::server::parseParams(params, map);
+
+    size_t top = 10;
+    if (!parseOptionalNumParam(map, "top", top, retStr))
+    {
+        return;
+    }
+
+    auto& profiler = mApp.getDatabase().getSQLProfiler();
+    auto enable = map.find("enable");
+    if (enable != map.end())
+    {
+        profiler.setEnabled(enable->second == "true");
+    }
+    if (map["reset"] == "true")
+    {
+        profiler.reset();
+    }
+
+    Json::Value root;
+    root["enabled"] = profiler.isEnabled();
+    root["statements"] = sqlProfileToJson(profiler.getTop(top), top);
+    auto& ledger = root["ledger"];
+    ledger["seq"] = profiler.getLastLedgerSeq();
+    ledger["statements"] = sqlProfileToJson(profiler.getLastLedger(), top);
+    retStr = root.toStyledString();
+}
 }
@@ -42,6 +42,7 @@ class CommandHandler
     void metrics(std::string const& params, std::string& retStr);
     void peers(std::string const& params, std::string& retStr);
     void setcursor(std::string const& params, std::string& retStr);
+    void sqlProfile(std::string const& params, std::string& retStr);
     void scpInfo(std::string const& params, std::string& retStr);
     void tx(std::string const& params, std::string& retStr);
     void testAcc(std::string const& params, std::string& retStr);
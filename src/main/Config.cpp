@@ -43,10 +43,15 @@ Config::Config() : PEER_KEY(SecretKey::random())
     LOG_FILE_PATH = "stellar-core.log";
     TMP_DIR_PATH = "tmp";
     BUCKET_DIR_PATH = "buckets";
+    COMPRESS_BUCKETS = false;
     HTTP_PORT = DEFAULT_PEER_PORT + 1;
     PUBLIC_HTTP_PORT = false;
     PEER_PUBLIC_KEY = PEER_KEY.getPublicKey();
     PARANOID_MODE = false;
+    WRITE_BEHIND_LEDGER_ENTRIES = false;
+    SQL_PROFILING = false;
+    PRELOAD_PREPARED_TX_SET = false;
+    SIGNATURE_CACHE_SIZE = 0xffff;
 
     DATABASE = "sqlite3://:memory:";
 }
@@ -304,6 +309,14 @@ Config::load(std::string const& filename)
                 }
                 BUCKET_DIR_PATH = item.second->as<std::string>()->value();
             }
+            else if (item.first == "COMPRESS_BUCKETS")
+            {
+                if (!item.second->as<bool>())
+                {
+                    throw std::invalid_argument("invalid COMPRESS_BUCKETS");
+                }
+                COMPRESS_BUCKETS = item.second->as<bool>()->value();
+            }
             else if (item.first == "VALIDATION_SEED")
             {
                 if (!item.second->as<std::string>())
@@ -454,6 +467,46 @@ Config::load(std::string const& filename)
                 }
                 PARANOID_MODE = item.second->as<bool>()->value();
             }
+            else if (item.first == "WRITE_BEHIND_LEDGER_ENTRIES")
+            {
+                if (!item.second->as<bool>())
+                {
+                    throw std::invalid_argument(
+                        "invalid WRITE_BEHIND_LEDGER_ENTRIES");
+                }
+                WRITE_BEHIND_LEDGER_ENTRIES =
+                    item.second->as<bool>()->value();
+            }
+            else if (item.first == "SQL_PROFILING")
+            {
+                if (!item.second->as<bool>())
+                {
+                    throw std::invalid_argument("invalid SQL_PROFILING");
+                }
+                SQL_PROFILING = item.second->as<bool>()->value();
+            }
+            else if (item.first == "PRELOAD_PREPARED_TX_SET")
+            {
+                if (!item.second->as<bool>())
+                {
+                    throw std::invalid_argument(
+                        "invalid PRELOAD_PREPARED_TX_SET");
+                }
+                PRELOAD_PREPARED_TX_SET = item.second->as<bool>()->value();
+            }
+            else if (item.first == "SIGNATURE_CACHE_SIZE")
+            {
+                if (!item.second->as<int64_t>())
+                {
+                    throw std::invalid_argument("invalid SIGNATURE_CACHE_SIZE");
+                }
+                int64_t f = item.second->as<int64_t>()->value();
+                if (f <= 0 || f >= UINT32_MAX)
+                {
+                    throw std::invalid_argument("invalid SIGNATURE_CACHE_SIZE");
+                }
+                SIGNATURE_CACHE_SIZE = (uint32_t)f;
+            }
             else if (item.first == "NETWORK_PASSPHRASE")
             {
                 if (!item.second->as<std::string>())
@@ -103,6 +103,12 @@ class Config : public std::enable_shared_from_this<Config>
     std::string LOG_FILE_PATH;
     std::string TMP_DIR_PATH;
     std::string BUCKET_DIR_PATH;
+
+    // Write local bucket files block-compressed (see BlockCompressedFile).
+    // Bucket hashes and published archives are over the uncompressed XDR
+    // either way, and both forms can be read regardless of this setting.
+    bool COMPRESS_BUCKETS;
+
     uint32_t DESIRED_BASE_FEE;     // in stroops
     uint32_t DESIRED_BASE_RESERVE; // in stroops
     uint32_t DESIRED_MAX_TX_PER_LEDGER;
@@ -128,6 +134,26 @@ class Config : public std::enable_shared_from_this<Config>
     // as the rest of the network, caution is advised when using this.
     bool PARANOID_MODE;
 
+    // Buffer account and trustline writes while closing a ledger and write
+    // each changed entry once at the end, instead of on every store.
+    // Setting this to false writes through to the database as entries are
+    // stored, which is useful to validate the write-behind path.
+    bool WRITE_BEHIND_LEDGER_ENTRIES;
+
+    // Profile every prepared statement from startup, with call counts and
+    // latency histograms reported by the `sqlprofile` command. It can also
+    // be switched on and off with that command.
+    bool SQL_PROFILING;
+
+    // Load the entries of a tx set into the entry cache as soon as a ballot
+    // for it is confirmed prepared, rather than when the ledger closes. This
+    // only warms the cache: nothing is applied before externalization.
+    // Off by default.
+    bool PRELOAD_PREPARED_TX_SET;
+
+    // Signature verification results cached by the process.
+    uint32_t SIGNATURE_CACHE_SIZE;
+
     // SCP config
     SecretKey VALIDATION_KEY;
     stellar::SCPQuorumSet QUORUM_SET;
@@ -108,7 +108,7 @@ ExternalQueue::process()
 
     if (st.got_data() && minIndicator == soci::indicator::i_ok)
     {
-        mApp.getLedgerManager().deleteOldEntries(mApp.getDatabase(), (uint32)m);
+        mApp.getLedgerManager().deleteOldEntries((uint32)m);
     }
 }
 
@@ -26,7 +26,8 @@ class ExternalQueue
     // deletes the subscription for the resource
     void deleteCursor(std::string const& resid);
 
-    // safely delete data
+    // schedules deletion of data that every cursor is past; the rows are
+    // deleted in the background by HistoryPruner
     void process();
 
   private:
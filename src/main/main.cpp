@@ -10,6 +10,7 @@
 #include "lib/util/getopt.h"
 #include "main/dumpxdr.h"
 #include "main/fuzz.h"
+#include "main/replay.h"
 #include "main/test.h"
 #include "main/Config.h"
 #include "lib/http/HttpClient.h"
@@ -20,6 +21,7 @@
 #include <sodium.h>
 #include "database/Database.h"
 #include "util/optional.h"
+#include <limits>
 
 _INITIALIZE_EASYLOGGINGPP
 
@@ -44,6 +46,8 @@ enum opttag
     OPT_METRIC,
     OPT_NEWDB,
     OPT_NEWHIST,
+    OPT_REPLAY,
+    OPT_REPLAYTO,
     OPT_TEST,
     OPT_VERSION
 };
@@ -63,6 +67,8 @@ static const struct option stellar_core_options[] = {
     {"metric", required_argument, nullptr, OPT_METRIC},
     {"newdb", no_argument, nullptr, OPT_NEWDB},
     {"newhist", required_argument, nullptr, OPT_NEWHIST},
+    {"replay", required_argument, nullptr, OPT_REPLAY},
+    {"replay-to", required_argument, nullptr, OPT_REPLAYTO},
     {"test", no_argument, nullptr, OPT_TEST},
     {"version", no_argument, nullptr, OPT_VERSION},
     {nullptr, 0, nullptr, 0}};
@@ -94,6 +100,9 @@ usage(int err = 1)
           "      --newdb         Creates or restores the DB to the genesis "
           "ledger\n"
           "      --newhist ARCH  Initialize the named history archive ARCH\n"
+          "      --replay DIR    Replay ledgers after the LCL from the local "
+          "history archive DIR, without consensus, reporting apply times\n"
+          "      --replay-to N   Stop --replay after ledger N\n"
           "      --test          To run self-tests\n"
           "      --version       To print version information\n";
     exit(err);
@@ -108,6 +117,31 @@ setNoListen(Config& cfg)
     cfg.MANUAL_CLOSE = true;
 }
 
+// Parse a ledger sequence number: decimal digits only, at most UINT32_MAX.
+static bool
+parseLedgerSeq(std::string const& str, uint32_t& seq)
+{
+    if (str.empty() ||
+        str.find_first_not_of("0123456789") != std::string::npos)
+    {
+        return false;
+    }
+    try
+    {
+        auto val = std::stoull(str);
+        if (val > std::numeric_limits<uint32_t>::max())
+        {
+            return false;
+        }
+        seq = static_cast<uint32_t>(val);
+        return true;
+    }
+    catch (std::out_of_range&)
+    {
+        return false;
+    }
+}
+
 static void
 sendCommand(std::string const& command, const std::vector<char*>& rest,
             unsigned short port)
@@ -274,6 +308,8 @@ main(int argc, char* const* argv)
     bool getInfo = false;
     std::vector<std::string> newHistories;
     std::vector<std::string> metrics;
+    std::string replayDir;
+    uint32_t replayTo = 0;
 
     int opt;
     while ((opt = getopt_long_only(argc, argv, "", stellar_core_options,
@@ -326,6 +362,18 @@ main(int argc, char* const* argv)
         case OPT_NEWHIST:
             newHistories.push_back(std::string(optarg));
             break;
+        case OPT_REPLAY:
+            replayDir = std::string(optarg);
+            break;
+        case OPT_REPLAYTO:
+            if (!parseLedgerSeq(optarg, replayTo))
+            {
+                std::cerr << "Invalid ledger number for --replay-to: "
+                          << optarg << std::endl;
+                usage(1);
+                return 1;
+            }
+            break;
         case OPT_TEST:
         {
             rest.push_back(*argv);
@@ -391,6 +439,11 @@ main(int argc, char* const* argv)
             setNoListen(cfg);
             return initializeHistories(cfg, newHistories);
         }
+        else if (!replayDir.empty())
+        {
+            setNoListen(cfg);
+            return replay(cfg, replayDir, replayTo);
+        }
 
         if (cfg.MANUAL_CLOSE)
         {
@@ -0,0 +1,332 @@
+// Copyright 2015 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/asio.h"
+#include "main/replay.h"
+#include "main/Application.h"
+#include "main/Config.h"
+#include "main/PersistentState.h"
+#include "bucket/BucketManager.h"
+#include "bucket/BucketList.h"
+#include "crypto/Hex.h"
+#include "herder/LedgerCloseData.h"
+#include "herder/TxSetFrame.h"
+#include "history/FileTransferInfo.h"
+#include "history/HistoryManager.h"
+#include "ledger/LedgerManager.h"
+#include "process/ProcessManager.h"
+#include "util/Fs.h"
+#include "util/Logging.h"
+#include "util/Timer.h"
+#include "util/TmpDir.h"
+#include "util/XDRStream.h"
+
+#include "medida/metrics_registry.h"
+#include "medida/timer.h"
+
+#include <chrono>
+
+/**
+ * Offline replay of history, for benchmarking.
+ *
+ * This reads checkpoint files straight out of a history archive on local disk
+ * (as written by a `cp`-style archive `put` command) and feeds every ledger in
+ * them through LedgerManager::closeLedger, exactly as catchup does, but
+ * without any network, consensus or archive commands involved. It's meant for
+ * comparing builds and database configurations on identical, real workloads.
+ *
+ * The database is expected to be at the LCL the replay should start from
+ * (typically genesis, after --newdb); the archive has to be from the same
+ * network as the configured NETWORK_PASSPHRASE.
+ */
+
+namespace stellar
+{
+
+using namespace std::chrono;
+
+namespace
+{
+
+class ReplayRunner
+{
+    Application& mApp;
+    std::string mArchiveDir;
+    uint32_t mLastLedger;
+    TmpDir mWorkDir;
+
+    // Cumulative milliseconds recorded by the timers of interest, sampled
+    // before and after every ledger.
+    double
+    timerSum(medida::MetricName const& name)
+    {
+        return mApp.getMetrics().NewTimer(name).sum();
+    }
+
+    double
+    sqlTimeMs()
+    {
+        double sum = 0;
+        for (auto const& kv : mApp.getMetrics().GetAllMetrics())
+        {
+            if (kv.first.domain() != "database")
+            {
+                continue;
+            }
+            auto timer = dynamic_cast<medida::Timer*>(kv.second.get());
+            if (timer)
+            {
+                sum += timer->sum();
+            }
+        }
+        return sum;
+    }
+
+    double
+    bucketTimeMs()
+    {
+        return timerSum({"bucket", "batch", "add"}) +
+               timerSum({"bucket", "snap", "merge"});
+    }
+
+    double
+    txApplyTimeMs()
+    {
+        return timerSum({"ledger", "transaction", "apply"});
+    }
+
+    void
+    crankUntil(bool const& done)
+    {
+        while (!done && !mApp.getClock().getIOService().stopped())
+        {
+            mApp.getClock().crank(true);
+        }
+    }
+
+    // Gunzip `type` file of checkpoint `checkpoint` from the archive into the
+    // work dir, leaving the archive untouched; returns the path of the
+    // decompressed copy or an empty string if the archive doesn't have it.
+    std::string
+    fetchCheckpointFile(std::string const& type, uint32_t checkpoint)
+    {
+        FileTransferInfo<int> fi(0, mWorkDir, type, checkpoint);
+        std::string src = mArchiveDir + "/" + fi.remoteName();
+        if (!fs::exists(src))
+        {
+            return std::string();
+        }
+
+        bool done = false;
+        asio::error_code error;
+        auto exit = mApp.getProcessManager().runProcess("gzip -d -c " + src,
+                                                        fi.localPath_nogz());
+        exit.async_wait([&done, &error](asio::error_code const& ec)
+                        {
+                            error = ec;
+                            done = true;
+                        });
+        crankUntil(done);
+        if (error)
+        {
+            throw std::runtime_error("failed to decompress " + src);
+        }
+        return fi.localPath_nogz();
+    }
+
+  public:
+    size_t mLedgers{0};
+    size_t mTransactions{0};
+    double mCloseMs{0};
+
+    ReplayRunner(Application& app, std::string const& archiveDir,
+                 uint32_t lastLedger)
+        : mApp(app)
+        , mArchiveDir(archiveDir)
+        , mLastLedger(lastLedger)
+        , mWorkDir(app.getTmpDirManager().tmpDir("replay"))
+    {
+    }
+
+    bool
+    done() const
+    {
+        return mLastLedger != 0 &&
+               mApp.getLedgerManager().getLastClosedLedgerNum() >= mLastLedger;
+    }
+
+    // Replay all the ledgers of one checkpoint past the LCL; returns false
+    // if the archive has no files for it.
+    bool
+    replayCheckpoint(uint32_t checkpoint)
+    {
+        auto hdrFile =
+            fetchCheckpointFile(HISTORY_FILE_TYPE_LEDGER, checkpoint);
+        auto txFile =
+            fetchCheckpointFile(HISTORY_FILE_TYPE_TRANSACTIONS, checkpoint);
+        if (hdrFile.empty() || txFile.empty())
+        {
+            LOG(INFO) << "No history for checkpoint " << checkpoint << " in "
+                      << mArchiveDir;
+            return false;
+        }
+
+        XDRInputFileStream hdrIn;
+        XDRInputFileStream txIn;
+        hdrIn.open(hdrFile);
+        txIn.open(txFile);
+
+        auto& lm = mApp.getLedgerManager();
+        LedgerHeaderHistoryEntry hHeader;
+        LedgerHeader& header = hHeader.header;
+        TransactionHistoryEntry txHistoryEntry;
+        bool readTxSet = txIn.readOne(txHistoryEntry);
+
+        while (!done() && hdrIn && hdrIn.readOne(hHeader))
+        {
+            if (header.ledgerSeq <= lm.getLastClosedLedgerNum())
+            {
+                continue;
+            }
+            auto const& lcl = lm.getLastClosedLedgerHeader();
+            if (header.ledgerSeq != lm.getLedgerNum() ||
+                header.previousLedgerHash != lcl.hash)
+            {
+                throw std::runtime_error(
+                    "replay history does not connect to LCL " +
+                    LedgerManager::ledgerAbbrev(lcl));
+            }
+
+            TxSetFramePtr txset = std::make_shared<TxSetFrame>(lcl.hash);
+            while (readTxSet && txHistoryEntry.ledgerSeq < header.ledgerSeq)
+            {
+                readTxSet = txIn.readOne(txHistoryEntry);
+            }
+            if (readTxSet && txHistoryEntry.ledgerSeq == header.ledgerSeq)
+            {
+                txset = std::make_shared<TxSetFrame>(mApp.getNetworkID(),
+                                                     txHistoryEntry.txSet);
+                readTxSet = txIn.readOne(txHistoryEntry);
+            }
+
+            // as in catchup: nothing from the archive is applied unless the
+            // header denotes it
+            if (header.scpValue.txSetHash != txset->getContentsHash())
+            {
+                throw std::runtime_error("replay txset hash differs from txset "
+                                         "hash in replay ledger");
+            }
+
+            double sql = sqlTimeMs();
+            double bucket = bucketTimeMs();
+            double apply = txApplyTimeMs();
+            auto start = steady_clock::now();
+
+            LedgerCloseData closeData(header.ledgerSeq, txset,
+                                      header.scpValue);
+            lm.closeLedger(closeData);
+
+            double closeMs =
+                duration<double, std::milli>(steady_clock::now() - start)
+                    .count();
+            sql = sqlTimeMs() - sql;
+            bucket = bucketTimeMs() - bucket;
+            apply = txApplyTimeMs() - apply;
+
+            if (lm.getLastClosedLedgerHeader().hash != hHeader.hash)
+            {
+                throw std::runtime_error(
+                    "replay produced mismatched ledger hash at " +
+                    LedgerManager::ledgerAbbrev(hHeader));
+            }
+
+            LOG(INFO) << "replay ledger=" << header.ledgerSeq
+                      << " txs=" << txset->size() << " close-ms=" << closeMs
+                      << " apply-ms=" << apply << " sql-ms=" << sql
+                      << " bucket-ms=" << bucket;
+
+            ++mLedgers;
+            mTransactions += txset->size();
+            mCloseMs += closeMs;
+        }
+        std::remove(hdrFile.c_str());
+        std::remove(txFile.c_str());
+        return true;
+    }
+};
+}
+
+int
+replay(Config const& cfg, std::string const& archiveDir, uint32_t lastLedger)
+{
+    VirtualClock clock(VirtualClock::REAL_TIME);
+    Application::pointer app = Application::create(clock, cfg);
+
+    if (app->getPersistentState().getState(
+            PersistentState::kDatabaseInitialized) != "true")
+    {
+        LOG(INFO) << "Database is not initialized, try --newdb";
+        return 1;
+    }
+
+    auto& lm = app->getLedgerManager();
+    auto& hm = app->getHistoryManager();
+
+    bool loaded = false;
+    asio::error_code loadError;
+    lm.loadLastKnownLedger([&loaded, &loadError](asio::error_code const& ec)
+                           {
+                               loadError = ec;
+                               loaded = true;
+                           });
+    while (!loaded)
+    {
+        clock.crank(true);
+    }
+    if (loadError)
+    {
+        LOG(ERROR) << "Unable to load last known ledger";
+        return 1;
+    }
+
+    LOG(INFO) << "Replaying history from " << archiveDir << " starting at LCL "
+              << LedgerManager::ledgerAbbrev(lm.getLastClosedLedgerHeader());
+
+    ReplayRunner runner(*app, archiveDir, lastLedger);
+    auto start = steady_clock::now();
+    try
+    {
+        app->getBucketManager().getBucketList().restartMerges(
+            *app, lm.getLastClosedLedgerNum());
+
+        uint32_t freq = hm.getCheckpointFrequency();
+        uint32_t checkpoint =
+            hm.nextCheckpointLedger(lm.getLastClosedLedgerNum() + 2) - 1;
+        while (!runner.done() && runner.replayCheckpoint(checkpoint))
+        {
+            checkpoint += freq;
+        }
+    }
+    catch (std::exception& e)
+    {
+        LOG(ERROR) << "Replay failed: " << e.what();
+        return 1;
+    }
+    double elapsed = duration<double>(steady_clock::now() - start).count();
+
+    LOG(INFO) << "Replayed " << runner.mLedgers << " ledgers, "
+              << runner.mTransactions << " transactions in " << elapsed
+              << "s (" << runner.mCloseMs << "ms closing ledgers)";
+    if (runner.mCloseMs > 0)
+    {
+        LOG(INFO) << "Throughput: "
+                  << (runner.mTransactions * 1000.0 / runner.mCloseMs)
+                  << " txs/sec, "
+                  << (runner.mLedgers * 1000.0 / runner.mCloseMs)
+                  << " ledgers/sec";
+    }
+    app->reportCfgMetrics();
+    return 0;
+}
+}
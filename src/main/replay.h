@@ -0,0 +1,23 @@
+#pragma once
+
+// Copyright 2015 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include <cstdint>
+#include <string>
+
+namespace stellar
+{
+
+class Config;
+
+// Replay the ledgers following the database's LCL from the history archive
+// rooted at local directory `archiveDir`, up to and including `lastLedger`
+// (or until the archive runs out, if `lastLedger` is 0), applying each one
+// through LedgerManager::closeLedger without running consensus. Logs
+// per-ledger apply, SQL and bucket times and a final throughput summary.
+// Returns a process exit code.
+int replay(Config const& cfg, std::string const& archiveDir,
+           uint32_t lastLedger);
+}
@@ -7,6 +7,7 @@
 #include "main/Application.h"
 #include "overlay/OverlayManager.h"
 #include "herder/Herder.h"
+#include "util/CachedXDR.h"
 
 #include "medida/counter.h"
 #include "medida/metrics_registry.h"
@@ -81,7 +82,9 @@ Floodgate::broadcast(StellarMessage const& msg, bool force)
     {
         return;
     }
-    Hash index = sha256(xdr::xdr_to_opaque(msg));
+    // encoded once, for the index and for every peer it is sent to
+    CachedXDR encoded;
+    Hash index = sha256(encoded.get(msg));
     auto result = mFloodMap.find(index);
     if (result == mFloodMap.end() || force)
     { // no one has sent us this message
@@ -95,7 +98,7 @@ Floodgate::broadcast(StellarMessage const& msg, bool force)
         {
             if (peer->getState() == Peer::GOT_HELLO)
             {
-                peer->sendMessage(msg);
+                peer->sendMessage(msg, encoded.get(msg));
                 record->mPeersTold.push_back(peer);
             }
         }
@@ -110,7 +113,7 @@ Floodgate::broadcast(StellarMessage const& msg, bool force)
             {
                 if (peer->getState() == Peer::GOT_HELLO)
                 {
-                    peer->sendMessage(msg);
+                    peer->sendMessage(msg, encoded.get(msg));
                     peersTold.push_back(peer);
                 }
             }
@@ -175,6 +175,19 @@ Peer::sendMessage(StellarMessage const& msg)
     this->sendMessage(std::move(xdrBytes));
 }
 
+void
+Peer::sendMessage(StellarMessage const& msg,
+                  xdr::opaque_vec<> const& xdrBytes)
+{
+    CLOG(TRACE, "Overlay") << "(" << PubKeyUtils::toShortString(
+                                         mApp.getConfig().PEER_PUBLIC_KEY)
+                           << ")send: " << msg.type()
+                           << " to : " << PubKeyUtils::toShortString(mPeerID);
+    xdr::msg_ptr m = xdr::message_t::alloc(xdrBytes.size());
+    memcpy(m->data(), xdrBytes.data(), xdrBytes.size());
+    this->sendMessage(std::move(m));
+}
+
 void
 Peer::recvMessage(xdr::msg_ptr const& msg)
 {
@@ -120,6 +120,10 @@ class Peer : public std::enable_shared_from_this<Peer>,
     void sendGetQuorumSet(uint256 const& setID);
 
     void sendMessage(StellarMessage const& msg);
+    // `msg`, already encoded as `xdrBytes`: flooding encodes a message once
+    // for all the peers it goes to.
+    void sendMessage(StellarMessage const& msg,
+                     xdr::opaque_vec<> const& xdrBytes);
 
     PeerRole
     getRole() const
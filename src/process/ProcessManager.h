@@ -23,8 +23,24 @@ class RealTimer;
  * No facilities exist for reading or writing to the subprocess I/O ports. This
  * is strictly for "run a command, wait to see if it worked"; a glorified
  * asynchronous version of system().
+ *
+ * Each subprocess belongs to a ProcessClass. When a slot frees up, the oldest
+ * pending process of the highest-priority class that is still under its own
+ * concurrency limit runs next, so a burst of publish uploads can't hold up
+ * catchup downloads. Catchup may use all MAX_CONCURRENT_SUBPROCESSES slots,
+ * publish three quarters of them and maintenance a quarter (at least one
+ * each).
  */
 
+// In decreasing order of priority.
+enum ProcessClass
+{
+    PROCESS_CATCHUP = 0,
+    PROCESS_PUBLISH = 1,
+    PROCESS_MAINTENANCE = 2,
+    PROCESS_NUM_CLASSES = 3
+};
+
 // Wrap a platform-specific Impl strategy that monitors process-exits in a
 // helper simulating an event-notifier, via a general asio timer set to maximum
 // duration. Clients can register handlers on this and they are wrapped into
@@ -48,9 +64,15 @@ class ProcessManager : public NonMovableOrCopyable
 {
   public:
     static std::unique_ptr<ProcessManager> create(Application& app);
-    virtual ProcessExitEvent runProcess(std::string const& cmdLine,
-                                        std::string outputFile = "") = 0;
+    virtual ProcessExitEvent
+    runProcess(std::string const& cmdLine, std::string outputFile = "",
+               ProcessClass cls = PROCESS_MAINTENANCE) = 0;
     virtual size_t getNumRunningProcesses() = 0;
+
+    // Drop any not-yet-started processes of class `cls`, completing their
+    // events with asio::error::operation_aborted. Processes already running
+    // are left alone. Returns the number of processes cancelled.
+    virtual size_t cancelPendingProcesses(ProcessClass cls) = 0;
     virtual ~ProcessManager()
     {
     }
@@ -18,9 +18,12 @@
 #include "process/ProcessManagerImpl.h"
 
 #include "medida/counter.h"
+#include "medida/meter.h"
 #include "medida/metrics_registry.h"
+#include "medida/timer.h"
 
 #include <algorithm>
+#include <chrono>
 #include <functional>
 #include <iterator>
 #include <mutex>
@@ -43,6 +46,33 @@ std::map<int, std::shared_ptr<ProcessExitEvent::Impl>>
 
 size_t ProcessManagerImpl::gNumProcessesActive = 0;
 
+static char const* const kProcessClassNames[PROCESS_NUM_CLASSES] = {
+    "catchup", "publish", "maintenance"};
+
+static std::vector<medida::Timer*>
+newClassTimers(Application& app, std::string const& name)
+{
+    std::vector<medida::Timer*> timers;
+    for (auto className : kProcessClassNames)
+    {
+        timers.push_back(
+            &app.getMetrics().NewTimer({"process", className, name}));
+    }
+    return timers;
+}
+
+static std::vector<medida::Meter*>
+newClassMeters(Application& app, std::string const& name)
+{
+    std::vector<medida::Meter*> meters;
+    for (auto className : kProcessClassNames)
+    {
+        meters.push_back(&app.getMetrics().NewMeter(
+            {"process", className, name}, "process"));
+    }
+    return meters;
+}
+
 size_t
 ProcessManagerImpl::getNumRunningProcesses()
 {
@@ -50,6 +80,21 @@ ProcessManagerImpl::getNumRunningProcesses()
     return gNumProcessesActive;
 }
 
+size_t
+ProcessManagerImpl::getClassLimit(ProcessClass cls) const
+{
+    size_t maxProcs = mApp.getConfig().MAX_CONCURRENT_SUBPROCESSES;
+    switch (cls)
+    {
+    case PROCESS_CATCHUP:
+        return maxProcs;
+    case PROCESS_PUBLISH:
+        return std::max<size_t>(1, maxProcs * 3 / 4);
+    default:
+        return std::max<size_t>(1, maxProcs / 4);
+    }
+}
+
 ProcessManagerImpl::~ProcessManagerImpl()
 {
 }
@@ -62,6 +107,9 @@ class ProcessExitEvent::Impl
     std::shared_ptr<asio::error_code> mOuterEc;
     std::string mCmdLine;
     std::string mOutFile;
+    ProcessClass mClass;
+    std::chrono::steady_clock::time_point mQueuedAt;
+    std::chrono::steady_clock::time_point mStartedAt;
     bool mRunning{false};
 #ifdef _WIN32
     asio::windows::object_handle mProcessHandle;
@@ -71,11 +119,13 @@ class ProcessExitEvent::Impl
     Impl(std::shared_ptr<RealTimer> const& outerTimer,
          std::shared_ptr<asio::error_code> const& outerEc,
          std::string const& cmdLine, std::string const& outFile,
-         ProcessManagerImpl& pm)
+         ProcessClass cls, ProcessManagerImpl& pm)
         : mOuterTimer(outerTimer)
         , mOuterEc(outerEc)
         , mCmdLine(cmdLine)
         , mOutFile(outFile)
+        , mClass(cls)
+        , mQueuedAt(std::chrono::steady_clock::now())
 #ifdef _WIN32
         , mProcessHandle(outerTimer->get_io_service())
 #endif
@@ -83,6 +133,17 @@ class ProcessExitEvent::Impl
     {
     }
     void run();
+
+    // Deliver `ec` to the waiter. Rather than cancelling the outer timer,
+    // which only reaches a wait that is already armed, expire it now: this
+    // also completes a wait the caller arms later, as happens when a spawn
+    // fails synchronously inside runProcess.
+    void
+    complete(asio::error_code const& ec)
+    {
+        *mOuterEc = ec;
+        mOuterTimer->expires_from_now(std::chrono::system_clock::duration(0));
+    }
 };
 
 #ifdef _WIN32
@@ -91,6 +152,11 @@ class ProcessExitEvent::Impl
 
 ProcessManagerImpl::ProcessManagerImpl(Application& app)
     : mApp(app)
+    , mPendingImpls(PROCESS_NUM_CLASSES)
+    , mNumRunning(PROCESS_NUM_CLASSES, 0)
+    , mQueueTimers(newClassTimers(app, "queue"))
+    , mRunTimers(newClassTimers(app, "run"))
+    , mCancelMeters(newClassMeters(app, "cancel"))
     , mSigChild(app.getClock().getIOService())
     , mImplsSize(app.getMetrics().NewCounter({"process", "memory", "handles"}))
 {
@@ -175,13 +241,7 @@ ProcessExitEvent::Impl::run()
     mProcessHandle.async_wait(
         [sf](asio::error_code ec)
         {
-            {
-                std::lock_guard<std::recursive_mutex> guard(
-                    ProcessManagerImpl::gImplsMutex);
-                --ProcessManagerImpl::gNumProcessesActive;
-                sf->mProcManagerImpl.mImplsSize.set_count(
-                    ProcessManagerImpl::gNumProcessesActive);
-            }
+            sf->mProcManagerImpl.processExited(*sf);
             // Fire off any new processes we've made room for before we
             // trigger the callback.
             sf->mProcManagerImpl.maybeRunPendingProcesses();
@@ -214,6 +274,11 @@ ProcessExitEvent::Impl::run()
 
 ProcessManagerImpl::ProcessManagerImpl(Application& app)
     : mApp(app)
+    , mPendingImpls(PROCESS_NUM_CLASSES)
+    , mNumRunning(PROCESS_NUM_CLASSES, 0)
+    , mQueueTimers(newClassTimers(app, "queue"))
+    , mRunTimers(newClassTimers(app, "run"))
+    , mCancelMeters(newClassMeters(app, "cancel"))
     , mSigChild(app.getClock().getIOService(), SIGCHLD)
     , mImplsSize(app.getMetrics().NewCounter({"process", "memory", "handles"}))
 {
@@ -296,12 +361,17 @@ ProcessManagerImpl::handleSignalWait()
                 ec = asio::error_code(1, asio::system_category());
             }
 
-            --gNumProcessesActive;
             gImpls.erase(pair);
+            impl->mProcManagerImpl.processExited(*impl);
 
             // Fire off any new processes we've made room for before we
-            // trigger the callback.
-            maybeRunPendingProcesses();
+            // trigger the callback. The exited process may have belonged to
+            // another ProcessManager in this process, so give both a chance.
+            impl->mProcManagerImpl.maybeRunPendingProcesses();
+            if (&impl->mProcManagerImpl != this)
+            {
+                maybeRunPendingProcesses();
+            }
 
             *(impl->mOuterEc) = ec;
             impl->mOuterTimer->cancel();
@@ -394,14 +464,15 @@ ProcessExitEvent::Impl::run()
 #endif
 
 ProcessExitEvent
-ProcessManagerImpl::runProcess(std::string const& cmdLine, std::string outFile)
+ProcessManagerImpl::runProcess(std::string const& cmdLine, std::string outFile,
+                               ProcessClass cls)
 {
     std::lock_guard<std::recursive_mutex> guard(gImplsMutex);
     auto& svc = mApp.getClock().getIOService();
     ProcessExitEvent pe(svc);
     pe.mImpl = std::make_shared<ProcessExitEvent::Impl>(
-        pe.mTimer, pe.mEc, cmdLine, outFile, *this);
-    mPendingImpls.push_back(pe.mImpl);
+        pe.mTimer, pe.mEc, cmdLine, outFile, cls, *this);
+    mPendingImpls.at(cls).push_back(pe.mImpl);
 
     maybeRunPendingProcesses();
     return std::move(pe);
@@ -411,15 +482,33 @@ void
 ProcessManagerImpl::maybeRunPendingProcesses()
 {
     std::lock_guard<std::recursive_mutex> guard(gImplsMutex);
-    while (!mPendingImpls.empty() &&
-           gNumProcessesActive < mApp.getConfig().MAX_CONCURRENT_SUBPROCESSES)
+    while (gNumProcessesActive < mApp.getConfig().MAX_CONCURRENT_SUBPROCESSES)
     {
-        auto i = mPendingImpls.front();
-        mPendingImpls.pop_front();
+        // Pick the highest-priority class with work pending and room to run.
+        int cls = 0;
+        for (; cls < PROCESS_NUM_CLASSES; ++cls)
+        {
+            if (!mPendingImpls[cls].empty() &&
+                mNumRunning[cls] <
+                    getClassLimit(static_cast<ProcessClass>(cls)))
+            {
+                break;
+            }
+        }
+        if (cls == PROCESS_NUM_CLASSES)
+        {
+            break;
+        }
+
+        auto i = mPendingImpls[cls].front();
+        mPendingImpls[cls].pop_front();
         try
         {
             CLOG(DEBUG, "Process") << "Running: " << i->mCmdLine;
             i->run();
+            i->mStartedAt = std::chrono::steady_clock::now();
+            mQueueTimers[cls]->Update(i->mStartedAt - i->mQueuedAt);
+            ++mNumRunning[cls];
             ++gNumProcessesActive;
             mImplsSize.set_count(gNumProcessesActive);
         }
@@ -427,10 +516,38 @@ ProcessManagerImpl::maybeRunPendingProcesses()
         {
             CLOG(ERROR, "Process") << "Error starting process: " << e.what();
             CLOG(ERROR, "Process") << "When running: " << i->mCmdLine;
+            i->complete(std::make_error_code(std::errc::io_error));
         }
     }
 }
 
+void
+ProcessManagerImpl::processExited(ProcessExitEvent::Impl& impl)
+{
+    std::lock_guard<std::recursive_mutex> guard(gImplsMutex);
+    --gNumProcessesActive;
+    --mNumRunning[impl.mClass];
+    mImplsSize.set_count(gNumProcessesActive);
+    mRunTimers[impl.mClass]->Update(std::chrono::steady_clock::now() -
+                                    impl.mStartedAt);
+}
+
+size_t
+ProcessManagerImpl::cancelPendingProcesses(ProcessClass cls)
+{
+    std::lock_guard<std::recursive_mutex> guard(gImplsMutex);
+    auto& pending = mPendingImpls.at(cls);
+    size_t n = pending.size();
+    for (auto const& i : pending)
+    {
+        CLOG(DEBUG, "Process") << "Cancelling: " << i->mCmdLine;
+        i->complete(asio::error::operation_aborted);
+    }
+    pending.clear();
+    mCancelMeters[cls]->Mark(n);
+    return n;
+}
+
 ProcessExitEvent::ProcessExitEvent(asio::io_service& io_service)
     : mTimer(std::make_shared<RealTimer>(io_service))
     , mImpl(nullptr)
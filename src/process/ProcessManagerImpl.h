@@ -7,10 +7,13 @@
 #include "process/ProcessManager.h"
 #include <mutex>
 #include <deque>
+#include <vector>
 
 namespace medida
 {
 class Counter;
+class Meter;
+class Timer;
 }
 
 namespace stellar
@@ -29,8 +32,17 @@ class ProcessManagerImpl : public ProcessManager
 
     Application& mApp;
 
-    std::deque<std::shared_ptr<ProcessExitEvent::Impl>> mPendingImpls;
+    // Indexed by ProcessClass.
+    std::vector<std::deque<std::shared_ptr<ProcessExitEvent::Impl>>>
+        mPendingImpls;
+    std::vector<size_t> mNumRunning;
+    std::vector<medida::Timer*> mQueueTimers;
+    std::vector<medida::Timer*> mRunTimers;
+    std::vector<medida::Meter*> mCancelMeters;
+
+    size_t getClassLimit(ProcessClass cls) const;
     void maybeRunPendingProcesses();
+    void processExited(ProcessExitEvent::Impl& impl);
 
     // These are only used on POSIX, but they're harmless here.
     asio::signal_set mSigChild;
@@ -42,9 +54,11 @@ class ProcessManagerImpl : public ProcessManager
 
   public:
     ProcessManagerImpl(Application& app);
-    ProcessExitEvent runProcess(std::string const& cmdLine,
-                                std::string outFile = "") override;
+    ProcessExitEvent
+    runProcess(std::string const& cmdLine, std::string outFile = "",
+               ProcessClass cls = PROCESS_MAINTENANCE) override;
     size_t getNumRunningProcesses() override;
+    size_t cancelPendingProcesses(ProcessClass cls) override;
     ~ProcessManagerImpl() override;
 };
 }
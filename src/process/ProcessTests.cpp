@@ -71,6 +71,32 @@ TEST_CASE("subprocess fails", "[process]")
     REQUIRE(failed);
 }
 
+TEST_CASE("subprocess fails to start", "[process]")
+{
+    VirtualClock clock;
+    Config const& cfg = getTestConfig();
+    Application::pointer app = Application::create(clock, cfg);
+    // The spawn fails inside runProcess, before the wait below is armed.
+    auto evt = app->getProcessManager().runProcess(
+        "stellar-core-test-no-such-program");
+    bool exited = false;
+    asio::error_code result;
+    evt.async_wait([&](asio::error_code ec)
+                   {
+                       CLOG(DEBUG, "Process") << "process exited: " << ec;
+                       result = ec;
+                       exited = true;
+                   });
+
+    while (!exited && !clock.getIOService().stopped())
+    {
+        clock.crank(true);
+    }
+    REQUIRE(exited);
+    REQUIRE(result == std::make_error_code(std::errc::io_error));
+    REQUIRE(app->getProcessManager().getNumRunningProcesses() == 0);
+}
+
 TEST_CASE("subprocess redirect to file", "[process]")
 {
     VirtualClock clock;
@@ -158,3 +184,78 @@ TEST_CASE("subprocess storm", "[process]")
         REQUIRE(fs::exists(dst));
     }
 }
+
+TEST_CASE("subprocess priority classes", "[process]")
+{
+    VirtualClock clock;
+    Config cfg(getTestConfig());
+    cfg.MAX_CONCURRENT_SUBPROCESSES = 1;
+    Application::pointer appPtr = Application::create(clock, cfg);
+    Application& app = *appPtr;
+    auto& pm = app.getProcessManager();
+
+    // With a single slot, the first maintenance process starts immediately
+    // and everything else queues; the catchup process queued last should
+    // still run before the remaining maintenance and publish work.
+    std::vector<std::string> order;
+    size_t completed = 0;
+    auto track = [&](std::string const& name, ProcessClass cls)
+    {
+        auto evt = pm.runProcess("hostname", "", cls);
+        evt.async_wait([&, name](asio::error_code ec)
+                       {
+                           CHECK(!ec);
+                           order.push_back(name);
+                           ++completed;
+                       });
+    };
+    track("maintenance-1", PROCESS_MAINTENANCE);
+    track("maintenance-2", PROCESS_MAINTENANCE);
+    track("publish", PROCESS_PUBLISH);
+    track("catchup", PROCESS_CATCHUP);
+
+    while (completed < 4 && !clock.getIOService().stopped())
+    {
+        clock.crank(true);
+    }
+    std::vector<std::string> expected = {"maintenance-1", "catchup", "publish",
+                                         "maintenance-2"};
+    REQUIRE(order == expected);
+}
+
+TEST_CASE("subprocess cancellation", "[process]")
+{
+    VirtualClock clock;
+    Config cfg(getTestConfig());
+    cfg.MAX_CONCURRENT_SUBPROCESSES = 1;
+    Application::pointer appPtr = Application::create(clock, cfg);
+    Application& app = *appPtr;
+    auto& pm = app.getProcessManager();
+
+    size_t n = 4;
+    size_t completed = 0;
+    size_t aborted = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        auto evt = pm.runProcess("hostname", "", PROCESS_CATCHUP);
+        evt.async_wait([&](asio::error_code ec)
+                       {
+                           if (ec == asio::error::operation_aborted)
+                           {
+                               ++aborted;
+                           }
+                           ++completed;
+                       });
+    }
+
+    // The first process is already running and can't be cancelled.
+    REQUIRE(pm.cancelPendingProcesses(PROCESS_CATCHUP) == n - 1);
+    REQUIRE(pm.cancelPendingProcesses(PROCESS_CATCHUP) == 0);
+
+    while (completed < n && !clock.getIOService().stopped())
+    {
+        clock.crank(true);
+    }
+    REQUIRE(aborted == n - 1);
+    REQUIRE(pm.getNumRunningProcesses() == 0);
+}
@@ -3,13 +3,11 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "transactions/AllowTrustOpFrame.h"
+#include "transactions/ApplyMeters.h"
 #include "ledger/LedgerManager.h"
 #include "ledger/TrustFrame.h"
 #include "database/Database.h"
 
-#include "medida/meter.h"
-#include "medida/metrics_registry.h"
-
 namespace stellar
 {
 AllowTrustOpFrame::AllowTrustOpFrame(Operation const& op, OperationResult& res,
@@ -26,13 +24,12 @@ AllowTrustOpFrame::getNeededThreshold() const
 }
 
 bool
-AllowTrustOpFrame::doApply(medida::MetricsRegistry& metrics, LedgerDelta& delta,
+AllowTrustOpFrame::doApply(ApplyMeters& meters, LedgerDelta& delta,
                            LedgerManager& ledgerManager)
 {
     if (!(mSourceAccount->getAccount().flags & AUTH_REQUIRED_FLAG))
     { // this account doesn't require authorization to hold credit
-        metrics.NewMeter({"op-allow-trust", "failure", "not-required"},
-                         "operation").Mark();
+        meters.mark(ApplyMeters::ALLOW_TRUST_FAILURE_NOT_REQUIRED);
         innerResult().code(ALLOW_TRUST_TRUST_NOT_REQUIRED);
         return false;
     }
@@ -40,8 +37,7 @@ AllowTrustOpFrame::doApply(medida::MetricsRegistry& metrics, LedgerDelta& delta,
     if (!(mSourceAccount->getAccount().flags & AUTH_REVOCABLE_FLAG) &&
         !mAllowTrust.authorize)
     {
-        metrics.NewMeter({"op-allow-trust", "failure", "cant-revoke"},
-                         "operation").Mark();
+        meters.mark(ApplyMeters::ALLOW_TRUST_FAILURE_CANT_REVOKE);
         innerResult().code(ALLOW_TRUST_CANT_REVOKE);
         return false;
     }
@@ -65,14 +61,12 @@ AllowTrustOpFrame::doApply(medida::MetricsRegistry& metrics, LedgerDelta& delta,
 
     if (!trustLine)
     {
-        metrics.NewMeter({"op-allow-trust", "failure", "no-trust-line"},
-                         "operation").Mark();
+        meters.mark(ApplyMeters::ALLOW_TRUST_FAILURE_NO_TRUST_LINE);
         innerResult().code(ALLOW_TRUST_NO_TRUST_LINE);
         return false;
     }
 
-    metrics.NewMeter({"op-allow-trust", "success", "apply"}, "operation")
-        .Mark();
+    meters.mark(ApplyMeters::ALLOW_TRUST_SUCCESS_APPLY);
     innerResult().code(ALLOW_TRUST_SUCCESS);
 
     trustLine->setAuthorized(mAllowTrust.authorize);
@@ -83,13 +77,11 @@ AllowTrustOpFrame::doApply(medida::MetricsRegistry& metrics, LedgerDelta& delta,
 }
 
 bool
-AllowTrustOpFrame::doCheckValid(medida::MetricsRegistry& metrics)
+AllowTrustOpFrame::doCheckValid(ApplyMeters& meters)
 {
     if (mAllowTrust.asset.type() == ASSET_TYPE_NATIVE)
     {
-        metrics.NewMeter(
-                    {"op-allow-trust", "invalid", "malformed-non-alphanum"},
-                    "operation").Mark();
+        meters.mark(ApplyMeters::ALLOW_TRUST_INVALID_MALFORMED_NON_ALPHANUM);
         innerResult().code(ALLOW_TRUST_MALFORMED);
         return false;
     }
@@ -108,13 +100,31 @@ AllowTrustOpFrame::doCheckValid(medida::MetricsRegistry& metrics)
 
     if (!isAssetValid(ci))
     {
-        metrics.NewMeter(
-                    {"op-allow-trust", "invalid", "malformed-invalid-asset"},
-                    "operation").Mark();
+        meters.mark(ApplyMeters::ALLOW_TRUST_INVALID_MALFORMED_INVALID_ASSET);
         innerResult().code(ALLOW_TRUST_MALFORMED);
         return false;
     }
 
     return true;
 }
+
+void
+AllowTrustOpFrame::addPrefetchKeys(Operation const& op, AccountID const& source,
+                                   std::vector<LedgerKey>& keys)
+{
+    auto const& allowTrust = op.body.allowTrustOp();
+    Asset ci;
+    ci.type(allowTrust.asset.type());
+    if (allowTrust.asset.type() == ASSET_TYPE_CREDIT_ALPHANUM4)
+    {
+        ci.alphaNum4().assetCode = allowTrust.asset.assetCode4();
+        ci.alphaNum4().issuer = source;
+    }
+    else if (allowTrust.asset.type() == ASSET_TYPE_CREDIT_ALPHANUM12)
+    {
+        ci.alphaNum12().assetCode = allowTrust.asset.assetCode12();
+        ci.alphaNum12().issuer = source;
+    }
+    addTrustLineKey(keys, allowTrust.trustor, ci);
+}
 }
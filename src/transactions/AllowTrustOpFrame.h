@@ -23,9 +23,11 @@ class AllowTrustOpFrame : public OperationFrame
     AllowTrustOpFrame(Operation const& op, OperationResult& res,
                       TransactionFrame& parentTx);
 
-    bool doApply(medida::MetricsRegistry& metrics, LedgerDelta& delta,
+    bool doApply(ApplyMeters& meters, LedgerDelta& delta,
                  LedgerManager& ledgerManager) override;
-    bool doCheckValid(medida::MetricsRegistry& metrics) override;
+    bool doCheckValid(ApplyMeters& meters) override;
+    static void addPrefetchKeys(Operation const& op, AccountID const& source,
+                                std::vector<LedgerKey>& keys);
 
     static AllowTrustResultCode
     getInnerCode(OperationResult const& res)
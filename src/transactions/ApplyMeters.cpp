@@ -0,0 +1,294 @@
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "transactions/ApplyMeters.h"
+#include <stdexcept>
+
+#include "medida/metrics_registry.h"
+
+namespace stellar
+{
+
+namespace
+{
+struct MeterName
+{
+    ApplyMeters::Meter mMeter;
+    char const* mName[3];
+    char const* mEventType;
+};
+
+// one row per ApplyMeters::Meter, in the same order
+MeterName const METER_NAMES[] = {
+    {ApplyMeters::TRANSACTION_INVALID_BAD_AUTH,
+     {"transaction", "invalid", "bad-auth"},
+     "transaction"},
+    {ApplyMeters::TRANSACTION_INVALID_BAD_AUTH_EXTRA,
+     {"transaction", "invalid", "bad-auth-extra"},
+     "transaction"},
+    {ApplyMeters::TRANSACTION_INVALID_BAD_SEQ,
+     {"transaction", "invalid", "bad-seq"},
+     "transaction"},
+    {ApplyMeters::TRANSACTION_INVALID_INSUFFICIENT_BALANCE,
+     {"transaction", "invalid", "insufficient-balance"},
+     "transaction"},
+    {ApplyMeters::TRANSACTION_INVALID_INSUFFICIENT_FEE,
+     {"transaction", "invalid", "insufficient-fee"},
+     "transaction"},
+    {ApplyMeters::TRANSACTION_INVALID_INVALID_OP,
+     {"transaction", "invalid", "invalid-op"},
+     "transaction"},
+    {ApplyMeters::TRANSACTION_INVALID_MISSING_OPERATION,
+     {"transaction", "invalid", "missing-operation"},
+     "transaction"},
+    {ApplyMeters::TRANSACTION_INVALID_NO_ACCOUNT,
+     {"transaction", "invalid", "no-account"},
+     "transaction"},
+    {ApplyMeters::TRANSACTION_INVALID_TOO_EARLY,
+     {"transaction", "invalid", "too-early"},
+     "transaction"},
+    {ApplyMeters::TRANSACTION_INVALID_TOO_LATE,
+     {"transaction", "invalid", "too-late"},
+     "transaction"},
+    {ApplyMeters::OPERATION_INVALID_BAD_AUTH,
+     {"operation", "invalid", "bad-auth"},
+     "operation"},
+    {ApplyMeters::OPERATION_INVALID_NO_ACCOUNT,
+     {"operation", "invalid", "no-account"},
+     "operation"},
+    {ApplyMeters::ALLOW_TRUST_FAILURE_CANT_REVOKE,
+     {"op-allow-trust", "failure", "cant-revoke"},
+     "operation"},
+    {ApplyMeters::ALLOW_TRUST_FAILURE_NO_TRUST_LINE,
+     {"op-allow-trust", "failure", "no-trust-line"},
+     "operation"},
+    {ApplyMeters::ALLOW_TRUST_FAILURE_NOT_REQUIRED,
+     {"op-allow-trust", "failure", "not-required"},
+     "operation"},
+    {ApplyMeters::ALLOW_TRUST_INVALID_MALFORMED_INVALID_ASSET,
+     {"op-allow-trust", "invalid", "malformed-invalid-asset"},
+     "operation"},
+    {ApplyMeters::ALLOW_TRUST_INVALID_MALFORMED_NON_ALPHANUM,
+     {"op-allow-trust", "invalid", "malformed-non-alphanum"},
+     "operation"},
+    {ApplyMeters::ALLOW_TRUST_SUCCESS_APPLY,
+     {"op-allow-trust", "success", "apply"},
+     "operation"},
+    {ApplyMeters::CHANGE_TRUST_FAILURE_INVALID_LIMIT,
+     {"op-change-trust", "failure", "invalid-limit"},
+     "operation"},
+    {ApplyMeters::CHANGE_TRUST_FAILURE_LOW_RESERVE,
+     {"op-change-trust", "failure", "low-reserve"},
+     "operation"},
+    {ApplyMeters::CHANGE_TRUST_FAILURE_NO_ISSUER,
+     {"op-change-trust", "failure", "no-issuer"},
+     "operation"},
+    {ApplyMeters::CHANGE_TRUST_INVALID_MALFORMED_INVALID_ASSET,
+     {"op-change-trust", "invalid", "malformed-invalid-asset"},
+     "operation"},
+    {ApplyMeters::CHANGE_TRUST_INVALID_MALFORMED_NEGATIVE_LIMIT,
+     {"op-change-trust", "invalid", "malformed-negative-limit"},
+     "operation"},
+    {ApplyMeters::CHANGE_TRUST_SUCCESS_APPLY,
+     {"op-change-trust", "success", "apply"},
+     "operation"},
+    {ApplyMeters::CREATE_ACCOUNT_FAILURE_ALREADY_EXIST,
+     {"op-create-account", "failure", "already-exist"},
+     "operation"},
+    {ApplyMeters::CREATE_ACCOUNT_FAILURE_LOW_RESERVE,
+     {"op-create-account", "failure", "low-reserve"},
+     "operation"},
+    {ApplyMeters::CREATE_ACCOUNT_FAILURE_UNDERFUNDED,
+     {"op-create-account", "failure", "underfunded"},
+     "operation"},
+    {ApplyMeters::CREATE_ACCOUNT_INVALID_MALFORMED_TO_SELF,
+     {"op-create-account", "invalid", "malformed-destination-equals-source"},
+     "operation"},
+    {ApplyMeters::CREATE_ACCOUNT_INVALID_MALFORMED_NEGATIVE_BALANCE,
+     {"op-create-account", "invalid", "malformed-negative-balance"},
+     "operation"},
+    {ApplyMeters::CREATE_ACCOUNT_SUCCESS_APPLY,
+     {"op-create-account", "success", "apply"},
+     "operation"},
+    {ApplyMeters::CREATE_OFFER_SUCCESS_APPLY,
+     {"op-create-offer", "success", "apply"},
+     "operation"},
+    {ApplyMeters::INFLATION_FAILURE_NOT_TIME,
+     {"op-inflation", "failure", "not-time"},
+     "operation"},
+    {ApplyMeters::INFLATION_SUCCESS_APPLY,
+     {"op-inflation", "success", "apply"},
+     "operation"},
+    {ApplyMeters::MANAGE_OFFER_INVALID_EQUAL_CURRENCIES,
+     {"op-manage-offer", "invalid", "equal-currencies"},
+     "operation"},
+    {ApplyMeters::MANAGE_OFFER_INVALID_INVALID_ASSET,
+     {"op-manage-offer", "invalid", "invalid-asset"},
+     "operation"},
+    {ApplyMeters::MANAGE_OFFER_INVALID_LINE_FULL,
+     {"op-manage-offer", "invalid", "line-full"},
+     "operation"},
+    {ApplyMeters::MANAGE_OFFER_INVALID_LOW_RESERVE,
+     {"op-manage-offer", "invalid", "low reserve"},
+     "operation"},
+    {ApplyMeters::MANAGE_OFFER_INVALID_NEGATIVE_OR_ZERO_VALUES,
+     {"op-manage-offer", "invalid", "negative-or-zero-values"},
+     "operation"},
+    {ApplyMeters::MANAGE_OFFER_INVALID_NO_TRUST,
+     {"op-manage-offer", "invalid", "no-trust"},
+     "operation"},
+    {ApplyMeters::MANAGE_OFFER_INVALID_NOT_AUTHORIZED,
+     {"op-manage-offer", "invalid", "not-authorized"},
+     "operation"},
+    {ApplyMeters::MANAGE_OFFER_INVALID_NOT_FOUND,
+     {"op-manage-offer", "invalid", "not-found"},
+     "operation"},
+    {ApplyMeters::MANAGE_OFFER_INVALID_UNDERFUNDED_ABSENT,
+     {"op-manage-offer", "invalid", "underfunded-absent"},
+     "operation"},
+    {ApplyMeters::MERGE_FAILURE_CREDIT_HELD,
+     {"op-merge", "failure", "credit-held"},
+     "operation"},
+    {ApplyMeters::MERGE_FAILURE_HAS_CREDIT,
+     {"op-merge", "failure", "has-credit"},
+     "operation"},
+    {ApplyMeters::MERGE_FAILURE_NO_ACCOUNT,
+     {"op-merge", "failure", "no-account"},
+     "operation"},
+    {ApplyMeters::MERGE_INVALID_MALFORMED_SELF_MERGE,
+     {"op-merge", "invalid", "malformed-self-merge"},
+     "operation"},
+    {ApplyMeters::MERGE_SUCCESS_APPLY,
+     {"op-merge", "success", "apply"},
+     "operation"},
+    {ApplyMeters::PATH_PAYMENT_FAILURE_LINE_FULL,
+     {"op-path-payment", "failure", "line-full"},
+     "operation"},
+    {ApplyMeters::PATH_PAYMENT_FAILURE_NO_DESTINATION,
+     {"op-path-payment", "failure", "no-destination"},
+     "operation"},
+    {ApplyMeters::PATH_PAYMENT_FAILURE_NO_ISSUER,
+     {"op-path-payment", "failure", "no-issuer"},
+     "operation"},
+    {ApplyMeters::PATH_PAYMENT_FAILURE_NO_TRUST,
+     {"op-path-payment", "failure", "no-trust"},
+     "operation"},
+    {ApplyMeters::PATH_PAYMENT_FAILURE_NOT_AUTHORIZED,
+     {"op-path-payment", "failure", "not-authorized"},
+     "operation"},
+    {ApplyMeters::PATH_PAYMENT_FAILURE_OFFER_CROSS_SELF,
+     {"op-path-payment", "failure", "offer-cross-self"},
+     "operation"},
+    {ApplyMeters::PATH_PAYMENT_FAILURE_OVER_SEND_MAX,
+     {"op-path-payment", "failure", "over-send-max"},
+     "operation"},
+    {ApplyMeters::PATH_PAYMENT_FAILURE_SRC_NO_TRUST,
+     {"op-path-payment", "failure", "src-no-trust"},
+     "operation"},
+    {ApplyMeters::PATH_PAYMENT_FAILURE_SRC_NOT_AUTHORIZED,
+     {"op-path-payment", "failure", "src-not-authorized"},
+     "operation"},
+    {ApplyMeters::PATH_PAYMENT_FAILURE_TOO_FEW_OFFERS,
+     {"op-path-payment", "failure", "too-few-offers"},
+     "operation"},
+    {ApplyMeters::PATH_PAYMENT_FAILURE_UNDERFUNDED,
+     {"op-path-payment", "failure", "underfunded"},
+     "operation"},
+    {ApplyMeters::PATH_PAYMENT_INVALID_MALFORMED_AMOUNTS,
+     {"op-path-payment", "invalid", "malformed-amounts"},
+     "operation"},
+    {ApplyMeters::PATH_PAYMENT_INVALID_MALFORMED_CURRENCIES,
+     {"op-path-payment", "invalid", "malformed-currencies"},
+     "operation"},
+    {ApplyMeters::PATH_PAYMENT_SUCCESS_APPLY,
+     {"op-path-payment", "success", "apply"},
+     "operation"},
+    {ApplyMeters::PAYMENT_FAILURE_LINE_FULL,
+     {"op-payment", "failure", "line-full"},
+     "operation"},
+    {ApplyMeters::PAYMENT_FAILURE_NO_DESTINATION,
+     {"op-payment", "failure", "no-destination"},
+     "operation"},
+    {ApplyMeters::PAYMENT_FAILURE_NO_TRUST,
+     {"op-payment", "failure", "no-trust"},
+     "operation"},
+    {ApplyMeters::PAYMENT_FAILURE_NOT_AUTHORIZED,
+     {"op-payment", "failure", "not-authorized"},
+     "operation"},
+    {ApplyMeters::PAYMENT_FAILURE_SRC_NO_TRUST,
+     {"op-payment", "failure", "src-no-trust"},
+     "operation"},
+    {ApplyMeters::PAYMENT_FAILURE_SRC_NOT_AUTHORIZED,
+     {"op-payment", "failure", "src-not-authorized"},
+     "operation"},
+    {ApplyMeters::PAYMENT_FAILURE_UNDERFUNDED,
+     {"op-payment", "failure", "underfunded"},
+     "operation"},
+    {ApplyMeters::PAYMENT_INVALID_MALFORMED_INVALID_ASSET,
+     {"op-payment", "invalid", "malformed-invalid-asset"},
+     "operation"},
+    {ApplyMeters::PAYMENT_INVALID_MALFORMED_NEGATIVE_AMOUNT,
+     {"op-payment", "invalid", "malformed-negative-amount"},
+     "operation"},
+    {ApplyMeters::PAYMENT_SUCCESS_APPLY,
+     {"op-payment", "success", "apply"},
+     "operation"},
+    {ApplyMeters::SET_OPTIONS_FAILURE_CANT_CHANGE,
+     {"op-set-options", "failure", "cant-change"},
+     "operation"},
+    {ApplyMeters::SET_OPTIONS_FAILURE_INVALID_INFLATION,
+     {"op-set-options", "failure", "invalid-inflation"},
+     "operation"},
+    {ApplyMeters::SET_OPTIONS_FAILURE_LOW_RESERVE,
+     {"op-set-options", "failure", "low-reserve"},
+     "operation"},
+    {ApplyMeters::SET_OPTIONS_FAILURE_TOO_MANY_SIGNERS,
+     {"op-set-options", "failure", "too-many-signers"},
+     "operation"},
+    {ApplyMeters::SET_OPTIONS_INVALID_BAD_FLAGS,
+     {"op-set-options", "invalid", "bad-flags"},
+     "operation"},
+    {ApplyMeters::SET_OPTIONS_INVALID_BAD_SIGNER,
+     {"op-set-options", "invalid", "bad-signer"},
+     "operation"},
+    {ApplyMeters::SET_OPTIONS_INVALID_THRESHOLD_OUT_OF_RANGE,
+     {"op-set-options", "invalid", "threshold-out-of-range"},
+     "operation"},
+    {ApplyMeters::SET_OPTIONS_SUCCESS_APPLY,
+     {"op-set-options", "success", "apply"},
+     "operation"},
+    {ApplyMeters::LEDGER_ACCOUNT_ADD, {"ledger", "account", "add"}, "entry"},
+    {ApplyMeters::LEDGER_ACCOUNT_DELETE,
+     {"ledger", "account", "delete"},
+     "entry"},
+    {ApplyMeters::LEDGER_ACCOUNT_MODIFY,
+     {"ledger", "account", "modify"},
+     "entry"},
+    {ApplyMeters::LEDGER_OFFER_ADD, {"ledger", "offer", "add"}, "entry"},
+    {ApplyMeters::LEDGER_OFFER_DELETE, {"ledger", "offer", "delete"}, "entry"},
+    {ApplyMeters::LEDGER_OFFER_MODIFY, {"ledger", "offer", "modify"}, "entry"},
+    {ApplyMeters::LEDGER_TRUST_ADD, {"ledger", "trust", "add"}, "entry"},
+    {ApplyMeters::LEDGER_TRUST_DELETE, {"ledger", "trust", "delete"}, "entry"},
+    {ApplyMeters::LEDGER_TRUST_MODIFY, {"ledger", "trust", "modify"}, "entry"},
+};
+}
+
+static_assert(sizeof(METER_NAMES) / sizeof(METER_NAMES[0]) ==
+                  ApplyMeters::NUM_METERS,
+              "every meter needs a name");
+
+ApplyMeters::ApplyMeters(medida::MetricsRegistry& metrics)
+{
+    for (size_t i = 0; i < NUM_METERS; i++)
+    {
+        auto const& n = METER_NAMES[i];
+        if (n.mMeter != static_cast<Meter>(i))
+        {
+            throw std::logic_error("ApplyMeters names out of order");
+        }
+        mMeters[i] = &metrics.NewMeter({n.mName[0], n.mName[1], n.mName[2]},
+                                       n.mEventType);
+    }
+}
+}
@@ -0,0 +1,166 @@
+#pragma once
+
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/NonCopyable.h"
+#include <array>
+#include <cstdint>
+
+#include "medida/meter.h"
+
+namespace medida
+{
+class MetricsRegistry;
+}
+
+namespace stellar
+{
+
+/**
+ * The meters marked while validating and applying transactions, registered
+ * with the MetricsRegistry once, when the Application is created.
+ *
+ * MetricsRegistry::NewMeter builds a MetricName and looks it up under the
+ * registry lock on every call, which on the apply path happens for every
+ * operation and every changed entry. Here each meter is resolved up front
+ * into a table indexed by Meter, so marking one is an array access and
+ * Meter::Mark.
+ *
+ * The names are those the meters always had; see ApplyMeters.cpp.
+ */
+class ApplyMeters : NonMovableOrCopyable
+{
+  public:
+    enum Meter
+    {
+        // transaction
+        TRANSACTION_INVALID_BAD_AUTH,
+        TRANSACTION_INVALID_BAD_AUTH_EXTRA,
+        TRANSACTION_INVALID_BAD_SEQ,
+        TRANSACTION_INVALID_INSUFFICIENT_BALANCE,
+        TRANSACTION_INVALID_INSUFFICIENT_FEE,
+        TRANSACTION_INVALID_INVALID_OP,
+        TRANSACTION_INVALID_MISSING_OPERATION,
+        TRANSACTION_INVALID_NO_ACCOUNT,
+        TRANSACTION_INVALID_TOO_EARLY,
+        TRANSACTION_INVALID_TOO_LATE,
+
+        // operation
+        OPERATION_INVALID_BAD_AUTH,
+        OPERATION_INVALID_NO_ACCOUNT,
+
+        // op-allow-trust
+        ALLOW_TRUST_FAILURE_CANT_REVOKE,
+        ALLOW_TRUST_FAILURE_NO_TRUST_LINE,
+        ALLOW_TRUST_FAILURE_NOT_REQUIRED,
+        ALLOW_TRUST_INVALID_MALFORMED_INVALID_ASSET,
+        ALLOW_TRUST_INVALID_MALFORMED_NON_ALPHANUM,
+        ALLOW_TRUST_SUCCESS_APPLY,
+
+        // op-change-trust
+        CHANGE_TRUST_FAILURE_INVALID_LIMIT,
+        CHANGE_TRUST_FAILURE_LOW_RESERVE,
+        CHANGE_TRUST_FAILURE_NO_ISSUER,
+        CHANGE_TRUST_INVALID_MALFORMED_INVALID_ASSET,
+        CHANGE_TRUST_INVALID_MALFORMED_NEGATIVE_LIMIT,
+        CHANGE_TRUST_SUCCESS_APPLY,
+
+        // op-create-account
+        CREATE_ACCOUNT_FAILURE_ALREADY_EXIST,
+        CREATE_ACCOUNT_FAILURE_LOW_RESERVE,
+        CREATE_ACCOUNT_FAILURE_UNDERFUNDED,
+        CREATE_ACCOUNT_INVALID_MALFORMED_TO_SELF,
+        CREATE_ACCOUNT_INVALID_MALFORMED_NEGATIVE_BALANCE,
+        CREATE_ACCOUNT_SUCCESS_APPLY,
+
+        // op-create-offer
+        CREATE_OFFER_SUCCESS_APPLY,
+
+        // op-inflation
+        INFLATION_FAILURE_NOT_TIME,
+        INFLATION_SUCCESS_APPLY,
+
+        // op-manage-offer
+        MANAGE_OFFER_INVALID_EQUAL_CURRENCIES,
+        MANAGE_OFFER_INVALID_INVALID_ASSET,
+        MANAGE_OFFER_INVALID_LINE_FULL,
+        MANAGE_OFFER_INVALID_LOW_RESERVE,
+        MANAGE_OFFER_INVALID_NEGATIVE_OR_ZERO_VALUES,
+        MANAGE_OFFER_INVALID_NO_TRUST,
+        MANAGE_OFFER_INVALID_NOT_AUTHORIZED,
+        MANAGE_OFFER_INVALID_NOT_FOUND,
+        MANAGE_OFFER_INVALID_UNDERFUNDED_ABSENT,
+
+        // op-merge
+        MERGE_FAILURE_CREDIT_HELD,
+        MERGE_FAILURE_HAS_CREDIT,
+        MERGE_FAILURE_NO_ACCOUNT,
+        MERGE_INVALID_MALFORMED_SELF_MERGE,
+        MERGE_SUCCESS_APPLY,
+
+        // op-path-payment
+        PATH_PAYMENT_FAILURE_LINE_FULL,
+        PATH_PAYMENT_FAILURE_NO_DESTINATION,
+        PATH_PAYMENT_FAILURE_NO_ISSUER,
+        PATH_PAYMENT_FAILURE_NO_TRUST,
+        PATH_PAYMENT_FAILURE_NOT_AUTHORIZED,
+        PATH_PAYMENT_FAILURE_OFFER_CROSS_SELF,
+        PATH_PAYMENT_FAILURE_OVER_SEND_MAX,
+        PATH_PAYMENT_FAILURE_SRC_NO_TRUST,
+        PATH_PAYMENT_FAILURE_SRC_NOT_AUTHORIZED,
+        PATH_PAYMENT_FAILURE_TOO_FEW_OFFERS,
+        PATH_PAYMENT_FAILURE_UNDERFUNDED,
+        PATH_PAYMENT_INVALID_MALFORMED_AMOUNTS,
+        PATH_PAYMENT_INVALID_MALFORMED_CURRENCIES,
+        PATH_PAYMENT_SUCCESS_APPLY,
+
+        // op-payment
+        PAYMENT_FAILURE_LINE_FULL,
+        PAYMENT_FAILURE_NO_DESTINATION,
+        PAYMENT_FAILURE_NO_TRUST,
+        PAYMENT_FAILURE_NOT_AUTHORIZED,
+        PAYMENT_FAILURE_SRC_NO_TRUST,
+        PAYMENT_FAILURE_SRC_NOT_AUTHORIZED,
+        PAYMENT_FAILURE_UNDERFUNDED,
+        PAYMENT_INVALID_MALFORMED_INVALID_ASSET,
+        PAYMENT_INVALID_MALFORMED_NEGATIVE_AMOUNT,
+        PAYMENT_SUCCESS_APPLY,
+
+        // op-set-options
+        SET_OPTIONS_FAILURE_CANT_CHANGE,
+        SET_OPTIONS_FAILURE_INVALID_INFLATION,
+        SET_OPTIONS_FAILURE_LOW_RESERVE,
+        SET_OPTIONS_FAILURE_TOO_MANY_SIGNERS,
+        SET_OPTIONS_INVALID_BAD_FLAGS,
+        SET_OPTIONS_INVALID_BAD_SIGNER,
+        SET_OPTIONS_INVALID_THRESHOLD_OUT_OF_RANGE,
+        SET_OPTIONS_SUCCESS_APPLY,
+
+        // ledger
+        LEDGER_ACCOUNT_ADD,
+        LEDGER_ACCOUNT_DELETE,
+        LEDGER_ACCOUNT_MODIFY,
+        LEDGER_OFFER_ADD,
+        LEDGER_OFFER_DELETE,
+        LEDGER_OFFER_MODIFY,
+        LEDGER_TRUST_ADD,
+        LEDGER_TRUST_DELETE,
+        LEDGER_TRUST_MODIFY,
+
+        NUM_METERS
+    };
+
+    ApplyMeters(medida::MetricsRegistry& metrics);
+
+    void
+    mark(Meter m, uint64_t n = 1)
+    {
+        mMeters[m]->Mark(n);
+    }
+
+  private:
+    std::array<medida::Meter*, NUM_METERS> mMeters;
+};
+}
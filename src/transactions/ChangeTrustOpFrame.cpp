@@ -3,13 +3,11 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "ChangeTrustOpFrame.h"
+#include "transactions/ApplyMeters.h"
 #include "ledger/TrustFrame.h"
 #include "ledger/LedgerManager.h"
 #include "database/Database.h"
 
-#include "medida/meter.h"
-#include "medida/metrics_registry.h"
-
 namespace stellar
 {
 
@@ -21,8 +19,8 @@ ChangeTrustOpFrame::ChangeTrustOpFrame(Operation const& op,
 {
 }
 bool
-ChangeTrustOpFrame::doApply(medida::MetricsRegistry& metrics,
-                            LedgerDelta& delta, LedgerManager& ledgerManager)
+ChangeTrustOpFrame::doApply(ApplyMeters& meters, LedgerDelta& delta,
+                            LedgerManager& ledgerManager)
 {
     TrustFrame::pointer trustLine;
     Database& db = ledgerManager.getDatabase();
@@ -35,8 +33,7 @@ ChangeTrustOpFrame::doApply(medida::MetricsRegistry& metrics,
         if (mChangeTrust.limit < 0 ||
             mChangeTrust.limit < trustLine->getBalance())
         { // Can't drop the limit below the balance you are holding with them
-            metrics.NewMeter({"op-change-trust", "failure", "invalid-limit"},
-                             "operation").Mark();
+            meters.mark(ApplyMeters::CHANGE_TRUST_FAILURE_INVALID_LIMIT);
             innerResult().code(CHANGE_TRUST_INVALID_LIMIT);
             return false;
         }
@@ -54,8 +51,7 @@ ChangeTrustOpFrame::doApply(medida::MetricsRegistry& metrics,
         {
             trustLine->storeChange(delta, db);
         }
-        metrics.NewMeter({"op-change-trust", "success", "apply"}, "operation")
-            .Mark();
+        meters.mark(ApplyMeters::CHANGE_TRUST_SUCCESS_APPLY);
         innerResult().code(CHANGE_TRUST_SUCCESS);
         return true;
     }
@@ -71,8 +67,7 @@ ChangeTrustOpFrame::doApply(medida::MetricsRegistry& metrics,
 
         if (!issuer)
         {
-            metrics.NewMeter({"op-change-trust", "failure", "no-issuer"},
-                             "operation").Mark();
+            meters.mark(ApplyMeters::CHANGE_TRUST_FAILURE_NO_ISSUER);
             innerResult().code(CHANGE_TRUST_NO_ISSUER);
             return false;
         }
@@ -86,8 +81,7 @@ ChangeTrustOpFrame::doApply(medida::MetricsRegistry& metrics,
 
         if (!mSourceAccount->addNumEntries(1, ledgerManager))
         {
-            metrics.NewMeter({"op-change-trust", "failure", "low-reserve"},
-                             "operation").Mark();
+            meters.mark(ApplyMeters::CHANGE_TRUST_FAILURE_LOW_RESERVE);
             innerResult().code(CHANGE_TRUST_LOW_RESERVE);
             return false;
         }
@@ -95,32 +89,35 @@ ChangeTrustOpFrame::doApply(medida::MetricsRegistry& metrics,
         mSourceAccount->storeChange(delta, db);
         trustLine->storeAdd(delta, db);
 
-        metrics.NewMeter({"op-change-trust", "success", "apply"}, "operation")
-            .Mark();
+        meters.mark(ApplyMeters::CHANGE_TRUST_SUCCESS_APPLY);
         innerResult().code(CHANGE_TRUST_SUCCESS);
         return true;
     }
 }
 
 bool
-ChangeTrustOpFrame::doCheckValid(medida::MetricsRegistry& metrics)
+ChangeTrustOpFrame::doCheckValid(ApplyMeters& meters)
 {
     if (mChangeTrust.limit < 0)
     {
-        metrics.NewMeter(
-                    {"op-change-trust", "invalid", "malformed-negative-limit"},
-                    "operation").Mark();
+        meters.mark(ApplyMeters::CHANGE_TRUST_INVALID_MALFORMED_NEGATIVE_LIMIT);
         innerResult().code(CHANGE_TRUST_MALFORMED);
         return false;
     }
     if (!isAssetValid(mChangeTrust.line))
     {
-        metrics.NewMeter(
-                    {"op-change-trust", "invalid", "malformed-invalid-asset"},
-                    "operation").Mark();
+        meters.mark(ApplyMeters::CHANGE_TRUST_INVALID_MALFORMED_INVALID_ASSET);
         innerResult().code(CHANGE_TRUST_MALFORMED);
         return false;
     }
     return true;
 }
+
+void
+ChangeTrustOpFrame::addPrefetchKeys(Operation const& op,
+                                    AccountID const& source,
+                                    std::vector<LedgerKey>& keys)
+{
+    addTrustLineKey(keys, source, op.body.changeTrustOp().line);
+}
 }
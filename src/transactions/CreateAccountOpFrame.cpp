@@ -3,6 +3,7 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "transactions/CreateAccountOpFrame.h"
+#include "transactions/ApplyMeters.h"
 #include "util/Logging.h"
 #include "ledger/LedgerDelta.h"
 #include "ledger/TrustFrame.h"
@@ -11,9 +12,6 @@
 #include "OfferExchange.h"
 #include <algorithm>
 
-#include "medida/meter.h"
-#include "medida/metrics_registry.h"
-
 namespace stellar
 {
 
@@ -29,8 +27,8 @@ CreateAccountOpFrame::CreateAccountOpFrame(Operation const& op,
 }
 
 bool
-CreateAccountOpFrame::doApply(medida::MetricsRegistry& metrics,
-                              LedgerDelta& delta, LedgerManager& ledgerManager)
+CreateAccountOpFrame::doApply(ApplyMeters& meters, LedgerDelta& delta,
+                              LedgerManager& ledgerManager)
 {
     AccountFrame::pointer destAccount;
 
@@ -41,8 +39,7 @@ CreateAccountOpFrame::doApply(medida::MetricsRegistry& metrics,
     {
         if (mCreateAccount.startingBalance < ledgerManager.getMinBalance(0))
         { // not over the minBalance to make an account
-            metrics.NewMeter({"op-create-account", "failure", "low-reserve"},
-                             "operation").Mark();
+            meters.mark(ApplyMeters::CREATE_ACCOUNT_FAILURE_LOW_RESERVE);
             innerResult().code(CREATE_ACCOUNT_LOW_RESERVE);
             return false;
         }
@@ -54,9 +51,7 @@ CreateAccountOpFrame::doApply(medida::MetricsRegistry& metrics,
             if ((mSourceAccount->getAccount().balance - minBalance) <
                 mCreateAccount.startingBalance)
             { // they don't have enough to send
-                metrics.NewMeter(
-                            {"op-create-account", "failure", "underfunded"},
-                            "operation").Mark();
+                meters.mark(ApplyMeters::CREATE_ACCOUNT_FAILURE_UNDERFUNDED);
                 innerResult().code(CREATE_ACCOUNT_UNDERFUNDED);
                 return false;
             }
@@ -72,42 +67,45 @@ CreateAccountOpFrame::doApply(medida::MetricsRegistry& metrics,
 
             destAccount->storeAdd(delta, db);
 
-            metrics.NewMeter({"op-create-account", "success", "apply"},
-                             "operation").Mark();
+            meters.mark(ApplyMeters::CREATE_ACCOUNT_SUCCESS_APPLY);
             innerResult().code(CREATE_ACCOUNT_SUCCESS);
             return true;
         }
     }
     else
     {
-        metrics.NewMeter({"op-create-account", "failure", "already-exist"},
-                         "operation").Mark();
+        meters.mark(ApplyMeters::CREATE_ACCOUNT_FAILURE_ALREADY_EXIST);
         innerResult().code(CREATE_ACCOUNT_ALREADY_EXIST);
         return false;
     }
 }
 
 bool
-CreateAccountOpFrame::doCheckValid(medida::MetricsRegistry& metrics)
+CreateAccountOpFrame::doCheckValid(ApplyMeters& meters)
 {
     if (mCreateAccount.startingBalance <= 0)
     {
-        metrics.NewMeter({"op-create-account", "invalid",
-                          "malformed-negative-balance"},
-                         "operation").Mark();
+        meters.mark(
+            ApplyMeters::CREATE_ACCOUNT_INVALID_MALFORMED_NEGATIVE_BALANCE);
         innerResult().code(CREATE_ACCOUNT_MALFORMED);
         return false;
     }
 
     if (mCreateAccount.destination == getSourceID())
     {
-        metrics.NewMeter({"op-create-account", "invalid",
-                          "malformed-destination-equals-source"},
-                         "operation").Mark();
+        meters.mark(ApplyMeters::CREATE_ACCOUNT_INVALID_MALFORMED_TO_SELF);
         innerResult().code(CREATE_ACCOUNT_MALFORMED);
         return false;
     }
 
     return true;
 }
+
+void
+CreateAccountOpFrame::addPrefetchKeys(Operation const& op,
+                                      AccountID const& source,
+                                      std::vector<LedgerKey>& keys)
+{
+    addAccountKey(keys, op.body.createAccountOp().destination);
+}
 }
@@ -3,12 +3,12 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "transactions/InflationOpFrame.h"
+#include "transactions/ApplyMeters.h"
+#include "database/Database.h"
 #include "ledger/AccountFrame.h"
 #include "ledger/LedgerDelta.h"
 #include "ledger/LedgerManager.h"
 #include "overlay/StellarXDR.h"
-#include "medida/meter.h"
-#include "medida/metrics_registry.h"
 
 const uint32_t INFLATION_FREQUENCY = (60 * 60 * 24 * 7); // every 7 days
 // inflation is .000190721 per 7 days, or 1% a year
@@ -27,7 +27,7 @@ InflationOpFrame::InflationOpFrame(Operation const& op, OperationResult& res,
 }
 
 bool
-InflationOpFrame::doApply(medida::MetricsRegistry& metrics, LedgerDelta& delta,
+InflationOpFrame::doApply(ApplyMeters& meters, LedgerDelta& delta,
                           LedgerManager& ledgerManager)
 {
     LedgerDelta inflationDelta(delta);
@@ -40,8 +40,7 @@ InflationOpFrame::doApply(medida::MetricsRegistry& metrics, LedgerDelta& delta,
     time_t inflationTime = (INFLATION_START_TIME + seq * INFLATION_FREQUENCY);
     if (closeTime < inflationTime)
     {
-        metrics.NewMeter({"op-inflation", "failure", "not-time"}, "operation")
-            .Mark();
+        meters.mark(ApplyMeters::INFLATION_FAILURE_NOT_TIME);
         innerResult().code(INFLATION_NOT_TIME);
         return false;
     }
@@ -62,7 +61,7 @@ InflationOpFrame::doApply(medida::MetricsRegistry& metrics, LedgerDelta& delta,
     std::vector<AccountFrame::InflationVotes> winners;
     auto& db = ledgerManager.getDatabase();
 
-    AccountFrame::processForInflation(
+    db.getInflationVoteTally().processForInflation(
         [&](AccountFrame::InflationVotes const& votes)
         {
             if (votes.mVotes >= minBalance)
@@ -116,12 +115,12 @@ InflationOpFrame::doApply(medida::MetricsRegistry& metrics, LedgerDelta& delta,
 
     inflationDelta.commit();
 
-    metrics.NewMeter({"op-inflation", "success", "apply"}, "operation").Mark();
+    meters.mark(ApplyMeters::INFLATION_SUCCESS_APPLY);
     return true;
 }
 
 bool
-InflationOpFrame::doCheckValid(medida::MetricsRegistry& metrics)
+InflationOpFrame::doCheckValid(ApplyMeters& meters)
 {
     return true;
 }
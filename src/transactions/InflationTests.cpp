@@ -13,6 +13,8 @@
 #include "util/Logging.h"
 #include "TxTests.h"
 #include "transactions/InflationOpFrame.h"
+#include "database/Database.h"
+#include "util/Math.h"
 #include <functional>
 
 using namespace stellar;
@@ -468,3 +470,137 @@ TEST_CASE("inflation", "[tx][inflation]")
         }
     }
 }
+
+static std::vector<AccountFrame::InflationVotes>
+getWinners(Database& db, bool fromTally)
+{
+    std::vector<AccountFrame::InflationVotes> winners;
+    auto processor = [&](AccountFrame::InflationVotes const& votes) -> bool
+    {
+        winners.push_back(votes);
+        return true;
+    };
+    if (fromTally)
+    {
+        db.getInflationVoteTally().processForInflation(processor, maxWinners,
+                                                        db);
+    }
+    else
+    {
+        AccountFrame::processForInflation(processor, maxWinners, db);
+    }
+    return winners;
+}
+
+static void
+checkTally(Database& db)
+{
+    auto expected = getWinners(db, false);
+    auto actual = getWinners(db, true);
+    REQUIRE(actual.size() == expected.size());
+    for (size_t i = 0; i < expected.size(); i++)
+    {
+        REQUIRE(actual[i].mVotes == expected[i].mVotes);
+        REQUIRE(actual[i].mInflationDest == expected[i].mInflationDest);
+    }
+}
+
+TEST_CASE("inflation vote tally", "[tx][inflation]")
+{
+    VirtualClock clock;
+    Application::pointer appPtr = Application::create(clock, getTestConfig());
+    Application& app = *appPtr;
+    app.start();
+
+    auto& lm = app.getLedgerManager();
+    auto& db = app.getDatabase();
+
+    int const nbAccounts = 40;
+    int64 const minVote = InflationVoteTally::MIN_VOTER_BALANCE;
+
+    // balances around the voting threshold, votes for a handful of accounts
+    createTestAccounts(app, nbAccounts,
+                       [&](int n)
+                       {
+                           return rand_uniform<int64>(minVote / 2,
+                                                      3 * minVote);
+                       },
+                       [&](int n)
+                       {
+                           return rand_uniform<int>(0, 4);
+                       });
+    REQUIRE(db.getInflationVoteTally().isValid());
+    REQUIRE(!getWinners(db, true).empty());
+    checkTally(db);
+
+    // store random changes of balance, destination or existence
+    auto mutate = [&](LedgerDelta& delta)
+    {
+        for (int i = 0; i < nbAccounts / 4; i++)
+        {
+            int n = rand_uniform<int>(0, nbAccounts - 1);
+            auto act = AccountFrame::loadAccount(
+                getTestAccount(n).getPublicKey(), db);
+            if (!act)
+            {
+                continue;
+            }
+            switch (rand_uniform<int>(0, 3))
+            {
+            case 0:
+                act->getAccount().balance =
+                    rand_uniform<int64>(minVote / 2, 3 * minVote);
+                break;
+            case 1:
+                act->getAccount().inflationDest.activate() =
+                    getTestAccount(rand_uniform<int>(0, 6)).getPublicKey();
+                break;
+            case 2:
+                act->getAccount().inflationDest.reset();
+                break;
+            default:
+                act->storeDelete(delta, db);
+                continue;
+            }
+            act->storeChange(delta, db);
+        }
+    };
+
+    SECTION("stored changes")
+    {
+        for (int round = 0; round < 10; round++)
+        {
+            LedgerDelta delta(lm.getCurrentLedgerHeader(), db);
+            mutate(delta);
+            checkTally(db);
+            delta.commit();
+        }
+    }
+    SECTION("rolled back changes")
+    {
+        for (int round = 0; round < 10; round++)
+        {
+            LedgerDelta delta(lm.getCurrentLedgerHeader(), db);
+            {
+                soci::transaction sqlTx(db.getSession());
+                LedgerDelta inner(delta);
+                mutate(inner);
+                if (rand_flip())
+                {
+                    sqlTx.commit();
+                    inner.commit();
+                }
+            }
+            checkTally(db);
+            delta.commit();
+        }
+    }
+    SECTION("rebuilt")
+    {
+        LedgerDelta delta(lm.getCurrentLedgerHeader(), db);
+        mutate(delta);
+        delta.commit();
+        db.getInflationVoteTally().rebuild(db);
+        checkTally(db);
+    }
+}
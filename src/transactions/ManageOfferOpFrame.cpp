@@ -3,14 +3,13 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "transactions/ManageOfferOpFrame.h"
+#include "transactions/ApplyMeters.h"
 #include "ledger/OfferFrame.h"
 #include "util/Logging.h"
 #include "util/types.h"
 #include "database/Database.h"
 #include "ledger/LedgerDelta.h"
 #include "OfferExchange.h"
-#include "medida/meter.h"
-#include "medida/metrics_registry.h"
 
 // convert from sheep to wheat
 // selling sheep
@@ -33,8 +32,7 @@ ManageOfferOpFrame::ManageOfferOpFrame(Operation const& op,
 
 // make sure these issuers exist and you can hold the ask asset
 bool
-ManageOfferOpFrame::checkOfferValid(medida::MetricsRegistry& metrics,
-                                    Database& db)
+ManageOfferOpFrame::checkOfferValid(ApplyMeters& meters, Database& db)
 {
     Asset const& sheep = mManageOffer.selling;
     Asset const& wheat = mManageOffer.buying;
@@ -44,24 +42,19 @@ ManageOfferOpFrame::checkOfferValid(medida::MetricsRegistry& metrics,
         mSheepLineA = TrustFrame::loadTrustLine(getSourceID(), sheep, db);
         if (!mSheepLineA)
         { // we don't have what we are trying to sell
-            metrics.NewMeter(
-                        {"op-manage-offer", "invalid", "underfunded-absent"},
-                        "operation").Mark();
+            meters.mark(ApplyMeters::MANAGE_OFFER_INVALID_UNDERFUNDED_ABSENT);
             innerResult().code(MANAGE_OFFER_SELL_NO_TRUST);
             return false;
         }
         if (mSheepLineA->getBalance() == 0)
         {
-            metrics.NewMeter(
-                        {"op-manage-offer", "invalid", "underfunded-absent"},
-                        "operation").Mark();
+            meters.mark(ApplyMeters::MANAGE_OFFER_INVALID_UNDERFUNDED_ABSENT);
             innerResult().code(MANAGE_OFFER_UNDERFUNDED);
             return false;
         }
         if (!mSheepLineA->isAuthorized())
         {
-            metrics.NewMeter({"op-manage-offer", "invalid", "not-authorized"},
-                             "operation").Mark();
+            meters.mark(ApplyMeters::MANAGE_OFFER_INVALID_NOT_AUTHORIZED);
             // we are not authorized to sell
             innerResult().code(MANAGE_OFFER_SELL_NOT_AUTHORIZED);
             return false;
@@ -73,16 +66,14 @@ ManageOfferOpFrame::checkOfferValid(medida::MetricsRegistry& metrics,
         mWheatLineA = TrustFrame::loadTrustLine(getSourceID(), wheat, db);
         if (!mWheatLineA)
         { // we can't hold what we are trying to buy
-            metrics.NewMeter({"op-manage-offer", "invalid", "no-trust"},
-                             "operation").Mark();
+            meters.mark(ApplyMeters::MANAGE_OFFER_INVALID_NO_TRUST);
             innerResult().code(MANAGE_OFFER_BUY_NO_TRUST);
             return false;
         }
 
         if (!mWheatLineA->isAuthorized())
         { // we are not authorized to hold what we are trying to buy
-            metrics.NewMeter({"op-manage-offer", "invalid", "not-authorized"},
-                             "operation").Mark();
+            meters.mark(ApplyMeters::MANAGE_OFFER_INVALID_NOT_AUTHORIZED);
             innerResult().code(MANAGE_OFFER_BUY_NOT_AUTHORIZED);
             return false;
         }
@@ -95,12 +86,12 @@ ManageOfferOpFrame::checkOfferValid(medida::MetricsRegistry& metrics,
 // see if this is modifying an old offer
 // see if this offer crosses any existing offers
 bool
-ManageOfferOpFrame::doApply(medida::MetricsRegistry& metrics,
-                            LedgerDelta& delta, LedgerManager& ledgerManager)
+ManageOfferOpFrame::doApply(ApplyMeters& meters, LedgerDelta& delta,
+                            LedgerManager& ledgerManager)
 {
     Database& db = ledgerManager.getDatabase();
 
-    if (!checkOfferValid(metrics, db))
+    if (!checkOfferValid(meters, db))
     {
         return false;
     }
@@ -117,8 +108,7 @@ ManageOfferOpFrame::doApply(medida::MetricsRegistry& metrics,
 
         if (!mSellSheepOffer)
         {
-            metrics.NewMeter({"op-manage-offer", "invalid", "not-found"},
-                             "operation").Mark();
+            meters.mark(ApplyMeters::MANAGE_OFFER_INVALID_NOT_FOUND);
             innerResult().code(MANAGE_OFFER_NOT_FOUND);
             return false;
         }
@@ -162,8 +152,7 @@ ManageOfferOpFrame::doApply(medida::MetricsRegistry& metrics,
         maxWheatCanSell = mWheatLineA->getMaxAmountReceive();
         if (maxWheatCanSell == 0)
         {
-            metrics.NewMeter({"op-manage-offer", "invalid", "line-full"},
-                             "operation").Mark();
+            meters.mark(ApplyMeters::MANAGE_OFFER_INVALID_LINE_FULL);
             innerResult().code(MANAGE_OFFER_LINE_FULL);
             return false;
         }
@@ -256,7 +245,7 @@ ManageOfferOpFrame::doApply(medida::MetricsRegistry& metrics,
             if (wheat.type() == ASSET_TYPE_NATIVE)
             {
                 mSourceAccount->getAccount().balance += wheatReceived;
-                mSourceAccount->storeChange(delta, db);
+                mSourceAccount->storeChange(tempDelta, db);
             }
             else
             {
@@ -274,13 +263,13 @@ ManageOfferOpFrame::doApply(medida::MetricsRegistry& metrics,
                     throw std::runtime_error("offer claimed over limit");
                 }
 
-                wheatLineSigningAccount->storeChange(delta, db);
+                wheatLineSigningAccount->storeChange(tempDelta, db);
             }
 
             if (sheep.type() == ASSET_TYPE_NATIVE)
             {
                 mSourceAccount->getAccount().balance -= sheepSent;
-                mSourceAccount->storeChange(delta, db);
+                mSourceAccount->storeChange(tempDelta, db);
             }
             else
             {
@@ -289,7 +278,7 @@ ManageOfferOpFrame::doApply(medida::MetricsRegistry& metrics,
                     // this would indicate a bug in OfferExchange
                     throw std::runtime_error("offer sold more than balance");
                 }
-                mSheepLineA->storeChange(delta, db);
+                mSheepLineA->storeChange(tempDelta, db);
             }
         }
 
@@ -305,9 +294,7 @@ ManageOfferOpFrame::doApply(medida::MetricsRegistry& metrics,
                 // the minbalance
                 if (!mSourceAccount->addNumEntries(1, ledgerManager))
                 {
-                    metrics.NewMeter(
-                                {"op-manage-offer", "invalid", "low reserve"},
-                                "operation").Mark();
+                    meters.mark(ApplyMeters::MANAGE_OFFER_INVALID_LOW_RESERVE);
                     innerResult().code(MANAGE_OFFER_LOW_RESERVE);
                     return false;
                 }
@@ -339,38 +326,33 @@ ManageOfferOpFrame::doApply(medida::MetricsRegistry& metrics,
         sqlTx.commit();
         tempDelta.commit();
     }
-    metrics.NewMeter({"op-create-offer", "success", "apply"}, "operation")
-        .Mark();
+    meters.mark(ApplyMeters::CREATE_OFFER_SUCCESS_APPLY);
     return true;
 }
 
 // makes sure the currencies are different
 bool
-ManageOfferOpFrame::doCheckValid(medida::MetricsRegistry& metrics)
+ManageOfferOpFrame::doCheckValid(ApplyMeters& meters)
 {
     Asset const& sheep = mManageOffer.selling;
     Asset const& wheat = mManageOffer.buying;
 
     if (!isAssetValid(sheep) || !isAssetValid(wheat))
     {
-        metrics.NewMeter({"op-manage-offer", "invalid", "invalid-asset"},
-                         "operation").Mark();
+        meters.mark(ApplyMeters::MANAGE_OFFER_INVALID_INVALID_ASSET);
         innerResult().code(MANAGE_OFFER_MALFORMED);
         return false;
     }
     if (compareAsset(sheep, wheat))
     {
-        metrics.NewMeter({"op-manage-offer", "invalid", "equal-currencies"},
-                         "operation").Mark();
+        meters.mark(ApplyMeters::MANAGE_OFFER_INVALID_EQUAL_CURRENCIES);
         innerResult().code(MANAGE_OFFER_MALFORMED);
         return false;
     }
     if (mManageOffer.amount < 0 || mManageOffer.price.d <= 0 ||
         mManageOffer.price.n <= 0)
     {
-        metrics.NewMeter(
-                    {"op-manage-offer", "invalid", "negative-or-zero-values"},
-                    "operation").Mark();
+        meters.mark(ApplyMeters::MANAGE_OFFER_INVALID_NEGATIVE_OR_ZERO_VALUES);
         innerResult().code(MANAGE_OFFER_MALFORMED);
         return false;
     }
@@ -392,4 +374,28 @@ ManageOfferOpFrame::buildOffer(AccountID const& account,
     o.flags = flags;
     return o;
 }
+
+void
+ManageOfferOpFrame::addPrefetchKeys(Operation const& op,
+                                    AccountID const& source,
+                                    std::vector<LedgerKey>& keys)
+{
+    if (op.body.type() == CREATE_PASSIVE_OFFER)
+    {
+        auto const& createPassive = op.body.createPassiveOfferOp();
+        addTrustLineKey(keys, source, createPassive.selling);
+        addTrustLineKey(keys, source, createPassive.buying);
+        return;
+    }
+
+    auto const& manageOffer = op.body.manageOfferOp();
+    addTrustLineKey(keys, source, manageOffer.selling);
+    addTrustLineKey(keys, source, manageOffer.buying);
+    if (manageOffer.offerID)
+    {
+        keys.emplace_back(OFFER);
+        keys.back().offer().sellerID = source;
+        keys.back().offer().offerID = manageOffer.offerID;
+    }
+}
 }
@@ -17,7 +17,7 @@ class ManageOfferOpFrame : public OperationFrame
 
     OfferFrame::pointer mSellSheepOffer;
 
-    bool checkOfferValid(medida::MetricsRegistry& metrics, Database& db);
+    bool checkOfferValid(ApplyMeters& meters, Database& db);
 
     ManageOfferResult&
     innerResult()
@@ -37,9 +37,11 @@ class ManageOfferOpFrame : public OperationFrame
     ManageOfferOpFrame(Operation const& op, OperationResult& res,
                        TransactionFrame& parentTx);
 
-    bool doApply(medida::MetricsRegistry& metrics, LedgerDelta& delta,
+    bool doApply(ApplyMeters& meters, LedgerDelta& delta,
                  LedgerManager& ledgerManager) override;
-    bool doCheckValid(medida::MetricsRegistry& metrics) override;
+    bool doCheckValid(ApplyMeters& meters) override;
+    static void addPrefetchKeys(Operation const& op, AccountID const& source,
+                                std::vector<LedgerKey>& keys);
 
     static ManageOfferResultCode
     getInnerCode(OperationResult const& res)
@@ -3,12 +3,10 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "transactions/MergeOpFrame.h"
+#include "transactions/ApplyMeters.h"
 #include "database/Database.h"
 #include "ledger/TrustFrame.h"
 
-#include "medida/meter.h"
-#include "medida/metrics_registry.h"
-
 using namespace soci;
 
 namespace stellar
@@ -33,7 +31,7 @@ MergeOpFrame::getNeededThreshold() const
 // make sure the we delete all the trustlines
 // move the XLM to the new account
 bool
-MergeOpFrame::doApply(medida::MetricsRegistry& metrics, LedgerDelta& delta,
+MergeOpFrame::doApply(ApplyMeters& meters, LedgerDelta& delta,
                       LedgerManager& ledgerManager)
 {
     AccountFrame::pointer otherAccount;
@@ -43,16 +41,14 @@ MergeOpFrame::doApply(medida::MetricsRegistry& metrics, LedgerDelta& delta,
 
     if (!otherAccount)
     {
-        metrics.NewMeter({"op-merge", "failure", "no-account"}, "operation")
-            .Mark();
+        meters.mark(ApplyMeters::MERGE_FAILURE_NO_ACCOUNT);
         innerResult().code(ACCOUNT_MERGE_NO_ACCOUNT);
         return false;
     }
 
     if (TrustFrame::hasIssued(getSourceID(), db))
     {
-        metrics.NewMeter({"op-merge", "failure", "credit-held"}, "operation")
-            .Mark();
+        meters.mark(ApplyMeters::MERGE_FAILURE_CREDIT_HELD);
         innerResult().code(ACCOUNT_MERGE_CREDIT_HELD);
         return false;
     }
@@ -63,8 +59,7 @@ MergeOpFrame::doApply(medida::MetricsRegistry& metrics, LedgerDelta& delta,
     {
         if (l->getBalance() > 0)
         {
-            metrics.NewMeter({"op-merge", "failure", "has-credit"}, "operation")
-                .Mark();
+            meters.mark(ApplyMeters::MERGE_FAILURE_HAS_CREDIT);
             innerResult().code(ACCOUNT_MERGE_HAS_CREDIT);
             return false;
         }
@@ -89,23 +84,29 @@ MergeOpFrame::doApply(medida::MetricsRegistry& metrics, LedgerDelta& delta,
     otherAccount->storeChange(delta, db);
     mSourceAccount->storeDelete(delta, db);
 
-    metrics.NewMeter({"op-merge", "success", "apply"}, "operation").Mark();
+    meters.mark(ApplyMeters::MERGE_SUCCESS_APPLY);
     innerResult().code(ACCOUNT_MERGE_SUCCESS);
     innerResult().sourceAccountBalance() = sourceBalance;
     return true;
 }
 
 bool
-MergeOpFrame::doCheckValid(medida::MetricsRegistry& metrics)
+MergeOpFrame::doCheckValid(ApplyMeters& meters)
 {
     // makes sure not merging into self
     if (getSourceID() == mOperation.body.destination())
     {
-        metrics.NewMeter({"op-merge", "invalid", "malformed-self-merge"},
-                         "operation").Mark();
+        meters.mark(ApplyMeters::MERGE_INVALID_MALFORMED_SELF_MERGE);
         innerResult().code(ACCOUNT_MERGE_MALFORMED);
         return false;
     }
     return true;
 }
+
+void
+MergeOpFrame::addPrefetchKeys(Operation const& op, AccountID const& source,
+                              std::vector<LedgerKey>& keys)
+{
+    addAccountKey(keys, op.body.destination());
+}
 }
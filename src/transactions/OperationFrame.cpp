@@ -20,6 +20,7 @@
 #include "transactions/PaymentOpFrame.h"
 #include "transactions/SetOptionsOpFrame.h"
 #include "database/Database.h"
+#include "transactions/ApplyMeters.h"
 
 #include "medida/meter.h"
 #include "medida/metrics_registry.h"
@@ -78,7 +79,7 @@ OperationFrame::apply(LedgerDelta& delta, Application& app)
     res = checkValid(app, true);
     if (res)
     {
-        res = doApply(app.getMetrics(), delta, app.getLedgerManager());
+        res = doApply(app.getApplyMeters(), delta, app.getLedgerManager());
     }
 
     return res;
@@ -103,6 +104,64 @@ OperationFrame::getSourceID() const
                                     : mParentTx.getEnvelope().tx.sourceAccount;
 }
 
+void
+OperationFrame::addPrefetchKeys(Operation const& op, AccountID const& txSource,
+                                std::vector<LedgerKey>& keys)
+{
+    AccountID const& source = op.sourceAccount ? *op.sourceAccount : txSource;
+    addAccountKey(keys, source);
+
+    switch (op.body.type())
+    {
+    case CREATE_ACCOUNT:
+        CreateAccountOpFrame::addPrefetchKeys(op, source, keys);
+        break;
+    case PAYMENT:
+        PaymentOpFrame::addPrefetchKeys(op, source, keys);
+        break;
+    case PATH_PAYMENT:
+        PathPaymentOpFrame::addPrefetchKeys(op, source, keys);
+        break;
+    case MANAGE_OFFER:
+    case CREATE_PASSIVE_OFFER:
+        ManageOfferOpFrame::addPrefetchKeys(op, source, keys);
+        break;
+    case CHANGE_TRUST:
+        ChangeTrustOpFrame::addPrefetchKeys(op, source, keys);
+        break;
+    case ALLOW_TRUST:
+        AllowTrustOpFrame::addPrefetchKeys(op, source, keys);
+        break;
+    case ACCOUNT_MERGE:
+        MergeOpFrame::addPrefetchKeys(op, source, keys);
+        break;
+    default:
+        // SET_OPTIONS and INFLATION name nothing beyond their source, and
+        // an unknown type is rejected later, when its frame is built.
+        break;
+    }
+}
+
+void
+OperationFrame::addAccountKey(std::vector<LedgerKey>& keys,
+                              AccountID const& accountID)
+{
+    keys.emplace_back(ACCOUNT);
+    keys.back().account().accountID = accountID;
+}
+
+void
+OperationFrame::addTrustLineKey(std::vector<LedgerKey>& keys,
+                                AccountID const& accountID, Asset const& asset)
+{
+    if (asset.type() != ASSET_TYPE_NATIVE)
+    {
+        keys.emplace_back(TRUSTLINE);
+        keys.back().trustLine().accountID = accountID;
+        keys.back().trustLine().asset = asset;
+    }
+}
+
 bool
 OperationFrame::loadAccount(Database& db)
 {
@@ -130,9 +189,8 @@ OperationFrame::checkValid(Application& app, bool forApply)
     {
         if (forApply || !mOperation.sourceAccount)
         {
-            app.getMetrics()
-                .NewMeter({"operation", "invalid", "no-account"}, "operation")
-                .Mark();
+            app.getApplyMeters().mark(
+                ApplyMeters::OPERATION_INVALID_NO_ACCOUNT);
             mResult.code(opNO_ACCOUNT);
             return false;
         }
@@ -145,9 +203,7 @@ OperationFrame::checkValid(Application& app, bool forApply)
 
     if (!checkSignature())
     {
-        app.getMetrics()
-            .NewMeter({"operation", "invalid", "bad-auth"}, "operation")
-            .Mark();
+        app.getApplyMeters().mark(ApplyMeters::OPERATION_INVALID_BAD_AUTH);
         mResult.code(opBAD_AUTH);
         return false;
     }
@@ -162,6 +218,6 @@ OperationFrame::checkValid(Application& app, bool forApply)
     mResult.code(opINNER);
     mResult.tr().type(mOperation.body.type());
 
-    return doCheckValid(app.getMetrics());
+    return doCheckValid(app.getApplyMeters());
 }
 }
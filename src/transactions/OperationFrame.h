@@ -10,14 +10,10 @@
 #include "overlay/StellarXDR.h"
 #include "util/types.h"
 
-namespace medida
-{
-class MetricsRegistry;
-}
-
 namespace stellar
 {
 class Application;
+class ApplyMeters;
 class LedgerManager;
 class LedgerDelta;
 
@@ -33,11 +29,17 @@ class OperationFrame
 
     bool checkSignature() const;
 
-    virtual bool doCheckValid(medida::MetricsRegistry& metrics) = 0;
-    virtual bool doApply(medida::MetricsRegistry& metrics, LedgerDelta& delta,
+    virtual bool doCheckValid(ApplyMeters& meters) = 0;
+    virtual bool doApply(ApplyMeters& meters, LedgerDelta& delta,
                          LedgerManager& ledgerManager) = 0;
     virtual int32_t getNeededThreshold() const;
 
+    static void addAccountKey(std::vector<LedgerKey>& keys,
+                              AccountID const& accountID);
+    // does nothing for the native asset
+    static void addTrustLineKey(std::vector<LedgerKey>& keys,
+                                AccountID const& accountID, Asset const& asset);
+
   public:
     static std::shared_ptr<OperationFrame>
     makeHelper(Operation const& op, OperationResult& res,
@@ -64,6 +66,13 @@ class OperationFrame
 
     AccountID const& getSourceID() const;
 
+    // Add the keys of the entries `op` is known to load, its source account
+    // included, so that they can be prefetched. Works from the operation
+    // alone, so it does not need the frames that checkValid or
+    // processFeeSeqNum build.
+    static void addPrefetchKeys(Operation const& op, AccountID const& txSource,
+                                std::vector<LedgerKey>& keys);
+
     // load account if needed
     // returns true on success
     bool loadAccount(Database& db);
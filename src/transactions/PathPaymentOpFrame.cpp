@@ -3,6 +3,7 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "transactions/PathPaymentOpFrame.h"
+#include "transactions/ApplyMeters.h"
 #include "util/Logging.h"
 #include "ledger/LedgerDelta.h"
 #include "ledger/TrustFrame.h"
@@ -11,9 +12,6 @@
 #include "OfferExchange.h"
 #include <algorithm>
 
-#include "medida/meter.h"
-#include "medida/metrics_registry.h"
-
 namespace stellar
 {
 
@@ -29,8 +27,8 @@ PathPaymentOpFrame::PathPaymentOpFrame(Operation const& op,
 }
 
 bool
-PathPaymentOpFrame::doApply(medida::MetricsRegistry& metrics,
-                            LedgerDelta& delta, LedgerManager& ledgerManager)
+PathPaymentOpFrame::doApply(ApplyMeters& meters, LedgerDelta& delta,
+                            LedgerManager& ledgerManager)
 {
     AccountFrame::pointer destination;
 
@@ -40,8 +38,7 @@ PathPaymentOpFrame::doApply(medida::MetricsRegistry& metrics,
 
     if (!destination)
     {
-        metrics.NewMeter({"op-path-payment", "failure", "no-destination"},
-                         "operation").Mark();
+        meters.mark(ApplyMeters::PATH_PAYMENT_FAILURE_NO_DESTINATION);
         innerResult().code(PATH_PAYMENT_NO_DESTINATION);
         return false;
     }
@@ -75,25 +72,21 @@ PathPaymentOpFrame::doApply(medida::MetricsRegistry& metrics,
                 TrustFrame::loadTrustLine(destination->getID(), curB, db);
             if (!destLine)
             {
-                metrics.NewMeter({"op-path-payment", "failure", "no-trust"},
-                                 "operation").Mark();
+                meters.mark(ApplyMeters::PATH_PAYMENT_FAILURE_NO_TRUST);
                 innerResult().code(PATH_PAYMENT_NO_TRUST);
                 return false;
             }
 
             if (!destLine->isAuthorized())
             {
-                metrics.NewMeter(
-                            {"op-path-payment", "failure", "not-authorized"},
-                            "operation").Mark();
+                meters.mark(ApplyMeters::PATH_PAYMENT_FAILURE_NOT_AUTHORIZED);
                 innerResult().code(PATH_PAYMENT_NOT_AUTHORIZED);
                 return false;
             }
 
             if (!destLine->addBalance(curBReceived))
             {
-                metrics.NewMeter({"op-path-payment", "failure", "line-full"},
-                                 "operation").Mark();
+                meters.mark(ApplyMeters::PATH_PAYMENT_FAILURE_LINE_FULL);
                 innerResult().code(PATH_PAYMENT_LINE_FULL);
                 return false;
             }
@@ -121,15 +114,14 @@ PathPaymentOpFrame::doApply(medida::MetricsRegistry& metrics,
         // curA -> curB
         OfferExchange::ConvertResult r = oe.convertWithOffers(
             curA, INT64_MAX, curASent, curB, curBReceived, actualCurBReceived,
-            [this, &metrics](OfferFrame const& o)
+            [this, &meters](OfferFrame const& o)
             {
                 if (o.getSellerID() == getSourceID())
                 {
                     // we are crossing our own offer, potentially invalidating
                     // mSourceAccount (balance or numSubEntries)
-                    metrics.NewMeter({"op-path-payment", "failure",
-                                      "offer-cross-self"},
-                                     "operation").Mark();
+                    meters.mark(
+                        ApplyMeters::PATH_PAYMENT_FAILURE_OFFER_CROSS_SELF);
                     innerResult().code(PATH_PAYMENT_OFFER_CROSS_SELF);
                     return OfferExchange::eStop;
                 }
@@ -147,8 +139,7 @@ PathPaymentOpFrame::doApply(medida::MetricsRegistry& metrics,
             }
         // fall through
         case OfferExchange::ePartial:
-            metrics.NewMeter({"op-path-payment", "failure", "too-few-offers"},
-                             "operation").Mark();
+            meters.mark(ApplyMeters::PATH_PAYMENT_FAILURE_TOO_FEW_OFFERS);
             innerResult().code(PATH_PAYMENT_TOO_FEW_OFFERS);
             return false;
         }
@@ -172,8 +163,7 @@ PathPaymentOpFrame::doApply(medida::MetricsRegistry& metrics,
 
     if (curBSent > mPathPayment.sendMax)
     { // make sure not over the max
-        metrics.NewMeter({"op-path-payment", "failure", "over-send-max"},
-                         "operation").Mark();
+        meters.mark(ApplyMeters::PATH_PAYMENT_FAILURE_OVER_SEND_MAX);
         innerResult().code(PATH_PAYMENT_OVER_SENDMAX);
         return false;
     }
@@ -184,8 +174,7 @@ PathPaymentOpFrame::doApply(medida::MetricsRegistry& metrics,
 
         if ((mSourceAccount->getAccount().balance - curBSent) < minBalance)
         { // they don't have enough to send
-            metrics.NewMeter({"op-path-payment", "failure", "underfunded"},
-                             "operation").Mark();
+            meters.mark(ApplyMeters::PATH_PAYMENT_FAILURE_UNDERFUNDED);
             innerResult().code(PATH_PAYMENT_UNDERFUNDED);
             return false;
         }
@@ -203,8 +192,7 @@ PathPaymentOpFrame::doApply(medida::MetricsRegistry& metrics,
 
         if (!issuer)
         {
-            metrics.NewMeter({"op-path-payment", "failure", "no-issuer"},
-                             "operation").Mark();
+            meters.mark(ApplyMeters::PATH_PAYMENT_FAILURE_NO_ISSUER);
             throw std::runtime_error("sendCredit Issuer not found");
         }
 
@@ -212,25 +200,21 @@ PathPaymentOpFrame::doApply(medida::MetricsRegistry& metrics,
         sourceLineFrame = TrustFrame::loadTrustLine(getSourceID(), curB, db);
         if (!sourceLineFrame)
         {
-            metrics.NewMeter({"op-path-payment", "failure", "src-no-trust"},
-                             "operation").Mark();
+            meters.mark(ApplyMeters::PATH_PAYMENT_FAILURE_SRC_NO_TRUST);
             innerResult().code(PATH_PAYMENT_SRC_NO_TRUST);
             return false;
         }
 
         if (!sourceLineFrame->isAuthorized())
         {
-            metrics.NewMeter(
-                        {"op-path-payment", "failure", "src-not-authorized"},
-                        "operation").Mark();
+            meters.mark(ApplyMeters::PATH_PAYMENT_FAILURE_SRC_NOT_AUTHORIZED);
             innerResult().code(PATH_PAYMENT_SRC_NOT_AUTHORIZED);
             return false;
         }
 
         if (!sourceLineFrame->addBalance(-curBSent))
         {
-            metrics.NewMeter({"op-path-payment", "failure", "underfunded"},
-                             "operation").Mark();
+            meters.mark(ApplyMeters::PATH_PAYMENT_FAILURE_UNDERFUNDED);
             innerResult().code(PATH_PAYMENT_UNDERFUNDED);
             return false;
         }
@@ -238,38 +222,45 @@ PathPaymentOpFrame::doApply(medida::MetricsRegistry& metrics,
         sourceLineFrame->storeChange(delta, db);
     }
 
-    metrics.NewMeter({"op-path-payment", "success", "apply"}, "operation")
-        .Mark();
+    meters.mark(ApplyMeters::PATH_PAYMENT_SUCCESS_APPLY);
 
     return true;
 }
 
 bool
-PathPaymentOpFrame::doCheckValid(medida::MetricsRegistry& metrics)
+PathPaymentOpFrame::doCheckValid(ApplyMeters& meters)
 {
     if (mPathPayment.destAmount <= 0 || mPathPayment.sendMax <= 0)
     {
-        metrics.NewMeter({"op-path-payment", "invalid", "malformed-amounts"},
-                         "operation").Mark();
+        meters.mark(ApplyMeters::PATH_PAYMENT_INVALID_MALFORMED_AMOUNTS);
         innerResult().code(PATH_PAYMENT_MALFORMED);
         return false;
     }
     if (!isAssetValid(mPathPayment.sendAsset) ||
         !isAssetValid(mPathPayment.destAsset))
     {
-        metrics.NewMeter({"op-path-payment", "invalid", "malformed-currencies"},
-                         "operation").Mark();
+        meters.mark(ApplyMeters::PATH_PAYMENT_INVALID_MALFORMED_CURRENCIES);
         innerResult().code(PATH_PAYMENT_MALFORMED);
         return false;
     }
     auto const& p = mPathPayment.path;
     if (!std::all_of(p.begin(), p.end(), isAssetValid))
     {
-        metrics.NewMeter({"op-path-payment", "invalid", "malformed-currencies"},
-                         "operation").Mark();
+        meters.mark(ApplyMeters::PATH_PAYMENT_INVALID_MALFORMED_CURRENCIES);
         innerResult().code(PATH_PAYMENT_MALFORMED);
         return false;
     }
     return true;
 }
+
+void
+PathPaymentOpFrame::addPrefetchKeys(Operation const& op,
+                                    AccountID const& source,
+                                    std::vector<LedgerKey>& keys)
+{
+    auto const& pathPayment = op.body.pathPaymentOp();
+    addAccountKey(keys, pathPayment.destination);
+    addTrustLineKey(keys, source, pathPayment.sendAsset);
+    addTrustLineKey(keys, pathPayment.destination, pathPayment.destAsset);
+}
 }
@@ -3,6 +3,7 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "transactions/PaymentOpFrame.h"
+#include "transactions/ApplyMeters.h"
 #include "transactions/PathPaymentOpFrame.h"
 #include "util/Logging.h"
 #include "ledger/LedgerDelta.h"
@@ -12,9 +13,6 @@
 #include "OfferExchange.h"
 #include <algorithm>
 
-#include "medida/meter.h"
-#include "medida/metrics_registry.h"
-
 namespace stellar
 {
 
@@ -28,14 +26,13 @@ PaymentOpFrame::PaymentOpFrame(Operation const& op, OperationResult& res,
 }
 
 bool
-PaymentOpFrame::doApply(medida::MetricsRegistry& metrics, LedgerDelta& delta,
+PaymentOpFrame::doApply(ApplyMeters& meters, LedgerDelta& delta,
                         LedgerManager& ledgerManager)
 {
     // if sending to self directly, just mark as success
     if (mPayment.destination == getSourceID())
     {
-        metrics.NewMeter({"op-payment", "success", "apply"}, "operation")
-            .Mark();
+        meters.mark(ApplyMeters::PAYMENT_SUCCESS_APPLY);
         innerResult().code(PAYMENT_SUCCESS);
         return true;
     }
@@ -59,8 +56,8 @@ PaymentOpFrame::doApply(medida::MetricsRegistry& metrics, LedgerDelta& delta,
     PathPaymentOpFrame ppayment(op, opRes, mParentTx);
     ppayment.setSourceAccountPtr(mSourceAccount);
 
-    if (!ppayment.doCheckValid(metrics) ||
-        !ppayment.doApply(metrics, delta, ledgerManager))
+    if (!ppayment.doCheckValid(meters) ||
+        !ppayment.doApply(meters, delta, ledgerManager))
     {
         if (ppayment.getResultCode() != opINNER)
         {
@@ -71,38 +68,31 @@ PaymentOpFrame::doApply(medida::MetricsRegistry& metrics, LedgerDelta& delta,
         switch (PathPaymentOpFrame::getInnerCode(ppayment.getResult()))
         {
         case PATH_PAYMENT_UNDERFUNDED:
-            metrics.NewMeter({"op-payment", "failure", "underfunded"},
-                             "operation").Mark();
+            meters.mark(ApplyMeters::PAYMENT_FAILURE_UNDERFUNDED);
             res = PAYMENT_UNDERFUNDED;
             break;
         case PATH_PAYMENT_SRC_NOT_AUTHORIZED:
-            metrics.NewMeter({"op-payment", "failure", "src-not-authorized"},
-                             "operation").Mark();
+            meters.mark(ApplyMeters::PAYMENT_FAILURE_SRC_NOT_AUTHORIZED);
             res = PAYMENT_SRC_NOT_AUTHORIZED;
             break;
         case PATH_PAYMENT_SRC_NO_TRUST:
-            metrics.NewMeter({"op-payment", "failure", "src-no-trust"},
-                             "operation").Mark();
+            meters.mark(ApplyMeters::PAYMENT_FAILURE_SRC_NO_TRUST);
             res = PAYMENT_SRC_NO_TRUST;
             break;
         case PATH_PAYMENT_NO_DESTINATION:
-            metrics.NewMeter({"op-payment", "failure", "no-destination"},
-                             "operation").Mark();
+            meters.mark(ApplyMeters::PAYMENT_FAILURE_NO_DESTINATION);
             res = PAYMENT_NO_DESTINATION;
             break;
         case PATH_PAYMENT_NO_TRUST:
-            metrics.NewMeter({"op-payment", "failure", "no-trust"}, "operation")
-                .Mark();
+            meters.mark(ApplyMeters::PAYMENT_FAILURE_NO_TRUST);
             res = PAYMENT_NO_TRUST;
             break;
         case PATH_PAYMENT_NOT_AUTHORIZED:
-            metrics.NewMeter({"op-payment", "failure", "not-authorized"},
-                             "operation").Mark();
+            meters.mark(ApplyMeters::PAYMENT_FAILURE_NOT_AUTHORIZED);
             res = PAYMENT_NOT_AUTHORIZED;
             break;
         case PATH_PAYMENT_LINE_FULL:
-            metrics.NewMeter({"op-payment", "failure", "line-full"},
-                             "operation").Mark();
+            meters.mark(ApplyMeters::PAYMENT_FAILURE_LINE_FULL);
             res = PAYMENT_LINE_FULL;
             break;
         default:
@@ -115,29 +105,37 @@ PaymentOpFrame::doApply(medida::MetricsRegistry& metrics, LedgerDelta& delta,
     assert(PathPaymentOpFrame::getInnerCode(ppayment.getResult()) ==
            PATH_PAYMENT_SUCCESS);
 
-    metrics.NewMeter({"op-payment", "success", "apply"}, "operation").Mark();
+    meters.mark(ApplyMeters::PAYMENT_SUCCESS_APPLY);
     innerResult().code(PAYMENT_SUCCESS);
 
     return true;
 }
 
 bool
-PaymentOpFrame::doCheckValid(medida::MetricsRegistry& metrics)
+PaymentOpFrame::doCheckValid(ApplyMeters& meters)
 {
     if (mPayment.amount <= 0)
     {
-        metrics.NewMeter({"op-payment", "invalid", "malformed-negative-amount"},
-                         "operation").Mark();
+        meters.mark(ApplyMeters::PAYMENT_INVALID_MALFORMED_NEGATIVE_AMOUNT);
         innerResult().code(PAYMENT_MALFORMED);
         return false;
     }
     if (!isAssetValid(mPayment.asset))
     {
-        metrics.NewMeter({"op-payment", "invalid", "malformed-invalid-asset"},
-                         "operation").Mark();
+        meters.mark(ApplyMeters::PAYMENT_INVALID_MALFORMED_INVALID_ASSET);
         innerResult().code(PAYMENT_MALFORMED);
         return false;
     }
     return true;
 }
+
+void
+PaymentOpFrame::addPrefetchKeys(Operation const& op, AccountID const& source,
+                                std::vector<LedgerKey>& keys)
+{
+    auto const& payment = op.body.paymentOp();
+    addAccountKey(keys, payment.destination);
+    addTrustLineKey(keys, source, payment.asset);
+    addTrustLineKey(keys, payment.destination, payment.asset);
+}
 }
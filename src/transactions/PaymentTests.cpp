@@ -15,6 +15,10 @@
 #include "ledger/LedgerDelta.h"
 #include "transactions/PaymentOpFrame.h"
 #include "transactions/ChangeTrustOpFrame.h"
+#include "transactions/ApplyMeters.h"
+#include "medida/meter.h"
+#include "medida/metrics_registry.h"
+#include <chrono>
 
 using namespace stellar;
 using namespace stellar::txtest;
@@ -528,3 +532,70 @@ TEST_CASE("single create account SQL", "[singlesql][paymentsql][hide]")
         applyCreateAccountTx(*app, root, a1, rootSeq++, paymentAmount);
     }
 }
+
+TEST_CASE("payment meters", "[tx][payment][meters]")
+{
+    VirtualClock clock;
+    Application::pointer app = Application::create(clock, getTestConfig());
+    app->start();
+
+    auto& metrics = app->getMetrics();
+    auto& success =
+        metrics.NewMeter({"op-payment", "success", "apply"}, "operation");
+    auto& modified =
+        metrics.NewMeter({"ledger", "account", "modify"}, "entry");
+
+    SecretKey root = getRoot(app->getNetworkID());
+    SecretKey a1 = getAccount("A");
+    SequenceNumber rootSeq = getAccountSeqNum(root, *app) + 1;
+    int64_t amount = app->getLedgerManager().getMinBalance(0) * 2;
+    applyCreateAccountTx(*app, root, a1, rootSeq++, amount);
+
+    auto successBefore = success.count();
+    auto modifiedBefore = modified.count();
+
+    LedgerDelta delta(app->getLedgerManager().getCurrentLedgerHeader(),
+                      app->getDatabase());
+    auto tx = createPaymentTx(app->getNetworkID(), root, a1, rootSeq++, 100);
+    REQUIRE(applyCheck(tx, delta, *app));
+    delta.markMeters(*app);
+
+    // ApplyMeters marks the meters registered under the usual names
+    REQUIRE(success.count() == successBefore + 1);
+    REQUIRE(modified.count() == modifiedBefore + 2);
+}
+
+TEST_CASE("operation meter bench", "[tx][meters][bench][hide]")
+{
+    VirtualClock clock;
+    Application::pointer app = Application::create(clock, getTestConfig());
+    auto& metrics = app->getMetrics();
+    auto& meters = app->getApplyMeters();
+
+    size_t const iterations = 1000000;
+
+    // what marking a result used to cost: build the name, look it up
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++)
+    {
+        metrics.NewMeter({"op-payment", "failure", "underfunded"}, "operation")
+            .Mark();
+    }
+    std::chrono::duration<double> byName =
+        std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++)
+    {
+        meters.mark(ApplyMeters::PAYMENT_FAILURE_UNDERFUNDED);
+    }
+    std::chrono::duration<double> preRegistered =
+        std::chrono::steady_clock::now() - start;
+
+    REQUIRE(metrics.NewMeter({"op-payment", "failure", "underfunded"},
+                             "operation").count() == 2 * iterations);
+
+    LOG(INFO) << "marking a meter by name: "
+              << (byName.count() * 1e9 / iterations) << "ns, pre-registered: "
+              << (preRegistered.count() * 1e9 / iterations) << "ns";
+}
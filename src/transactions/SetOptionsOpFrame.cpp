@@ -3,11 +3,9 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "transactions/SetOptionsOpFrame.h"
+#include "transactions/ApplyMeters.h"
 #include "database/Database.h"
 
-#include "medida/meter.h"
-#include "medida/metrics_registry.h"
-
 namespace stellar
 {
 using xdr::operator==;
@@ -33,7 +31,7 @@ SetOptionsOpFrame::getNeededThreshold() const
 }
 
 bool
-SetOptionsOpFrame::doApply(medida::MetricsRegistry& metrics, LedgerDelta& delta,
+SetOptionsOpFrame::doApply(ApplyMeters& meters, LedgerDelta& delta,
                            LedgerManager& ledgerManager)
 {
     Database& db = ledgerManager.getDatabase();
@@ -46,8 +44,7 @@ SetOptionsOpFrame::doApply(medida::MetricsRegistry& metrics, LedgerDelta& delta,
         inflationAccount = AccountFrame::loadAccount(inflationID, db);
         if (!inflationAccount)
         {
-            metrics.NewMeter({"op-set-options", "failure", "invalid-inflation"},
-                             "operation").Mark();
+            meters.mark(ApplyMeters::SET_OPTIONS_FAILURE_INVALID_INFLATION);
             innerResult().code(SET_OPTIONS_INVALID_INFLATION);
             return false;
         }
@@ -67,8 +64,7 @@ SetOptionsOpFrame::doApply(medida::MetricsRegistry& metrics, LedgerDelta& delta,
             // must ensure no one is holding your credit
             if (TrustFrame::hasIssued(account.accountID, db))
             {
-                metrics.NewMeter({"op-set-options", "failure", "cant-change"},
-                                 "operation").Mark();
+                meters.mark(ApplyMeters::SET_OPTIONS_FAILURE_CANT_CHANGE);
                 innerResult().code(SET_OPTIONS_CANT_CHANGE);
                 return false;
             }
@@ -123,17 +119,14 @@ SetOptionsOpFrame::doApply(medida::MetricsRegistry& metrics, LedgerDelta& delta,
             {
                 if (signers.size() == signers.max_size())
                 {
-                    metrics.NewMeter({"op-set-options", "failure",
-                                      "too-many-signers"},
-                                     "operation").Mark();
+                    meters.mark(
+                        ApplyMeters::SET_OPTIONS_FAILURE_TOO_MANY_SIGNERS);
                     innerResult().code(SET_OPTIONS_TOO_MANY_SIGNERS);
                     return false;
                 }
                 if (!mSourceAccount->addNumEntries(1, ledgerManager))
                 {
-                    metrics.NewMeter(
-                                {"op-set-options", "failure", "low-reserve"},
-                                "operation").Mark();
+                    meters.mark(ApplyMeters::SET_OPTIONS_FAILURE_LOW_RESERVE);
                     innerResult().code(SET_OPTIONS_LOW_RESERVE);
                     return false;
                 }
@@ -160,15 +153,14 @@ SetOptionsOpFrame::doApply(medida::MetricsRegistry& metrics, LedgerDelta& delta,
         mSourceAccount->setUpdateSigners();
     }
 
-    metrics.NewMeter({"op-set-options", "success", "apply"}, "operation")
-        .Mark();
+    meters.mark(ApplyMeters::SET_OPTIONS_SUCCESS_APPLY);
     innerResult().code(SET_OPTIONS_SUCCESS);
     mSourceAccount->storeChange(delta, db);
     return true;
 }
 
 bool
-SetOptionsOpFrame::doCheckValid(medida::MetricsRegistry& metrics)
+SetOptionsOpFrame::doCheckValid(ApplyMeters& meters)
 {
     if (mSetOptions.setFlags)
     {
@@ -193,8 +185,7 @@ SetOptionsOpFrame::doCheckValid(medida::MetricsRegistry& metrics)
     {
         if ((*mSetOptions.setFlags & *mSetOptions.clearFlags) != 0)
         {
-            metrics.NewMeter({"op-set-options", "invalid", "bad-flags"},
-                             "operation").Mark();
+            meters.mark(ApplyMeters::SET_OPTIONS_INVALID_BAD_FLAGS);
             innerResult().code(SET_OPTIONS_BAD_FLAGS);
             return false;
         }
@@ -204,9 +195,8 @@ SetOptionsOpFrame::doCheckValid(medida::MetricsRegistry& metrics)
     {
         if (*mSetOptions.masterWeight > UINT8_MAX)
         {
-            metrics.NewMeter(
-                        {"op-set-options", "invalid", "threshold-out-of-range"},
-                        "operation").Mark();
+            meters.mark(
+                ApplyMeters::SET_OPTIONS_INVALID_THRESHOLD_OUT_OF_RANGE);
             innerResult().code(SET_OPTIONS_THRESHOLD_OUT_OF_RANGE);
             return false;
         }
@@ -216,9 +206,8 @@ SetOptionsOpFrame::doCheckValid(medida::MetricsRegistry& metrics)
     {
         if (*mSetOptions.lowThreshold > UINT8_MAX)
         {
-            metrics.NewMeter(
-                        {"op-set-options", "invalid", "threshold-out-of-range"},
-                        "operation").Mark();
+            meters.mark(
+                ApplyMeters::SET_OPTIONS_INVALID_THRESHOLD_OUT_OF_RANGE);
             innerResult().code(SET_OPTIONS_THRESHOLD_OUT_OF_RANGE);
             return false;
         }
@@ -228,9 +217,8 @@ SetOptionsOpFrame::doCheckValid(medida::MetricsRegistry& metrics)
     {
         if (*mSetOptions.medThreshold > UINT8_MAX)
         {
-            metrics.NewMeter(
-                        {"op-set-options", "invalid", "threshold-out-of-range"},
-                        "operation").Mark();
+            meters.mark(
+                ApplyMeters::SET_OPTIONS_INVALID_THRESHOLD_OUT_OF_RANGE);
             innerResult().code(SET_OPTIONS_THRESHOLD_OUT_OF_RANGE);
             return false;
         }
@@ -240,9 +228,8 @@ SetOptionsOpFrame::doCheckValid(medida::MetricsRegistry& metrics)
     {
         if (*mSetOptions.highThreshold > UINT8_MAX)
         {
-            metrics.NewMeter(
-                        {"op-set-options", "invalid", "threshold-out-of-range"},
-                        "operation").Mark();
+            meters.mark(
+                ApplyMeters::SET_OPTIONS_INVALID_THRESHOLD_OUT_OF_RANGE);
             innerResult().code(SET_OPTIONS_THRESHOLD_OUT_OF_RANGE);
             return false;
         }
@@ -252,8 +239,7 @@ SetOptionsOpFrame::doCheckValid(medida::MetricsRegistry& metrics)
     {
         if (mSetOptions.signer->pubKey == getSourceID())
         {
-            metrics.NewMeter({"op-set-options", "invalid", "bad-signer"},
-                             "operation").Mark();
+            meters.mark(ApplyMeters::SET_OPTIONS_INVALID_BAD_SIGNER);
             innerResult().code(SET_OPTIONS_BAD_SIGNER);
             return false;
         }
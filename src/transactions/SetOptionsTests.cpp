@@ -13,6 +13,9 @@
 #include "TxTests.h"
 #include "transactions/TransactionFrame.h"
 #include "ledger/LedgerDelta.h"
+#include "database/Database.h"
+#include <algorithm>
+#include <chrono>
 
 using namespace stellar;
 using namespace stellar::txtest;
@@ -137,3 +140,95 @@ TEST_CASE("set options", "[tx][setoptions]")
     // set thresholds
     // set signer
 }
+
+TEST_CASE("signer load and update bench", "[tx][setoptions][bench][hide]")
+{
+    using xdr::operator==;
+
+    Config const& cfg = getTestConfig();
+
+    VirtualClock clock;
+    Application::pointer appPtr = Application::create(clock, cfg);
+    Application& app = *appPtr;
+    app.start();
+
+    auto& lm = app.getLedgerManager();
+    auto& db = app.getDatabase();
+    SecretKey root = getRoot(app.getNetworkID());
+    SequenceNumber rootSeq = getAccountSeqNum(root, app) + 1;
+
+    size_t const iterations = 2000;
+
+    for (size_t nSigners : {1, 10, 20})
+    {
+        std::string name = "bench-" + std::to_string(nSigners);
+        SecretKey a = getAccount(name.c_str());
+        applyCreateAccountTx(app, root, a, rootSeq++,
+                             lm.getMinBalance(nSigners) + 1000);
+        SequenceNumber aSeq = getAccountSeqNum(a, app) + 1;
+        for (size_t i = 0; i < nSigners; i++)
+        {
+            SecretKey s =
+                getAccount((name + "-" + std::to_string(i)).c_str());
+            Signer sk(s.getPublicKey(), 1);
+            applySetOptions(app, a, aSeq++, nullptr, nullptr, nullptr, nullptr,
+                            &sk);
+        }
+        AccountID const& id = a.getPublicKey();
+        LedgerKey key;
+        key.type(ACCOUNT);
+        key.account().accountID = id;
+
+        // cold loads: accounts row and signers every time
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; i++)
+        {
+            AccountFrame::flushCachedEntry(key, db);
+            auto acc = AccountFrame::loadAccount(id, db);
+            REQUIRE(acc->getAccount().signers.size() == nSigners);
+        }
+        std::chrono::duration<double> loadTime =
+            std::chrono::steady_clock::now() - start;
+
+        // updates changing the weight of a single signer
+        std::chrono::duration<double> updateTime(0);
+        LedgerDelta delta(lm.getCurrentLedgerHeader(), db);
+        for (size_t i = 0; i < iterations; i++)
+        {
+            auto acc = AccountFrame::loadAccount(id, db);
+            acc->getAccount().signers[i % nSigners].weight =
+                static_cast<uint32_t>(2 + i % 2);
+            acc->setUpdateSigners();
+            start = std::chrono::steady_clock::now();
+            acc->storeChange(delta, db);
+            updateTime += std::chrono::steady_clock::now() - start;
+        }
+        delta.commit();
+
+        AccountFrame::flushCachedEntry(key, db);
+        auto acc = AccountFrame::loadAccount(id, db);
+        REQUIRE(acc->getAccount().signers.size() == nSigners);
+        for (size_t i = 0; i < nSigners; i++)
+        {
+            uint32_t expected = 1;
+            for (size_t j = i; j < iterations; j += nSigners)
+            {
+                expected = static_cast<uint32_t>(2 + j % 2);
+            }
+            auto const& signers = acc->getAccount().signers;
+            SecretKey s =
+                getAccount((name + "-" + std::to_string(i)).c_str());
+            auto it = std::find_if(signers.begin(), signers.end(),
+                                   [&](Signer const& sg)
+                                   {
+                                       return sg.pubKey == s.getPublicKey();
+                                   });
+            REQUIRE(it != signers.end());
+            REQUIRE(it->weight == expected);
+        }
+
+        LOG(INFO) << nSigners << " signers: "
+                  << iterations / loadTime.count() << " loads/s, "
+                  << iterations / updateTime.count() << " updates/s";
+    }
+}
@@ -13,9 +13,11 @@
 #include "crypto/SHA.h"
 #include "crypto/SecretKey.h"
 #include "database/Database.h"
+#include "transactions/ApplyMeters.h"
 #include "herder/TxSetFrame.h"
 #include "crypto/Hex.h"
 #include "util/basen.h"
+#include "util/make_unique.h"
 
 #include "medida/meter.h"
 #include "medida/metrics_registry.h"
@@ -45,11 +47,17 @@ TransactionFrame::getFullHash() const
 {
     if (isZero(mFullHash))
     {
-        mFullHash = sha256(xdr::xdr_to_opaque(mEnvelope));
+        mFullHash = sha256(getEnvelopeBytes());
     }
     return (mFullHash);
 }
 
+xdr::opaque_vec<> const&
+TransactionFrame::getEnvelopeBytes() const
+{
+    return mEnvelopeBytes.get(mEnvelope);
+}
+
 Hash const&
 TransactionFrame::getContentsHash() const
 {
@@ -61,12 +69,44 @@ TransactionFrame::getContentsHash() const
     return (mContentsHash);
 }
 
+void
+TransactionFrame::computeHashes(std::vector<TransactionFramePtr> const& txs)
+{
+    // the contents are only ever hashed, the envelopes are kept by the frames
+    std::vector<xdr::opaque_vec<>> contents;
+    contents.reserve(txs.size());
+    std::vector<ByteSlice> bins;
+    std::vector<Hash*> hashes;
+    for (auto const& tx : txs)
+    {
+        if (isZero(tx->mFullHash))
+        {
+            bins.emplace_back(tx->getEnvelopeBytes());
+            hashes.push_back(&tx->mFullHash);
+        }
+        if (isZero(tx->mContentsHash))
+        {
+            contents.emplace_back(xdr::xdr_to_opaque(
+                tx->mNetworkID, ENVELOPE_TYPE_TX, tx->mEnvelope.tx));
+            bins.emplace_back(contents.back());
+            hashes.push_back(&tx->mContentsHash);
+        }
+    }
+
+    auto res = sha256Batch(bins);
+    for (size_t i = 0; i < res.size(); i++)
+    {
+        *hashes[i] = res[i];
+    }
+}
+
 void
 TransactionFrame::clearCached()
 {
     Hash zero;
     mContentsHash = zero;
     mFullHash = zero;
+    mEnvelopeBytes.clear();
 }
 
 TransactionResultPair
@@ -217,10 +257,8 @@ TransactionFrame::commonValid(Application& app, bool applying,
 {
     if (mOperations.size() == 0)
     {
-        app.getMetrics()
-            .NewMeter({"transaction", "invalid", "missing-operation"},
-                      "transaction")
-            .Mark();
+        app.getApplyMeters().mark(
+            ApplyMeters::TRANSACTION_INVALID_MISSING_OPERATION);
         getResult().result.code(txMISSING_OPERATION);
         return false;
     }
@@ -231,19 +269,16 @@ TransactionFrame::commonValid(Application& app, bool applying,
             app.getLedgerManager().getCurrentLedgerHeader().scpValue.closeTime;
         if (mEnvelope.tx.timeBounds->minTime > closeTime)
         {
-            app.getMetrics()
-                .NewMeter({"transaction", "invalid", "too-early"},
-                          "transaction")
-                .Mark();
+            app.getApplyMeters().mark(
+                ApplyMeters::TRANSACTION_INVALID_TOO_EARLY);
             getResult().result.code(txTOO_EARLY);
             return false;
         }
         if (mEnvelope.tx.timeBounds->maxTime &&
             (mEnvelope.tx.timeBounds->maxTime < closeTime))
         {
-            app.getMetrics()
-                .NewMeter({"transaction", "invalid", "too-late"}, "transaction")
-                .Mark();
+            app.getApplyMeters().mark(
+                ApplyMeters::TRANSACTION_INVALID_TOO_LATE);
             getResult().result.code(txTOO_LATE);
             return false;
         }
@@ -251,19 +286,15 @@ TransactionFrame::commonValid(Application& app, bool applying,
 
     if (mEnvelope.tx.fee < getMinFee(app))
     {
-        app.getMetrics()
-            .NewMeter({"transaction", "invalid", "insufficient-fee"},
-                      "transaction")
-            .Mark();
+        app.getApplyMeters().mark(
+            ApplyMeters::TRANSACTION_INVALID_INSUFFICIENT_FEE);
         getResult().result.code(txINSUFFICIENT_FEE);
         return false;
     }
 
     if (!loadAccount(app.getDatabase()))
     {
-        app.getMetrics()
-            .NewMeter({"transaction", "invalid", "no-account"}, "transaction")
-            .Mark();
+        app.getApplyMeters().mark(ApplyMeters::TRANSACTION_INVALID_NO_ACCOUNT);
         getResult().result.code(txNO_ACCOUNT);
         return false;
     }
@@ -278,9 +309,7 @@ TransactionFrame::commonValid(Application& app, bool applying,
 
         if (current + 1 != mEnvelope.tx.seqNum)
         {
-            app.getMetrics()
-                .NewMeter({"transaction", "invalid", "bad-seq"}, "transaction")
-                .Mark();
+            app.getApplyMeters().mark(ApplyMeters::TRANSACTION_INVALID_BAD_SEQ);
             getResult().result.code(txBAD_SEQ);
             return false;
         }
@@ -288,9 +317,7 @@ TransactionFrame::commonValid(Application& app, bool applying,
 
     if (!checkSignature(*mSigningAccount, mSigningAccount->getLowThreshold()))
     {
-        app.getMetrics()
-            .NewMeter({"transaction", "invalid", "bad-auth"}, "transaction")
-            .Mark();
+        app.getApplyMeters().mark(ApplyMeters::TRANSACTION_INVALID_BAD_AUTH);
         getResult().result.code(txBAD_AUTH);
         return false;
     }
@@ -299,10 +326,8 @@ TransactionFrame::commonValid(Application& app, bool applying,
     if (mSigningAccount->getAccount().balance - mEnvelope.tx.fee <
         mSigningAccount->getMinimumBalance(app.getLedgerManager()))
     {
-        app.getMetrics()
-            .NewMeter({"transaction", "invalid", "insufficient-balance"},
-                      "transaction")
-            .Mark();
+        app.getApplyMeters().mark(
+            ApplyMeters::TRANSACTION_INVALID_INSUFFICIENT_BALANCE);
         getResult().result.code(txINSUFFICIENT_BALANCE);
         return false;
     }
@@ -310,6 +335,17 @@ TransactionFrame::commonValid(Application& app, bool applying,
     return true;
 }
 
+void
+TransactionFrame::addPrefetchKeys(std::vector<LedgerKey>& keys) const
+{
+    keys.emplace_back(ACCOUNT);
+    keys.back().account().accountID = getSourceID();
+    for (auto const& op : mEnvelope.tx.operations)
+    {
+        OperationFrame::addPrefetchKeys(op, getSourceID(), keys);
+    }
+}
+
 void
 TransactionFrame::processFeeSeqNum(LedgerDelta& delta,
                                    LedgerManager& ledgerManager)
@@ -395,10 +431,8 @@ TransactionFrame::checkValid(Application& app, SequenceNumber current)
                 // it's OK to just fast fail here and not try to call
                 // checkValid on all operations as the resulting object
                 // is only used by applications
-                app.getMetrics()
-                    .NewMeter({"transaction", "invalid", "invalid-op"},
-                              "transaction")
-                    .Mark();
+                app.getApplyMeters().mark(
+                    ApplyMeters::TRANSACTION_INVALID_INVALID_OP);
                 markResultFailed();
                 return false;
             }
@@ -406,10 +440,8 @@ TransactionFrame::checkValid(Application& app, SequenceNumber current)
         res = checkAllSignaturesUsed();
         if (!res)
         {
-            app.getMetrics()
-                .NewMeter({"transaction", "invalid", "bad-auth-extra"},
-                          "transaction")
-                .Mark();
+            app.getApplyMeters().mark(
+                ApplyMeters::TRANSACTION_INVALID_BAD_AUTH_EXTRA);
         }
     }
     return res;
@@ -502,89 +534,315 @@ TransactionFrame::toStellarMessage() const
     return msg;
 }
 
-void
-TransactionFrame::storeTransaction(LedgerManager& ledgerManager,
-                                   TransactionMeta& tm, int txindex,
-                                   TransactionResultSet& resultSet) const
+namespace
 {
-    auto txBytes(xdr::xdr_to_opaque(mEnvelope));
+/**
+ * Exchanges one XDR-valued history column with the database, in whichever
+ * encoding the schema uses (see Database::SCHEMA_VERSION): base64 TEXT before
+ * schema 2, raw bytes afterwards. Raw bytes are stored as a BLOB on sqlite,
+ * bound through soci::blob, and as a BYTEA on postgres. soci only binds text
+ * to postgres, so there the bytes travel in bytea's hex form ("\x0a1b..."),
+ * which the server converts to and from binary storage.
+ */
+class HistoryColumn
+{
+    enum Encoding
+    {
+        BASE64_TEXT,
+        SQLITE_BLOB,
+        POSTGRES_BYTEA
+    };
+
+    Encoding mEncoding;
+    std::unique_ptr<soci::blob> mBlob;
+    std::string mText;
+    std::vector<uint8_t> mBytes;
+
+  public:
+    HistoryColumn(Database& db, soci::session& sess, bool binary)
+        : mEncoding(!binary ? BASE64_TEXT : db.isSqlite() ? SQLITE_BLOB
+                                                          : POSTGRES_BYTEA)
+    {
+        if (mEncoding == SQLITE_BLOB)
+        {
+            mBlob = make_unique<soci::blob>(sess);
+        }
+    }
 
-    resultSet.results.emplace_back(getResultPair());
-    auto txResultBytes(xdr::xdr_to_opaque(resultSet.results.back()));
+    HistoryColumn(Database& db, soci::session& sess)
+        : HistoryColumn(db, sess, db.getDBSchemaVersion() >= 2)
+    {
+    }
+
+    void
+    exchangeUse(soci::statement& st)
+    {
+        if (mBlob)
+        {
+            st.exchange(soci::use(*mBlob));
+        }
+        else
+        {
+            st.exchange(soci::use(mText));
+        }
+    }
+
+    void
+    exchangeInto(soci::statement& st)
+    {
+        if (mBlob)
+        {
+            st.exchange(soci::into(*mBlob));
+        }
+        else
+        {
+            st.exchange(soci::into(mText));
+        }
+    }
+
+    void
+    setBytes(std::vector<uint8_t> const& bytes)
+    {
+        switch (mEncoding)
+        {
+        case BASE64_TEXT:
+            mText = bn::encode_b64(bytes);
+            break;
+        case SQLITE_BLOB:
+            if (mBlob->get_len() != 0)
+            {
+                mBlob->trim(0);
+            }
+            if (!bytes.empty())
+            {
+                mBlob->write(0, reinterpret_cast<char const*>(bytes.data()),
+                             bytes.size());
+            }
+            break;
+        case POSTGRES_BYTEA:
+            mText = "\\x" + binToHex(bytes);
+            break;
+        }
+    }
+
+    template <typename T>
+    void
+    set(T const& t)
+    {
+        auto bytes = xdr::xdr_to_opaque(t);
+        setBytes(bytes);
+    }
+
+    // Decode the current row's column into mBytes and return it.
+    std::vector<uint8_t> const&
+    getBytes()
+    {
+        switch (mEncoding)
+        {
+        case BASE64_TEXT:
+            mBytes.clear();
+            bn::decode_b64(mText, mBytes);
+            break;
+        case SQLITE_BLOB:
+            mBytes.resize(mBlob->get_len());
+            if (!mBytes.empty())
+            {
+                mBlob->read(0, reinterpret_cast<char*>(mBytes.data()),
+                            mBytes.size());
+            }
+            break;
+        case POSTGRES_BYTEA:
+            if (mText.compare(0, 2, "\\x") != 0)
+            {
+                throw std::runtime_error("unexpected bytea encoding");
+            }
+            mBytes = hexToBin(mText.substr(2));
+            break;
+        }
+        return mBytes;
+    }
+
+    template <typename T>
+    void
+    get(T& t)
+    {
+        auto const& bytes = getBytes();
+        xdr::xdr_get g(bytes.data(), bytes.data() + bytes.size());
+        xdr_argpack_archive(g, t);
+    }
+};
+}
 
-    std::string txBody;
-    txBody = bn::encode_b64(txBytes);
+size_t const TxHistoryBatch::MAX_ROWS_PER_INSERT = 64;
 
-    std::string txResult;
-    txResult = bn::encode_b64(txResultBytes);
+TxHistoryBatch::TxHistoryBatch(Database& db, uint32 ledgerSeq)
+    : mDatabase(db), mLedgerSeq(ledgerSeq)
+{
+}
+
+void
+TxHistoryBatch::addTransaction(std::string const& txID, int txindex,
+                               std::vector<uint8_t> body,
+                               std::vector<uint8_t> result,
+                               std::vector<uint8_t> meta)
+{
+    mTxRows.push_back(TxRow{txID, txindex, std::move(body), std::move(result),
+                            std::move(meta)});
+}
 
-    xdr::opaque_vec<> txMeta(xdr::xdr_to_opaque(tm));
+void
+TxHistoryBatch::addFee(std::string const& txID, int txindex,
+                       std::vector<uint8_t> changes)
+{
+    mFeeRows.push_back(FeeRow{txID, txindex, std::move(changes)});
+}
 
-    std::string meta;
-    meta = bn::encode_b64(txMeta);
+// Split [0, n) into chunks of MAX_ROWS_PER_INSERT rows, then a power-of-two
+// decomposition of the remainder, so only a handful of distinct multi-row
+// statements ever end up in the prepared statement cache.
+template <typename F>
+static void
+forEachInsertChunk(size_t n, F f)
+{
+    size_t begin = 0;
+    for (size_t chunk = TxHistoryBatch::MAX_ROWS_PER_INSERT; chunk > 0;
+         chunk /= 2)
+    {
+        while (n - begin >= chunk)
+        {
+            f(begin, begin + chunk);
+            begin += chunk;
+        }
+    }
+}
 
-    string txIDString(binToHex(getContentsHash()));
+static std::string
+multiRowInsert(std::string const& head,
+               std::vector<std::string> const& columns, size_t nRows)
+{
+    std::string sql = head + " VALUES ";
+    for (size_t i = 0; i < nRows; ++i)
+    {
+        sql += (i == 0) ? "(" : ", (";
+        for (size_t j = 0; j < columns.size(); ++j)
+        {
+            sql += (j == 0) ? ":" : ", :";
+            sql += columns[j] + std::to_string(i);
+        }
+        sql += ")";
+    }
+    return sql;
+}
 
-    auto& db = ledgerManager.getDatabase();
-    auto prep = db.getPreparedStatement(
+void
+TxHistoryBatch::flushTxRows(size_t begin, size_t end)
+{
+    size_t n = end - begin;
+    auto prep = mDatabase.getPreparedStatement(multiRowInsert(
         "INSERT INTO txhistory "
-        "( txid, ledgerseq, txindex,  txbody, txresult, txmeta) VALUES "
-        "(:id,  :seq,      :txindex, :txb,   :txres,   :meta)");
+        "(txid, ledgerseq, txindex, txbody, txresult, txmeta)",
+        {"id", "seq", "txindex", "txb", "txres", "meta"}, n));
 
+    auto& sess = mDatabase.getSession();
     auto& st = prep.statement();
-    st.exchange(soci::use(txIDString));
-    st.exchange(soci::use(ledgerManager.getCurrentLedgerHeader().ledgerSeq));
-    st.exchange(soci::use(txindex));
-    st.exchange(soci::use(txBody));
-    st.exchange(soci::use(txResult));
-    st.exchange(soci::use(meta));
+    std::vector<HistoryColumn> columns;
+    columns.reserve(3 * n);
+    for (size_t i = begin; i < end; ++i)
+    {
+        auto& row = mTxRows[i];
+        st.exchange(soci::use(row.mTxID));
+        st.exchange(soci::use(mLedgerSeq));
+        st.exchange(soci::use(row.mTxIndex));
+        for (auto bytes : {&row.mBody, &row.mResult, &row.mMeta})
+        {
+            columns.emplace_back(mDatabase, sess);
+            columns.back().setBytes(*bytes);
+            columns.back().exchangeUse(st);
+        }
+    }
     st.define_and_bind();
     {
-        auto timer = db.getInsertTimer("txhistory");
+        auto timer = mDatabase.getInsertTimer("txhistory");
         st.execute(true);
     }
 
-    if (st.get_affected_rows() != 1)
+    if (st.get_affected_rows() != static_cast<long long>(n))
     {
         throw std::runtime_error("Could not update data in SQL");
     }
 }
 
 void
-TransactionFrame::storeTransactionFee(LedgerManager& ledgerManager,
-                                      LedgerEntryChanges const& changes,
-                                      int txindex) const
+TxHistoryBatch::flushFeeRows(size_t begin, size_t end)
 {
-    xdr::opaque_vec<> txChanges(xdr::xdr_to_opaque(changes));
-
-    std::string txChanges64;
-    txChanges64 = bn::encode_b64(txChanges);
-
-    string txIDString(binToHex(getContentsHash()));
-
-    auto& db = ledgerManager.getDatabase();
-    auto prep = db.getPreparedStatement(
-        "INSERT INTO txfeehistory "
-        "( txid, ledgerseq, txindex,  txchanges) VALUES "
-        "(:id,  :seq,      :txindex, :txchanges)");
+    size_t n = end - begin;
+    auto prep = mDatabase.getPreparedStatement(
+        multiRowInsert("INSERT INTO txfeehistory "
+                       "(txid, ledgerseq, txindex, txchanges)",
+                       {"id", "seq", "txindex", "txchanges"}, n));
 
+    auto& sess = mDatabase.getSession();
     auto& st = prep.statement();
-    st.exchange(soci::use(txIDString));
-    st.exchange(soci::use(ledgerManager.getCurrentLedgerHeader().ledgerSeq));
-    st.exchange(soci::use(txindex));
-    st.exchange(soci::use(txChanges64));
+    std::vector<HistoryColumn> columns;
+    columns.reserve(n);
+    for (size_t i = begin; i < end; ++i)
+    {
+        auto& row = mFeeRows[i];
+        st.exchange(soci::use(row.mTxID));
+        st.exchange(soci::use(mLedgerSeq));
+        st.exchange(soci::use(row.mTxIndex));
+        columns.emplace_back(mDatabase, sess);
+        columns.back().setBytes(row.mChanges);
+        columns.back().exchangeUse(st);
+    }
     st.define_and_bind();
     {
-        auto timer = db.getInsertTimer("txfeehistory");
+        auto timer = mDatabase.getInsertTimer("txfeehistory");
         st.execute(true);
     }
 
-    if (st.get_affected_rows() != 1)
+    if (st.get_affected_rows() != static_cast<long long>(n))
     {
         throw std::runtime_error("Could not update data in SQL");
     }
 }
 
+void
+TxHistoryBatch::flush()
+{
+    forEachInsertChunk(mFeeRows.size(), [this](size_t begin, size_t end)
+                       {
+                           flushFeeRows(begin, end);
+                       });
+    forEachInsertChunk(mTxRows.size(), [this](size_t begin, size_t end)
+                       {
+                           flushTxRows(begin, end);
+                       });
+    mFeeRows.clear();
+    mTxRows.clear();
+}
+
+void
+TransactionFrame::storeTransaction(TxHistoryBatch& batch, TransactionMeta& tm,
+                                   int txindex,
+                                   TransactionResultSet& resultSet) const
+{
+    resultSet.results.emplace_back(getResultPair());
+    batch.addTransaction(binToHex(getContentsHash()), txindex,
+                         getEnvelopeBytes(),
+                         xdr::xdr_to_opaque(resultSet.results.back()),
+                         xdr::xdr_to_opaque(tm));
+}
+
+void
+TransactionFrame::storeTransactionFee(TxHistoryBatch& batch,
+                                      LedgerEntryChanges const& changes,
+                                      int txindex) const
+{
+    batch.addFee(binToHex(getContentsHash()), txindex,
+                 xdr::xdr_to_opaque(changes));
+}
+
 static void
 saveTransactionHelper(Database& db, soci::session& sess, uint32 ledgerSeq,
                       TxSetFrame& txSet, TransactionHistoryResultEntry& results,
@@ -612,27 +870,20 @@ TransactionResultSet
 TransactionFrame::getTransactionHistoryMeta(Database& db, uint32 ledgerSeq)
 {
     TransactionResultSet res;
-    std::string txresult64;
+    HistoryColumn txResult(db, db.getSession());
     auto prep =
         db.getPreparedStatement("SELECT txresult FROM txhistory "
                                 "WHERE ledgerseq = :lseq ORDER BY txindex ASC");
     auto& st = prep.statement();
 
     st.exchange(soci::use(ledgerSeq));
-    st.exchange(soci::into(txresult64));
+    txResult.exchangeInto(st);
     st.define_and_bind();
     st.execute(true);
     while (st.got_data())
     {
-        std::vector<uint8_t> result;
-        bn::decode_b64(txresult64, result);
-
         res.results.emplace_back();
-        TransactionResultPair& p = res.results.back();
-
-        xdr::xdr_get g(&result.front(), &result.back() + 1);
-        xdr_argpack_archive(g, p);
-
+        txResult.get(res.results.back());
         st.fetch();
     }
     return res;
@@ -642,25 +893,20 @@ std::vector<LedgerEntryChanges>
 TransactionFrame::getTransactionFeeMeta(Database& db, uint32 ledgerSeq)
 {
     std::vector<LedgerEntryChanges> res;
-    std::string changes64;
+    HistoryColumn txChanges(db, db.getSession());
     auto prep =
         db.getPreparedStatement("SELECT txchanges FROM txfeehistory "
                                 "WHERE ledgerseq = :lseq ORDER BY txindex ASC");
     auto& st = prep.statement();
 
-    st.exchange(soci::into(changes64));
+    txChanges.exchangeInto(st);
     st.exchange(soci::use(ledgerSeq));
     st.define_and_bind();
     st.execute(true);
     while (st.got_data())
     {
-        std::vector<uint8_t> changesRaw;
-        bn::decode_b64(changes64, changesRaw);
-
-        xdr::xdr_get g1(&changesRaw.front(), &changesRaw.back() + 1);
         res.emplace_back();
-        xdr_argpack_archive(g1, res.back());
-
+        txChanges.get(res.back());
         st.fetch();
     }
     return res;
@@ -675,7 +921,8 @@ TransactionFrame::copyTransactionsToStream(Hash const& networkID, Database& db,
                                            XDROutputFileStream& txResultOut)
 {
     auto timer = db.getSelectTimer("txhistory");
-    std::string txBody, txResult, txMeta;
+    HistoryColumn txBody(db, sess);
+    HistoryColumn txResult(db, sess);
     uint32_t begin = ledgerSeq, end = ledgerSeq + ledgerCount;
     size_t n = 0;
 
@@ -686,9 +933,13 @@ TransactionFrame::copyTransactionsToStream(Hash const& networkID, Database& db,
     soci::statement st =
         (sess.prepare << "SELECT ledgerseq, txbody, txresult FROM txhistory "
                          "WHERE ledgerseq >= :begin AND ledgerseq < :end ORDER "
-                         "BY ledgerseq ASC, txindex ASC",
-         soci::into(curLedgerSeq), soci::into(txBody), soci::into(txResult),
-         soci::use(begin), soci::use(end));
+                         "BY ledgerseq ASC, txindex ASC");
+    st.exchange(soci::into(curLedgerSeq));
+    txBody.exchangeInto(st);
+    txResult.exchangeInto(st);
+    st.exchange(soci::use(begin));
+    st.exchange(soci::use(end));
+    st.define_and_bind();
 
     Hash h;
     TxSetFrame txSet(h); // we're setting the hash later
@@ -712,24 +963,16 @@ TransactionFrame::copyTransactionsToStream(Hash const& networkID, Database& db,
             lastLedgerSeq = curLedgerSeq;
         }
 
-        std::vector<uint8_t> body;
-        bn::decode_b64(txBody, body);
-
-        std::vector<uint8_t> result;
-        bn::decode_b64(txResult, result);
-
-        xdr::xdr_get g1(&body.front(), &body.back() + 1);
-        xdr_argpack_archive(g1, tx);
+        txBody.get(tx);
 
         TransactionFramePtr txFrame =
             make_shared<TransactionFrame>(networkID, tx);
         txSet.add(txFrame);
 
-        xdr::xdr_get g2(&result.front(), &result.back() + 1);
         results.txResultSet.results.emplace_back();
 
         TransactionResultPair& p = results.txResultSet.results.back();
-        xdr_argpack_archive(g2, p);
+        txResult.get(p);
 
         if (p.transactionHash != txFrame->getContentsHash())
         {
@@ -747,39 +990,196 @@ TransactionFrame::copyTransactionsToStream(Hash const& networkID, Database& db,
     return n;
 }
 
-void
-TransactionFrame::dropAll(Database& db)
+static void
+createHistoryTables(Database& db, std::string const& suffix)
 {
-    db.getSession() << "DROP TABLE IF EXISTS txhistory";
+    std::string blobType = db.isSqlite() ? "BLOB" : "BYTEA";
 
-    db.getSession() << "DROP TABLE IF EXISTS txfeehistory";
-
-    db.getSession() << "CREATE TABLE txhistory ("
+    db.getSession() << "CREATE TABLE txhistory" << suffix
+                    << " ("
                        "txid        CHARACTER(64) NOT NULL,"
                        "ledgerseq   INT NOT NULL CHECK (ledgerseq >= 0),"
                        "txindex     INT NOT NULL,"
-                       "txbody      TEXT NOT NULL,"
-                       "txresult    TEXT NOT NULL,"
-                       "txmeta      TEXT NOT NULL,"
-                       "PRIMARY KEY (ledgerseq, txindex)"
-                       ")";
-    db.getSession() << "CREATE INDEX histbyseq ON txhistory (ledgerseq);";
-
-    db.getSession() << "CREATE TABLE txfeehistory ("
+                       "txbody      "
+                    << blobType << " NOT NULL,"
+                                   "txresult    "
+                    << blobType << " NOT NULL,"
+                                   "txmeta      "
+                    << blobType << " NOT NULL,"
+                                   "PRIMARY KEY (ledgerseq, txindex)"
+                                   ")";
+
+    db.getSession() << "CREATE TABLE txfeehistory" << suffix
+                    << " ("
                        "txid        CHARACTER(64) NOT NULL,"
                        "ledgerseq   INT NOT NULL CHECK (ledgerseq >= 0),"
                        "txindex     INT NOT NULL,"
-                       "txchanges   TEXT NOT NULL,"
-                       "PRIMARY KEY (ledgerseq, txindex)"
-                       ")";
+                       "txchanges   "
+                    << blobType << " NOT NULL,"
+                                   "PRIMARY KEY (ledgerseq, txindex)"
+                                   ")";
+}
+
+static void
+createHistoryIndexes(Database& db)
+{
+    db.getSession() << "CREATE INDEX histbyseq ON txhistory (ledgerseq);";
     db.getSession() << "CREATE INDEX histfeebyseq ON txfeehistory (ledgerseq);";
 }
 
 void
-TransactionFrame::deleteOldEntries(Database& db, uint32_t ledgerSeq)
+TransactionFrame::dropAll(Database& db)
+{
+    db.getSession() << "DROP TABLE IF EXISTS txhistory";
+
+    db.getSession() << "DROP TABLE IF EXISTS txfeehistory";
+
+    createHistoryTables(db, "");
+    createHistoryIndexes(db);
+}
+
+// Copies the rows of `table` with ledgerseq in [begin, end) into
+// `table`_new, decoding the base64 `columns` into binary.
+static void
+copyHistoryRangeToBinary(Database& db, std::string const& table,
+                         std::vector<std::string> const& columns,
+                         uint32_t begin, uint32_t end)
+{
+    auto& sess = db.getSession();
+    std::string colList;
+    std::string paramList;
+    for (auto const& c : columns)
+    {
+        colList += ", " + c;
+        paramList += ", :" + c;
+    }
+
+    std::string txID;
+    uint32_t ledgerSeq;
+    int txIndex;
+    std::vector<std::unique_ptr<HistoryColumn>> text, binary;
+    for (size_t i = 0; i < columns.size(); ++i)
+    {
+        text.emplace_back(make_unique<HistoryColumn>(db, sess, false));
+        binary.emplace_back(make_unique<HistoryColumn>(db, sess, true));
+    }
+
+    soci::statement sel =
+        (sess.prepare << "SELECT txid, ledgerseq, txindex" << colList
+                      << " FROM " << table
+                      << " WHERE ledgerseq >= :begin AND ledgerseq < :end");
+    sel.exchange(soci::into(txID));
+    sel.exchange(soci::into(ledgerSeq));
+    sel.exchange(soci::into(txIndex));
+    for (auto& t : text)
+    {
+        t->exchangeInto(sel);
+    }
+    sel.exchange(soci::use(begin));
+    sel.exchange(soci::use(end));
+    sel.define_and_bind();
+
+    soci::statement ins =
+        (sess.prepare << "INSERT INTO " << table
+                      << "_new (txid, ledgerseq, txindex" << colList
+                      << ") VALUES (:id, :seq, :txindex" << paramList << ")");
+    ins.exchange(soci::use(txID));
+    ins.exchange(soci::use(ledgerSeq));
+    ins.exchange(soci::use(txIndex));
+    for (auto& b : binary)
+    {
+        b->exchangeUse(ins);
+    }
+    ins.define_and_bind();
+
+    sel.execute(true);
+    while (sel.got_data())
+    {
+        for (size_t i = 0; i < columns.size(); ++i)
+        {
+            binary[i]->setBytes(text[i]->getBytes());
+        }
+        ins.execute(true);
+        sel.fetch();
+    }
+}
+
+void
+TransactionFrame::upgradeHistoryToBinary(Database& db)
+{
+    // Ledgers copied per SQL transaction.
+    uint32_t const batchSize = 1024;
+
+    auto& sess = db.getSession();
+
+    // Everything is copied into fresh tables first and swapped in at the end,
+    // so an interrupted upgrade leaves the original tables untouched and
+    // simply starts over on the next launch.
+    sess << "DROP TABLE IF EXISTS txhistory_new";
+    sess << "DROP TABLE IF EXISTS txfeehistory_new";
+    createHistoryTables(db, "_new");
+
+    std::vector<std::pair<std::string, std::vector<std::string>>> tables = {
+        {"txhistory", {"txbody", "txresult", "txmeta"}},
+        {"txfeehistory", {"txchanges"}}};
+
+    for (auto const& t : tables)
+    {
+        uint32_t minSeq = 0, maxSeq = 0;
+        soci::indicator minInd, maxInd;
+        sess << "SELECT MIN(ledgerseq), MAX(ledgerseq) FROM " << t.first,
+            soci::into(minSeq, minInd), soci::into(maxSeq, maxInd);
+        if (minInd != soci::i_ok || maxInd != soci::i_ok)
+        {
+            continue;
+        }
+        CLOG(INFO, "Database") << "Converting " << t.first << " ledgers "
+                               << minSeq << " to " << maxSeq << " to binary";
+        for (uint64_t begin = minSeq; begin <= maxSeq; begin += batchSize)
+        {
+            uint64_t end = std::min<uint64_t>(begin + batchSize,
+                                              uint64_t(maxSeq) + 1);
+            soci::transaction tx(sess);
+            copyHistoryRangeToBinary(db, t.first, t.second,
+                                     static_cast<uint32_t>(begin),
+                                     static_cast<uint32_t>(end));
+            tx.commit();
+        }
+    }
+
+    soci::transaction tx(sess);
+    sess << "DROP TABLE txhistory";
+    sess << "DROP TABLE txfeehistory";
+    sess << "ALTER TABLE txhistory_new RENAME TO txhistory";
+    sess << "ALTER TABLE txfeehistory_new RENAME TO txfeehistory";
+    if (!db.isSqlite())
+    {
+        sess << "ALTER INDEX txhistory_new_pkey RENAME TO txhistory_pkey";
+        sess << "ALTER INDEX txfeehistory_new_pkey RENAME TO "
+                "txfeehistory_pkey";
+    }
+    createHistoryIndexes(db);
+    // Record the new schema in the same transaction as the swap, so the
+    // tables and the recorded version can never disagree.
+    db.putSchemaVersion(2);
+    tx.commit();
+}
+
+size_t
+TransactionFrame::deleteOldEntries(Database& db, soci::session& sess,
+                                   uint32_t ledgerSeq)
 {
-    db.getSession() << "DELETE FROM txhistory WHERE ledgerseq <= " << ledgerSeq;
-    db.getSession() << "DELETE FROM txfeehistory WHERE ledgerseq <= "
-                    << ledgerSeq;
+    auto timer = db.getDeleteTimer("txhistory");
+    size_t rows = 0;
+    for (auto const& table : {"txhistory", "txfeehistory"})
+    {
+        soci::statement st =
+            (sess.prepare << "DELETE FROM " << table
+                          << " WHERE ledgerseq <= :v1",
+             soci::use(ledgerSeq));
+        st.execute(true);
+        rows += static_cast<size_t>(st.get_affected_rows());
+    }
+    return rows;
 }
 }
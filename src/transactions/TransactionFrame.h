@@ -8,6 +8,7 @@
 #include "ledger/LedgerManager.h"
 #include "ledger/AccountFrame.h"
 #include "overlay/StellarXDR.h"
+#include "util/CachedXDR.h"
 #include "util/types.h"
 
 namespace soci
@@ -31,6 +32,58 @@ class SHA256;
 class TransactionFrame;
 typedef std::shared_ptr<TransactionFrame> TransactionFramePtr;
 
+/*
+Rows of txhistory and txfeehistory produced while closing one ledger.
+They are kept in memory and written by flush() with multi-row INSERTs of up
+to MAX_ROWS_PER_INSERT rows each, instead of one INSERT per transaction.
+*/
+class TxHistoryBatch
+{
+    struct TxRow
+    {
+        std::string mTxID;
+        int mTxIndex;
+        std::vector<uint8_t> mBody;
+        std::vector<uint8_t> mResult;
+        std::vector<uint8_t> mMeta;
+    };
+
+    struct FeeRow
+    {
+        std::string mTxID;
+        int mTxIndex;
+        std::vector<uint8_t> mChanges;
+    };
+
+    Database& mDatabase;
+    uint32 mLedgerSeq;
+    std::vector<TxRow> mTxRows;
+    std::vector<FeeRow> mFeeRows;
+
+    void flushTxRows(size_t begin, size_t end);
+    void flushFeeRows(size_t begin, size_t end);
+
+  public:
+    static size_t const MAX_ROWS_PER_INSERT;
+
+    TxHistoryBatch(Database& db, uint32 ledgerSeq);
+
+    void addTransaction(std::string const& txID, int txindex,
+                        std::vector<uint8_t> body, std::vector<uint8_t> result,
+                        std::vector<uint8_t> meta);
+    void addFee(std::string const& txID, int txindex,
+                std::vector<uint8_t> changes);
+
+    size_t
+    size() const
+    {
+        return mTxRows.size() + mFeeRows.size();
+    }
+
+    // Write out and forget all pending rows.
+    void flush();
+};
+
 class TransactionFrame
 {
   protected:
@@ -44,6 +97,7 @@ class TransactionFrame
     Hash const& mNetworkID;     // used to change the way we compute signatures
     mutable Hash mContentsHash; // the hash of the contents
     mutable Hash mFullHash;     // the hash of the contents and the sig.
+    CachedXDR mEnvelopeBytes;   // mEnvelope, as hashed and stored
 
     std::vector<std::shared_ptr<OperationFrame>> mOperations;
 
@@ -68,6 +122,13 @@ class TransactionFrame
     Hash const& getFullHash() const;
     Hash const& getContentsHash() const;
 
+    // The XDR of the envelope, encoded once for the full hash, the tx set
+    // hash and the history tables.
+    xdr::opaque_vec<> const& getEnvelopeBytes() const;
+
+    // Compute the hashes of `txs` not computed yet, all in one sha256Batch.
+    static void computeHashes(std::vector<TransactionFramePtr> const& txs);
+
     AccountFrame::pointer
     getSourceAccountPtr() const
     {
@@ -135,6 +196,11 @@ class TransactionFrame
 
     bool checkValid(Application& app, SequenceNumber current);
 
+    // Add the keys of the entries applying this transaction is known to
+    // load: source accounts, and what each operation names. Reads the
+    // envelope only, so it works before checkValid or processFeeSeqNum.
+    void addPrefetchKeys(std::vector<LedgerKey>& keys) const;
+
     // collect fee, consume sequence number
     void processFeeSeqNum(LedgerDelta& delta, LedgerManager& ledgerManager);
 
@@ -150,12 +216,12 @@ class TransactionFrame
     AccountFrame::pointer loadAccount(Database& app,
                                       AccountID const& accountID);
 
-    // transaction history
-    void storeTransaction(LedgerManager& ledgerManager, TransactionMeta& tm,
+    // transaction history, written when `batch` is flushed
+    void storeTransaction(TxHistoryBatch& batch, TransactionMeta& tm,
                           int txindex, TransactionResultSet& resultSet) const;
 
-    // fee history
-    void storeTransactionFee(LedgerManager& ledgerManager,
+    // fee history, written when `batch` is flushed
+    void storeTransactionFee(TxHistoryBatch& batch,
                              LedgerEntryChanges const& changes,
                              int txindex) const;
 
@@ -177,6 +243,13 @@ class TransactionFrame
                                            XDROutputFileStream& txResultOut);
     static void dropAll(Database& db);
 
-    static void deleteOldEntries(Database& db, uint32_t ledgerSeq);
+    // Convert the history tables from base64 TEXT columns (schema 1) to
+    // binary columns (schema 2). See Database::upgradeToCurrentSchema.
+    static void upgradeHistoryToBinary(Database& db);
+
+    // Deletes transaction and fee history at or below ledgerSeq, returning
+    // the number of rows deleted.
+    static size_t deleteOldEntries(Database& db, soci::session& sess,
+                                   uint32_t ledgerSeq);
 };
 }
@@ -16,6 +16,9 @@
 #include "transactions/CreateAccountOpFrame.h"
 #include "transactions/ManageOfferOpFrame.h"
 #include "transactions/TxTests.h"
+#include "crypto/SHA.h"
+#include "util/CachedXDR.h"
+#include "xdrpp/marshal.h"
 
 using namespace stellar;
 using namespace stellar::txtest;
@@ -512,3 +515,35 @@ TEST_CASE("txenvelope", "[tx][envelope]")
         }
     }
 }
+
+TEST_CASE("envelope encoding", "[tx][envelope][xdr]")
+{
+    using xdr::operator==;
+    Hash networkID = sha256(getTestConfig().NETWORK_PASSPHRASE);
+    SecretKey a1 = getAccount("A");
+    SecretKey b1 = getAccount("B");
+    auto tx = createPaymentTx(networkID, a1, b1, 1, 100);
+
+    uint64_t made = 0, reused = 0;
+    CachedXDR::flushCounts(made, reused);
+
+    auto bytes = xdr::xdr_to_opaque(tx->getEnvelope());
+    REQUIRE(tx->getEnvelopeBytes() == bytes);
+    CHECK(tx->getFullHash() == sha256(bytes));
+    TxSetFrame txSet(Hash{});
+    txSet.add(tx);
+    txSet.getContentsHash();
+
+    CachedXDR::flushCounts(made, reused);
+    CHECK(made == 1);
+    CHECK(reused == 2);
+
+    SECTION("signing encodes again")
+    {
+        tx->addSignature(b1);
+        auto signedBytes = xdr::xdr_to_opaque(tx->getEnvelope());
+        CHECK(!(signedBytes == bytes));
+        CHECK(tx->getEnvelopeBytes() == signedBytes);
+        CHECK(tx->getFullHash() == sha256(signedBytes));
+    }
+}
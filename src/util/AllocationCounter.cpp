@@ -0,0 +1,74 @@
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/AllocationCounter.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace stellar
+{
+
+#ifdef COUNT_ALLOCATIONS
+static std::atomic<uint64_t> gAllocations{0};
+
+static void*
+countedAlloc(std::size_t size)
+{
+    gAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size == 0 ? 1 : size))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+#endif
+
+bool
+AllocationCounter::isEnabled()
+{
+#ifdef COUNT_ALLOCATIONS
+    return true;
+#else
+    return false;
+#endif
+}
+
+uint64_t
+AllocationCounter::getCount()
+{
+#ifdef COUNT_ALLOCATIONS
+    return gAllocations.load(std::memory_order_relaxed);
+#else
+    return 0;
+#endif
+}
+}
+
+#ifdef COUNT_ALLOCATIONS
+// the nothrow and sized forms of the standard library forward to these
+void*
+operator new(std::size_t size)
+{
+    return stellar::countedAlloc(size);
+}
+
+void*
+operator new[](std::size_t size)
+{
+    return stellar::countedAlloc(size);
+}
+
+void
+operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void
+operator delete[](void* p) noexcept
+{
+    std::free(p);
+}
+#endif
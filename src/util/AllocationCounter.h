@@ -0,0 +1,27 @@
+#pragma once
+
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include <cstdint>
+
+namespace stellar
+{
+
+/**
+ * Count of the heap allocations made through operator new by the whole
+ * process, for benchmarks to report allocations per operation.
+ *
+ * Counting replaces the global operator new, so it is only compiled in
+ * builds configured with --enable-alloc-counting (COUNT_ALLOCATIONS);
+ * elsewhere isEnabled() is false and the count stays 0.
+ */
+namespace AllocationCounter
+{
+bool isEnabled();
+
+// allocations since the process started
+uint64_t getCount();
+}
+}
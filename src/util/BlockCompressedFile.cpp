@@ -0,0 +1,271 @@
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/BlockCompressedFile.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <zlib.h>
+
+namespace stellar
+{
+
+size_t const BlockCompressedFile::BLOCK_SIZE = 256 * 1024;
+char const BlockCompressedFile::MAGIC[8] = {'S', 'T', 'B', 'K',
+                                            'Z', '0', '0', '1'};
+size_t const BlockCompressedReader::READAHEAD_SIZE = 1024 * 1024;
+
+// Each index entry is a big-endian uint64 offset followed by big-endian
+// uint32 compressed and uncompressed sizes. The footer is a big-endian uint64
+// index offset, a big-endian uint32 block count and the magic again.
+static size_t const INDEX_ENTRY_SIZE = 16;
+static size_t const FOOTER_SIZE = 20;
+
+static void
+putBE(std::vector<char>& out, uint64_t v, size_t nbytes)
+{
+    for (size_t i = nbytes; i > 0; --i)
+    {
+        out.push_back(static_cast<char>((v >> (8 * (i - 1))) & 0xFF));
+    }
+}
+
+static uint64_t
+getBE(char const* in, size_t nbytes)
+{
+    uint64_t v = 0;
+    for (size_t i = 0; i < nbytes; ++i)
+    {
+        v = (v << 8) | static_cast<uint8_t>(in[i]);
+    }
+    return v;
+}
+
+bool
+BlockCompressedFile::isBlockCompressed(std::string const& filename)
+{
+    std::ifstream in(filename, std::ifstream::binary);
+    char buf[sizeof(MAGIC)];
+    return in.read(buf, sizeof(buf)) &&
+           std::memcmp(buf, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+void
+BlockCompressedWriter::open(std::string const& filename)
+{
+    mOut.open(filename, std::ofstream::binary | std::ofstream::trunc);
+    mOut.write(BlockCompressedFile::MAGIC, sizeof(BlockCompressedFile::MAGIC));
+    mOffset = sizeof(BlockCompressedFile::MAGIC);
+    mGood = mOut.good();
+    if (!mGood)
+    {
+        std::string msg("failed to open block-compressed file: ");
+        throw std::runtime_error(msg + filename);
+    }
+    mBlock.reserve(BlockCompressedFile::BLOCK_SIZE);
+}
+
+bool
+BlockCompressedWriter::flushBlock()
+{
+    if (mBlock.empty())
+    {
+        return mGood;
+    }
+    uLongf compressedSize = compressBound(static_cast<uLong>(mBlock.size()));
+    mCompressed.resize(compressedSize);
+    if (compress2(reinterpret_cast<Bytef*>(mCompressed.data()),
+                  &compressedSize,
+                  reinterpret_cast<Bytef const*>(mBlock.data()),
+                  static_cast<uLong>(mBlock.size()), Z_BEST_SPEED) != Z_OK ||
+        !mOut.write(mCompressed.data(), compressedSize))
+    {
+        mGood = false;
+        return false;
+    }
+    mIndex.push_back({mOffset, static_cast<uint32_t>(compressedSize),
+                      static_cast<uint32_t>(mBlock.size())});
+    mOffset += compressedSize;
+    mBlock.clear();
+    return true;
+}
+
+bool
+BlockCompressedWriter::write(char const* data, size_t n)
+{
+    if (!mGood)
+    {
+        return false;
+    }
+    mBlock.insert(mBlock.end(), data, data + n);
+    if (mBlock.size() >= BlockCompressedFile::BLOCK_SIZE)
+    {
+        return flushBlock();
+    }
+    return true;
+}
+
+bool
+BlockCompressedWriter::close()
+{
+    if (!mOut.is_open())
+    {
+        return mGood;
+    }
+    if (flushBlock())
+    {
+        std::vector<char> tail;
+        tail.reserve(mIndex.size() * INDEX_ENTRY_SIZE + FOOTER_SIZE);
+        for (auto const& b : mIndex)
+        {
+            putBE(tail, b.mOffset, 8);
+            putBE(tail, b.mCompressedSize, 4);
+            putBE(tail, b.mUncompressedSize, 4);
+        }
+        putBE(tail, mOffset, 8);
+        putBE(tail, mIndex.size(), 4);
+        tail.insert(tail.end(), BlockCompressedFile::MAGIC,
+                    BlockCompressedFile::MAGIC +
+                        sizeof(BlockCompressedFile::MAGIC));
+        mOut.write(tail.data(), tail.size());
+    }
+    mOut.close();
+    mGood = mGood && !mOut.fail();
+    return mGood;
+}
+
+void
+BlockCompressedReader::open(std::string const& filename)
+{
+    std::string msg("malformed block-compressed file: ");
+    mIn.open(filename, std::ifstream::binary | std::ifstream::ate);
+    if (!mIn)
+    {
+        throw std::runtime_error("failed to open block-compressed file: " +
+                                 filename);
+    }
+
+    uint64_t fileSize = static_cast<uint64_t>(mIn.tellg());
+    char footer[FOOTER_SIZE];
+    if (fileSize < sizeof(BlockCompressedFile::MAGIC) + FOOTER_SIZE ||
+        !mIn.seekg(fileSize - FOOTER_SIZE) || !mIn.read(footer, FOOTER_SIZE) ||
+        std::memcmp(footer + 12, BlockCompressedFile::MAGIC,
+                    sizeof(BlockCompressedFile::MAGIC)) != 0)
+    {
+        throw std::runtime_error(msg + filename);
+    }
+
+    uint64_t indexOffset = getBE(footer, 8);
+    uint64_t nBlocks = getBE(footer + 8, 4);
+    if (indexOffset + nBlocks * INDEX_ENTRY_SIZE + FOOTER_SIZE != fileSize)
+    {
+        throw std::runtime_error(msg + filename);
+    }
+
+    std::vector<char> index(nBlocks * INDEX_ENTRY_SIZE);
+    if (!mIn.seekg(indexOffset) || !mIn.read(index.data(), index.size()))
+    {
+        throw std::runtime_error(msg + filename);
+    }
+    mIndex.clear();
+    mIndex.reserve(nBlocks);
+    for (size_t i = 0; i < nBlocks; ++i)
+    {
+        char const* e = index.data() + i * INDEX_ENTRY_SIZE;
+        BlockCompressedFile::BlockInfo b{getBE(e, 8),
+                                         static_cast<uint32_t>(getBE(e + 8, 4)),
+                                         static_cast<uint32_t>(
+                                             getBE(e + 12, 4))};
+        if (b.mOffset + b.mCompressedSize > indexOffset)
+        {
+            throw std::runtime_error(msg + filename);
+        }
+        mIndex.push_back(b);
+    }
+
+    mBlock.clear();
+    mBlockPos = 0;
+    mNextBlock = 0;
+    mReadaheadPos = 0;
+    mReadaheadEnd = 0;
+    mGood = true;
+}
+
+void
+BlockCompressedReader::close()
+{
+    mIn.close();
+    mGood = false;
+}
+
+bool
+BlockCompressedReader::loadNextBlock()
+{
+    if (mNextBlock >= mIndex.size())
+    {
+        return false;
+    }
+
+    if (mNextBlock >= mReadaheadEnd)
+    {
+        // Pull in the compressed bytes of as many consecutive blocks as fit
+        // in READAHEAD_SIZE (always at least one) with a single read; blocks
+        // are contiguous on disk so this is one sequential read.
+        size_t end = mNextBlock;
+        uint64_t bytes = 0;
+        do
+        {
+            bytes += mIndex[end].mCompressedSize;
+            ++end;
+        } while (end < mIndex.size() &&
+                 bytes + mIndex[end].mCompressedSize <= READAHEAD_SIZE);
+
+        mReadahead.resize(bytes);
+        if (!mIn.seekg(mIndex[mNextBlock].mOffset) ||
+            !mIn.read(mReadahead.data(), bytes))
+        {
+            mGood = false;
+            return false;
+        }
+        mReadaheadPos = 0;
+        mReadaheadEnd = end;
+    }
+
+    auto const& b = mIndex[mNextBlock];
+    mBlock.resize(b.mUncompressedSize);
+    uLongf outSize = b.mUncompressedSize;
+    if (uncompress(reinterpret_cast<Bytef*>(mBlock.data()), &outSize,
+                   reinterpret_cast<Bytef const*>(mReadahead.data() +
+                                                  mReadaheadPos),
+                   b.mCompressedSize) != Z_OK ||
+        outSize != b.mUncompressedSize)
+    {
+        mGood = false;
+        return false;
+    }
+    mReadaheadPos += b.mCompressedSize;
+    mBlockPos = 0;
+    ++mNextBlock;
+    return true;
+}
+
+bool
+BlockCompressedReader::read(char* buf, size_t n)
+{
+    while (n > 0)
+    {
+        if (mBlockPos == mBlock.size() && !loadNextBlock())
+        {
+            mGood = false;
+            return false;
+        }
+        size_t chunk = std::min(n, mBlock.size() - mBlockPos);
+        std::memcpy(buf, mBlock.data() + mBlockPos, chunk);
+        mBlockPos += chunk;
+        buf += chunk;
+        n -= chunk;
+    }
+    return true;
+}
+}
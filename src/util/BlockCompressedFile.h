@@ -0,0 +1,108 @@
+#pragma once
+
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/NonCopyable.h"
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace stellar
+{
+
+/**
+ * A simple block-compressed file container, used to keep local bucket files
+ * compressed on disk while still allowing them to be streamed.
+ *
+ * The file starts with an 8-byte magic (whose first byte has the high bit
+ * clear, so it can never be mistaken for a raw XDR record stream) followed by
+ * a sequence of independently deflated blocks, each holding roughly
+ * BLOCK_SIZE bytes of uncompressed data. At the tail is an index giving the
+ * offset and sizes of every block, followed by a fixed-size footer pointing
+ * at the index. Blocks are compressed at Z_BEST_SPEED: the goal is to cut
+ * disk usage and IO without making merges CPU bound.
+ */
+class BlockCompressedFile
+{
+  public:
+    static size_t const BLOCK_SIZE;
+    static char const MAGIC[8];
+
+    struct BlockInfo
+    {
+        uint64_t mOffset;
+        uint32_t mCompressedSize;
+        uint32_t mUncompressedSize;
+    };
+
+    // Returns true if `filename` starts with the block-compressed magic.
+    static bool isBlockCompressed(std::string const& filename);
+};
+
+class BlockCompressedWriter : NonCopyable
+{
+    std::ofstream mOut;
+    std::vector<char> mBlock;
+    std::vector<char> mCompressed;
+    std::vector<BlockCompressedFile::BlockInfo> mIndex;
+    uint64_t mOffset{0};
+    bool mGood{false};
+
+    bool flushBlock();
+
+  public:
+    void open(std::string const& filename);
+
+    // Appends `n` bytes. A block is only ever cut between calls, so callers
+    // writing one whole record per call never have records straddle blocks.
+    bool write(char const* data, size_t n);
+
+    // Flushes the last block and writes the index and footer.
+    bool close();
+
+    bool
+    good() const
+    {
+        return mGood;
+    }
+};
+
+class BlockCompressedReader : NonCopyable
+{
+    std::ifstream mIn;
+    std::vector<BlockCompressedFile::BlockInfo> mIndex;
+
+    // Compressed bytes of blocks [mNextBlock, mReadaheadEnd), read from disk
+    // in a single call.
+    std::vector<char> mReadahead;
+    size_t mReadaheadPos{0};
+    size_t mReadaheadEnd{0};
+
+    std::vector<char> mBlock;
+    size_t mBlockPos{0};
+    size_t mNextBlock{0};
+    bool mGood{false};
+
+    bool loadNextBlock();
+
+  public:
+    // Upper bound on compressed bytes fetched per disk read.
+    static size_t const READAHEAD_SIZE;
+
+    void open(std::string const& filename);
+    void close();
+
+    // Reads exactly `n` bytes into `buf`, returning false (and clearing
+    // good()) on end of file or a corrupt block.
+    bool read(char* buf, size_t n);
+
+    bool
+    good() const
+    {
+        return mGood;
+    }
+};
+}
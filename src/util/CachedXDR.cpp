@@ -0,0 +1,32 @@
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/CachedXDR.h"
+#include <atomic>
+
+namespace stellar
+{
+
+static std::atomic<uint64_t> gEncodingsMade{0};
+static std::atomic<uint64_t> gEncodingsReused{0};
+
+void
+CachedXDR::noteMade()
+{
+    ++gEncodingsMade;
+}
+
+void
+CachedXDR::noteReused()
+{
+    ++gEncodingsReused;
+}
+
+void
+CachedXDR::flushCounts(uint64_t& made, uint64_t& reused)
+{
+    made = gEncodingsMade.exchange(0);
+    reused = gEncodingsReused.exchange(0);
+}
+}
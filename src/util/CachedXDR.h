@@ -0,0 +1,61 @@
+#pragma once
+
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "xdrpp/marshal.h"
+#include <cstdint>
+
+namespace stellar
+{
+
+/**
+ * XDR encoding of a value, made when first asked for and kept until clear().
+ *
+ * For frames whose object is encoded by several of the hashing, storage and
+ * network paths: they all get() the same bytes, and the frame clear()s them
+ * whenever it changes the object, along with its other cached values.
+ *
+ * How many encodings were made and how many were served from a cache are
+ * counted for the whole process, for the xdr.encode meters.
+ */
+class CachedXDR
+{
+    mutable xdr::opaque_vec<> mBytes;
+    mutable bool mValid{false};
+
+  public:
+    // The encoding of `args`, which must be what the previous call encoded
+    // unless clear() was called since.
+    template <typename... Args>
+    xdr::opaque_vec<> const&
+    get(Args const&... args) const
+    {
+        if (mValid)
+        {
+            noteReused();
+        }
+        else
+        {
+            mBytes = xdr::xdr_to_opaque(args...);
+            mValid = true;
+            noteMade();
+        }
+        return mBytes;
+    }
+
+    void
+    clear()
+    {
+        mValid = false;
+        mBytes.clear();
+    }
+
+    static void noteMade();
+    static void noteReused();
+
+    // Encodings made and reused since the last flush, which zeroes them.
+    static void flushCounts(uint64_t& made, uint64_t& reused);
+};
+}
@@ -7,8 +7,11 @@
 #include "lib/catch.hpp"
 #include "util/Logging.h"
 #include "lib/util/uint128_t.h"
+#include "util/types.h"
+#include <chrono>
 #include <limits>
 #include <ostream>
+#include <random>
 
 // This file just cross-checks a selection of operators in the uint128_t class
 // against the values produced by native (compiler-provided) __int128 types,
@@ -88,3 +91,132 @@ TEST_CASE("uint128_t", "[uint128]")
 }
 
 #endif
+
+// bigDivide takes the native path where there is one; either way it must
+// agree with the portable class.
+
+namespace
+{
+bool
+sameBigDivide(uint64_t a, uint64_t b, uint64_t c)
+{
+    uint64_t r1 = 0, r2 = 0;
+    bool ok1 = stellar::bigDivide(r1, a, b, c);
+    bool ok2 = stellar::bigDividePortable(r2, a, b, c);
+    return ok1 == ok2 && (!ok1 || r1 == r2);
+}
+
+// values of any width, so that products land on both sides of 64 bits
+struct gen64
+{
+    typedef uint64_t result_type;
+    result_type operator()(size_t size = 0)
+    {
+        std::uniform_int_distribution<int> bits(1, 64);
+        std::uniform_int_distribution<uint64_t> dist(
+            1, std::numeric_limits<uint64_t>::max());
+        int n = bits(autocheck::rng());
+        auto x = dist(autocheck::rng());
+        return n == 64 ? x : (x & ((uint64_t(1) << n) - 1)) | 1;
+    }
+};
+}
+
+TEST_CASE("bigDivide edge values", "[uint128][bigdivide]")
+{
+    uint64_t const max = std::numeric_limits<uint64_t>::max();
+    std::vector<uint64_t> values = {0,
+                                    1,
+                                    2,
+                                    3,
+                                    (1ull << 31) - 1,
+                                    1ull << 31,
+                                    (1ull << 32) - 1,
+                                    1ull << 32,
+                                    (1ull << 32) + 1,
+                                    (1ull << 63) - 1,
+                                    1ull << 63,
+                                    max - 1,
+                                    max};
+    for (auto a : values)
+    {
+        for (auto b : values)
+        {
+            for (auto c : values)
+            {
+                if (c != 0)
+                {
+                    REQUIRE(sameBigDivide(a, b, c));
+                }
+            }
+        }
+    }
+
+    uint64_t r;
+    REQUIRE(stellar::bigDivide(r, max, max, max));
+    REQUIRE(r == max);
+    REQUIRE(!stellar::bigDivide(r, max, 2, 1));
+    REQUIRE(stellar::bigDivide(r, 1ull << 32, 1ull << 31, 1ull << 32));
+    REQUIRE(r == 1ull << 31);
+
+    int64_t s;
+    REQUIRE(stellar::bigDivide(s, INT64_MAX, 3, 3));
+    REQUIRE(s == INT64_MAX);
+    REQUIRE(!stellar::bigDivide(s, INT64_MAX, 2, 1));
+}
+
+TEST_CASE("bigDivide against uint128_t", "[uint128][bigdivide]")
+{
+    auto arb = autocheck::make_arbitrary(gen64(), gen64(), gen64());
+    autocheck::check<uint64_t, uint64_t, uint64_t>(
+        [](uint64_t a, uint64_t b, uint64_t c)
+        {
+            return sameBigDivide(a, b, c);
+        },
+        100000, arb);
+}
+
+TEST_CASE("bigDivide bench", "[uint128][bigdivide][bench][hide]")
+{
+    size_t const iterations = 1000000;
+
+    // amounts and prices as offer crossing sees them
+    std::uniform_int_distribution<int64_t> amounts(1, INT64_MAX);
+    std::uniform_int_distribution<int32_t> prices(1, INT32_MAX);
+    std::vector<uint64_t> args;
+    for (size_t i = 0; i < iterations; i++)
+    {
+        args.push_back(amounts(autocheck::rng()));
+        args.push_back(prices(autocheck::rng()));
+        args.push_back(prices(autocheck::rng()));
+    }
+
+    uint64_t sum1 = 0, sum2 = 0, r;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < args.size(); i += 3)
+    {
+        if (stellar::bigDividePortable(r, args[i], args[i + 1], args[i + 2]))
+        {
+            sum1 += r;
+        }
+    }
+    std::chrono::duration<double> portable =
+        std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < args.size(); i += 3)
+    {
+        if (stellar::bigDivide(r, args[i], args[i + 1], args[i + 2]))
+        {
+            sum2 += r;
+        }
+    }
+    std::chrono::duration<double> fast =
+        std::chrono::steady_clock::now() - start;
+
+    REQUIRE(sum1 == sum2);
+    LOG(INFO) << "bigDivide with uint128_t: "
+              << (portable.count() * 1e9 / iterations)
+              << "ns, bigDivide: " << (fast.count() * 1e9 / iterations)
+              << "ns";
+}
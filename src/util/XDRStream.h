@@ -10,29 +10,56 @@
 #include "xdrpp/marshal.h"
 #include "crypto/SHA.h"
 #include "crypto/ByteSlice.h"
+#include "util/BlockCompressedFile.h"
+#include "util/NonCopyable.h"
+#include "util/make_unique.h"
+#include <zlib.h>
 
 namespace stellar
 {
 
 /**
  * Helper for loading a sequence of XDR objects from a file one at a time,
- * rather than all at once.
+ * rather than all at once. Block-compressed files (see BlockCompressedFile)
+ * are detected on open and decompressed transparently.
  */
 class XDRInputFileStream
 {
     std::ifstream mIn;
+    std::unique_ptr<BlockCompressedReader> mBlocks;
     std::vector<char> mBuf;
 
+    bool
+    readBytes(char* buf, size_t n)
+    {
+        if (mBlocks)
+        {
+            return mBlocks->read(buf, n);
+        }
+        return static_cast<bool>(mIn.read(buf, n));
+    }
+
   public:
     void
     close()
     {
+        if (mBlocks)
+        {
+            mBlocks->close();
+            mBlocks.reset();
+        }
         mIn.close();
     }
 
     void
     open(std::string const& filename)
     {
+        if (BlockCompressedFile::isBlockCompressed(filename))
+        {
+            mBlocks = make_unique<BlockCompressedReader>();
+            mBlocks->open(filename);
+            return;
+        }
         mIn.open(filename, std::ifstream::binary);
         if (!mIn)
         {
@@ -43,7 +70,7 @@ class XDRInputFileStream
 
     operator bool() const
     {
-        return mIn.good();
+        return mBlocks ? mBlocks->good() : mIn.good();
     }
 
     template <typename T>
@@ -51,7 +78,7 @@ class XDRInputFileStream
     readOne(T& out)
     {
         char szBuf[4];
-        if (!mIn.read(szBuf, 4))
+        if (!readBytes(szBuf, 4))
         {
             return false;
         }
@@ -71,7 +98,7 @@ class XDRInputFileStream
         {
             mBuf.resize(sz);
         }
-        if (!mIn.read(mBuf.data(), sz))
+        if (!readBytes(mBuf.data(), sz))
         {
             throw xdr::xdr_runtime_error("malformed XDR file");
         }
@@ -81,23 +108,72 @@ class XDRInputFileStream
     }
 };
 
-class XDROutputFileStream
+/**
+ * Helper for writing a sequence of XDR objects to a file one at a time. If
+ * opened as GZIP or BLOCK_COMPRESSED, the file is compressed in-process as
+ * it's written; hashes and byte counts passed to writeOne are always over the
+ * uncompressed XDR.
+ */
+class XDROutputFileStream : NonCopyable
 {
     std::ofstream mOut;
+    gzFile mGzOut{nullptr};
+    bool mGzGood{false};
+    std::unique_ptr<BlockCompressedWriter> mBlocks;
     std::vector<char> mBuf;
 
   public:
-    void
+    enum Format
+    {
+        RAW,
+        GZIP,
+        BLOCK_COMPRESSED
+    };
+
+    ~XDROutputFileStream()
+    {
+        if (mGzOut)
+        {
+            gzclose(mGzOut);
+        }
+    }
+
+    // Returns false if any buffered data could not be flushed.
+    bool
     close()
     {
+        if (mGzOut)
+        {
+            mGzGood = (gzclose(mGzOut) == Z_OK) && mGzGood;
+            mGzOut = nullptr;
+            return mGzGood;
+        }
+        if (mBlocks)
+        {
+            return mBlocks->close();
+        }
         mOut.close();
+        return !mOut.fail();
     }
 
     void
-    open(std::string const& filename)
+    open(std::string const& filename, Format format = RAW)
     {
-        mOut.open(filename, std::ofstream::binary | std::ofstream::trunc);
-        if (!mOut)
+        if (format == GZIP)
+        {
+            mGzOut = gzopen(filename.c_str(), "wb");
+            mGzGood = (mGzOut != nullptr);
+        }
+        else if (format == BLOCK_COMPRESSED)
+        {
+            mBlocks = make_unique<BlockCompressedWriter>();
+            mBlocks->open(filename);
+        }
+        else
+        {
+            mOut.open(filename, std::ofstream::binary | std::ofstream::trunc);
+        }
+        if (!*this)
         {
             std::string msg("failed to open XDR file: ");
             throw std::runtime_error(msg + filename);
@@ -106,7 +182,11 @@ class XDROutputFileStream
 
     operator bool() const
     {
-        return mOut.good();
+        if (mGzOut)
+        {
+            return mGzGood;
+        }
+        return mBlocks ? mBlocks->good() : mOut.good();
     }
 
     template <typename T>
@@ -131,7 +211,22 @@ class XDROutputFileStream
         xdr::xdr_put p(mBuf.data() + 4, mBuf.data() + 4 + sz);
         xdr_argpack_archive(p, t);
 
-        if (!mOut.write(mBuf.data(), sz + 4))
+        if (mGzOut)
+        {
+            if (gzwrite(mGzOut, mBuf.data(), sz + 4) != int(sz + 4))
+            {
+                mGzGood = false;
+                return false;
+            }
+        }
+        else if (mBlocks)
+        {
+            if (!mBlocks->write(mBuf.data(), sz + 4))
+            {
+                return false;
+            }
+        }
+        else if (!mOut.write(mBuf.data(), sz + 4))
         {
             return false;
         }
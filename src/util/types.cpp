@@ -143,7 +143,27 @@ bigDivide(int64_t& result, int64_t A, int64_t B, int64_t C)
 bool
 bigDivide(uint64_t& result, uint64_t A, uint64_t B, uint64_t C)
 {
-    // update when moving to (signed) int128
+    // amounts and prices usually multiply without leaving 64 bits
+    if (((A | B) >> 32) == 0)
+    {
+        result = (A * B) / C;
+        return true;
+    }
+
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 x = ((unsigned __int128)A * B) / C;
+
+    result = (uint64_t)x;
+
+    return (x <= UINT64_MAX);
+#else
+    return bigDividePortable(result, A, B, C);
+#endif
+}
+
+bool
+bigDividePortable(uint64_t& result, uint64_t A, uint64_t B, uint64_t C)
+{
     uint128_t a(A);
     uint128_t b(B);
     uint128_t c(C);